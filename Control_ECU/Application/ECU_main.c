@@ -12,51 +12,94 @@
 #include "eeprom.h"
 #include "adc.h"
 #include "Buzzer.h"
+#include "motor.h"
+#include "uart.h"
+#include "sysctl.h"
+#include "protocol.h"
+#include "config.h"
+#include "users.h"
+#include "audit.h"
+#include "lockout.h"
+#include "pinhash.h"
+#include "pinauth.h"
+#include "wear.h"
 
 void ClearPasswordBuffer(void);
 void System_Init(void);
-uint8_t VerifyPassword(const char* input, const char* stored);
+uint8_t VerifyPassword(const char* input, const uint8_t* stored);
 void Door_Init(void);
 void Door_Lock(void);
 void Door_Unlock(void);
+static void Telemetry_EepromBusy(uint8_t busy);
+static uint8_t IsMasterPassword(const char *pwd);
 
 /**************************
  *                              Definitions                                    *
  **************************/
 
 #define PASSWORD_LENGTH         5       /* 5-digit password */
-#define PASSWORD_EEPROM_BLOCK   0       /* Store password in block 0 */
-#define PASSWORD_EEPROM_OFFSET  0       /* Starting at offset 0 */
+#define PASSWORD_EEPROM_OFFSET  0       /* Word offset in the config record */
+#define PASSWORD_SIZE           PINHASH_SIZE    /* hash, not digits (pinhash.h) */
 #define TIMEOUT_EEPROM_OFFSET   4       /* Store timeout at offset 4 */
+                                        /* Words 2-3: lockout counters (lockout.h) */
+#define EPOCH_EEPROM_OFFSET     5       /* PIN challenge epoch (Challenge_Epoch) */
 
 #define MIN_TIMEOUT             5       /* Minimum timeout in seconds */
 #define MAX_TIMEOUT             30      /* Maximum timeout in seconds */
-#define MAX_ATTEMPTS            3       /* Maximum password attempts */
-#define LOCKOUT_DURATION        10      /* Lockout duration in seconds */
 
 /* Door LED Pins */
 #define DOOR_LED_RED            PIN1    /* PF1 - Red (Locked) */
 #define DOOR_LED_GREEN          PIN3    /* PF3 - Green (Unlocked) */
 #define STATUS_LED_BLUE         PIN2    /* PF2 - Status/Feedback */
-#define TIMER0_1MS_RELOAD 16000
 #include "GPTM_TIMER0.h"
+#include "GPTM_TIMER1.h"
 
 static char buffer[PASSWORD_LENGTH + 1];
 static uint8_t password_index = 0;
-static char stored_password[PASSWORD_LENGTH + 1] = {0};    /* Password from EEPROM */
-static uint8_t attempt_count = 0;
+static PROTO_Parser link_parser;                            /* HMI link decoder */
+static uint8_t event_seq = 0;                               /* Sequence of unsolicited events */
+static uint8_t door_state = PROTO_DOOR_LOCKED;              /* Door cycle phase */
+static PROTO_Frame door_request;                            /* Open request awaiting its reply */
+static PROTO_Frame store_request;                           /* Store awaiting its EEPROM commit */
+static uint8_t store_pending = 0;                           /* store_request not answered yet */
+static uint8_t lock_requested = 0;                          /* Lock-now seen while unlocking */
+static uint8_t baud_probation = 0;                          /* New rate not yet confirmed */
+static uint32_t baud_switch_time = 0;                       /* SysTick_GetMs() of the switch */
+static PROTO_ErrorWatch link_errors;                        /* Framing errors -> fallback */
+static uint8_t telemetry_on = 0;                            /* HMI subscribed */
+static uint8_t telemetry_sent[PROTO_TLM_SIZE];              /* Last record published */
+static uint8_t eeprom_busy = 0;                             /* Write / erase in progress */
+static uint8_t pin_session = 0;                             /* Streamed PIN being checked */
+static uint8_t pin_received = 0;                            /* Bit per digit index, 0 = idle */
+static char pin_digits[PASSWORD_LENGTH + 1];                /* Digits of the session so far */
+static uint16_t verified_user = PROTO_AUDIT_NOBODY;         /* Last PIN verified, for the log */
+static uint32_t audit_first = 0;                            /* Query being streamed: entry numbers */
+static uint32_t audit_next = 0;
+static uint32_t audit_stop = 0;
+static PROTO_Frame verdict_request;                         /* PIN check awaiting the lockout commit */
+static uint8_t verdict_status = PROTO_STATUS_OK;
+static uint8_t verdict_reply[4];
+static uint8_t verdict_length = 0;
+static uint8_t verdict_pending = 0;                         /* verdict_request not answered yet */
+static uint8_t stored_password[PASSWORD_SIZE] = {0};       /* Password hash from EEPROM */
+static uint8_t challenge[PINAUTH_CHALLENGE_SIZE];           /* Opens the next sealed PIN frame */
+static uint8_t pin_challenge[PINAUTH_CHALLENGE_SIZE];       /* Spent on the PIN_DIGIT session */
+static uint32_t challenge_epoch = 0;                        /* Stored, bumped at every boot */
+static uint32_t challenge_count = 0;                        /* Challenges drawn this epoch */
+static uint8_t epoch_saved = 0;                             /* challenge_epoch is in EEPROM */
 static uint8_t auto_lock_timeout = 10;  /* Default 10 seconds */
-static uint8_t pending_timeout = 10;     /* Temp value when adjusting */
 
 
 #define SYSTICK_1MS_RELOAD   16000U
 #define DOOR_MOVE_DELAY_MS  3000U
+#define DOOR_HOLD_DELAY_MS  2000U
+#define ALARM_DURATION_MS   3000U
 #define TIMER0_1MS_RELOAD 16000U
 
 void System_Init(void)
 {
     /* Initialize SysTick for delays */
-    SysTick_Init(SYSTICK_1MS_RELOAD, SYSTICK_NOINT);
+    SysTick_Init(SYSTICK_1MS_RELOAD, SYSTICK_INT);
     
     /* Initialize LCD */
     //LCD_Init();
@@ -72,6 +115,9 @@ void System_Init(void)
     //POT_Init();
     
     Buzzer_Init();
+
+    /* Free-running cycle counter for EEPROM timing */
+    GPTM_Timer1A_Init();
 }
 /*
  * Door_Init
@@ -98,80 +144,177 @@ void ClearPasswordBuffer(void)
 }
 
 
+/*
+ * StoreConfig_Reply
+ * Answers a store request once its outcome is known; a new timeout takes
+ * effect only when it is stored.
+ */
+static void StoreConfig_Reply(const PROTO_Frame *request, uint8_t result, uint32_t written)
+{
+    uint8_t count = (uint8_t)written;
+
+    Audit_Log((request->type == PROTO_CMD_STORE_TIMEOUT) ? PROTO_AUDIT_TIMEOUT : PROTO_AUDIT_PASSWORD,
+              (result == EEPROM_SUCCESS) ? PROTO_STATUS_OK : PROTO_STATUS_FAIL, verified_user);
+    if(result != EEPROM_SUCCESS)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+        return;
+    }
+    if(request->type == PROTO_CMD_STORE_TIMEOUT)
+    {
+        auto_lock_timeout = request->payload[0];
+    }
+    PROTO_Reply(request, PROTO_STATUS_OK, &count, 1);
+}
+
+/* Completion of the queued EEPROM write of store_request */
+static void StoreConfig_Done(uint8_t result, uint32_t written)
+{
+    store_pending = 0;
+    Telemetry_EepromBusy(0);
+    StoreConfig_Reply(&store_request, result, written);
+}
+
+/*
+ * StoreConfig_Busy
+ * Turns away a store while another one is being written: BUSY, or nothing
+ * for a retransmission of that one, whose reply is on its way.
+ * Returns: 1 if request was dealt with
+ */
+static uint8_t StoreConfig_Busy(const PROTO_Frame *request)
+{
+    if(!store_pending)
+    {
+        return 0;
+    }
+    if(request->type != store_request.type || request->seq != store_request.seq)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BUSY, 0, 0);
+    }
+    return 1;
+}
+
+/*
+ * StoreConfig
+ * Writes a config field to EEPROM through the write queue and replies
+ * when it is committed; the dispatcher keeps serving the link meanwhile.
+ * Saving an unchanged value is answered at once without touching the
+ * EEPROM or raising the busy flag.
+ */
+static void StoreConfig(const PROTO_Frame *request, uint32_t offset, const uint8_t *data, uint32_t length)
+{
+    if(StoreConfig_Busy(request))
+    {
+        return;
+    }
+
+    if(Config_Matches(offset, data, length))
+    {
+        StoreConfig_Reply(request, EEPROM_SUCCESS, 0);
+        return;
+    }
+
+    store_request = *request;
+    if(Config_Submit(offset, data, length, StoreConfig_Done) != EEPROM_SUCCESS)
+    {
+        StoreConfig_Reply(request, EEPROM_ERROR, 0);
+        return;
+    }
+    store_pending = 1;
+    Telemetry_EepromBusy(1);
+}
+
 /*
  * StorePassword
- * Stores the password in EEPROM.
+ * Stores the hash of the password (pinhash.h) in EEPROM; the reply to
+ * request follows the commit. Saving the stored password again keeps its
+ * hash, so it is a no-op like any unchanged value.
  */
-uint8_t StorePassword(const char* pwd)
+void StorePassword(const PROTO_Frame *request, const char* pwd)
 {
-    uint8_t tmp_buffer[8] = {0};  /* Initialize with zeros */
-    uint8_t i;
-    
-    /* Convert password string to bytes */
-    for(i = 0; i < PASSWORD_LENGTH; i++)
+    uint8_t hash[PASSWORD_SIZE];
+
+    if(StoreConfig_Busy(request))
     {
-        tmp_buffer[i] = (uint8_t)pwd[i];
+        return;                     /* not worth a hash */
     }
-    
-    /* Write to EEPROM - must be multiple of 4 bytes, so write 8 bytes */
-    return EEPROM_WriteBuffer(PASSWORD_EEPROM_BLOCK, PASSWORD_EEPROM_OFFSET, tmp_buffer, 8);
+    if(IsMasterPassword(pwd) && !PinHash_IsPlain(stored_password))
+    {
+        memcpy(hash, stored_password, PASSWORD_SIZE);
+    }
+    else
+    {
+        PinHash_Make(pwd, hash);
+    }
+    StoreConfig(request, PASSWORD_EEPROM_OFFSET, hash, PASSWORD_SIZE);
 }
 
 
 /*
  * RetrievePassword
- * Retrieves the stored password from EEPROM.
+ * Retrieves the stored password hash (from the RAM shadow of the EEPROM).
  */
-uint8_t RetrievePassword(char* pwd)
+uint8_t RetrievePassword(uint8_t* hash)
 {
-    uint8_t local_buffer[8] = {0};  /* Initialize with zeros */
-    //uint8_t i;
-    uint8_t result;
-    
-    /* Read from EEPROM - read 8 bytes */
-    result = EEPROM_ReadBuffer(PASSWORD_EEPROM_BLOCK, PASSWORD_EEPROM_OFFSET, local_buffer, 8);
-    
-    if(result == EEPROM_SUCCESS)
+    return Config_Read(PASSWORD_EEPROM_OFFSET, hash, PASSWORD_SIZE);
+}
+
+/*
+ * UpgradePassword
+ * Replaces a password stored in plain by older firmware with its hash and
+ * scrubs the older record copies that still hold the digits. Until it
+ * succeeds (next boot, if the EEPROM failed) the plain one is still
+ * checked.
+ */
+static void UpgradePassword(void)
+{
+    uint8_t hash[PASSWORD_SIZE];
+    char pwd[PASSWORD_LENGTH + 1];
+    uint32_t written;
+
+    if(RetrievePassword(stored_password) != EEPROM_SUCCESS ||
+       !Config_IsSet(PASSWORD_EEPROM_OFFSET, PASSWORD_SIZE) ||
+       !PinHash_IsPlain(stored_password))
     {
-        
-        /* Convert bytes to password string */
-        for(uint8_t i = 0; i < PASSWORD_LENGTH; i++)
-        {
-            pwd[i] = (char)local_buffer[i];
-        }
-        pwd[PASSWORD_LENGTH] = '\0';
+        return;
+    }
+    memcpy(pwd, stored_password, PASSWORD_LENGTH);
+    pwd[PASSWORD_LENGTH] = '\0';
+    PinHash_Make(pwd, hash);
+    if(Config_Write(PASSWORD_EEPROM_OFFSET, hash, PASSWORD_SIZE, &written) == EEPROM_SUCCESS)
+    {
+        Config_Forget();
     }
-    
-    return result;
 }
 
 
 
-uint8_t StoreTimeout(uint8_t timeout)
+void StoreTimeout(const PROTO_Frame *request, uint8_t timeout)
 {
     uint8_t timeout_Buffer [4] = {0};  /* Initialize with zeros */
     timeout_Buffer[0] = timeout;
     
-    /* Write to EEPROM - write 4 bytes (multiple of 4) */
-    return EEPROM_WriteBuffer(PASSWORD_EEPROM_BLOCK, TIMEOUT_EEPROM_OFFSET, timeout_Buffer, 4);
+    /* Write through to EEPROM - write 4 bytes (multiple of 4) */
+    StoreConfig(request, TIMEOUT_EEPROM_OFFSET, timeout_Buffer, 4);
 }
 /*
  * RetrieveTimeout
- * Retrieves the timeout value from EEPROM.
+ * Retrieves the timeout value (from the RAM shadow of the EEPROM).
  */
 uint8_t RetrieveTimeout(uint8_t* timeout)
 {
     uint8_t timeout_Buffer[4] = {0};  /* Initialize with zeros */
     uint8_t result;
     
-    /* Read from EEPROM - read 4 bytes */
-    result = EEPROM_ReadBuffer(PASSWORD_EEPROM_BLOCK, TIMEOUT_EEPROM_OFFSET, timeout_Buffer, 4);
+    /* Read 4 bytes */
+    result = Config_Read(TIMEOUT_EEPROM_OFFSET, timeout_Buffer, 4);
     
     if(result == EEPROM_SUCCESS)
     {
         *timeout = timeout_Buffer[0];
-        /* Validate timeout range */
-        if(*timeout < MIN_TIMEOUT || *timeout > MAX_TIMEOUT)
+        /* Never set, or out of range */
+        if(!Config_IsSet(TIMEOUT_EEPROM_OFFSET, 4) ||
+           *timeout < MIN_TIMEOUT || *timeout > MAX_TIMEOUT)
         {
             *timeout = 10; 
         }
@@ -182,289 +325,1386 @@ uint8_t RetrieveTimeout(uint8_t* timeout)
 
 /*
  * VerifyPassword
- * Compares input password with stored password.
+ * Checks the input password against the stored hash (pinhash.h). Takes
+ * the same time whichever digits are wrong.
  */
-uint8_t VerifyPassword(const char* input, const char* stored)
+uint8_t VerifyPassword(const char* input, const uint8_t* stored)
 {
-    uint8_t i;
-    for(i = 0; i < PASSWORD_LENGTH; i++)
+    return PinHash_Check(input, stored);
+}
+
+/*
+ * Door_SecondsLeft
+ * Seconds until the current door phase ends, rounded up so the HMI never
+ * shows 0 before the phase is over. 0 while locked.
+ */
+static uint8_t Door_SecondsLeft(void)
+{
+    if(door_state == PROTO_DOOR_LOCKED)
     {
-        if(input[i] != stored[i])
-        {
-            return 0;  /* Password mismatch */
-        }
+        return 0;
     }
-    return 1;  /* Password match */
+    return (uint8_t)((GPTM_Timer0A_Remaining() / TIMER0_1MS_RELOAD + 999U) / 1000U);
 }
 
+/*
+ * Telemetry_Read
+ * Fills a PROTO_TLM_SIZE record with the current actuator state.
+ */
+static void Telemetry_Read(uint8_t *record)
+{
+    uint16_t lockout = Lockout_Remaining();
+
+    record[PROTO_TLM_DOOR] = door_state;
+    record[PROTO_TLM_MOTOR] = Motor_GetDirection();     /* same encoding as PROTO_MOTOR_xxx */
+    record[PROTO_TLM_SECONDS] = Door_SecondsLeft();
+    record[PROTO_TLM_FLAGS] = (Buzzer_IsOn() ? PROTO_TLM_BUZZER : 0) |
+                              (eeprom_busy ? PROTO_TLM_EEPROM_BUSY : 0);
+    record[PROTO_TLM_LOCKOUT] = (uint8_t)(lockout >> 8);
+    record[PROTO_TLM_LOCKOUT + 1] = (uint8_t)(lockout & 0xFF);
+}
 
-//////////////////////////////////////////
-void UART_SavePasswordCase()
+/*
+ * Telemetry_Task
+ * Publishes the record to a subscribed HMI whenever a field changed.
+ */
+void Telemetry_Task(void)
 {
-       char received ;
-     //UART0_SendChar(received);
-     
-  while(1){
-     if(UART5_IsDataAvailable())
-        {
-      received = UART5_ReceiveChar();
-     //UART0_SendChar(received);
-    if(received >= '0' && received <= '9')
+    uint8_t record[PROTO_TLM_SIZE];
+
+    if(!telemetry_on)
     {
-        if(password_index < PASSWORD_LENGTH)
-        {
-            buffer[password_index++] = received;
-        }
-        break;
+        return;
     }
-    else if(received == '\0')
+
+    Telemetry_Read(record);
+    if(memcmp(record, telemetry_sent, PROTO_TLM_SIZE) != 0)
     {
-      
-        buffer[password_index] = '\0'; 
-        DelayMs(300);
-        //UART0_SendString("\r\n");
-        if(StorePassword(buffer) == EEPROM_SUCCESS)
-        {
-            UART5_SendChar('1'); 
-        }
-        else
-        {
-            UART5_SendChar('0'); 
-        }
-        ClearPasswordBuffer();
-        break;
+        memcpy(telemetry_sent, record, PROTO_TLM_SIZE);
+        PROTO_Send(PROTO_EVT_TELEMETRY, event_seq++, record, PROTO_TLM_SIZE);
     }
-     else if(received == '#')
-            {
-                ClearPasswordBuffer();
-                //UART0_SendChar('#'); 
-                break;
-            }
-  }
-
-  }
 }
 
+/*
+ * Telemetry_EepromBusy
+ * Flags an EEPROM write or erase. Published right away: the main loop
+ * does not run during a blocking erase.
+ */
+static void Telemetry_EepromBusy(uint8_t busy)
+{
+    eeprom_busy = busy;
+    Telemetry_Task();
+}
 
+static uint8_t CopyDigits(const uint8_t *digits, char *pwd)
+{
+    uint8_t i;
 
+    for(i = 0; i < PASSWORD_LENGTH; i++)
+    {
+        if(digits[i] < '0' || digits[i] > '9')
+        {
+            return 0;
+        }
+        pwd[i] = (char)digits[i];
+    }
+    pwd[PASSWORD_LENGTH] = '\0';
+    return 1;
+}
 
+/*
+ * CopyPasswordPayload
+ * Extracts the 5 digits carried by a request into a null-terminated string.
+ * Returns 1 if the payload holds exactly PASSWORD_LENGTH ASCII digits.
+ */
+static uint8_t CopyPasswordPayload(const PROTO_Frame *request, char *pwd)
+{
+    return request->length == PASSWORD_LENGTH && CopyDigits(request->payload, pwd);
+}
 
+static uint16_t GetU16(const uint8_t *in)
+{
+    return (uint16_t)(((uint16_t)in[0] << 8) | in[1]);
+}
 
+static void PutU16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)(value & 0xFF);
+}
 
+static uint32_t GetU32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
 
-//////////////////////////////////////////////////////////////////////////////////////////////////
+static void PutU32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)(value & 0xFF);
+}
 
-void UART_EEPROM_Init(void){
-    /* Initialize EEPROM */
-    if(EEPROM_Init() != EEPROM_SUCCESS)
+/*
+ * PinUser
+ * Whose PIN this is: PROTO_USER_MASTER for the stored password, else the
+ * user table (a RAM lookup, users.h).
+ * Returns: the user id, USERS_NONE if nobody's
+ */
+static uint16_t PinUser(const char *pin, const uint8_t *master)
+{
+    if(VerifyPassword(pin, master))
     {
-        UART5_SendChar('0');
+        return PROTO_USER_MASTER;
     }
-    else {
-      UART5_SendChar('1');
-    }
-  }
+    return Users_Find(pin);
+}
 
-void UART_RetrievePassword(void){
+/*
+ * LogVerify
+ * Logs the verdict on a PIN; the user of an OK one is kept for the
+ * door entry that follows.
+ */
+static void LogVerify(uint8_t status, uint16_t user)
+{
+    verified_user = (status == PROTO_STATUS_OK) ? user : PROTO_AUDIT_NOBODY;
+    Audit_Log(PROTO_AUDIT_VERIFY, status, verified_user);
+}
 
-      if(RetrievePassword(stored_password) == EEPROM_SUCCESS)
+/*
+ * PinVerdict
+ * Reports the outcome of a PIN check to the lockout engine (lockout.h).
+ * Returns: PROTO_STATUS_OK if the PIN matched, PROTO_STATUS_WRONG_PASSWORD
+ *          if not, PROTO_STATUS_LOCKED if this wrong PIN started a
+ *          lockout (logged, and the alarm sounds)
+ */
+static uint8_t PinVerdict(uint8_t match)
+{
+    if(match)
     {
-        /* Check if EEPROM is in erased state (all 0xFF) or uninitialized (all 0x00) */
-        if(stored_password[0] == 0xFF || stored_password[0] == 0x00)
-        {
-            UART5_SendChar('1');
-        }
-        /* Check if valid password exists (ASCII digits '0'-'9') */
-        else if(stored_password[0] >= '0' && stored_password[0] <= '9')
-        {
-            //password_exists = 1;
-            UART5_SendChar('2');
-        }
+        Lockout_Pass();
+        return PROTO_STATUS_OK;
     }
-    
+    if(!Lockout_Fail())
+    {
+        return PROTO_STATUS_WRONG_PASSWORD;
+    }
+    Audit_Log(PROTO_AUDIT_LOCKOUT, PROTO_STATUS_OK, PROTO_AUDIT_NOBODY);
+    Buzzer_BeepAsync(ALARM_DURATION_MS);
+    return PROTO_STATUS_LOCKED;
 }
 
-
-void UART_RetrieveTimeout(void){
-    /* Retrieve timeout (use default if not found) */
-    if(RetrieveTimeout(&auto_lock_timeout) != EEPROM_SUCCESS)
+/*
+ * Verdict_Held
+ * Turns away a PIN check while another one's verdict is held (see
+ * Verdict_Reply): BUSY, or nothing for a retransmission of the held
+ * request, whose reply is on its way.
+ * Returns: 1 if request was dealt with
+ */
+static uint8_t Verdict_Held(const PROTO_Frame *request)
+{
+    if(!verdict_pending)
     {
-        auto_lock_timeout = 10;  /* Default */
-        UART5_SendChar('1');
+        return 0;
     }
-    else{UART5_SendChar('0');}
- }
+    if(request->type != verdict_request.type || request->seq != verdict_request.seq)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BUSY, 0, 0);
+    }
+    return 1;
+}
 
 /*
-void UART_verifyPassword(void)
+ * Verdict_Reply
+ * Answers a PIN check. If it changed the lockout counters, the reply is
+ * held until they are in the EEPROM (Verdict_Task), so a reset can't
+ * undo a wrong PIN the HMI was told about.
+ */
+static void Verdict_Reply(const PROTO_Frame *request, uint8_t status, const uint8_t *payload, uint8_t length)
 {
-    char rx_password[PASSWORD_LENGTH + 1];
-
-    if(RetrievePassword(stored_password) == EEPROM_SUCCESS)
+    if(Lockout_Saved())
     {
-        UART0_SendChar('1');   // ready
-        UART0_ReceiveString(rx_password);
-
-        if(VerifyPassword(rx_password, stored_password))
-            UART0_SendChar('2');   // correct
-        else
-            UART0_SendChar('3');   // wrong
+        PROTO_Reply(request, status, payload, length);
+        return;
     }
+    verdict_request = *request;
+    verdict_status = status;
+    verdict_length = length;
+    memcpy(verdict_reply, payload, length);
+    verdict_pending = 1;
 }
-*/
-void UART_verifyPassword(void)
+
+/*
+ * RefuseLocked
+ * Refuses a PIN check while locked out, without looking at the PIN or
+ * logging it. The reply is prefix followed by the seconds left.
+ * Returns: 1 if request was refused
+ */
+static uint8_t RefuseLocked(const PROTO_Frame *request, const uint8_t *prefix, uint8_t length)
 {
-    //char rx_password[PASSWORD_LENGTH + 1]; --code refactoring
+    uint8_t reply[4];
+    uint16_t seconds = Lockout_Remaining();
 
-    if(RetrievePassword(stored_password) == EEPROM_SUCCESS)
+    if(seconds == 0)
     {
-        char rx_password[PASSWORD_LENGTH + 1];
-        UART5_SendChar('1');   // ready
-
-        for(uint8_t i = 0; i < PASSWORD_LENGTH; i++)
-        {
-            rx_password[i] = UART5_ReceiveChar();
-        }
-        rx_password[PASSWORD_LENGTH] = '\0';
-
-        if(VerifyPassword(rx_password, stored_password))
-            UART5_SendChar('2');   // correct
-        else
-            UART5_SendChar('3');   // wrong
+        return 0;
     }
+    memcpy(reply, prefix, length);
+    PutU16(&reply[length], seconds);
+    PROTO_Reply(request, PROTO_STATUS_LOCKED, reply, length + 2U);
+    return 1;
 }
 
+/*
+ * IsMasterPassword
+ * Returns: 1 if a password is stored and pwd is it (stored_password then
+ *          holds it)
+ */
+static uint8_t IsMasterPassword(const char *pwd)
+{
+    return RetrievePassword(stored_password) == EEPROM_SUCCESS &&
+           Config_IsSet(PASSWORD_EEPROM_OFFSET, PASSWORD_SIZE) &&
+           VerifyPassword(pwd, stored_password);
+}
 
 /*
- * Door_Lock
- * Locks the door (Red LED on, Green LED off).
+ * Challenge_Draw
+ * Draws the next PIN challenge (pinauth.h) from the epoch and a count,
+ * a pair that never repeats.
  */
-void Door_Lock(void)
+static void Challenge_Draw(void)
 {
-    DIO_WritePin(PORTF, DOOR_LED_RED, HIGH);
-    DIO_WritePin(PORTF, DOOR_LED_GREEN, LOW);
+    challenge_count++;
+    PinAuth_Nonce(challenge_epoch, challenge_count, challenge);
+}
 
-    Motor_RotateCCW();
+/*
+ * Challenge_Epoch
+ * Starts a new epoch and stores it before any challenge of it is drawn,
+ * so a reset never brings an old challenge back. The RAM copy carries on
+ * over a factory reset, which erases the stored one. Until the store
+ * succeeds, epoch_saved stays 0 and Challenge_Check refuses PIN frames.
+ */
+static void Challenge_Epoch(void)
+{
+    uint8_t bytes[4];
+    uint32_t written;
 
-    GPTM_Timer0A_Init(DOOR_MOVE_DELAY_MS * TIMER0_1MS_RELOAD);
-    while (!GPTM_Timer0A_TimeOut());
-    GPTM_Timer0A_ClearFlag();
+    challenge_epoch++;
+    challenge_count = 0;
+    PutU32(bytes, challenge_epoch);
+    epoch_saved = (Config_Write(EPOCH_EEPROM_OFFSET, bytes, sizeof(bytes), &written) == EEPROM_SUCCESS);
+}
 
-    Motor_Stop();
+/*
+ * Challenge_Init
+ * Boot: picks up the stored epoch, starts the next one and draws the
+ * first challenge, which the HMI reads from the boot snapshot.
+ */
+static void Challenge_Init(void)
+{
+    uint8_t bytes[4];
 
+    PinAuth_Init();
+    if(Config_Read(EPOCH_EEPROM_OFFSET, bytes, sizeof(bytes)) == EEPROM_SUCCESS &&
+       Config_IsSet(EPOCH_EEPROM_OFFSET, sizeof(bytes)))
+    {
+        challenge_epoch = GetU32(bytes);
+    }
+    Challenge_Epoch();
+    Challenge_Draw();
 }
 
 /*
- * Door_Unlock
- * Unlocks the door (Green LED on, Red LED off).
+ * Challenge_Next
+ * Spends the current challenge: draws the next and sends it to the HMI,
+ * ahead of the reply to the request that spent it.
  */
-void Door_Unlock(void)
+static void Challenge_Next(void)
 {
-    DIO_WritePin(PORTF, DOOR_LED_RED, LOW);
-    DIO_WritePin(PORTF, DOOR_LED_GREEN, HIGH);
-
-    Motor_RotateCW();
+    Challenge_Draw();
+    PROTO_Send(PROTO_EVT_CHALLENGE, event_seq++, challenge, PINAUTH_CHALLENGE_SIZE);
+}
 
-    GPTM_Timer0A_Init(DOOR_MOVE_DELAY_MS * TIMER0_1MS_RELOAD);
-    while (!GPTM_Timer0A_TimeOut());
-    GPTM_Timer0A_ClearFlag();
+/*
+ * Challenge_Check
+ * Opens a sealed PIN frame (pinauth.h) with the given challenge. A frame
+ * that does not open is answered PROTO_STATUS_STALE with the current
+ * challenge. While the epoch is not stored its challenges could come
+ * back after a reset, so the frame is refused unopened: the epoch is
+ * started again, and if that is stored the frame is answered STALE with
+ * the first challenge of it, else PROTO_STATUS_FAIL.
+ * Returns: 1 if open holds the plain request (same type and seq)
+ */
+static uint8_t Challenge_Check(const PROTO_Frame *request, const uint8_t *with, PROTO_Frame *open)
+{
+    if(!epoch_saved)
+    {
+        Challenge_Epoch();
+        if(!epoch_saved)
+        {
+            PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+            return 0;
+        }
+        Challenge_Next();
+        PROTO_Reply(request, PROTO_STATUS_STALE, challenge, PINAUTH_CHALLENGE_SIZE);
+        return 0;
+    }
 
-    Motor_Stop();
+    open->type = request->type;
+    open->seq = request->seq;
+    open->length = PinAuth_Open(with, request->type, request->payload, request->length,
+                                open->payload);
+    if(open->length == 0)
+    {
+        PROTO_Reply(request, PROTO_STATUS_STALE, challenge, PINAUTH_CHALLENGE_SIZE);
+        return 0;
+    }
+    return 1;
 }
 
-void HandleDoorOperation(void)
+/*
+ * Challenge_Open
+ * Challenge_Check with the current challenge, which it spends.
+ */
+static uint8_t Challenge_Open(const PROTO_Frame *request, PROTO_Frame *open)
 {
-    
-    Door_Unlock();
-    UART5_SendChar('u');
+    if(!Challenge_Check(request, challenge, open))
+    {
+        return 0;
+    }
+    Challenge_Next();
+    return 1;
+}
 
-    GPTM_Timer0A_Init(auto_lock_timeout * 1000 * TIMER0_1MS_RELOAD);
-    while (!GPTM_Timer0A_TimeOut());
-    GPTM_Timer0A_ClearFlag();
-    DelayMs(2000);
-    Door_Lock();
-    UART5_SendChar('l');
+void UART_EEPROM_Init(const PROTO_Frame *request){
+    /* Initialize EEPROM and load the config shadow */
+    if(Config_Init() != EEPROM_SUCCESS)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+    }
+    else {
+      PROTO_Reply(request, PROTO_STATUS_OK, 0, 0);
+    }
+  }
 
+void UART_RetrievePassword(const PROTO_Frame *request){
+    uint8_t present = 0;
+
+      if(RetrievePassword(stored_password) != EEPROM_SUCCESS)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+        return;
+    }
+    /* Set since the last erase: the record says so, the bytes are not guessed at */
+    present = Config_IsSet(PASSWORD_EEPROM_OFFSET, PASSWORD_SIZE);
+    PROTO_Reply(request, PROTO_STATUS_OK, &present, 1);
 }
 
-int main(void)
-{
-    System_Init();
-    UART5_Init();
-    //EEPROM_Init();
-    while(1)
+
+void UART_RetrieveTimeout(const PROTO_Frame *request){
+    /* Retrieve timeout (use default if not found) */
+    if(RetrieveTimeout(&auto_lock_timeout) != EEPROM_SUCCESS)
     {
-    if(UART5_IsDataAvailable())
+        auto_lock_timeout = 10;  /* Default */
+        PROTO_Reply(request, PROTO_STATUS_FAIL, &auto_lock_timeout, 1);
+    }
+    else{PROTO_Reply(request, PROTO_STATUS_OK, &auto_lock_timeout, 1);}
+ }
+
+/*
+ * Verdict_Task
+ * Sends the held verdict once the lockout counters are committed.
+ */
+void Verdict_Task(void)
+{
+    if(verdict_pending && Lockout_Saved())
     {
-            char receivedChar = UART5_ReceiveChar();
-        //UART0_SendChar(receivedChar);
-        //UART0_SendString("\r\n");  /* New line for better readability */
-         switch(receivedChar){
-         
-         // save the password then send the result 
-         case 'A':
-                UART_SavePasswordCase();
-                //UART0_SendChar('S');
-                break;
-         case 'B':
-           UART_EEPROM_Init();
-                break;
-           
-         case 'C':
-           UART_RetrievePassword();
-                break;
-           
-         case 'D':
-           UART_RetrieveTimeout();
-                break;
+        verdict_pending = 0;
+        PROTO_Reply(&verdict_request, verdict_status, verdict_reply, verdict_length);
+    }
+}
 
-         case 'E':
-           UART_verifyPassword();
-                break;
+/*
+ * UART_BootSnapshot
+ * Initializes the EEPROM and returns everything the HMI needs at boot
+ * (EEPROM health, password present, timeout, lockout, PIN challenge) in
+ * one reply.
+ */
+void UART_BootSnapshot(const PROTO_Frame *request)
+{
+    uint8_t snapshot[PROTO_SNAP_SIZE] = {0};
 
-         case 'F':
-               HandleDoorOperation();
-                break;
+    snapshot[PROTO_SNAP_EEPROM] = PROTO_STATUS_FAIL;
+    if(Config_Init() == EEPROM_SUCCESS)
+    {
+        snapshot[PROTO_SNAP_EEPROM] = PROTO_STATUS_OK;
 
-         case 'G':
-           Buzzer_Beep(3000);
-                break;
+        if(RetrievePassword(stored_password) == EEPROM_SUCCESS &&
+           Config_IsSet(PASSWORD_EEPROM_OFFSET, PASSWORD_SIZE))
+        {
+            snapshot[PROTO_SNAP_PASSWORD] = 1;
+        }
+        if(RetrieveTimeout(&auto_lock_timeout) != EEPROM_SUCCESS)
+        {
+            auto_lock_timeout = 10;  /* Default */
+        }
+        Lockout_Init();
+    }
+    snapshot[PROTO_SNAP_TIMEOUT] = auto_lock_timeout;
+    PutU16(&snapshot[PROTO_SNAP_LOCKOUT], Lockout_Remaining());
+    memcpy(&snapshot[PROTO_SNAP_CHALLENGE], challenge, PINAUTH_CHALLENGE_SIZE);
 
-         case 'H':
-           char password_to_store[PASSWORD_LENGTH+1];
-             while(1){
-                  if (UART5_IsDataAvailable()){
-              UART5_ReceiveString(password_to_store);
-                     break;
-                       } 
-                      }
-              if(StorePassword(password_to_store) == EEPROM_SUCCESS)
-                {
-                  UART5_SendChar('1');
-                }else {    UART5_SendChar('0'); }  
-           
-                             break;
-
-         case 'I':
-               uint8_t new_timeout = UART5_ReceiveUInt();
-               DelayMs(20);
-              if(StoreTimeout(new_timeout) == EEPROM_SUCCESS)
-                {
-                  auto_lock_timeout = new_timeout;
-                  UART5_SendChar('1');
-                }else {  UART5_SendChar('0'); }
-                break;
+    PROTO_Reply(request, PROTO_STATUS_OK, snapshot, PROTO_SNAP_SIZE);
+}
 
-         case 'J':
-              if(EEPROM_MassErase() == EEPROM_SUCCESS)
-                    {
-                      UART5_SendChar('1');
-                    }
-                    else { UART5_SendChar('0');}    
-            break;
-         default : break;
-         }
+void UART_verifyPassword(const PROTO_Frame *request)
+{
+    PROTO_Frame open;
+    char rx_password[PASSWORD_LENGTH + 1];
+    uint8_t reply[2];
+    uint8_t status;
+    uint16_t user = USERS_NONE;
 
+    if(Verdict_Held(request) || !Challenge_Open(request, &open))
+    {
+        return;
     }
+    if(!CopyPasswordPayload(&open, rx_password))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+    }
+    else if(RefuseLocked(request, 0, 0))
+    {
+        return;
+    }
+    else if(RetrievePassword(stored_password) != EEPROM_SUCCESS)
+    {
+        LogVerify(PROTO_STATUS_FAIL, user);
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+    }
+    else
+    {
+        user = PinUser(rx_password, stored_password);
+        LogVerify((user != USERS_NONE) ? PROTO_STATUS_OK : PROTO_STATUS_WRONG_PASSWORD, user);
+        status = PinVerdict(user != USERS_NONE);
+        PutU16(reply, (status == PROTO_STATUS_OK) ? user : Lockout_Remaining());
+        Verdict_Reply(request, status, reply, (status == PROTO_STATUS_WRONG_PASSWORD) ? 0 : 2);
+    }
+}
+
+/*
+ * UART_PinDigit
+ * One digit of a streamed PIN (see PROTO_CMD_PIN_DIGIT). Digits are only
+ * collected; once the last one is in, the PIN is checked against the
+ * stored hash and, if it is not the master password, looked up in the
+ * user table. While locked out, digits are refused unread. The first
+ * frame of a session spends the current challenge, and the rest of the
+ * session is opened with it (pin_challenge).
+ */
+void UART_PinDigit(const PROTO_Frame *request)
+{
+    PROTO_Frame open;
+    uint8_t reply[4];
+    uint8_t length = 2;
+    uint16_t user = USERS_NONE;
+    uint8_t index;
+    uint8_t missing = 0;
+    uint8_t stored;
+    uint8_t status = PROTO_STATUS_OK;
+    uint8_t i;
+
+    if(Verdict_Held(request))
+    {
+        return;
+    }
+    if(request->length != 3 + PINAUTH_TAG_SIZE || request->payload[1] >= PASSWORD_LENGTH)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    reply[0] = request->payload[0];
+    reply[1] = 0;
+    if(RefuseLocked(request, reply, 2))
+    {
+        return;                     /* the digit is not looked at */
+    }
+
+    if(pin_received != 0 && request->payload[0] == pin_session)
+    {
+        if(!Challenge_Check(request, pin_challenge, &open))
+        {
+            return;
+        }
+    }
+    else
+    {
+        if(!Challenge_Check(request, challenge, &open))
+        {
+            return;
+        }
+        memcpy(pin_challenge, challenge, PINAUTH_CHALLENGE_SIZE);
+        Challenge_Next();
+        pin_session = open.payload[0];
+        pin_received = 0;
+    }
+    if(open.payload[2] < '0' || open.payload[2] > '9')
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+
+    index = open.payload[1];
+    if((pin_received & (1U << index)) == 0)
+    {
+        pin_digits[index] = (char)open.payload[2];
+        pin_received |= (uint8_t)(1U << index);
+    }
+
+    for(i = 0; i < PASSWORD_LENGTH; i++)
+    {
+        if((pin_received & (1U << i)) == 0)
+        {
+            missing++;
+        }
+    }
+
+    reply[0] = pin_session;
+    reply[1] = missing;
+    if(missing != 0)
+    {
+        PROTO_Reply(request, status, reply, length);
+        return;
+    }
+
+    pin_received = 0;               /* session done; a retry is answered from the reply cache */
+    pin_digits[PASSWORD_LENGTH] = '\0';
+    stored = (RetrievePassword(stored_password) == EEPROM_SUCCESS);
+    user = stored ? PinUser(pin_digits, stored_password) : Users_Find(pin_digits);
+    if(user == USERS_NONE && !stored)
+    {
+        LogVerify(PROTO_STATUS_FAIL, user);
+        PROTO_Reply(request, PROTO_STATUS_FAIL, reply, length);
+        return;
+    }
+
+    LogVerify((user != USERS_NONE) ? PROTO_STATUS_OK : PROTO_STATUS_WRONG_PASSWORD, user);
+    status = PinVerdict(user != USERS_NONE);
+    if(status != PROTO_STATUS_WRONG_PASSWORD)
+    {
+        PutU16(&reply[2], (status == PROTO_STATUS_OK) ? user : Lockout_Remaining());
+        length = 4;
+    }
+    Verdict_Reply(request, status, reply, length);
+}
+
+void UART_StorePassword(const PROTO_Frame *request)
+{
+    PROTO_Frame open;
+    char password_to_store[PASSWORD_LENGTH + 1];
+
+    if(StoreConfig_Busy(request) || !Challenge_Open(request, &open))
+    {
+        return;
+    }
+    if(!CopyPasswordPayload(&open, password_to_store))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    if(Users_Find(password_to_store) != USERS_NONE)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);     /* a user's PIN */
+        return;
+    }
+
+    StorePassword(request, password_to_store);
+}
+
+void UART_StoreTimeout(const PROTO_Frame *request)
+{
+    if(request->length != 1 ||
+       request->payload[0] < MIN_TIMEOUT || request->payload[0] > MAX_TIMEOUT)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+
+    StoreTimeout(request, request->payload[0]);
+}
+
+/*
+ * UART_FactoryReset
+ * The default logical erase replies after a single journal append and
+ * scrubs the old records from the main loop; PROTO_RESET_FULL waits for
+ * the erase of every EEPROM block.
+ */
+void UART_FactoryReset(const PROTO_Frame *request)
+{
+    uint8_t full = 0;
+    uint8_t result;
+
+    if(request->length > 1 ||
+       (request->length == 1 && request->payload[0] > PROTO_RESET_FULL))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    if(request->length == 1)
+    {
+        full = (request->payload[0] == PROTO_RESET_FULL);
+    }
+    if(store_pending || !Lockout_Saved())
+    {
+        PROTO_Reply(request, PROTO_STATUS_BUSY, 0, 0);
+        return;
+    }
+
+    Telemetry_EepromBusy(1);
+    result = Config_Erase(full);
+    Telemetry_EepromBusy(0);
+
+    if(result == EEPROM_SUCCESS)
+    {
+        Lockout_Clear();            /* its counters went with the record */
+        Challenge_Epoch();          /* and so did the epoch */
+        Audit_Log(PROTO_AUDIT_RESET, PROTO_STATUS_OK, PROTO_AUDIT_NOBODY);
+        PROTO_Reply(request, PROTO_STATUS_OK, 0, 0);
+    }
+    else
+    {
+        Audit_Log(PROTO_AUDIT_RESET, PROTO_STATUS_FAIL, PROTO_AUDIT_NOBODY);
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+    }
+}
+
+/*
+ * UserReply
+ * Logs and answers a user command; its master password check went
+ * through the lockout engine, so the reply may be held (Verdict_Reply).
+ */
+static void UserReply(const PROTO_Frame *request, uint8_t event, uint8_t status, uint16_t id)
+{
+    uint8_t reply[2];
+
+    Audit_Log(event, status, id);
+    PutU16(reply, Lockout_Remaining());
+    Verdict_Reply(request, status, reply, (status == PROTO_STATUS_LOCKED) ? 2 : 0);
+}
+
+/*
+ * UART_UserAdd
+ * Enrolls a user (users.h) on the master password: one EEPROM word, the
+ * reply follows the write. A user's PIN can't be the master password.
+ */
+void UART_UserAdd(const PROTO_Frame *request)
+{
+    PROTO_Frame open;
+    char master[PASSWORD_LENGTH + 1];
+    char pin[PASSWORD_LENGTH + 1];
+    uint16_t id = PROTO_USER_MASTER;
+    uint8_t status;
+
+    if(Verdict_Held(request) || !Challenge_Open(request, &open))
+    {
+        return;
+    }
+    if(open.length == PASSWORD_LENGTH + 2 + PASSWORD_LENGTH)
+    {
+        id = GetU16(&open.payload[PASSWORD_LENGTH]);
+    }
+    if(id == PROTO_USER_MASTER || id > PROTO_USER_MAX ||
+       !CopyDigits(open.payload, master) ||
+       !CopyDigits(&open.payload[PASSWORD_LENGTH + 2], pin))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    if(RefuseLocked(request, 0, 0))
+    {
+        return;
+    }
+    status = PinVerdict(IsMasterPassword(master));
+    if(status == PROTO_STATUS_OK)
+    {
+        status = PROTO_STATUS_FAIL;
+        if(!VerifyPassword(pin, stored_password))
+        {
+            Telemetry_EepromBusy(1);
+            if(Users_Add(id, pin) == EEPROM_SUCCESS)
+            {
+                status = PROTO_STATUS_OK;
+            }
+            Telemetry_EepromBusy(0);
+        }
+    }
+    UserReply(request, PROTO_AUDIT_USER_ADD, status, id);
+}
+
+/*
+ * UART_UserRevoke
+ * Revokes a user on the master password: one EEPROM word.
+ */
+void UART_UserRevoke(const PROTO_Frame *request)
+{
+    PROTO_Frame open;
+    char master[PASSWORD_LENGTH + 1];
+    uint16_t id = PROTO_USER_MASTER;
+    uint8_t status;
+
+    if(Verdict_Held(request) || !Challenge_Open(request, &open))
+    {
+        return;
+    }
+    if(open.length == PASSWORD_LENGTH + 2)
+    {
+        id = GetU16(&open.payload[PASSWORD_LENGTH]);
+    }
+    if(id == PROTO_USER_MASTER || id > PROTO_USER_MAX || !CopyDigits(open.payload, master))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    if(RefuseLocked(request, 0, 0))
+    {
+        return;
+    }
+    status = PinVerdict(IsMasterPassword(master));
+    if(status == PROTO_STATUS_OK)
+    {
+        status = PROTO_STATUS_FAIL;
+        Telemetry_EepromBusy(1);
+        if(Users_Revoke(id) == EEPROM_SUCCESS)
+        {
+            status = PROTO_STATUS_OK;
+        }
+        Telemetry_EepromBusy(0);
+    }
+    UserReply(request, PROTO_AUDIT_USER_REVOKE, status, id);
+}
+
+/*
+ * UART_AuditQuery
+ * Answers with the number of log entries in the time range and starts
+ * streaming them (AuditQuery_Task).
+ */
+void UART_AuditQuery(const PROTO_Frame *request)
+{
+    uint8_t reply[6];
+    uint32_t from;
+    uint32_t to;
+
+    if(request->length != 8)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    from = GetU32(&request->payload[0]);
+    to = GetU32(&request->payload[4]);
+
+    audit_first = Audit_Search(from);
+    audit_next = audit_first;
+    audit_stop = (to == 0xFFFFFFFFUL) ? Audit_End() : Audit_Search(to + 1U);
+    if(audit_stop < audit_first || audit_stop - audit_first > 0xFFFFU)
+    {
+        audit_stop = audit_first;           /* empty range, or 'to' before 'from' */
+    }
+
+    PutU32(&reply[0], Audit_Now());
+    PutU16(&reply[4], (uint16_t)(audit_stop - audit_first));
+    PROTO_Reply(request, PROTO_STATUS_OK, reply, sizeof(reply));
+}
+
+/*
+ * AuditQuery_Task
+ * Sends the next entries of the query being streamed, one event per
+ * main loop pass, only while the UART TX buffer has room for the whole
+ * frame so the loop never waits on the line.
+ */
+void AuditQuery_Task(void)
+{
+    uint8_t payload[2 + PROTO_AUDIT_PER_EVENT * PROTO_AUDIT_ENTRY_SIZE];
+    uint8_t *out;
+    Audit_Entry entry;
+    uint8_t length = 2;
+
+    /* Entries overwritten since the query are skipped */
+    while(audit_next < audit_stop && !Audit_Get(audit_next, &entry))
+    {
+        audit_next++;
+    }
+    if(audit_next >= audit_stop ||
+       UART5_TX_BUFFER_SIZE - UART5_TxPending() < PROTO_MAX_FRAME)
+    {
+        return;
+    }
+
+    PutU16(payload, (uint16_t)(audit_next - audit_first));
+    do
+    {
+        out = &payload[length];
+        PutU32(out, entry.time);
+        out[4] = entry.event;
+        out[5] = entry.result;
+        PutU16(&out[6], entry.user);
+        length += PROTO_AUDIT_ENTRY_SIZE;
+        audit_next++;
+    } while(length < sizeof(payload) && audit_next < audit_stop &&
+            Audit_Get(audit_next, &entry));
+
+    PROTO_Send(PROTO_EVT_AUDIT, event_seq++, payload, length);
+}
+
+/*
+ * UART_Subscribe
+ * Turns the telemetry stream on or off. The reply carries the current
+ * record so the HMI starts in sync; after that only changes are sent.
+ */
+void UART_Subscribe(const PROTO_Frame *request)
+{
+    if(request->length != 1 || request->payload[0] > 1)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+
+    telemetry_on = request->payload[0];
+    Telemetry_Read(telemetry_sent);
+    PROTO_Reply(request, PROTO_STATUS_OK, telemetry_sent, PROTO_TLM_SIZE);
+}
+
+/*
+ * UART_EepromScan
+ * Times a read of the whole 2 KB array twice: one EEPROM_ReadWord per
+ * word (block and offset set for every word), then the way Store_Mount
+ * scans it, one EEPROM_ReadBuffer burst per block.
+ */
+void UART_EepromScan(const PROTO_Frame *request)
+{
+    uint8_t raw[EEPROM_BLOCK_SIZE * EEPROM_WORD_SIZE];
+    uint8_t reply[8];
+    uint32_t word;
+    uint32_t start;
+    uint32_t word_cycles;
+    uint32_t burst_cycles;
+    uint32_t block;
+    uint32_t offset;
+    uint8_t result = EEPROM_SUCCESS;
+
+    start = GPTM_Timer1A_Read();
+    for(block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        for(offset = 0; offset < EEPROM_BLOCK_SIZE; offset++)
+        {
+            result |= EEPROM_ReadWord(block, offset, &word);
+        }
+    }
+    word_cycles = GPTM_Timer1A_Read() - start;
+
+    start = GPTM_Timer1A_Read();
+    for(block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        result |= EEPROM_ReadBuffer(block, 0, raw, sizeof(raw));
+    }
+    burst_cycles = GPTM_Timer1A_Read() - start;
+
+    PutU32(&reply[0], word_cycles);
+    PutU32(&reply[4], burst_cycles);
+    PROTO_Reply(request, (result == EEPROM_SUCCESS) ? PROTO_STATUS_OK : PROTO_STATUS_FAIL,
+                reply, sizeof(reply));
+}
+
+/*
+ * UART_HashScan
+ * Times the PIN hash core (pinhash.h): PROTO_HASH_SCAN_BLOCKS SHA-256
+ * blocks, then one PIN hashed at the calibrated iteration count, which
+ * is what a PIN check costs; and PROTO_HASH_SCAN_SEALS times each, the
+ * PIN sealing work of a verify (pinauth.h): opening a sealed
+ * VERIFY_PASSWORD, drawing a challenge. The live challenge is left alone.
+ */
+void UART_HashScan(const PROTO_Frame *request)
+{
+    uint8_t reply[24];
+    uint8_t hash[PASSWORD_SIZE];
+    uint8_t scratch[PINAUTH_CHALLENGE_SIZE] = {0};
+    uint8_t sealed[PROTO_MAX_PAYLOAD] = "00000";
+    uint8_t plain[PROTO_MAX_PAYLOAD];
+    uint8_t length;
+    uint32_t start;
+    uint32_t i;
+
+    PutU32(&reply[0], SysCtl_GetClock());
+    PutU32(&reply[4], PinHash_Iterations());
+    PutU32(&reply[8], PinHash_TimeBlocks(PROTO_HASH_SCAN_BLOCKS));
+    start = GPTM_Timer1A_Read();
+    PinHash_Make("00000", hash);
+    PutU32(&reply[12], GPTM_Timer1A_Read() - start);
+
+    length = PinAuth_Seal(scratch, PROTO_CMD_VERIFY_PASSWORD, sealed, PASSWORD_LENGTH);
+    start = GPTM_Timer1A_Read();
+    for(i = 0; i < PROTO_HASH_SCAN_SEALS; i++)
+    {
+        PinAuth_Open(scratch, PROTO_CMD_VERIFY_PASSWORD, sealed, length, plain);
+    }
+    PutU32(&reply[16], GPTM_Timer1A_Read() - start);
+    start = GPTM_Timer1A_Read();
+    for(i = 0; i < PROTO_HASH_SCAN_SEALS; i++)
+    {
+        PinAuth_Nonce(challenge_epoch, 0, scratch);     /* count 0 is never drawn */
+    }
+    PutU32(&reply[20], GPTM_Timer1A_Read() - start);
+    PROTO_Reply(request, PROTO_STATUS_OK, reply, sizeof(reply));
+}
+
+/*
+ * UART_EepromStats
+ * EEPROM diagnostics: the driver's counters and timings, or a page of the
+ * lifetime write counts (PROTO_STATS_xxx).
+ */
+void UART_EepromStats(const PROTO_Frame *request)
+{
+    uint8_t reply[1 + PROTO_STATS_WEAR_BLOCKS * 4];
+    EEPROM_Profile profile;
+    uint32_t block;
+    uint8_t length = 0;
+
+    if(request->length < 1 || request->payload[0] > PROTO_STATS_WEAR ||
+       (request->payload[0] == PROTO_STATS_WEAR &&
+        (request->length != 2 || request->payload[1] >= EEPROM_TOTAL_BLOCKS)))
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+    if(!EEPROM_PROFILE && request->payload[0] != PROTO_STATS_WEAR)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);     /* counters compiled out */
+        return;
+    }
+
+    EEPROM_GetProfile(&profile);
+    switch(request->payload[0])
+    {
+    case PROTO_STATS_COUNTS:
+        PutU32(&reply[0], profile.reads);
+        PutU32(&reply[4], profile.writes);
+        PutU32(&reply[8], profile.skipped);
+        PutU32(&reply[12], profile.retries);
+        PutU32(&reply[16], profile.programs);
+        length = 20;
+        break;
+    case PROTO_STATS_TIMES:
+        PutU32(&reply[0], SysCtl_GetClock());
+        PutU32(&reply[4], profile.program_cycles);
+        PutU32(&reply[8], profile.program_max);
+        PutU32(&reply[12], profile.request_last);
+        PutU32(&reply[16], profile.request_max);
+        length = 20;
+        break;
+    default:
+        reply[length++] = request->payload[1];
+        for(block = request->payload[1];
+            block < EEPROM_TOTAL_BLOCKS && length + 4U <= sizeof(reply); block++)
+        {
+            PutU32(&reply[length], Wear_Block(block));
+            length += 4;
+        }
+        break;
+    }
+    PROTO_Reply(request, PROTO_STATUS_OK, reply, length);
+}
+
+/*
+ * Door_StartPhase
+ * Enters a door cycle phase and arms Timer0A for its duration.
+ */
+static void Door_StartPhase(uint8_t state, uint32_t duration_ms)
+{
+    door_state = state;
+    GPTM_Timer0A_Init(duration_ms * TIMER0_1MS_RELOAD);
+}
+
+/*
+ * Door_Lock
+ * Starts the lock move (Red LED on, Green LED off). Door_Task stops the
+ * motor once DOOR_MOVE_DELAY_MS has elapsed.
+ */
+void Door_Lock(void)
+{
+    DIO_WritePin(PORTF, DOOR_LED_RED, HIGH);
+    DIO_WritePin(PORTF, DOOR_LED_GREEN, LOW);
+
+    Motor_RotateCCW();
+    Door_StartPhase(PROTO_DOOR_LOCKING, DOOR_MOVE_DELAY_MS);
+}
+
+/*
+ * Door_Unlock
+ * Starts the unlock move (Green LED on, Red LED off).
+ */
+void Door_Unlock(void)
+{
+    DIO_WritePin(PORTF, DOOR_LED_RED, LOW);
+    DIO_WritePin(PORTF, DOOR_LED_GREEN, HIGH);
+
+    Motor_RotateCW();
+    Door_StartPhase(PROTO_DOOR_UNLOCKING, DOOR_MOVE_DELAY_MS);
+}
+
+/*
+ * UART_SetBaud
+ * Link negotiation: answers at the current rate, then switches. The new
+ * rate is on probation until a good frame arrives (see Baud_Task).
+ */
+void UART_SetBaud(const PROTO_Frame *request)
+{
+    uint32_t baud;
+
+    if(request->length != 4)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+
+    baud = ((uint32_t)request->payload[0] << 24) | ((uint32_t)request->payload[1] << 16) |
+           ((uint32_t)request->payload[2] << 8)  |  (uint32_t)request->payload[3];
+    if(UART5_CheckBaudRate(baud) == 0)
+    {
+        PROTO_Reply(request, PROTO_STATUS_FAIL, 0, 0);
+        return;
+    }
+
+    PROTO_Reply(request, PROTO_STATUS_OK, 0, 0);
+    UART5_SetBaudRate(baud);            /* waits for the reply to go out */
+    PROTO_ParserReset(&link_parser);
+    baud_probation = (baud != UART5_DEFAULT_BAUD);
+    baud_switch_time = SysTick_GetMs();
+}
+
+#if PROTO_SECURE
+/*
+ * UART_Hello
+ * Opens a session of the sealed link (protocol.h): draws a nonce like a
+ * challenge, so it never repeats, and answers with it and the confirm
+ * tag. A HELLO repeating the current session's HMI nonce (its reply was
+ * lost) gets the same answer and leaves the session running. As in
+ * Challenge_Check, no nonce is drawn while the epoch is not stored: the
+ * epoch is started again, and if that fails too the HELLO is answered
+ * PROTO_STATUS_FAIL (the HMI sends it again).
+ */
+void UART_Hello(const PROTO_Frame *request)
+{
+    static uint8_t hmi_nonce[SECLINK_NONCE_SIZE];
+    static uint8_t answer[SECLINK_NONCE_SIZE + SECLINK_TAG_SIZE];
+
+    if(request->length != SECLINK_NONCE_SIZE)
+    {
+        PROTO_ReplyPlain(request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+        return;
+    }
+
+    if(!epoch_saved)
+    {
+        Challenge_Epoch();
+        if(!epoch_saved)
+        {
+            PROTO_ReplyPlain(request, PROTO_STATUS_FAIL, 0, 0);
+            return;
+        }
+        Challenge_Draw();               /* nothing of the unstored epoch stays in use */
+    }
+
+    if(!PROTO_Secured() || memcmp(request->payload, hmi_nonce, SECLINK_NONCE_SIZE) != 0)
+    {
+        memcpy(hmi_nonce, request->payload, SECLINK_NONCE_SIZE);
+        challenge_count++;
+        PinAuth_Nonce(challenge_epoch, challenge_count, answer);
+        PROTO_SecureStart(SECLINK_CONTROL, hmi_nonce, answer, &answer[SECLINK_NONCE_SIZE]);
+    }
+    PROTO_ReplyPlain(request, PROTO_STATUS_OK, answer, sizeof(answer));
+}
+
+/*
+ * UART_Unsealed
+ * A plain frame or a sealed one that did not open: HELLO is served, any
+ * other request is answered PROTO_STATUS_NO_SESSION in clear.
+ */
+void UART_Unsealed(const PROTO_Frame *request, uint8_t result)
+{
+    if((request->type & PROTO_REPLY_FLAG) != 0)
+    {
+        return;
+    }
+
+    if(result == PROTO_FRAME_PLAIN && request->type == PROTO_CMD_HELLO)
+    {
+        UART_Hello(request);
+    }
+    else
+    {
+        PROTO_ReplyPlain(request, PROTO_STATUS_NO_SESSION, 0, 0);
+    }
+}
+#endif
+
+/*
+ * Baud_Task
+ * Drops back to UART5_DEFAULT_BAUD when a new rate is not confirmed in
+ * time or when receive errors pile up at a negotiated rate.
+ */
+void Baud_Task(void)
+{
+    uint32_t now = SysTick_GetMs();
+    uint8_t burst = PROTO_ErrorBurst(&link_errors, now);
+
+    if(UART5_GetBaudRate() == UART5_DEFAULT_BAUD)
+    {
+        baud_probation = 0;
+        return;
+    }
+
+    if(burst || (baud_probation && (now - baud_switch_time) >= PROTO_BAUD_PROBATION_MS))
+    {
+        UART5_SetBaudRate(UART5_DEFAULT_BAUD);
+        PROTO_ParserReset(&link_parser);
+        baud_probation = 0;
+    }
+}
+
+/*
+ * HandleDoorOperation
+ * Starts a door cycle. The reply is deferred until the door is unlocked;
+ * everything after that is driven by Door_Task from the main loop.
+ */
+void HandleDoorOperation(const PROTO_Frame *request)
+{
+    if(door_state == PROTO_DOOR_UNLOCKING && request->seq == door_request.seq)
+    {
+        return;                 /* retransmission, the reply is on its way */
+    }
+
+    if(door_state != PROTO_DOOR_LOCKED)
+    {
+        PROTO_Reply(request, PROTO_STATUS_BUSY, 0, 0);
+        return;
+    }
+
+    door_request = *request;
+    lock_requested = 0;
+    Audit_Log(PROTO_AUDIT_DOOR, PROTO_STATUS_OK, verified_user);
+    verified_user = PROTO_AUDIT_NOBODY;
+    Door_Unlock();
+}
+
+/*
+ * HandleLockNow
+ * Cuts the auto-lock wait short. A request during the unlock move is
+ * remembered and applied as soon as the door is open.
+ */
+void HandleLockNow(const PROTO_Frame *request)
+{
+    if(door_state == PROTO_DOOR_OPEN || door_state == PROTO_DOOR_HOLD)
+    {
+        Door_Lock();
+    }
+    else if(door_state == PROTO_DOOR_UNLOCKING)
+    {
+        lock_requested = 1;
+    }
+    PROTO_Reply(request, PROTO_STATUS_OK, 0, 0);
+}
+
+/*
+ * HandleDoorStatus
+ * Replies with the door cycle phase and the seconds left in that phase.
+ */
+void HandleDoorStatus(const PROTO_Frame *request)
+{
+    uint8_t status[2];
+
+    status[0] = door_state;
+    status[1] = Door_SecondsLeft();
+    PROTO_Reply(request, PROTO_STATUS_OK, status, 2);
+}
+
+/*
+ * Door_Task
+ * Advances the door cycle when the current phase times out:
+ *   UNLOCKING (3 s) -> OPEN (auto_lock_timeout) -> HOLD (2 s) -> LOCKING (3 s)
+ * Never blocks, so commands keep being served while the door is open.
+ */
+void Door_Task(void)
+{
+    if(door_state == PROTO_DOOR_LOCKED || !GPTM_Timer0A_TimeOut())
+    {
+        return;
+    }
+    GPTM_Timer0A_ClearFlag();
+
+    switch(door_state)
+    {
+        case PROTO_DOOR_UNLOCKING:
+            Motor_Stop();
+            PROTO_Reply(&door_request, PROTO_STATUS_OK, 0, 0);
+            if(lock_requested)
+            {
+                Door_Lock();
+            }
+            else
+            {
+                Door_StartPhase(PROTO_DOOR_OPEN, auto_lock_timeout * 1000U);
+            }
+            break;
+
+        case PROTO_DOOR_OPEN:
+            Door_StartPhase(PROTO_DOOR_HOLD, DOOR_HOLD_DELAY_MS);
+            break;
+
+        case PROTO_DOOR_HOLD:
+            Door_Lock();
+            break;
+
+        case PROTO_DOOR_LOCKING:
+        default:
+            Motor_Stop();
+            door_state = PROTO_DOOR_LOCKED;
+            PROTO_Send(PROTO_EVT_DOOR_LOCKED, event_seq++, 0, 0);
+            break;
+    }
+}
+
+int main(void)
+{
+    PROTO_Frame request;
+    uint8_t result;
+
+    System_Init();
+    UART5_InitMode(UART5_MODE_INTERRUPT);
+    PROTO_ParserReset(&link_parser);
+    PinHash_Init(SysCtl_GetClock());
+    Config_Init();                  /* retried by the HMI boot query if it fails */
+    UpgradePassword();
+    Lockout_Init();
+    Challenge_Init();
+    Audit_Log(PROTO_AUDIT_BOOT, PROTO_STATUS_OK, PROTO_AUDIT_NOBODY);
+    while(1)
+    {
+    result = PROTO_Poll(&link_parser, &request);
+#if PROTO_SECURE
+    if(result == PROTO_FRAME_PLAIN || result == PROTO_FRAME_REFUSED)
+    {
+         baud_probation = 0;
+         UART_Unsealed(&request, result);
+    }
+#endif
+
+    /* A retransmitted request is answered from the reply cache, except
+     * SET_BAUD which must switch again */
+    if(result == PROTO_FRAME_READY &&
+       (request.type == PROTO_CMD_SET_BAUD || !PROTO_ReplayReply(&request)))
+    {
+         baud_probation = 0;            /* a good frame confirms the rate */
+
+         switch(request.type){
+         
+         case PROTO_CMD_EEPROM_INIT:
+           UART_EEPROM_Init(&request);
+                break;
+           
+         case PROTO_CMD_PASSWORD_STATUS:
+           UART_RetrievePassword(&request);
+                break;
+           
+         case PROTO_CMD_GET_TIMEOUT:
+           UART_RetrieveTimeout(&request);
+                break;
+
+         case PROTO_CMD_VERIFY_PASSWORD:
+           UART_verifyPassword(&request);
+                break;
+
+         case PROTO_CMD_OPEN_DOOR:
+               HandleDoorOperation(&request);
+                break;
+
+         case PROTO_CMD_ALARM:
+           Audit_Log(PROTO_AUDIT_ALARM, PROTO_STATUS_OK, PROTO_AUDIT_NOBODY);
+           PROTO_Reply(&request, PROTO_STATUS_OK, 0, 0);
+           Buzzer_BeepAsync(ALARM_DURATION_MS);
+                break;
+
+         case PROTO_CMD_LOCK_NOW:
+           HandleLockNow(&request);
+                break;
+
+         case PROTO_CMD_DOOR_STATUS:
+           HandleDoorStatus(&request);
+                break;
+
+         case PROTO_CMD_STORE_PASSWORD:
+           UART_StorePassword(&request);
+                break;
+
+         case PROTO_CMD_STORE_TIMEOUT:
+           UART_StoreTimeout(&request);
+                break;
+
+         case PROTO_CMD_SET_BAUD:
+           UART_SetBaud(&request);
+                break;
+
+         case PROTO_CMD_PING:
+           PROTO_Reply(&request, PROTO_STATUS_OK, 0, 0);
+                break;
+
+         case PROTO_CMD_BOOT_SNAPSHOT:
+           UART_BootSnapshot(&request);
+                break;
+
+         case PROTO_CMD_PIN_DIGIT:
+           UART_PinDigit(&request);
+                break;
+
+         case PROTO_CMD_SUBSCRIBE:
+           UART_Subscribe(&request);
+                break;
+
+         case PROTO_CMD_FACTORY_RESET:
+           UART_FactoryReset(&request);
+                break;
+
+         case PROTO_CMD_EEPROM_SCAN:
+           UART_EepromScan(&request);
+                break;
+         case PROTO_CMD_EEPROM_STATS:
+           UART_EepromStats(&request);
+                break;
+         case PROTO_CMD_HASH_SCAN:
+           UART_HashScan(&request);
+                break;
+         case PROTO_CMD_USER_ADD:
+           UART_UserAdd(&request);
+                break;
+         case PROTO_CMD_USER_REVOKE:
+           UART_UserRevoke(&request);
+                break;
+         case PROTO_CMD_AUDIT_QUERY:
+           UART_AuditQuery(&request);
+                break;
+         default :
+           PROTO_Reply(&request, PROTO_STATUS_BAD_REQUEST, 0, 0);
+           break;
+         }
+
+    }
+
+    Door_Task();
+    Buzzer_Task();
+    Baud_Task();
+    Telemetry_Task();
+    AuditQuery_Task();
+    Lockout_Task();
+    Verdict_Task();
+    Config_Task();
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,309 @@
+/******************************************************************************
+ * File: audit.c
+ * Module: Control Audit
+ * Description: Append-only access log in an EEPROM ring
+ ******************************************************************************/
+
+#include "audit.h"
+#include "systick.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define AUDIT_WORDS             (AUDIT_ENTRIES * AUDIT_ENTRY_WORDS)
+#define AUDIT_ERASED            0xFFFFFFFFUL
+#define AUDIT_SEQ_SHIFT         17
+#define AUDIT_SEQ_MASK          0x7FU
+#define AUDIT_EVENT_SHIFT       13
+#define AUDIT_RESULT_SHIFT      10
+#define AUDIT_USER_MASK         0x3FFU              /* all ones = nobody */
+#define AUDIT_SUBMIT_DEADLINE_US 1000000UL          /* one batch, EEPROM copy cycles included */
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint32_t words[AUDIT_WORDS];         /* RAM copy of the ring */
+static uint32_t head = 0;                   /* slot of the next entry */
+static uint32_t length = 0;                 /* entries in the log */
+static uint32_t total = 0;                  /* entries numbered so far (Audit_End) */
+static uint8_t  seq = 0;                    /* sequence number of the next entry */
+static uint32_t unsaved = 0;                /* newest entries not written yet */
+static uint32_t unsaved_since = 0;          /* SysTick_GetMs when the oldest was logged */
+static uint32_t writing = 0;                /* entries of the write in flight */
+static uint8_t  stale = 0;                  /* writes in flight from before Audit_Init */
+static uint32_t clock_s = 0;
+static uint32_t clock_ms = 0;               /* SysTick_GetMs at clock_s */
+static uint8_t  loaded = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint8_t Audit_Check(uint32_t time, uint32_t body)
+{
+    uint8_t bytes[7];
+
+    bytes[0] = (uint8_t)(time >> 24);
+    bytes[1] = (uint8_t)(time >> 16);
+    bytes[2] = (uint8_t)(time >> 8);
+    bytes[3] = (uint8_t)(time & 0xFF);
+    bytes[4] = (uint8_t)(body >> 16);
+    bytes[5] = (uint8_t)(body >> 8);
+    bytes[6] = (uint8_t)(body & 0xFF);
+    return (uint8_t)(PROTO_Crc16(0xFFFF, bytes, sizeof(bytes)) & 0xFF);
+}
+
+static uint8_t Audit_Valid(uint32_t slot)
+{
+    uint32_t time = words[slot * AUDIT_ENTRY_WORDS];
+    uint32_t info = words[slot * AUDIT_ENTRY_WORDS + 1];
+
+    if(time == AUDIT_ERASED && info == AUDIT_ERASED)
+    {
+        return 0;
+    }
+    return (uint8_t)(info >> 24) == Audit_Check(time, info & 0x00FFFFFFUL);
+}
+
+static uint8_t Audit_Seq(uint32_t slot)
+{
+    return (uint8_t)((words[slot * AUDIT_ENTRY_WORDS + 1] >> AUDIT_SEQ_SHIFT) & AUDIT_SEQ_MASK);
+}
+
+static uint32_t Audit_Time(uint32_t slot)
+{
+    return words[slot * AUDIT_ENTRY_WORDS];
+}
+
+/* Whether the entry in slot was logged right after the one in prev */
+static uint8_t Audit_Follows(uint32_t prev, uint32_t slot)
+{
+    return Audit_Valid(prev) && Audit_Valid(slot) &&
+           Audit_Seq(slot) == ((Audit_Seq(prev) + 1U) & AUDIT_SEQ_MASK) &&
+           Audit_Time(prev) <= Audit_Time(slot);
+}
+
+/* Slot of an entry number that is in the ring */
+static uint32_t Audit_Slot(uint32_t number)
+{
+    return (head + AUDIT_ENTRIES - (total - number)) % AUDIT_ENTRIES;
+}
+
+/* Completion of the batch write of Audit_Task */
+static void Audit_Written(uint8_t result, uint32_t written)
+{
+    (void)written;
+
+    if(stale > 0)
+    {
+        stale--;
+        return;
+    }
+    if(result == EEPROM_SUCCESS)
+    {
+        unsaved = (unsaved > writing) ? (unsaved - writing) : 0;
+    }
+    unsaved_since = SysTick_GetMs();       /* after a failure, retry in AUDIT_FLUSH_MS */
+    writing = 0;
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Audit_Init(void)
+{
+    uint32_t newest = AUDIT_ENTRIES;
+    uint32_t slot;
+    uint32_t prev;
+    uint8_t result;
+
+    loaded = 0;
+    result = EEPROM_ReadBurst(AUDIT_FIRST_BLOCK, 0, words, AUDIT_WORDS);
+    if(result != EEPROM_SUCCESS)
+    {
+        return result;
+    }
+    if(writing != 0)
+    {
+        stale++;
+    }
+    writing = 0;
+    unsaved = 0;
+
+    /* The newest entry: valid, and not continued by the next slot */
+    for(slot = 0; slot < AUDIT_ENTRIES; slot++)
+    {
+        if(Audit_Valid(slot) && !Audit_Follows(slot, (slot + 1U) % AUDIT_ENTRIES) &&
+           (newest == AUDIT_ENTRIES || Audit_Time(slot) >= Audit_Time(newest)))
+        {
+            newest = slot;
+        }
+    }
+
+    head = 0;
+    seq = 0;
+    length = 0;
+    if(newest != AUDIT_ENTRIES)
+    {
+        /* Back from the newest entry for as long as the sequence runs */
+        slot = newest;
+        length = 1;
+        while(length < AUDIT_ENTRIES)
+        {
+            prev = (slot + AUDIT_ENTRIES - 1U) % AUDIT_ENTRIES;
+            if(!Audit_Follows(prev, slot))
+            {
+                break;
+            }
+            slot = prev;
+            length++;
+        }
+        head = (newest + 1U) % AUDIT_ENTRIES;
+        seq = (uint8_t)((Audit_Seq(newest) + 1U) & AUDIT_SEQ_MASK);
+        if(Audit_Now() < Audit_Time(newest))
+        {
+            clock_s = Audit_Time(newest);
+        }
+    }
+    total = length;
+    loaded = 1;
+    return EEPROM_SUCCESS;
+}
+
+void Audit_Log(uint8_t event, uint8_t result, uint16_t user)
+{
+    uint32_t time;
+    uint32_t body;
+
+    if(!loaded)
+    {
+        return;
+    }
+
+    time = Audit_Now();
+    body = ((uint32_t)seq << AUDIT_SEQ_SHIFT) |
+           ((uint32_t)(event & 0x0F) << AUDIT_EVENT_SHIFT) |
+           ((uint32_t)(result & 0x07) << AUDIT_RESULT_SHIFT) |
+           ((user > USERS_ID_MAX) ? AUDIT_USER_MASK : user);
+    words[head * AUDIT_ENTRY_WORDS] = time;
+    words[head * AUDIT_ENTRY_WORDS + 1] = ((uint32_t)Audit_Check(time, body) << 24) | body;
+
+    head = (head + 1U) % AUDIT_ENTRIES;
+    seq = (uint8_t)((seq + 1U) & AUDIT_SEQ_MASK);
+    total++;
+    if(length < AUDIT_ENTRIES)
+    {
+        length++;
+    }
+    if(unsaved == 0)
+    {
+        unsaved_since = SysTick_GetMs();
+    }
+    if(unsaved < AUDIT_ENTRIES)
+    {
+        unsaved++;
+    }
+}
+
+uint32_t Audit_Now(void)
+{
+    uint32_t elapsed = (SysTick_GetMs() - clock_ms) / 1000U;
+
+    clock_s += elapsed;
+    clock_ms += elapsed * 1000U;
+    return clock_s;
+}
+
+uint32_t Audit_End(void)
+{
+    return total;
+}
+
+uint32_t Audit_Search(uint32_t time)
+{
+    uint32_t low = total - length;
+    uint32_t high = total;
+    uint32_t mid;
+
+    while(low < high)
+    {
+        mid = low + (high - low) / 2U;
+        if(Audit_Time(Audit_Slot(mid)) < time)
+        {
+            low = mid + 1U;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+uint8_t Audit_Get(uint32_t number, Audit_Entry *entry)
+{
+    uint32_t info;
+    uint32_t slot;
+
+    if(!loaded || entry == 0 || number >= total || total - number > length)
+    {
+        return 0;
+    }
+    slot = Audit_Slot(number);
+    info = words[slot * AUDIT_ENTRY_WORDS + 1];
+    entry->time = Audit_Time(slot);
+    entry->event = (uint8_t)((info >> AUDIT_EVENT_SHIFT) & 0x0F);
+    entry->result = (uint8_t)((info >> AUDIT_RESULT_SHIFT) & 0x07);
+    entry->user = (uint16_t)(info & AUDIT_USER_MASK);
+    if(entry->user == AUDIT_USER_MASK)
+    {
+        entry->user = PROTO_AUDIT_NOBODY;
+    }
+    return 1;
+}
+
+void Audit_Task(void)
+{
+    uint8_t raw[AUDIT_BATCH * AUDIT_ENTRY_WORDS * EEPROM_WORD_SIZE];
+    uint32_t first;
+    uint32_t count;
+    uint32_t word;
+    uint32_t i;
+
+    if(!loaded || writing != 0 || unsaved == 0 ||
+       (unsaved < AUDIT_BATCH && (SysTick_GetMs() - unsaved_since) < AUDIT_FLUSH_MS))
+    {
+        return;
+    }
+
+    /* Oldest unsaved entries, up to the end of the ring */
+    first = (head + AUDIT_ENTRIES - unsaved) % AUDIT_ENTRIES;
+    count = unsaved;
+    if(count > AUDIT_BATCH)
+    {
+        count = AUDIT_BATCH;
+    }
+    if(count > AUDIT_ENTRIES - first)
+    {
+        count = AUDIT_ENTRIES - first;
+    }
+
+    for(i = 0; i < count * AUDIT_ENTRY_WORDS; i++)
+    {
+        word = words[first * AUDIT_ENTRY_WORDS + i];
+        raw[i * 4]     = (uint8_t)(word & 0xFF);
+        raw[i * 4 + 1] = (uint8_t)((word >> 8) & 0xFF);
+        raw[i * 4 + 2] = (uint8_t)((word >> 16) & 0xFF);
+        raw[i * 4 + 3] = (uint8_t)((word >> 24) & 0xFF);
+    }
+    first *= AUDIT_ENTRY_WORDS;
+    if(EEPROM_Submit(AUDIT_FIRST_BLOCK + first / EEPROM_BLOCK_SIZE, first % EEPROM_BLOCK_SIZE,
+                     raw, count * AUDIT_ENTRY_WORDS * EEPROM_WORD_SIZE,
+                     AUDIT_SUBMIT_DEADLINE_US, Audit_Written) == EEPROM_SUCCESS)
+    {
+        writing = count;
+    }
+}
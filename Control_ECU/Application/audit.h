@@ -0,0 +1,124 @@
+/******************************************************************************
+ * File: audit.h
+ * Module: Control Audit
+ * Description: Append-only access log in an EEPROM ring
+ *
+ * PIN checks, door openings, alarms, user and settings changes are each
+ * logged as one fixed-size entry in a ring of AUDIT_ENTRIES entries kept
+ * in the AUDIT_BLOCKS blocks between the user table (users.h) and the
+ * wear table (wear.h); once the ring is full the oldest entry goes.
+ * Entry (2 words, written in this order):
+ *
+ *   word 0  time (s, see Audit_Now)
+ *   word 1  bits 31-24  check byte, low byte of PROTO_Crc16 over the
+ *                       time and bits 23-0
+ *           bits 23-17  sequence number, mod 128
+ *           bits 16-13  PROTO_AUDIT_xxx event
+ *           bits 12-10  result, PROTO_STATUS_xxx
+ *           bits 9-0    user id, all ones = PROTO_AUDIT_NOBODY
+ *
+ * No head pointer is stored: the newest entry is the one the next slot
+ * does not continue (sequence + 1). An entry torn by a reset fails its
+ * check and ends the log there.
+ *
+ * Audit_Log appends to the RAM copy of the ring only. Audit_Task writes
+ * the new entries with one EEPROM_Submit once AUDIT_BATCH of them are
+ * waiting or the oldest has waited AUDIT_FLUSH_MS, so a burst of events
+ * costs one queued write rather than one per event; a reset loses at
+ * most those. The RAM copy is also the index of the queries: times never
+ * go backwards along the log, so Audit_Search bisects it.
+ *
+ * There is no real-time clock. Time is counted in seconds of uptime and
+ * carries on at boot from the newest entry, so it never goes backwards,
+ * but the time the device was off is not counted; the query reply gives
+ * the current value for a host to line it up with its own clock.
+ ******************************************************************************/
+
+#ifndef AUDIT_H_
+#define AUDIT_H_
+
+#include <stdint.h>
+#include "users.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define AUDIT_FIRST_BLOCK       (USERS_FIRST_BLOCK + USERS_BLOCKS)
+#define AUDIT_BLOCKS            6
+#define AUDIT_ENTRY_WORDS       2
+#define AUDIT_ENTRIES           (AUDIT_BLOCKS * EEPROM_BLOCK_SIZE / AUDIT_ENTRY_WORDS)
+#define AUDIT_BATCH             (EEPROM_QUEUE_WORDS / AUDIT_ENTRY_WORDS)   /* per write */
+#define AUDIT_FLUSH_MS          1000
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint32_t time;          /* Audit_Now when logged */
+    uint8_t  event;         /* PROTO_AUDIT_xxx */
+    uint8_t  result;        /* PROTO_STATUS_xxx */
+    uint16_t user;          /* user id, PROTO_AUDIT_NOBODY */
+} Audit_Entry;
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Audit_Init
+ * Loads the ring into RAM and moves the clock past its newest entry.
+ * Call once the EEPROM is initialized, and again after a full erase.
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Audit_Init(void);
+
+/*
+ * Audit_Log
+ * Appends an entry stamped with Audit_Now (to RAM; see Audit_Task).
+ * Dropped if the ring was never loaded.
+ */
+void Audit_Log(uint8_t event, uint8_t result, uint16_t user);
+
+/*
+ * Audit_Now
+ * Returns: the log's clock, in seconds
+ */
+uint32_t Audit_Now(void);
+
+/*
+ * Audit_End
+ * Entries are numbered in the order they were logged since Audit_Init,
+ * the oldest in the ring being number Audit_End() - (entries in the ring).
+ * Returns: the number the next entry will get
+ */
+uint32_t Audit_End(void);
+
+/*
+ * Audit_Search
+ * Returns: the number of the oldest entry in the ring logged at or after
+ *          time, Audit_End() if there is none
+ */
+uint32_t Audit_Search(uint32_t time);
+
+/*
+ * Audit_Get
+ * Parameters:
+ *   number - Entry number (see Audit_End)
+ *   entry  - Receives the entry
+ * Returns: 1, or 0 if the entry is not in the ring (overwritten, or not
+ *          logged yet)
+ */
+uint8_t Audit_Get(uint32_t number, Audit_Entry *entry);
+
+/*
+ * Audit_Task
+ * Writes the entries logged since the last write in the background once
+ * AUDIT_BATCH are waiting or AUDIT_FLUSH_MS have passed. Call from the
+ * main loop.
+ */
+void Audit_Task(void);
+
+#endif /* AUDIT_H_ */
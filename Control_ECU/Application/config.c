@@ -0,0 +1,243 @@
+/******************************************************************************
+ * File: config.c
+ * Module: Control Config
+ * Description: RAM shadow of the configuration record
+ ******************************************************************************/
+
+#include <string.h>
+#include "config.h"
+#include "users.h"
+#include "audit.h"
+#include "wear.h"
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint8_t  shadow[CONFIG_SIZE];
+static uint8_t  set = 0;                    /* bit per word written since the last erase */
+static uint8_t  loaded = 0;
+static uint32_t generation = 0;
+static uint8_t  pending[CONFIG_SIZE];       /* record of a Config_Submit in flight */
+static uint8_t  pending_set = 0;
+static uint8_t  submitting = 0;
+static EEPROM_Callback pending_done = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint8_t Config_Load(void)
+{
+    uint8_t result;
+
+    result = Store_Mount(shadow, &set);
+    loaded = (result == EEPROM_SUCCESS);
+    generation++;
+    return result;
+}
+
+static uint8_t Config_InRange(uint32_t offset, const void *buffer, uint32_t length)
+{
+    return buffer != 0 && (length % EEPROM_WORD_SIZE) == 0 &&
+           offset < CONFIG_WORDS &&
+           length <= (CONFIG_WORDS - offset) * EEPROM_WORD_SIZE;
+}
+
+/* Bits of the words a field covers */
+static uint8_t Config_Mask(uint32_t offset, uint32_t length)
+{
+    return (uint8_t)(((1U << (length / EEPROM_WORD_SIZE)) - 1U) << offset);
+}
+
+/* The shadow with a field changed, as the next record */
+static uint8_t Config_Merge(uint32_t offset, const uint8_t *buffer, uint32_t length, uint8_t *record)
+{
+    memcpy(record, shadow, CONFIG_SIZE);
+    memcpy(&record[offset * EEPROM_WORD_SIZE], buffer, length);
+    return (uint8_t)(set | Config_Mask(offset, length));
+}
+
+/* Writes the record with a changed field and updates the shadow */
+static uint8_t Config_Commit(uint32_t offset, const uint8_t *buffer, uint32_t length, uint32_t *written)
+{
+    uint8_t record[CONFIG_SIZE];
+    uint8_t record_set;
+
+    record_set = Config_Merge(offset, buffer, length, record);
+    if(Store_Write(record, record_set, written) != EEPROM_SUCCESS)
+    {
+        /* The previous copy is still the newest valid one: reload it */
+        Config_Load();
+        return EEPROM_ERROR;
+    }
+
+    memcpy(shadow, record, CONFIG_SIZE);
+    set = record_set;
+    generation++;
+    return EEPROM_SUCCESS;
+}
+
+/* Completion of Config_Submit: the shadow follows the journal */
+static void Config_Submitted(uint8_t result, uint32_t written)
+{
+    EEPROM_Callback done = pending_done;
+
+    if(result == EEPROM_SUCCESS)
+    {
+        memcpy(shadow, pending, CONFIG_SIZE);
+        set = pending_set;
+        generation++;
+    }
+    else
+    {
+        Config_Load();
+    }
+    submitting = 0;
+    pending_done = 0;
+    if(done != 0)
+    {
+        done(result, written);
+    }
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Config_Init(void)
+{
+    uint8_t result;
+
+    if(loaded)
+    {
+        return EEPROM_SUCCESS;
+    }
+    result = EEPROM_Init();
+    if(result == EEPROM_SUCCESS)
+    {
+        result = Config_Load();
+    }
+    if(result == EEPROM_SUCCESS)
+    {
+        Wear_Init();
+        Users_Init();
+        Audit_Init();
+    }
+    return result;
+}
+
+uint8_t Config_Read(uint32_t offset, uint8_t *buffer, uint32_t length)
+{
+    if(!Config_InRange(offset, buffer, length) || Config_Init() != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    memcpy(buffer, &shadow[offset * EEPROM_WORD_SIZE], length);
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Config_Matches(uint32_t offset, const uint8_t *buffer, uint32_t length)
+{
+    return buffer != 0 && Config_IsSet(offset, length) &&
+           memcmp(&shadow[offset * EEPROM_WORD_SIZE], buffer, length) == 0;
+}
+
+uint8_t Config_IsSet(uint32_t offset, uint32_t length)
+{
+    uint8_t mask;
+
+    if(length == 0 || !Config_InRange(offset, shadow, length) || Config_Init() != EEPROM_SUCCESS)
+    {
+        return 0;
+    }
+    mask = Config_Mask(offset, length);
+    return (set & mask) == mask;
+}
+
+uint8_t Config_Write(uint32_t offset, const uint8_t *buffer, uint32_t length, uint32_t *written)
+{
+    uint32_t count = 0;
+    uint8_t result = EEPROM_ERROR;
+
+    if(Config_InRange(offset, buffer, length) && Config_Init() == EEPROM_SUCCESS)
+    {
+        result = EEPROM_SUCCESS;
+        if(!Config_Matches(offset, buffer, length))
+        {
+            result = Config_Commit(offset, buffer, length, &count);
+        }
+    }
+    if(written != 0)
+    {
+        *written = count;
+    }
+    return result;
+}
+
+uint8_t Config_Submit(uint32_t offset, const uint8_t *buffer, uint32_t length, EEPROM_Callback done)
+{
+    if(submitting || length == 0 ||
+       !Config_InRange(offset, buffer, length) || Config_Init() != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+
+    pending_set = Config_Merge(offset, buffer, length, pending);
+    if(Store_Submit(pending, pending_set, Config_Submitted) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    submitting = 1;
+    pending_done = done;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Config_Erase(uint8_t full)
+{
+    uint8_t result;
+
+    Config_Init();
+    /* Users first: a reset in between leaves the record to erase again */
+    if(!full && Users_Clear() != EEPROM_SUCCESS)
+    {
+        full = 1;
+    }
+    result = full ? Store_Format() : Store_Erase();
+    if(result != EEPROM_SUCCESS)
+    {
+        Config_Load();
+        return result;
+    }
+    memset(shadow, 0xFF, sizeof(shadow));
+    set = 0;
+    loaded = 1;
+    generation++;
+    if(full)
+    {
+        Users_Init();       /* the full erase took the tables with it */
+        Audit_Init();
+        Wear_Flush();
+    }
+    return EEPROM_SUCCESS;
+}
+
+void Config_Forget(void)
+{
+    Store_Forget();
+}
+
+void Config_Task(void)
+{
+    Store_Task();
+    Audit_Task();
+    if(!submitting)
+    {
+        Wear_Task();
+    }
+}
+
+uint32_t Config_Generation(void)
+{
+    return generation;
+}
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * File: config.h
+ * Module: Control Config
+ * Description: RAM shadow of the configuration record
+ *
+ * The record lives in the wear-leveled journal of store.c; its newest
+ * valid copy is loaded once at Config_Init and every read after that is
+ * served from RAM. Every write stores a whole new copy, verified there,
+ * and only then updates the shadow, so the shadow always matches the
+ * array and a reset mid-write leaves the previous record in force.
+ * Along with the record the journal keeps which words were ever written,
+ * so Config_IsSet tells an unset field from stored data without looking
+ * at its contents.
+ * Config_Generation changes on every successful write or erase; a caller
+ * that keeps a copy of a field compares it instead of re-reading.
+ ******************************************************************************/
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include "store.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define CONFIG_WORDS            STORE_IMAGE_WORDS
+#define CONFIG_SIZE             (CONFIG_WORDS * EEPROM_WORD_SIZE)
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Config_Init
+ * Initializes the EEPROM and loads the shadow, the wear table (wear.h),
+ * the user table (users.h) and the access log (audit.h). Only the first
+ * successful call touches the EEPROM; after a failure the next call
+ * tries again.
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Config_Init(void);
+
+/*
+ * Config_Read
+ * Copies bytes of the record from the shadow (loading it first if needed).
+ * Parameters:
+ *   offset - Word offset within the record
+ *   buffer - Destination
+ *   length - Number of bytes (multiple of 4, within the record)
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR on bad arguments or no shadow
+ */
+uint8_t Config_Read(uint32_t offset, uint8_t *buffer, uint32_t length);
+
+/*
+ * Config_Write
+ * Writes bytes of the record through to EEPROM (one new copy of the
+ * record, verified by reading back). Bytes equal to the shadow of a field
+ * already set are a no-op: nothing is read or written.
+ * Parameters:
+ *   offset  - Word offset within the record
+ *   buffer  - Data
+ *   length  - Number of bytes (multiple of 4, within the record)
+ *   written - Receives the number of EEPROM words programmed (may be 0)
+ * Returns: EEPROM_SUCCESS, or EEPROM_ERROR if the write or verify failed
+ *          (the shadow is then reloaded from the array)
+ */
+uint8_t Config_Write(uint32_t offset, const uint8_t *buffer, uint32_t length, uint32_t *written);
+
+/*
+ * Config_Submit
+ * Queued form of Config_Write: returns at once and the shadow is updated
+ * when the EEPROM write queue reports the new copy. Unlike Config_Write
+ * it always writes, so check Config_Matches first. One submit at a time.
+ * Parameters:
+ *   offset - Word offset within the record
+ *   buffer - Data, copied
+ *   length - Number of bytes (multiple of 4, within the record)
+ *   done   - Called from Config_Task with the result and the number of
+ *            EEPROM words programmed (the shadow is reloaded on failure)
+ * Returns: EEPROM_SUCCESS if queued, EEPROM_ERROR if not (done is then
+ *          never called)
+ */
+uint8_t Config_Submit(uint32_t offset, const uint8_t *buffer, uint32_t length, EEPROM_Callback done);
+
+/*
+ * Config_Matches
+ * Returns: 1 if the field is set and already holds these bytes (a write
+ *          would be a no-op), 0 otherwise or on bad arguments
+ */
+uint8_t Config_Matches(uint32_t offset, const uint8_t *buffer, uint32_t length);
+
+/*
+ * Config_IsSet
+ * Returns: 1 if every word of the field was written since the last erase,
+ *          0 otherwise, on bad arguments or with no record loaded
+ */
+uint8_t Config_IsSet(uint32_t offset, uint32_t length);
+
+/*
+ * Config_Erase
+ * Erases the record and revokes every user; the shadow becomes all 0xFF
+ * and no field is set.
+ * Parameters:
+ *   full - 0: logical erase (Users_Clear, then Store_Erase, one blank
+ *             copy); a full erase if the user table can't be cleared.
+ *             The access log (audit.h) is kept.
+ *          1: every EEPROM block erased (Store_Format), the access log
+ *             included
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t Config_Erase(uint8_t full);
+
+/*
+ * Config_Forget
+ * Scrubs the older copies of the record from the journal in the
+ * background (Store_Forget); the current one is kept.
+ */
+void Config_Forget(void);
+
+/*
+ * Config_Task
+ * EEPROM write queue, background journal scrub (Store_Task), access
+ * log writes (Audit_Task) and wear table write-back (Wear_Task), call
+ * from the main loop.
+ */
+void Config_Task(void);
+
+/*
+ * Config_Generation
+ * Returns: a counter bumped by every change of the record
+ */
+uint32_t Config_Generation(void);
+
+#endif /* CONFIG_H_ */
@@ -0,0 +1,183 @@
+/******************************************************************************
+ * File: lockout.c
+ * Module: Control Lockout
+ * Description: Failed PIN counting and lockout with exponential back-off
+ ******************************************************************************/
+
+#include "lockout.h"
+#include "config.h"
+#include "audit.h"
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint8_t  failures = 0;               /* wrong PINs since the last correct one */
+static uint32_t until = 0;                  /* Audit_Now at the end of the lockout */
+static uint8_t  changes = 0;                /* bumped by every change of the two */
+static uint8_t  saved = 0;                  /* changes as of the last commit */
+static uint8_t  writing = 0;                /* changes of the write in flight */
+static uint8_t  in_flight = 0;
+static uint8_t  loaded = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+/* Lockout earned by the count-th wrong PIN in a row */
+static uint32_t Lockout_Duration(uint8_t count)
+{
+    uint32_t seconds = LOCKOUT_BASE_S;
+    uint8_t n;
+
+    if(count < LOCKOUT_ATTEMPTS)
+    {
+        return 0;
+    }
+    for(n = LOCKOUT_ATTEMPTS; n < count && seconds < LOCKOUT_MAX_S; n++)
+    {
+        seconds *= 2U;
+    }
+    return (seconds < LOCKOUT_MAX_S) ? seconds : LOCKOUT_MAX_S;
+}
+
+static void Lockout_Encode(uint8_t *bytes)
+{
+    bytes[0] = failures;
+    bytes[1] = 0;
+    bytes[2] = 0;
+    bytes[3] = 0;
+    bytes[4] = (uint8_t)(until >> 24);
+    bytes[5] = (uint8_t)(until >> 16);
+    bytes[6] = (uint8_t)(until >> 8);
+    bytes[7] = (uint8_t)(until & 0xFF);
+}
+
+/* Completion of the write of Lockout_Task */
+static void Lockout_Written(uint8_t result, uint32_t written)
+{
+    (void)written;
+
+    in_flight = 0;
+    if(result == EEPROM_SUCCESS)
+    {
+        saved = writing;
+    }
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Lockout_Init(void)
+{
+    uint8_t bytes[LOCKOUT_CONFIG_SIZE];
+    uint8_t result;
+
+    if(loaded)
+    {
+        return EEPROM_SUCCESS;
+    }
+    result = Config_Read(LOCKOUT_CONFIG_OFFSET, bytes, LOCKOUT_CONFIG_SIZE);
+    if(result != EEPROM_SUCCESS)
+    {
+        return result;
+    }
+
+    failures = 0;
+    until = 0;
+    if(Config_IsSet(LOCKOUT_CONFIG_OFFSET, LOCKOUT_CONFIG_SIZE))
+    {
+        failures = bytes[0];
+        until = ((uint32_t)bytes[4] << 24) | ((uint32_t)bytes[5] << 16) |
+                ((uint32_t)bytes[6] << 8) | bytes[7];
+    }
+    saved = changes;
+    loaded = 1;
+    return EEPROM_SUCCESS;
+}
+
+void Lockout_Clear(void)
+{
+    failures = 0;
+    until = 0;
+    saved = changes;
+    loaded = 1;
+}
+
+uint16_t Lockout_Remaining(void)
+{
+    uint32_t now;
+    uint32_t left;
+    uint32_t longest;
+
+    if(!loaded)
+    {
+        return 0;
+    }
+    longest = Lockout_Duration(failures);
+    now = Audit_Now();
+    if(longest == 0 || until <= now)
+    {
+        return 0;
+    }
+    /* Never more than the lockout itself, whatever the clock did (erase) */
+    left = until - now;
+    return (uint16_t)((left < longest) ? left : longest);
+}
+
+void Lockout_Pass(void)
+{
+    if(Lockout_Init() == EEPROM_SUCCESS && (failures != 0 || until != 0))
+    {
+        failures = 0;
+        until = 0;
+        changes++;
+    }
+}
+
+uint8_t Lockout_Fail(void)
+{
+    if(Lockout_Init() != EEPROM_SUCCESS)
+    {
+        return 0;
+    }
+    if(failures < 0xFF)
+    {
+        failures++;
+    }
+    changes++;
+    if(failures < LOCKOUT_ATTEMPTS)
+    {
+        return 0;
+    }
+    until = Audit_Now() + Lockout_Duration(failures);
+    return 1;
+}
+
+uint8_t Lockout_Saved(void)
+{
+    return changes == saved;
+}
+
+void Lockout_Task(void)
+{
+    uint8_t bytes[LOCKOUT_CONFIG_SIZE];
+
+    if(!loaded || in_flight || changes == saved)
+    {
+        return;
+    }
+
+    Lockout_Encode(bytes);
+    if(Config_Matches(LOCKOUT_CONFIG_OFFSET, bytes, LOCKOUT_CONFIG_SIZE))
+    {
+        saved = changes;
+        return;
+    }
+    writing = changes;
+    if(Config_Submit(LOCKOUT_CONFIG_OFFSET, bytes, LOCKOUT_CONFIG_SIZE, Lockout_Written) == EEPROM_SUCCESS)
+    {
+        in_flight = 1;
+    }
+}
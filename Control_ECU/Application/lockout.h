@@ -0,0 +1,92 @@
+/******************************************************************************
+ * File: lockout.h
+ * Module: Control Lockout
+ * Description: Failed PIN counting and lockout with exponential back-off
+ *
+ * Every PIN check on Control_ECU (VERIFY_PASSWORD, the last PIN_DIGIT, the
+ * master password of USER_ADD / USER_REVOKE) reports its outcome here.
+ * Wrong PINs are counted since the last correct one; from the
+ * LOCKOUT_ATTEMPTS-th on, each one locks PIN checks out for
+ * LOCKOUT_BASE_S, doubled for every further wrong PIN up to LOCKOUT_MAX_S.
+ * While locked, PIN checks are refused without looking at the PIN.
+ *
+ * The count and the end of the lockout live in words 2-3 of the config
+ * record (config.h), written back by Lockout_Task through the EEPROM
+ * write queue; the caller holds the verdict until Lockout_Saved, so a
+ * reset can't undo a wrong PIN the HMI has already been told about:
+ *
+ *   byte 0     wrong PINs since the last correct one (saturates at 255)
+ *   bytes 1-3  0
+ *   bytes 4-7  end of the lockout, Audit_Now seconds, MSB first
+ *
+ * Time is the access log's clock (audit.h): it never goes backwards and
+ * stops while the device is off, so a reset does not shorten a lockout.
+ ******************************************************************************/
+
+#ifndef LOCKOUT_H_
+#define LOCKOUT_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define LOCKOUT_CONFIG_OFFSET   2       /* word offset in the config record */
+#define LOCKOUT_CONFIG_SIZE     8
+#define LOCKOUT_ATTEMPTS        3       /* wrong PINs before the first lockout */
+#define LOCKOUT_BASE_S          10
+#define LOCKOUT_MAX_S           600
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Lockout_Init
+ * Loads the counters from the config record. Only the first successful
+ * call reads it; Lockout_Pass and Lockout_Fail call it if needed.
+ * Returns: EEPROM_SUCCESS, or the Config_Read error
+ */
+uint8_t Lockout_Init(void);
+
+/*
+ * Lockout_Clear
+ * The config record was erased: the counters are back to none.
+ */
+void Lockout_Clear(void);
+
+/*
+ * Lockout_Remaining
+ * Returns: seconds until PIN checks are accepted again, 0 if not locked
+ *          or not loaded yet
+ */
+uint16_t Lockout_Remaining(void);
+
+/*
+ * Lockout_Pass
+ * A correct PIN: clears the count.
+ */
+void Lockout_Pass(void);
+
+/*
+ * Lockout_Fail
+ * A wrong PIN: counts it and locks out from LOCKOUT_ATTEMPTS on.
+ * Returns: 1 if it started a lockout, 0 otherwise
+ */
+uint8_t Lockout_Fail(void);
+
+/*
+ * Lockout_Saved
+ * Returns: 1 once every change to the counters is in the EEPROM
+ */
+uint8_t Lockout_Saved(void);
+
+/*
+ * Lockout_Task
+ * Writes changed counters back (Config_Submit, retried while the config
+ * record is busy). Call from the main loop.
+ */
+void Lockout_Task(void);
+
+#endif /* LOCKOUT_H_ */
@@ -0,0 +1,307 @@
+/******************************************************************************
+ * File: pinhash.c
+ * Module: Control PIN Hash
+ * Description: Salted, iterated hash of the master password
+ *
+ * PBKDF2 with a single output block. The HMAC key is the PIN, so its inner
+ * and outer padded states are hashed once per check; every iteration then
+ * costs exactly two SHA-256 compressions of blocks whose padding is filled
+ * in once. Words stay in registers in the compression: the eight working
+ * variables rotate through the round macro's arguments instead of being
+ * moved, and rotations are the ROR the Cortex-M4 does in one cycle.
+ ******************************************************************************/
+
+#include "pinhash.h"
+#include "systick.h"
+#include "GPTM_TIMER1.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define ROTR(x, n)              (((x) >> (n)) | ((x) << (32U - (n))))
+#define SIGMA0(a)               (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22))
+#define SIGMA1(e)               (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25))
+#define GAMMA0(w)               (ROTR(w, 7) ^ ROTR(w, 18) ^ ((w) >> 3))
+#define GAMMA1(w)               (ROTR(w, 17) ^ ROTR(w, 19) ^ ((w) >> 10))
+#define CH(e, f, g)             ((((f) ^ (g)) & (e)) ^ (g))
+#define MAJ(a, b, c)            (((a) & (b)) | (((a) | (b)) & (c)))
+
+/* Message word j: the block itself, then the schedule kept in 16 words */
+#define WORD(j)                 (w[j])
+#define SCHEDULE(j)             (w[(j) & 15U] += GAMMA1(w[((j) - 2U) & 15U]) + w[((j) - 7U) & 15U] + \
+                                                 GAMMA0(w[((j) - 15U) & 15U]))
+
+#define ROUND(a, b, c, d, e, f, g, h, j, next) \
+    do { \
+        uint32_t t1 = (h) + SIGMA1(e) + CH(e, f, g) + sha256_k[j] + next(j); \
+        (d) += t1; \
+        (h) = t1 + SIGMA0(a) + MAJ(a, b, c); \
+    } while(0)
+
+#define ROUNDS8(j, next) \
+    ROUND(a, b, c, d, e, f, g, h, (j) + 0U, next); \
+    ROUND(h, a, b, c, d, e, f, g, (j) + 1U, next); \
+    ROUND(g, h, a, b, c, d, e, f, (j) + 2U, next); \
+    ROUND(f, g, h, a, b, c, d, e, (j) + 3U, next); \
+    ROUND(e, f, g, h, a, b, c, d, (j) + 4U, next); \
+    ROUND(d, e, f, g, h, a, b, c, (j) + 5U, next); \
+    ROUND(c, d, e, f, g, h, a, b, (j) + 6U, next); \
+    ROUND(b, c, d, e, f, g, h, a, (j) + 7U, next)
+
+#define HMAC_IPAD               0x36363636UL
+#define HMAC_OPAD               0x5C5C5C5CUL
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static const uint32_t sha256_k[64] =
+{
+    0x428A2F98UL, 0x71374491UL, 0xB5C0FBCFUL, 0xE9B5DBA5UL, 0x3956C25BUL, 0x59F111F1UL, 0x923F82A4UL, 0xAB1C5ED5UL,
+    0xD807AA98UL, 0x12835B01UL, 0x243185BEUL, 0x550C7DC3UL, 0x72BE5D74UL, 0x80DEB1FEUL, 0x9BDC06A7UL, 0xC19BF174UL,
+    0xE49B69C1UL, 0xEFBE4786UL, 0x0FC19DC6UL, 0x240CA1CCUL, 0x2DE92C6FUL, 0x4A7484AAUL, 0x5CB0A9DCUL, 0x76F988DAUL,
+    0x983E5152UL, 0xA831C66DUL, 0xB00327C8UL, 0xBF597FC7UL, 0xC6E00BF3UL, 0xD5A79147UL, 0x06CA6351UL, 0x14292967UL,
+    0x27B70A85UL, 0x2E1B2138UL, 0x4D2C6DFCUL, 0x53380D13UL, 0x650A7354UL, 0x766A0ABBUL, 0x81C2C92EUL, 0x92722C85UL,
+    0xA2BFE8A1UL, 0xA81A664BUL, 0xC24B8B70UL, 0xC76C51A3UL, 0xD192E819UL, 0xD6990624UL, 0xF40E3585UL, 0x106AA070UL,
+    0x19A4C116UL, 0x1E376C08UL, 0x2748774CUL, 0x34B0BCB5UL, 0x391C0CB3UL, 0x4ED8AA4AUL, 0x5B9CCA4FUL, 0x682E6FF3UL,
+    0x748F82EEUL, 0x78A5636FUL, 0x84C87814UL, 0x8CC70208UL, 0x90BEFFFAUL, 0xA4506CEBUL, 0xBEF9A3F7UL, 0xC67178F2UL
+};
+
+static const uint32_t sha256_iv[8] =
+{
+    0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+    0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static uint16_t iterations = PINHASH_MIN_ITERATIONS;
+static uint32_t salt_state = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+/* One SHA-256 compression of a 16-word block (big-endian words) into state */
+static void PinHash_Compress(uint32_t *state, const uint32_t *block)
+{
+    uint32_t w[16];
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    uint32_t j;
+
+    for(j = 0; j < 16U; j++)
+    {
+        w[j] = block[j];
+    }
+    for(j = 0; j < 16U; j += 8U)
+    {
+        ROUNDS8(j, WORD);
+    }
+    for(; j < 64U; j += 8U)
+    {
+        ROUNDS8(j, SCHEDULE);
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void PinHash_Copy(uint32_t *to, const uint32_t *from)
+{
+    uint8_t i;
+
+    for(i = 0; i < 8U; i++)
+    {
+        to[i] = from[i];
+    }
+}
+
+/* State after the key block of HMAC(pin), with the pad given */
+static void PinHash_KeyState(const char *pin, uint32_t pad, uint32_t *state)
+{
+    uint32_t block[16];
+    uint8_t i;
+
+    for(i = 0; i < 16U; i++)
+    {
+        block[i] = pad;
+    }
+    for(i = 0; i < PINHASH_PIN_LENGTH; i++)
+    {
+        block[i / 4U] ^= (uint32_t)(uint8_t)pin[i] << (24U - 8U * (i % 4U));
+    }
+    PinHash_Copy(state, sha256_iv);
+    PinHash_Compress(state, block);
+}
+
+/* First word of PBKDF2-HMAC-SHA256(pin, salt, count) */
+static uint32_t PinHash_Derive(const char *pin, uint16_t salt, uint16_t count)
+{
+    uint32_t inner[8];
+    uint32_t outer[8];
+    uint32_t state[8];
+    uint32_t block[16] = {0};
+    uint32_t tag;
+
+    PinHash_KeyState(pin, HMAC_IPAD, inner);
+    PinHash_KeyState(pin, HMAC_OPAD, outer);
+
+    /* U1 = HMAC(salt || INT(1)): 6 bytes after the 64-byte key block */
+    block[0] = (uint32_t)salt << 16;
+    block[1] = 0x00018000UL;
+    block[15] = (64U + 6U) * 8U;
+    PinHash_Copy(state, inner);
+    PinHash_Compress(state, block);
+
+    /* From here on every block is a 32-byte digest after the key block */
+    block[1] = 0;
+    block[8] = 0x80000000UL;
+    block[15] = (64U + 32U) * 8U;
+    PinHash_Copy(block, state);
+    PinHash_Copy(state, outer);
+    PinHash_Compress(state, block);
+    tag = state[0];
+
+    while(--count > 0U)
+    {
+        PinHash_Copy(block, state);
+        PinHash_Copy(state, inner);
+        PinHash_Compress(state, block);
+        PinHash_Copy(block, state);
+        PinHash_Copy(state, outer);
+        PinHash_Compress(state, block);
+        tag ^= state[0];
+    }
+    return tag;
+}
+
+/* Compares length bytes without stopping at the first difference */
+static uint8_t PinHash_Equal(const uint8_t *a, const uint8_t *b, uint8_t length)
+{
+    uint8_t diff = 0;
+    uint8_t i;
+
+    for(i = 0; i < length; i++)
+    {
+        diff |= (uint8_t)(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+static uint16_t PinHash_Count(const uint8_t *hash)
+{
+    return (uint16_t)(((uint16_t)hash[0] << 8) | hash[1]);
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+void PinHash_Init(uint32_t clock_hz)
+{
+    uint32_t start;
+    uint32_t per_iteration;
+    uint32_t count;
+
+    GPTM_Timer1A_Init();
+    start = GPTM_Timer1A_Read();
+    salt_state ^= PinHash_Derive("00000", (uint16_t)start, PINHASH_CALIBRATION_ITERATIONS);
+
+    /* The key setup is counted in, so the estimate errs under the budget */
+    per_iteration = (GPTM_Timer1A_Read() - start) / PINHASH_CALIBRATION_ITERATIONS;
+    count = (clock_hz / 1000U) * PINHASH_BUDGET_MS / ((per_iteration > 0U) ? per_iteration : 1U);
+    if(count < PINHASH_MIN_ITERATIONS)
+    {
+        count = PINHASH_MIN_ITERATIONS;
+    }
+    if(count > PINHASH_MAX_ITERATIONS)
+    {
+        count = PINHASH_MAX_ITERATIONS;
+    }
+    iterations = (uint16_t)count;
+}
+
+uint16_t PinHash_Iterations(void)
+{
+    return iterations;
+}
+
+void PinHash_Make(const char *pin, uint8_t *hash)
+{
+    uint32_t tag;
+    uint16_t salt;
+
+    /* Timer and uptime at the request: unknown ahead, never repeated */
+    salt_state = (salt_state * 0x01000193UL) ^ GPTM_Timer1A_Read() ^ (SysTick_GetMs() << 12);
+    salt = (uint16_t)(salt_state ^ (salt_state >> 16));
+
+    tag = PinHash_Derive(pin, salt, iterations);
+    hash[0] = (uint8_t)(iterations >> 8);
+    hash[1] = (uint8_t)(iterations & 0xFF);
+    hash[2] = (uint8_t)(salt >> 8);
+    hash[3] = (uint8_t)(salt & 0xFF);
+    hash[4] = (uint8_t)(tag >> 24);
+    hash[5] = (uint8_t)(tag >> 16);
+    hash[6] = (uint8_t)(tag >> 8);
+    hash[7] = (uint8_t)(tag & 0xFF);
+}
+
+uint8_t PinHash_Check(const char *pin, const uint8_t *hash)
+{
+    uint8_t tag[4];
+    uint32_t value;
+    uint16_t count = PinHash_Count(hash);
+
+    if(PinHash_IsPlain(hash))
+    {
+        return PinHash_Equal((const uint8_t *)pin, hash, PINHASH_PIN_LENGTH);
+    }
+    if(count == 0U || count > PINHASH_MAX_ITERATIONS)
+    {
+        return 0;                   /* unset */
+    }
+
+    value = PinHash_Derive(pin, (uint16_t)(((uint16_t)hash[2] << 8) | hash[3]), count);
+    tag[0] = (uint8_t)(value >> 24);
+    tag[1] = (uint8_t)(value >> 16);
+    tag[2] = (uint8_t)(value >> 8);
+    tag[3] = (uint8_t)(value & 0xFF);
+    return PinHash_Equal(tag, &hash[4], sizeof(tag));
+}
+
+uint8_t PinHash_IsPlain(const uint8_t *hash)
+{
+    uint8_t i;
+
+    for(i = 0; i < PINHASH_PIN_LENGTH; i++)
+    {
+        if(hash[i] < '0' || hash[i] > '9')
+        {
+            return 0;
+        }
+    }
+    for(; i < PINHASH_SIZE; i++)
+    {
+        if(hash[i] != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t PinHash_TimeBlocks(uint32_t count)
+{
+    uint32_t state[8];
+    uint32_t block[16] = {0};
+    uint32_t start;
+
+    PinHash_Copy(state, sha256_iv);
+    start = GPTM_Timer1A_Read();
+    while(count-- > 0U)
+    {
+        PinHash_Compress(state, block);
+        block[0] = state[0];        /* chained, so no pass can be skipped */
+    }
+    return GPTM_Timer1A_Read() - start;
+}
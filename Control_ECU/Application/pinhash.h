@@ -0,0 +1,96 @@
+/******************************************************************************
+ * File: pinhash.h
+ * Module: Control PIN Hash
+ * Description: Salted, iterated hash of the master password
+ *
+ * The password field of the config record (words 0-1) holds no digits,
+ * only a PBKDF2-HMAC-SHA256 tag of them:
+ *
+ *   bytes 0-1  iterations, MSB first (1..PINHASH_MAX_ITERATIONS)
+ *   bytes 2-3  salt, MSB first
+ *   bytes 4-7  first 4 bytes of PBKDF2(PIN, salt, iterations)
+ *
+ * The iteration count is calibrated once at boot (PinHash_Init) so one
+ * check takes at most PINHASH_BUDGET_MS at the running system clock, and
+ * a new hash is made with it; a stored hash keeps the count it was made
+ * with, so changing the clock never locks the password out.
+ *
+ * The plain layout of older firmware (5 ASCII digits, zero padded) is
+ * still recognized: byte 0 of a hash is never a digit, since
+ * PINHASH_MAX_ITERATIONS < 0x3000. PinHash_IsPlain tells it apart so the
+ * caller can store its hash instead.
+ *
+ * Checks compare the whole tag (or all digits), whatever differs first.
+ ******************************************************************************/
+
+#ifndef PINHASH_H_
+#define PINHASH_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define PINHASH_SIZE            8       /* bytes of the password field */
+#define PINHASH_PIN_LENGTH      5
+
+/* Longest a PIN check may take at the calibrated iteration count */
+#ifndef PINHASH_BUDGET_MS
+#define PINHASH_BUDGET_MS       50U
+#endif
+
+#define PINHASH_MIN_ITERATIONS  16U
+#define PINHASH_MAX_ITERATIONS  10000U
+#define PINHASH_CALIBRATION_ITERATIONS 32U
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * PinHash_Init
+ * Times PINHASH_CALIBRATION_ITERATIONS iterations on GPTM Timer1A and sets
+ * the count new hashes use to what fits in PINHASH_BUDGET_MS, within
+ * PINHASH_MIN_ITERATIONS..PINHASH_MAX_ITERATIONS.
+ * Parameters:
+ *   clock_hz - System clock
+ */
+void PinHash_Init(uint32_t clock_hz);
+
+/*
+ * PinHash_Iterations
+ * Returns: the iteration count of new hashes
+ */
+uint16_t PinHash_Iterations(void);
+
+/*
+ * PinHash_Make
+ * Hashes a PIN with a fresh salt at the calibrated iteration count.
+ * Parameters:
+ *   pin  - PINHASH_PIN_LENGTH ASCII digits
+ *   hash - Receives PINHASH_SIZE bytes
+ */
+void PinHash_Make(const char *pin, uint8_t *hash);
+
+/*
+ * PinHash_Check
+ * Returns: 1 if hash (or a plain password field) is that of pin, 0 if not
+ *          or if it is neither (an unset field)
+ */
+uint8_t PinHash_Check(const char *pin, const uint8_t *hash);
+
+/*
+ * PinHash_IsPlain
+ * Returns: 1 if the field holds a plain password of older firmware
+ */
+uint8_t PinHash_IsPlain(const uint8_t *hash);
+
+/*
+ * PinHash_TimeBlocks
+ * Benchmark of the hash core.
+ * Returns: system clock cycles of count SHA-256 block compressions
+ */
+uint32_t PinHash_TimeBlocks(uint32_t count);
+
+#endif /* PINHASH_H_ */
@@ -0,0 +1,414 @@
+/******************************************************************************
+ * File: store.c
+ * Module: Control Config
+ * Description: Wear-leveled, log-structured record store on the EEPROM
+ ******************************************************************************/
+
+#include <string.h>
+#include "store.h"
+#include "protocol.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define STORE_RECORD_SIZE       (STORE_RECORD_WORDS * EEPROM_WORD_SIZE)
+#define STORE_IMAGE_SIZE        (STORE_IMAGE_WORDS * EEPROM_WORD_SIZE)
+#define STORE_SEQ_POS           (STORE_RECORD_SIZE - EEPROM_WORD_SIZE)
+#define STORE_NO_SLOT           0xFF
+#define STORE_EMPTY_SEQ         0xFFFFFFFFUL
+#define STORE_LEGACY_DIGITS     5           /* old layout: password length */
+#define STORE_SUBMIT_DEADLINE_US 500000UL   /* one copy, EEPROM copy cycles included */
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint8_t  live = STORE_NO_SLOT;       /* newest valid copy */
+static uint8_t  head = 0;                   /* where the next copy goes */
+static uint32_t next_seq = 0;
+static uint8_t  mounted = 0;
+static uint8_t  scrub = STORE_SLOTS;        /* next slot to scrub, STORE_SLOTS = done */
+static uint8_t  pending_slot = STORE_NO_SLOT;   /* queued copy, kept until adopted */
+static uint8_t  pending_raw[STORE_RECORD_SIZE];
+static EEPROM_Callback pending_done = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint32_t Store_Block(uint8_t slot)
+{
+    return STORE_FIRST_BLOCK + slot / STORE_SLOTS_PER_BLOCK;
+}
+
+static uint32_t Store_Offset(uint8_t slot)
+{
+    return (uint32_t)(slot % STORE_SLOTS_PER_BLOCK) * STORE_RECORD_WORDS;
+}
+
+static uint8_t Store_Next(uint8_t slot)
+{
+    return (uint8_t)((slot + 1U) % STORE_SLOTS);
+}
+
+/* CRC of a raw copy, the CRC field itself excluded */
+static uint16_t Store_Crc(const uint8_t *raw)
+{
+    return PROTO_Crc16(0xFFFF, &raw[2], STORE_RECORD_SIZE - 2);
+}
+
+static uint32_t Store_Seq(const uint8_t *raw)
+{
+    return (uint32_t)raw[STORE_SEQ_POS] |
+           ((uint32_t)raw[STORE_SEQ_POS + 1] << 8) |
+           ((uint32_t)raw[STORE_SEQ_POS + 2] << 16) |
+           ((uint32_t)raw[STORE_SEQ_POS + 3] << 24);
+}
+
+static void Store_Encode(const uint8_t *image, uint8_t tag, uint32_t seq, uint8_t *raw)
+{
+    uint16_t crc;
+
+    raw[2] = STORE_KIND_IMAGE;
+    raw[3] = tag;
+    memcpy(&raw[4], image, STORE_IMAGE_SIZE);
+    raw[STORE_SEQ_POS]     = (uint8_t)(seq & 0xFF);
+    raw[STORE_SEQ_POS + 1] = (uint8_t)((seq >> 8) & 0xFF);
+    raw[STORE_SEQ_POS + 2] = (uint8_t)((seq >> 16) & 0xFF);
+    raw[STORE_SEQ_POS + 3] = (uint8_t)((seq >> 24) & 0xFF);
+
+    crc = Store_Crc(raw);
+    raw[0] = (uint8_t)(crc >> 8);
+    raw[1] = (uint8_t)(crc & 0xFF);
+}
+
+/* Returns 1 when raw holds a complete, CRC-checked copy */
+static uint8_t Store_IsValid(const uint8_t *raw)
+{
+    uint16_t crc = Store_Crc(raw);
+
+    return Store_Seq(raw) != STORE_EMPTY_SEQ && raw[2] == STORE_KIND_IMAGE &&
+           raw[0] == (uint8_t)(crc >> 8) && raw[1] == (uint8_t)(crc & 0xFF);
+}
+
+static uint8_t Store_IsErased(const uint8_t *data, uint32_t length)
+{
+    uint32_t i;
+
+    for(i = 0; i < length; i++)
+    {
+        if(data[i] != 0xFF)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Store_Claim
+ * Builds the next copy in raw and reserves the slot at the head for it,
+ * stepping over the live copy and a queued one.
+ * Returns: the slot
+ */
+static uint8_t Store_Claim(const uint8_t *image, uint8_t tag, uint8_t *raw)
+{
+    uint8_t slot = head;
+
+    while(slot == live || slot == pending_slot)
+    {
+        slot = Store_Next(slot);
+    }
+    Store_Encode(image, tag, next_seq++, raw);
+
+    head = Store_Next(slot);     /* a failed slot is not retried right away */
+    return slot;
+}
+
+/*
+ * Store_Adopt
+ * Reads a written copy back and, if it is intact, makes it the live one.
+ */
+static uint8_t Store_Adopt(uint8_t slot, const uint8_t *raw)
+{
+    uint8_t check[STORE_RECORD_SIZE];
+
+    if(EEPROM_ReadBuffer(Store_Block(slot), Store_Offset(slot), check, STORE_RECORD_SIZE) != EEPROM_SUCCESS ||
+       memcmp(check, raw, STORE_RECORD_SIZE) != 0)
+    {
+        return EEPROM_ERROR;
+    }
+    live = slot;
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * Store_Append
+ * Writes a copy to a claimed slot and adopts it. Words the slot already
+ * holds are not programmed again; the count of programmed words goes to
+ * written.
+ */
+static uint8_t Store_Append(const uint8_t *image, uint8_t tag, uint32_t *written)
+{
+    uint8_t raw[STORE_RECORD_SIZE];
+    uint8_t slot;
+
+    slot = Store_Claim(image, tag, raw);
+    if(EEPROM_UpdateBuffer(Store_Block(slot), Store_Offset(slot), raw, STORE_RECORD_SIZE, written) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    return Store_Adopt(slot, raw);
+}
+
+/*
+ * Store_Submitted
+ * Completion of the queued copy of Store_Submit.
+ */
+static void Store_Submitted(uint8_t result, uint32_t written)
+{
+    EEPROM_Callback done = pending_done;
+    uint8_t slot = pending_slot;
+
+    pending_slot = STORE_NO_SLOT;
+    pending_done = 0;
+    if(result == EEPROM_SUCCESS)
+    {
+        result = Store_Adopt(slot, pending_raw);
+    }
+    if(done != 0)
+    {
+        done(result, written);
+    }
+}
+
+/*
+ * Store_Scrub
+ * Erases one slot that is neither live nor queued.
+ */
+static uint8_t Store_Scrub(uint8_t slot)
+{
+    uint8_t raw[STORE_RECORD_SIZE];
+    uint8_t result;
+
+    if(slot == live || slot == pending_slot)
+    {
+        return EEPROM_SUCCESS;
+    }
+    result = EEPROM_ReadBuffer(Store_Block(slot), Store_Offset(slot), raw, STORE_RECORD_SIZE);
+    if(result != EEPROM_SUCCESS || Store_IsErased(raw, STORE_RECORD_SIZE))
+    {
+        return result;
+    }
+    memset(raw, 0xFF, STORE_RECORD_SIZE);
+    return EEPROM_UpdateBuffer(Store_Block(slot), Store_Offset(slot), raw, STORE_RECORD_SIZE, 0);
+}
+
+/*
+ * Store_IsLegacy
+ * The old layout kept the password in words 0-1 as STORE_LEGACY_DIGITS
+ * ASCII digits, zero padded. Anything else in the first block (e.g. a
+ * first copy torn by a reset) is not taken for it.
+ */
+static uint8_t Store_IsLegacy(const uint8_t *data)
+{
+    uint8_t i;
+
+    for(i = 0; i < 2 * EEPROM_WORD_SIZE; i++)
+    {
+        if((i < STORE_LEGACY_DIGITS) ? (data[i] < '0' || data[i] > '9') : (data[i] != 0))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Store_Migrate
+ * Writes an image read from the old fixed layout as the first copy, past
+ * the first block so that one stays intact meanwhile. The tag marks the
+ * words that were not erased.
+ */
+static uint8_t Store_Migrate(const uint8_t *image, uint8_t *tag)
+{
+    uint32_t written = 0;
+    uint8_t word;
+
+    *tag = 0;
+    for(word = 0; word < STORE_IMAGE_WORDS; word++)
+    {
+        if(!Store_IsErased(&image[word * EEPROM_WORD_SIZE], EEPROM_WORD_SIZE))
+        {
+            *tag |= (uint8_t)(1U << word);
+        }
+    }
+    head = STORE_SLOTS_PER_BLOCK;
+    return Store_Append(image, *tag, &written);
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Store_Mount(uint8_t *image, uint8_t *tag)
+{
+    uint8_t raw[EEPROM_BLOCK_SIZE * EEPROM_WORD_SIZE];
+    uint8_t newest[STORE_RECORD_SIZE];
+    const uint8_t *copy;
+    uint8_t result;
+    uint8_t slot;
+
+    mounted = 0;
+    live = STORE_NO_SLOT;
+    head = 0;
+    next_seq = 0;
+    scrub = STORE_SLOTS;
+    memset(image, 0xFF, STORE_IMAGE_SIZE);
+    *tag = 0;
+
+    /* One pass, one burst per block: keep the newest valid copy */
+    for(slot = 0; slot < STORE_SLOTS; slot++)
+    {
+        if((slot % STORE_SLOTS_PER_BLOCK) == 0)
+        {
+            result = EEPROM_ReadBuffer(Store_Block(slot), 0, raw, sizeof(raw));
+            if(result != EEPROM_SUCCESS)
+            {
+                return result;
+            }
+        }
+        copy = &raw[Store_Offset(slot) * EEPROM_WORD_SIZE];
+        if(Store_IsValid(copy) && (live == STORE_NO_SLOT || Store_Seq(copy) >= next_seq))
+        {
+            live = slot;
+            next_seq = Store_Seq(copy) + 1U;
+            memcpy(newest, copy, STORE_RECORD_SIZE);
+        }
+    }
+
+    if(live != STORE_NO_SLOT)
+    {
+        memcpy(image, &newest[4], STORE_IMAGE_SIZE);
+        *tag = newest[3];
+        head = Store_Next(live);
+        if(*tag == 0)
+        {
+            scrub = 0;          /* erased: make sure nothing older is left */
+        }
+    }
+    else
+    {
+        result = EEPROM_ReadBuffer(STORE_FIRST_BLOCK, 0, raw, STORE_IMAGE_SIZE);
+        if(result != EEPROM_SUCCESS)
+        {
+            return result;
+        }
+        if(Store_IsLegacy(raw))
+        {
+            memcpy(image, raw, STORE_IMAGE_SIZE);
+            result = Store_Migrate(image, tag);
+            if(result != EEPROM_SUCCESS)
+            {
+                return result;
+            }
+        }
+    }
+
+    mounted = 1;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Store_Write(const uint8_t *image, uint8_t tag, uint32_t *written)
+{
+    *written = 0;
+    if(!mounted || pending_slot != STORE_NO_SLOT || image == 0)
+    {
+        return EEPROM_ERROR;
+    }
+    return Store_Append(image, tag, written);
+}
+
+uint8_t Store_Submit(const uint8_t *image, uint8_t tag, EEPROM_Callback done)
+{
+    uint8_t slot;
+
+    if(!mounted || pending_slot != STORE_NO_SLOT || image == 0)
+    {
+        return EEPROM_ERROR;
+    }
+
+    slot = Store_Claim(image, tag, pending_raw);
+    if(EEPROM_Submit(Store_Block(slot), Store_Offset(slot), pending_raw, STORE_RECORD_SIZE,
+                     STORE_SUBMIT_DEADLINE_US, Store_Submitted) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    pending_slot = slot;
+    pending_done = done;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Store_Erase(void)
+{
+    uint8_t blank[STORE_IMAGE_SIZE];
+    uint32_t written = 0;
+
+    if(pending_slot != STORE_NO_SLOT)
+    {
+        return EEPROM_ERROR;
+    }
+    if(!mounted)
+    {
+        return Store_Format();
+    }
+
+    /* The blank copy supersedes every older one; the rest is left to Store_Task */
+    memset(blank, 0xFF, sizeof(blank));
+    if(Store_Append(blank, 0, &written) != EEPROM_SUCCESS)
+    {
+        return Store_Format();
+    }
+    scrub = 0;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Store_Format(void)
+{
+    uint32_t block;
+    uint8_t result = EEPROM_SUCCESS;
+
+    for(block = 0; block < EEPROM_TOTAL_BLOCKS && result == EEPROM_SUCCESS; block++)
+    {
+        result = EEPROM_EraseBlock(block);
+    }
+    live = STORE_NO_SLOT;
+    head = 0;
+    next_seq = 0;
+    scrub = STORE_SLOTS;
+    mounted = (result == EEPROM_SUCCESS);
+    return result;
+}
+
+void Store_Forget(void)
+{
+    if(mounted)
+    {
+        scrub = 0;
+    }
+}
+
+void Store_Task(void)
+{
+    EEPROM_Task();
+    if(!mounted || pending_slot != STORE_NO_SLOT)
+    {
+        return;
+    }
+    if(scrub < STORE_SLOTS)
+    {
+        Store_Scrub(scrub);
+        scrub++;
+    }
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * File: store.h
+ * Module: Control Config
+ * Description: Wear-leveled, log-structured record store on the EEPROM
+ *
+ * The configuration is one record image of STORE_IMAGE_WORDS words. Every
+ * update writes the whole image again, as a new copy, to the next free
+ * slot of the journal: the store blocks are cut into STORE_SLOTS fixed
+ * slots and the copies go round-robin, so the writes are spread over the
+ * whole array instead of one block, and the previous copy stays intact
+ * until the new one is complete.
+ *
+ * Copy (STORE_RECORD_WORDS words, written in this order):
+ *
+ *   word 0   CRC16 (bytes 0-1, high first) | STORE_KIND_IMAGE | tag
+ *   word 1-6 image
+ *   word 7   sequence number, 0xFFFFFFFF = slot never written
+ *
+ * The CRC (PROTO_Crc16) covers every byte after it, the sequence number
+ * included. The sequence word goes last, so a copy torn by a reset fails
+ * its CRC and is ignored. Store_Mount reads every slot once and keeps the
+ * valid copy with the highest sequence number: no field is ever guessed
+ * from its contents, and the newest copy is the only live slot.
+ *
+ * The tag is a byte the caller stores along with the image (config.c
+ * keeps a mask of the words ever written in it).
+ *
+ * Store_Erase writes a blank copy (all 0xFF, tag 0); the older copies are
+ * then overwritten with 0xFF by Store_Task, one slot per call, so no old
+ * password stays readable in the array. Store_Format is the full (slow)
+ * erase: EEPROM_EraseBlock on every block.
+ *
+ * A device still holding the old fixed layout (password and timeout
+ * written straight into block 0) has no valid copy; its block 0 is taken
+ * as the image and written as the first copy into block 1 at mount, if
+ * it starts with a password (digits, zero padded) as that layout did.
+ ******************************************************************************/
+
+#ifndef STORE_H_
+#define STORE_H_
+
+#include <stdint.h>
+#include "eeprom.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define STORE_FIRST_BLOCK       0
+#define STORE_BLOCKS            4                       /* then the user table (users.h) */
+#define STORE_IMAGE_WORDS       6                       /* 24-byte image */
+#define STORE_RECORD_WORDS      (STORE_IMAGE_WORDS + 2)
+#define STORE_SLOTS_PER_BLOCK   (EEPROM_BLOCK_SIZE / STORE_RECORD_WORDS)
+#define STORE_SLOTS             (STORE_BLOCKS * STORE_SLOTS_PER_BLOCK)
+#define STORE_KIND_IMAGE        0xC5                    /* word 0, byte 2 */
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Store_Mount
+ * Scans the journal and loads the newest valid copy into image (all 0xFF,
+ * tag 0 if there is none).
+ * Parameters:
+ *   image - STORE_IMAGE_WORDS * EEPROM_WORD_SIZE bytes
+ *   tag   - Receives the tag of the copy
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Store_Mount(uint8_t *image, uint8_t *tag);
+
+/*
+ * Store_Write
+ * Writes a new copy of the image and verifies it by reading it back.
+ * Parameters:
+ *   image   - STORE_IMAGE_WORDS * EEPROM_WORD_SIZE bytes
+ *   tag     - Stored with the image
+ *   written - Receives the number of EEPROM words programmed
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR if the write or verify failed
+ *          (the previous copy is then still the newest valid one) or a
+ *          Store_Submit is in flight
+ */
+uint8_t Store_Write(const uint8_t *image, uint8_t tag, uint32_t *written);
+
+/*
+ * Store_Submit
+ * Same as Store_Write through the EEPROM write queue: returns at once and
+ * the copy is read back when the queue reports it. One submit at a time;
+ * the background work of Store_Task waits for it.
+ * Parameters:
+ *   image - Copied
+ *   tag   - Stored with the image
+ *   done  - Called from Store_Task with the result and the number of
+ *           words programmed
+ * Returns: EEPROM_SUCCESS if queued, EEPROM_ERROR if not (done is then
+ *          never called)
+ */
+uint8_t Store_Submit(const uint8_t *image, uint8_t tag, EEPROM_Callback done);
+
+/*
+ * Store_Erase
+ * Logical erase: writes a blank copy and leaves the scrubbing of the
+ * older ones to Store_Task. Falls back to Store_Format if the write fails
+ * or nothing is mounted.
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR/EEPROM_TIMEOUT on failure,
+ *          EEPROM_ERROR while a Store_Submit is in flight
+ */
+uint8_t Store_Erase(void);
+
+/*
+ * Store_Format
+ * Erases every EEPROM block (EEPROM_EraseBlock) and empties the journal.
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t Store_Format(void);
+
+/*
+ * Store_Forget
+ * Leaves the live copy the only one: Store_Task scrubs the older copies
+ * as after an erase, when they hold data that must not stay readable.
+ */
+void Store_Forget(void);
+
+/*
+ * Store_Task
+ * Background work, call from the main loop. Runs EEPROM_Task, then,
+ * unless a Store_Submit is still in flight, scrubs one slot while an
+ * erase (or a Store_Forget) is pending.
+ */
+void Store_Task(void);
+
+#endif /* STORE_H_ */
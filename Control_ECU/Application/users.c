@@ -0,0 +1,390 @@
+/******************************************************************************
+ * File: users.c
+ * Module: Control Users
+ * Description: PIN table of the enrolled users
+ ******************************************************************************/
+
+#include "users.h"
+#include "systick.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define USERS_FREE              0xFFFFFFFFUL
+#define USERS_REVOKED           0x00000000UL
+#define USERS_ID_SHIFT          15
+#define USERS_QUOTIENT_SHIFT    6
+#define USERS_QUOTIENT_MASK     0x1FFUL
+#define USERS_DISTANCE_MAX      0x3FUL
+#define USERS_NOWHERE           0xFFFF                  /* where[] of an id not enrolled */
+
+#define USERS_PINS              100000UL                /* 10^USERS_PIN_LENGTH */
+#define USERS_QUOTIENT_MAX      ((USERS_PINS - 1U) / USERS_SLOTS)
+#define USERS_HALF_BITS         9                       /* Feistel halves, 2^18 >= USERS_PINS */
+#define USERS_HALF_MASK         ((1UL << USERS_HALF_BITS) - 1U)
+#define USERS_ROUNDS            4
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint32_t salt = USERS_FREE;
+static uint32_t slots[USERS_SLOTS];                 /* RAM copy, bad words as USERS_REVOKED */
+static uint16_t where[USERS_ID_MAX + 1];            /* slot of each id */
+static uint16_t count = 0;
+static uint8_t  loaded = 0;
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+/* MurmurHash3 finalizer: every input bit flips half of the output bits */
+static uint32_t Users_Mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6BUL;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35UL;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Round function of Users_Code, keyed by the salt */
+static uint32_t Users_Round(uint8_t round, uint32_t half)
+{
+    return Users_Mix(salt ^ ((uint32_t)round << 24) ^ half) & USERS_HALF_MASK;
+}
+
+/*
+ * Users_Code
+ * The PIN as a number, put through a Feistel permutation of 18 bits keyed
+ * by the salt until it lands below USERS_PINS again (cycle walking). So
+ * the code is a permutation of the PINs: two PINs never share one.
+ */
+static uint32_t Users_Code(const char *pin)
+{
+    uint32_t code = 0;
+    uint32_t left;
+    uint32_t right;
+    uint32_t next;
+    uint8_t i;
+
+    for(i = 0; i < USERS_PIN_LENGTH; i++)
+    {
+        code = code * 10U + (uint32_t)(pin[i] - '0');
+    }
+    do
+    {
+        left = code >> USERS_HALF_BITS;
+        right = code & USERS_HALF_MASK;
+        for(i = 0; i < USERS_ROUNDS; i++)
+        {
+            next = left ^ Users_Round(i, right);
+            left = right;
+            right = next;
+        }
+        code = (left << USERS_HALF_BITS) | right;
+    } while(code >= USERS_PINS);
+    return code;
+}
+
+static uint8_t Users_IsPin(const char *pin)
+{
+    uint8_t i;
+
+    if(pin == 0)
+    {
+        return 0;
+    }
+    for(i = 0; i < USERS_PIN_LENGTH; i++)
+    {
+        if(pin[i] < '0' || pin[i] > '9')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint8_t Users_Check(uint32_t body)
+{
+    uint8_t bytes[3];
+
+    bytes[0] = (uint8_t)(body >> 16);
+    bytes[1] = (uint8_t)(body >> 8);
+    bytes[2] = (uint8_t)(body & 0xFF);
+    return (uint8_t)(PROTO_Crc16(0xFFFF, bytes, sizeof(bytes)) & 0xFF);
+}
+
+/* An entry: the code is its home slot (where it sits, less the distance)
+ * and the quotient together */
+static uint32_t Users_Encode(uint16_t id, uint32_t code, uint32_t distance)
+{
+    uint32_t body = ((uint32_t)id << USERS_ID_SHIFT) |
+                    ((code / USERS_SLOTS) << USERS_QUOTIENT_SHIFT) | distance;
+
+    return ((uint32_t)Users_Check(body) << 24) | body;
+}
+
+/* The word as the RAM copy holds it: free, revoked or a valid entry */
+static uint32_t Users_Decode(uint32_t word)
+{
+    uint32_t body = word & 0x00FFFFFFUL;
+    uint32_t id = body >> USERS_ID_SHIFT;
+
+    if(word == USERS_FREE)
+    {
+        return USERS_FREE;
+    }
+    if((uint8_t)(word >> 24) != Users_Check(body) || id == 0 || id > USERS_ID_MAX ||
+       ((body >> USERS_QUOTIENT_SHIFT) & USERS_QUOTIENT_MASK) > USERS_QUOTIENT_MAX)
+    {
+        return USERS_REVOKED;
+    }
+    return word;
+}
+
+static uint16_t Users_Id(uint32_t entry)
+{
+    return (uint16_t)((entry & 0x00FFFFFFUL) >> USERS_ID_SHIFT);
+}
+
+/* Quotient and distance: what of an entry must match a code */
+static uint32_t Users_Place(uint32_t entry)
+{
+    return entry & ((USERS_QUOTIENT_MASK << USERS_QUOTIENT_SHIFT) | USERS_DISTANCE_MAX);
+}
+
+/* Slot index to EEPROM address; word 0 of the table is the salt */
+static uint8_t Users_Program(uint32_t slot, uint32_t word)
+{
+    uint32_t index = slot + 1U;
+
+    return EEPROM_WriteWord(USERS_FIRST_BLOCK + index / EEPROM_BLOCK_SIZE,
+                            index % EEPROM_BLOCK_SIZE, word);
+}
+
+/* Files an entry (or its absence) in the RAM copy */
+static void Users_Set(uint32_t slot, uint32_t entry)
+{
+    uint32_t old = slots[slot];
+
+    if(old != USERS_FREE && old != USERS_REVOKED)
+    {
+        where[Users_Id(old)] = USERS_NOWHERE;
+        count--;
+    }
+    if(entry != USERS_FREE && entry != USERS_REVOKED)
+    {
+        if(where[Users_Id(entry)] != USERS_NOWHERE)
+        {
+            entry = USERS_REVOKED;          /* a second entry for an id: never matches */
+        }
+        else
+        {
+            where[Users_Id(entry)] = (uint16_t)slot;
+            count++;
+        }
+    }
+    slots[slot] = entry;
+}
+
+/* After a failed program the word may or may not hold the new value */
+static void Users_Reload(uint32_t slot)
+{
+    uint32_t index = slot + 1U;
+    uint32_t word;
+
+    if(EEPROM_ReadWord(USERS_FIRST_BLOCK + index / EEPROM_BLOCK_SIZE,
+                       index % EEPROM_BLOCK_SIZE, &word) != EEPROM_SUCCESS)
+    {
+        word = USERS_REVOKED;
+    }
+    Users_Set(slot, Users_Decode(word));
+}
+
+/*
+ * Users_Probe
+ * Searches from the home slot of a code up to the first free slot, and no
+ * further than USERS_DISTANCE_MAX slots on, the farthest an entry can sit.
+ * Returns: the slot holding the code, USERS_SLOTS if none; vacant
+ *          receives the first free or revoked slot on the way
+ */
+static uint32_t Users_Probe(uint32_t code, uint32_t *vacant)
+{
+    uint32_t slot = code % USERS_SLOTS;
+    uint32_t quotient = code / USERS_SLOTS;
+    uint32_t entry;
+    uint32_t n;
+
+    *vacant = USERS_SLOTS;
+    for(n = 0; n <= USERS_DISTANCE_MAX; n++)
+    {
+        entry = slots[slot];
+        if(entry == USERS_FREE || entry == USERS_REVOKED)
+        {
+            if(*vacant == USERS_SLOTS)
+            {
+                *vacant = slot;
+            }
+            if(entry == USERS_FREE)
+            {
+                break;
+            }
+        }
+        else if(Users_Place(entry) == ((quotient << USERS_QUOTIENT_SHIFT) | n))
+        {
+            return slot;
+        }
+        slot = (slot + 1U == USERS_SLOTS) ? 0 : slot + 1U;
+    }
+    return USERS_SLOTS;
+}
+
+/* A salt that is never the erased word, different from the last one */
+static uint8_t Users_NewSalt(void)
+{
+    uint32_t next = Users_Mix(salt ^ SysTick_GetMs() ^ 0x9E3779B9UL);
+    uint8_t result;
+
+    if(next == USERS_FREE)
+    {
+        next = ~next;
+    }
+    result = EEPROM_WriteWord(USERS_FIRST_BLOCK, 0, next);
+    if(result == EEPROM_SUCCESS)
+    {
+        salt = next;
+    }
+    return result;
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Users_Init(void)
+{
+    uint32_t slot;
+    uint32_t word;
+    uint32_t id;
+    uint8_t result;
+
+    loaded = 0;
+    result = EEPROM_ReadWord(USERS_FIRST_BLOCK, 0, &salt);
+    if(result == EEPROM_SUCCESS)
+    {
+        result = EEPROM_ReadBurst(USERS_FIRST_BLOCK, 1, slots, USERS_SLOTS);
+    }
+    if(result != EEPROM_SUCCESS)
+    {
+        return result;
+    }
+
+    for(id = 0; id <= USERS_ID_MAX; id++)
+    {
+        where[id] = USERS_NOWHERE;
+    }
+    count = 0;
+    for(slot = 0; slot < USERS_SLOTS; slot++)
+    {
+        word = slots[slot];
+        slots[slot] = USERS_FREE;
+        Users_Set(slot, Users_Decode(word));
+    }
+    loaded = 1;
+    return EEPROM_SUCCESS;
+}
+
+uint16_t Users_Find(const char *pin)
+{
+    uint32_t vacant;
+    uint32_t slot;
+
+    if(!loaded || count == 0 || !Users_IsPin(pin))
+    {
+        return USERS_NONE;
+    }
+    slot = Users_Probe(Users_Code(pin), &vacant);
+    return (slot < USERS_SLOTS) ? Users_Id(slots[slot]) : USERS_NONE;
+}
+
+uint8_t Users_Add(uint16_t id, const char *pin)
+{
+    uint32_t code;
+    uint32_t vacant;
+    uint32_t entry;
+
+    if(!loaded || id == 0 || id > USERS_ID_MAX || where[id] != USERS_NOWHERE ||
+       count >= USERS_MAX || !Users_IsPin(pin))
+    {
+        return EEPROM_ERROR;
+    }
+    if(salt == USERS_FREE && Users_NewSalt() != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+
+    code = Users_Code(pin);
+    if(Users_Probe(code, &vacant) < USERS_SLOTS || vacant == USERS_SLOTS)
+    {
+        return EEPROM_ERROR;            /* PIN taken, or no slot in reach */
+    }
+
+    entry = Users_Encode(id, code, (vacant + USERS_SLOTS - code % USERS_SLOTS) % USERS_SLOTS);
+    if(Users_Program(vacant, entry) != EEPROM_SUCCESS)
+    {
+        Users_Reload(vacant);
+        return EEPROM_ERROR;
+    }
+    Users_Set(vacant, entry);
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Users_Revoke(uint16_t id)
+{
+    uint32_t slot;
+
+    if(!loaded || id > USERS_ID_MAX || where[id] == USERS_NOWHERE)
+    {
+        return EEPROM_ERROR;
+    }
+    slot = where[id];
+    if(Users_Program(slot, USERS_REVOKED) != EEPROM_SUCCESS)
+    {
+        Users_Reload(slot);
+        return EEPROM_ERROR;
+    }
+    Users_Set(slot, USERS_REVOKED);
+    return EEPROM_SUCCESS;
+}
+
+uint8_t Users_Clear(void)
+{
+    uint32_t slot;
+    uint8_t result;
+
+    if(!loaded)
+    {
+        return EEPROM_ERROR;
+    }
+    result = Users_NewSalt();
+    for(slot = 0; slot < USERS_SLOTS && result == EEPROM_SUCCESS; slot++)
+    {
+        if(slots[slot] != USERS_FREE)
+        {
+            result = Users_Program(slot, USERS_FREE);
+            if(result == EEPROM_SUCCESS)
+            {
+                Users_Set(slot, USERS_FREE);
+            }
+        }
+    }
+    return result;
+}
+
+uint16_t Users_Count(void)
+{
+    return count;
+}
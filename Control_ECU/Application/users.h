@@ -0,0 +1,106 @@
+/******************************************************************************
+ * File: users.h
+ * Module: Control Users
+ * Description: PIN table of the enrolled users
+ *
+ * Besides the master password of the config record, up to USERS_MAX users
+ * have a PIN of their own. The table takes the USERS_BLOCKS blocks between
+ * the store (store.h) and the access log (audit.h): word 0 is the salt,
+ * then one word per slot:
+ *
+ *   bits 31-24  check byte, low byte of PROTO_Crc16 over bits 23-0
+ *   bits 23-15  user id (1..USERS_ID_MAX)
+ *   bits 14-6   quotient, the PIN's code / USERS_SLOTS
+ *   bits 5-0    distance of the slot from the code's home slot
+ *
+ * The code of a PIN is a permutation of the 10^5 PINs keyed by the salt
+ * (Users_Code in users.c), so no two PINs share one. Its home slot is the
+ * code modulo USERS_SLOTS, and home slot and quotient give the code back:
+ * a PIN matches an entry only if it is that entry's PIN. 0xFFFFFFFF is a
+ * free slot and 0 a revoked one. The table is open addressed: a PIN is
+ * looked for from its home slot on, one slot at a time, up to the first
+ * free slot and at most 63 slots on. A revoked slot keeps the search going
+ * and is taken by the next add, so adding or revoking a user programs
+ * exactly one word. A word that fails its check (torn by a reset while it
+ * was written) counts as revoked.
+ *
+ * Users_Init copies the table to RAM along with the slot of every id;
+ * lookups never touch the EEPROM, and the load is capped at USERS_MAX so
+ * the search from the home slot stays short however many users there are.
+ ******************************************************************************/
+
+#ifndef USERS_H_
+#define USERS_H_
+
+#include <stdint.h>
+#include "store.h"
+#include "protocol.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define USERS_FIRST_BLOCK       (STORE_FIRST_BLOCK + STORE_BLOCKS)
+#define USERS_BLOCKS            18
+#define USERS_SLOTS             (USERS_BLOCKS * EEPROM_BLOCK_SIZE - 1)   /* after the salt */
+#define USERS_MAX               224                     /* at most ~78% full */
+#define USERS_ID_MAX            PROTO_USER_MAX
+#define USERS_PIN_LENGTH        5
+#define USERS_NONE              0xFFFF
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Users_Init
+ * Loads the table into RAM. Call once the EEPROM is initialized.
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Users_Init(void);
+
+/*
+ * Users_Find
+ * Looks a PIN up in the RAM copy of the table.
+ * Parameters:
+ *   pin - USERS_PIN_LENGTH ASCII digits
+ * Returns: the id of the user with this PIN, USERS_NONE if there is none
+ */
+uint16_t Users_Find(const char *pin);
+
+/*
+ * Users_Add
+ * Enrolls a user: programs the first free or revoked slot from the home
+ * slot of the PIN, which must be within 63 slots of it. The salt is made
+ * at the first add.
+ * Parameters:
+ *   id  - 1..USERS_ID_MAX, not enrolled yet
+ *   pin - USERS_PIN_LENGTH ASCII digits, not another user's PIN
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR on bad arguments, a taken id or
+ *          PIN, no slot in reach or a failed write
+ */
+uint8_t Users_Add(uint16_t id, const char *pin);
+
+/*
+ * Users_Revoke
+ * Marks the slot of a user revoked.
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR if the id is not enrolled or the
+ *          write failed
+ */
+uint8_t Users_Revoke(uint16_t id);
+
+/*
+ * Users_Clear
+ * Revokes every user: writes a new salt, so no old entry matches even if
+ * a reset cuts this short, then frees every slot in use.
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Users_Clear(void);
+
+/*
+ * Users_Count
+ * Returns: number of enrolled users
+ */
+uint16_t Users_Count(void);
+
+#endif /* USERS_H_ */
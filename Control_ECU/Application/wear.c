@@ -0,0 +1,211 @@
+/******************************************************************************
+ * File: wear.c
+ * Module: Control Config
+ * Description: Persistent per-block write counts of the EEPROM
+ ******************************************************************************/
+
+#include "wear.h"
+#include "protocol.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define WEAR_ERASED             0xFFFFFFFFUL
+#define WEAR_CHUNKS             (2 * EEPROM_TOTAL_BLOCKS / EEPROM_QUEUE_WORDS)  /* requests per write */
+#define WEAR_SUBMIT_DEADLINE_US 500000UL            /* one request, EEPROM copy cycles included */
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static uint32_t stored[EEPROM_TOTAL_BLOCKS];    /* count in the table */
+static uint32_t mark[EEPROM_TOTAL_BLOCKS];      /* EEPROM_BlockWrites when stored */
+static uint8_t  loaded = 0;
+static uint8_t  chunk = WEAR_CHUNKS;            /* next request of the write, WEAR_CHUNKS: none */
+static uint8_t  writing = 0;                    /* a request in the queue */
+static uint8_t  again = 0;                      /* Wear_Flush while writing */
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint8_t Wear_Check(uint32_t count)
+{
+    uint8_t bytes[3];
+
+    bytes[0] = (uint8_t)(count >> 16);
+    bytes[1] = (uint8_t)(count >> 8);
+    bytes[2] = (uint8_t)(count & 0xFF);
+    return (uint8_t)(PROTO_Crc16(0xFFFF, bytes, sizeof(bytes)) & 0xFF);
+}
+
+static uint32_t Wear_Decode(uint32_t word)
+{
+    uint32_t count = word >> 8;
+
+    if(word == WEAR_ERASED || (uint8_t)(word & 0xFF) != Wear_Check(count))
+    {
+        return 0;
+    }
+    return count;
+}
+
+static uint32_t Wear_Encode(uint32_t count)
+{
+    return (count << 8) | Wear_Check(count);
+}
+
+/* Words programmed in a block since the table was loaded or written */
+static uint32_t Wear_Unsaved(uint32_t block)
+{
+    return EEPROM_BlockWrites(block) - mark[block];
+}
+
+/* Takes the counts of now as those to write, and starts the write over */
+static void Wear_Snapshot(void)
+{
+    uint32_t block;
+
+    /* The table's own programs are counted in a later write, once there
+     * are WEAR_FLUSH_WORDS of them: updating its own entries every time
+     * would make each write program more words than it needs */
+    for(block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        if(block < WEAR_FIRST_BLOCK || Wear_Unsaved(block) >= WEAR_FLUSH_WORDS)
+        {
+            stored[block] = Wear_Block(block);
+            mark[block] = EEPROM_BlockWrites(block);
+        }
+    }
+    chunk = 0;
+    again = 0;
+}
+
+/* Completion of one request of the write */
+static void Wear_Written(uint8_t result, uint32_t written)
+{
+    (void)written;
+
+    writing = 0;
+    chunk = (result == EEPROM_SUCCESS) ? (uint8_t)(chunk + 1U) : WEAR_CHUNKS;
+}
+
+/* Queues the next request: copy A, then copy B, EEPROM_QUEUE_WORDS
+ * counts at a time */
+static void Wear_Next(void)
+{
+    uint8_t raw[EEPROM_QUEUE_WORDS * EEPROM_WORD_SIZE];
+    uint32_t first;
+    uint32_t word;
+    uint32_t i;
+
+    if(writing)
+    {
+        return;
+    }
+    if(again)
+    {
+        Wear_Snapshot();
+    }
+    if(chunk >= WEAR_CHUNKS)
+    {
+        return;
+    }
+
+    first = (chunk * EEPROM_QUEUE_WORDS) % EEPROM_TOTAL_BLOCKS;
+    for(i = 0; i < EEPROM_QUEUE_WORDS; i++)
+    {
+        word = Wear_Encode(stored[first + i]);
+        raw[i * 4]     = (uint8_t)(word & 0xFF);
+        raw[i * 4 + 1] = (uint8_t)((word >> 8) & 0xFF);
+        raw[i * 4 + 2] = (uint8_t)((word >> 16) & 0xFF);
+        raw[i * 4 + 3] = (uint8_t)((word >> 24) & 0xFF);
+    }
+    if(EEPROM_Submit(WEAR_FIRST_BLOCK + (chunk * EEPROM_QUEUE_WORDS) / EEPROM_BLOCK_SIZE,
+                     (chunk * EEPROM_QUEUE_WORDS) % EEPROM_BLOCK_SIZE, raw, sizeof(raw),
+                     WEAR_SUBMIT_DEADLINE_US, Wear_Written) == EEPROM_SUCCESS)
+    {
+        writing = 1;
+    }
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Wear_Init(void)
+{
+    uint32_t words[2 * EEPROM_TOTAL_BLOCKS];
+    uint32_t block;
+    uint32_t a;
+    uint32_t b;
+    uint8_t result;
+
+    result = EEPROM_ReadBurst(WEAR_FIRST_BLOCK, 0, words, 2 * EEPROM_TOTAL_BLOCKS);
+    if(result != EEPROM_SUCCESS)
+    {
+        return result;
+    }
+    for(block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        a = Wear_Decode(words[block]);
+        b = Wear_Decode(words[EEPROM_TOTAL_BLOCKS + block]);
+        stored[block] = (a > b) ? a : b;
+        mark[block] = EEPROM_BlockWrites(block);
+    }
+    chunk = WEAR_CHUNKS;
+    writing = 0;
+    again = 0;
+    loaded = 1;
+    return EEPROM_SUCCESS;
+}
+
+uint32_t Wear_Block(uint32_t block)
+{
+    uint32_t count;
+
+    if(block >= EEPROM_TOTAL_BLOCKS)
+    {
+        return 0;
+    }
+    count = stored[block] + Wear_Unsaved(block);
+    return (count > WEAR_MAX || count < stored[block]) ? WEAR_MAX : count;
+}
+
+uint8_t Wear_Flush(void)
+{
+    if(!loaded)
+    {
+        return EEPROM_ERROR;
+    }
+    again = 1;
+    Wear_Next();
+    return EEPROM_SUCCESS;
+}
+
+void Wear_Task(void)
+{
+    uint32_t unsaved = 0;
+    uint32_t block;
+
+    if(!loaded)
+    {
+        return;
+    }
+    if(chunk < WEAR_CHUNKS || again)
+    {
+        Wear_Next();
+        return;
+    }
+    /* Not the table's own blocks: every write of it would count toward
+     * the next one */
+    for(block = 0; block < WEAR_FIRST_BLOCK && unsaved < WEAR_FLUSH_WORDS; block++)
+    {
+        unsaved += Wear_Unsaved(block);
+    }
+    if(unsaved >= WEAR_FLUSH_WORDS)
+    {
+        Wear_Flush();
+    }
+}
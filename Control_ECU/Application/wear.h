@@ -0,0 +1,79 @@
+/******************************************************************************
+ * File: wear.h
+ * Module: Control Config
+ * Description: Persistent per-block write counts of the EEPROM
+ *
+ * EEPROM_BlockWrites counts the words programmed in each block since
+ * reset; this module adds them up across resets in a table kept in the
+ * last WEAR_BLOCKS blocks, past the access log (audit.h). The table is
+ * kept twice, copy A then copy B, each one word per block:
+ *
+ *   bits 31-8  words programmed in the block (saturates at WEAR_MAX)
+ *   bits 7-0   check byte, low byte of PROTO_Crc16 over bits 31-8
+ *
+ * Both copies are written with the same counts, one after the other, so
+ * a reset tears at most one of the two words of a block. Counts only
+ * grow, and Wear_Init keeps the larger of the two: an erased word or one
+ * that fails its check (torn) counts as 0, and the other copy holds the
+ * count of this write or of the last one.
+ *
+ * The table is written back once WEAR_FLUSH_WORDS words have been
+ * programmed outside it since the last write, and right after a mass
+ * erase, so at most twice that many programs are lost to a reset. The
+ * write is queued (EEPROM_Submit), one block of the table at a time, and
+ * moved on by Wear_Task. The table's own programs are counted too, but
+ * only carried along by the next write; they never trigger one.
+ ******************************************************************************/
+
+#ifndef WEAR_H_
+#define WEAR_H_
+
+#include <stdint.h>
+#include "audit.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define WEAR_FIRST_BLOCK        (AUDIT_FIRST_BLOCK + AUDIT_BLOCKS)
+#define WEAR_BLOCKS             (EEPROM_TOTAL_BLOCKS - WEAR_FIRST_BLOCK)   /* both copies */
+#define WEAR_FLUSH_WORDS        64
+#define WEAR_MAX                0x00FFFFFEUL
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Wear_Init
+ * Loads the table. Call once the EEPROM is initialized.
+ * Returns: EEPROM_SUCCESS, or the EEPROM driver error
+ */
+uint8_t Wear_Init(void);
+
+/*
+ * Wear_Block
+ * Returns: the words programmed in a block over the life of the device
+ *          (as far as the table knows), 0 for a block out of range
+ */
+uint32_t Wear_Block(uint32_t block);
+
+/*
+ * Wear_Flush
+ * Starts writing the table back (only the words that changed are
+ * programmed); Wear_Task queues the rest. A write already under way is
+ * finished and then started again with the counts of now.
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR if not loaded
+ */
+uint8_t Wear_Flush(void);
+
+/*
+ * Wear_Task
+ * Queues the next block of a write under way, or starts one once
+ * WEAR_FLUSH_WORDS words have been programmed outside the table since
+ * the last. A block whose write failed is left to the next write. Call
+ * from the main loop.
+ */
+void Wear_Task(void);
+
+#endif /* WEAR_H_ */
@@ -2,11 +2,16 @@
 
 #include "tm4c123gh6pm.h"
 #include "systick.h"
+#include "Buzzer.h"
 
 /* Buzzer pin: PA7 */
 #define BUZZER_PORT 0
 #define BUZZER_PIN  7
 
+static uint8_t  beepActive = 0;
+static uint32_t beepStartMs = 0;
+static uint32_t beepDurationMs = 0;
+
 void Buzzer_Init(void)
 {
     volatile uint32_t delay;
@@ -54,9 +59,35 @@ void Buzzer_Toggle(void)
 }
 
 
-void Buzzer_Beep(uint16_t duration_ms)
+void Buzzer_Beep(uint32_t duration_ms)
 {
     Buzzer_On();
     DelayMs(duration_ms);
     Buzzer_Off();
 }
+
+
+/* Non-blocking beep timed by the SysTick tick (needs SYSTICK_INT mode) */
+void Buzzer_BeepAsync(uint32_t duration_ms)
+{
+    beepStartMs = SysTick_GetMs();
+    beepDurationMs = duration_ms;
+    beepActive = 1;
+    Buzzer_On();
+}
+
+
+void Buzzer_Task(void)
+{
+    if (beepActive && (SysTick_GetMs() - beepStartMs) >= beepDurationMs)
+    {
+        beepActive = 0;
+        Buzzer_Off();
+    }
+}
+
+
+uint8_t Buzzer_IsOn(void)
+{
+    return (GPIO_PORTA_DATA_R >> BUZZER_PIN) & 1;
+}
@@ -7,5 +7,8 @@ void Buzzer_Init(void);
 void Buzzer_On(void);
 void Buzzer_Off(void);
 void Buzzer_Beep(uint32_t duration_ms);
+void Buzzer_BeepAsync(uint32_t duration_ms);   /* returns at once, see Buzzer_Task */
+void Buzzer_Task(void);                        /* call from the main loop */
+uint8_t Buzzer_IsOn(void);
 
 #endif
@@ -69,3 +69,17 @@ void Motor_Stop(void) {
     DIO_WritePin(MOTOR_PORT, MOTOR_IN1, LOW);
     DIO_WritePin(MOTOR_PORT, MOTOR_IN2, LOW);
 }
+
+/*
+ * Motor_GetDirection
+ * IN1=HIGH -> CW, IN2=HIGH -> CCW, both LOW -> stopped
+ */
+uint8_t Motor_GetDirection(void) {
+    if (DIO_ReadPin(MOTOR_PORT, MOTOR_IN1) == HIGH) {
+        return MOTOR_CW;
+    }
+    if (DIO_ReadPin(MOTOR_PORT, MOTOR_IN2) == HIGH) {
+        return MOTOR_CCW;
+    }
+    return MOTOR_STOPPED;
+}
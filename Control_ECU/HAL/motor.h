@@ -11,6 +11,11 @@
 
 #include <stdint.h>
 
+/* Motor_GetDirection */
+#define MOTOR_STOPPED   0
+#define MOTOR_CW        1
+#define MOTOR_CCW       2
+
 /******************************************************************************
  * Function Prototypes
  * API for Motor control.
@@ -41,4 +46,11 @@ void Motor_RotateCCW(void);
  */
 void Motor_Stop(void);
 
+/*
+ * Motor_GetDirection
+ * Reads back the driver inputs.
+ * Returns: MOTOR_STOPPED, MOTOR_CW or MOTOR_CCW
+ */
+uint8_t Motor_GetDirection(void);
+
 #endif /* MOTOR_H_ */
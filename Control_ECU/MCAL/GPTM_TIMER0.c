@@ -43,3 +43,9 @@ void GPTM_Timer0A_ClearFlag(void)
 {
     TIMER0_ICR_R = 0x01;
 }
+
+uint32_t GPTM_Timer0A_Remaining(void)
+{
+    /* Counting up from 0 to the interval load value */
+    return TIMER0_TAILR_R - TIMER0_TAV_R;
+}
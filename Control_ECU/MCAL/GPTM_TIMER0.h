@@ -12,5 +12,6 @@
 void GPTM_Timer0A_Init(uint32_t reloadValue);
 uint8_t GPTM_Timer0A_TimeOut(void);
 void GPTM_Timer0A_ClearFlag(void);
+uint32_t GPTM_Timer0A_Remaining(void);   /* ticks left until the next time-out */
 
 #endif /* GPTM_TIMER0_H */
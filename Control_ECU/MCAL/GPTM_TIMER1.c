@@ -0,0 +1,44 @@
+/*************************************************
+ * File: GPTM_TIMER1.c
+ * Description: GPTM Timer1A free-running time base implementation
+ *************************************************/
+
+#include "GPTM_TIMER1.h"
+#include "tm4c123gh6pm.h"
+
+void GPTM_Timer1A_Init(void)
+{
+    volatile uint32_t delay;
+
+    /* Already running: keep the time base of the other users */
+    if((SYSCTL_RCGCTIMER_R & 0x02) && (TIMER1_CTL_R & 0x01))
+    {
+        return;
+    }
+
+    /* Enable Timer1 clock */
+    SYSCTL_RCGCTIMER_R |= 0x02;
+    delay = SYSCTL_RCGCTIMER_R;
+
+    /* Disable Timer1A */
+    TIMER1_CTL_R &= ~0x01;
+
+    /* Configure as 32-bit timer */
+    TIMER1_CFG_R = 0x00;
+
+    /* Periodic mode, count up over the full 32-bit range */
+    TIMER1_TAMR_R = 0x12;
+    TIMER1_TAILR_R = 0xFFFFFFFF;
+    TIMER1_TAV_R   = 0;
+
+    /* Clear timeout flag */
+    TIMER1_ICR_R = 0x01;
+
+    /* Enable Timer1A */
+    TIMER1_CTL_R |= 0x01;
+}
+
+uint32_t GPTM_Timer1A_Read(void)
+{
+    return TIMER1_TAV_R;
+}
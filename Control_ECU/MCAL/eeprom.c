@@ -8,38 +8,311 @@
 
 #include "eeprom.h"
 #include "tm4c123gh6pm.h"
+#include "GPTM_TIMER1.h"
+#include "sysctl.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+/* Flash and EEPROM share IRQ 29: enable bit 29 of EN0, priority field
+ * [15:13] of PRI7, below UART5 so the link is never held up */
+#define EEPROM_NVIC_EN_BIT      (1U << 29)
+#define EEPROM_NVIC_PRI_MASK    0x0000E000U
+#define EEPROM_NVIC_PRI         (3U << 13)
+
+/* Queue entry states */
+#define EEPROM_REQ_FREE         0
+#define EEPROM_REQ_QUEUED       1
+#define EEPROM_REQ_DONE         2       /* finished, callback not called yet */
+
+/* Profile counter update, compiled out without EEPROM_PROFILE */
+#if EEPROM_PROFILE
+#define EEPROM_COUNT(field, n)  (profile.field += (n))
+#else
+#define EEPROM_COUNT(field, n)  ((void)0)
+#endif
+
+/******************************************************************************
+ *                          Private Types                                      *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint32_t         first;                         /* block * 16 + offset */
+    uint32_t         words[EEPROM_QUEUE_WORDS];
+    uint32_t         start;                         /* Timer1 at submit */
+    uint32_t         limit;                         /* deadline, Timer1 ticks after start */
+    EEPROM_Callback  done;
+    uint8_t          count;
+    uint8_t          next;                          /* next word to look at */
+    uint8_t          written;
+    uint8_t          result;
+    volatile uint8_t state;
+} EEPROM_Request;
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+/* Ring of requests: reported <= active <= submitted. The ISR owns
+ * active, the application owns the other two; queue_count (requests not
+ * finished yet) is changed by both, with the interrupt masked. */
+static EEPROM_Request    queue[EEPROM_QUEUE_SIZE];
+static volatile uint8_t  queue_active = 0;          /* being programmed */
+static uint8_t           queue_submit = 0;          /* next free entry */
+static uint8_t           queue_report = 0;          /* oldest not reported */
+static volatile uint8_t  queue_count = 0;
+static uint32_t          ticks_per_us = 16;         /* Timer1 rate */
+static uint32_t          block_writes[EEPROM_TOTAL_BLOCKS];
+static uint32_t          program_start = 0;         /* Timer1 at the queued word's start */
+#if EEPROM_PROFILE
+static EEPROM_Profile    profile;
+#endif
 
 /******************************************************************************
  *                          Private Functions                                  *
  ******************************************************************************/
 
+/* Counts a word programmed in block */
+static void EEPROM_Programmed(uint32_t block)
+{
+    block_writes[block]++;
+    EEPROM_COUNT(writes, 1);
+}
+
 /*
- * EEPROM_WaitDone
+ * EEPROM_Timed
+ * Records the duration of a program that started at Timer1 value start,
+ * and a retry EESUPP asks for after it.
+ */
+static void EEPROM_Timed(uint32_t start)
+{
+#if EEPROM_PROFILE
+    uint32_t cycles = GPTM_Timer1A_Read() - start;
+    
+    profile.programs++;
+    profile.program_cycles += cycles;
+    if(cycles > profile.program_max)
+    {
+        profile.program_max = cycles;
+    }
+    if(EEPROM_EESUPP_R & (EEPROM_EESUPP_PRETRY | EEPROM_EESUPP_ERETRY))
+    {
+        profile.retries++;
+    }
+#else
+    (void)start;
+#endif
+}
+
+/*
+ * EEPROM_WaitDoneFor
  * Waits for EEPROM operation to complete by polling EEDONE register.
+ * Parameters:
+ *   timeout_us - Maximum wait in microseconds
  * Returns: EEPROM_SUCCESS if done, EEPROM_TIMEOUT if timeout occurs
  */
-static uint8_t EEPROM_WaitDone(void)
+static uint8_t EEPROM_WaitDoneFor(uint32_t timeout_us)
 {
-    uint32_t timeout = 1000000;  /* Timeout counter */
+    uint32_t start = GPTM_Timer1A_Read();
+    uint32_t limit = timeout_us * ticks_per_us;
     
     /* Wait for EEPROM to complete operation */
-    while((EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING) && (timeout > 0))
+    while(EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING)
     {
-        timeout--;
+        /* Check for timeout */
+        if((GPTM_Timer1A_Read() - start) > limit)
+        {
+            return EEPROM_TIMEOUT;
+        }
     }
     
-    /* Check for timeout */
-    if(timeout == 0)
+    /* Check for errors */
+    if(EEPROM_EEDONE_R & (EEPROM_EEDONE_INVPL | EEPROM_EEDONE_NOPERM))
     {
-        return EEPROM_TIMEOUT;
+        return EEPROM_ERROR;
     }
     
-    /* Check for errors */
-    if(EEPROM_EEDONE_R & (EEPROM_EEDONE_INVPL | EEPROM_EEDONE_NOPERM))
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_WaitDone
+ * Waits for a word write to complete and times it.
+ */
+static uint8_t EEPROM_WaitDone(void)
+{
+    uint32_t start = GPTM_Timer1A_Read();
+    uint8_t result;
+    
+    result = EEPROM_WaitDoneFor(EEPROM_WAIT_TIMEOUT_US);
+    EEPROM_Timed(start);
+    return result;
+}
+
+/*
+ * EEPROM_BurstStart
+ * Checks that count words from block/offset fit in the EEPROM and points
+ * EEBLOCK/EEOFFSET at the first one for an EERDWRINC stream.
+ * Returns: EEPROM_SUCCESS, EEPROM_ERROR if out of range
+ */
+static uint8_t EEPROM_BurstStart(uint32_t block, uint32_t offset, uint32_t count)
+{
+    if(block >= EEPROM_TOTAL_BLOCKS || offset >= EEPROM_BLOCK_SIZE ||
+       count > (EEPROM_TOTAL_BLOCKS - block) * EEPROM_BLOCK_SIZE - offset)
     {
         return EEPROM_ERROR;
     }
     
+    EEPROM_EEBLOCK_R = block;
+    EEPROM_EEOFFSET_R = offset;
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_BurstNext
+ * Follows EERDWRINC over one word. The hardware wraps the offset back to 0
+ * within the same block, so at the end of a block select the next one.
+ * This is the only place that handles block rollover; BurstStart has
+ * already checked the whole range.
+ */
+static void EEPROM_BurstNext(uint32_t *block, uint32_t *offset)
+{
+    (*offset)++;
+    if(*offset >= EEPROM_BLOCK_SIZE)
+    {
+        *offset = 0;
+        (*block)++;
+        if(*block < EEPROM_TOTAL_BLOCKS)
+        {
+            EEPROM_EEBLOCK_R = *block;
+            EEPROM_EEOFFSET_R = 0;
+        }
+    }
+}
+
+/* Packs 4 bytes into a 32-bit word (little endian) */
+static uint32_t EEPROM_Pack(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] |
+           ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) |
+           ((uint32_t)bytes[3] << 24);
+}
+
+/*
+ * EEPROM_Finish
+ * Ends the active request and moves the queue on; runs from the
+ * interrupt, or with it masked.
+ */
+static void EEPROM_Finish(EEPROM_Request *request)
+{
+#if EEPROM_PROFILE
+    profile.request_last = GPTM_Timer1A_Read() - request->start;
+    if(profile.request_last > profile.request_max)
+    {
+        profile.request_max = profile.request_last;
+    }
+#endif
+    request->state = EEPROM_REQ_DONE;
+    queue_active = (uint8_t)((queue_active + 1U) % EEPROM_QUEUE_SIZE);
+    queue_count--;
+}
+
+/*
+ * EEPROM_Pump
+ * Starts programming the next word of the active request that differs
+ * from the array, finishing requests as they run out of words. Runs from
+ * the interrupt, or with it masked; it returns while a word is being
+ * programmed and the done interrupt calls it again. Every word is
+ * addressed explicitly, so EEBLOCK/EEOFFSET are never touched while the
+ * EEPROM is working.
+ */
+static void EEPROM_Pump(void)
+{
+    EEPROM_Request *request;
+    uint32_t address;
+    uint32_t word;
+    
+    while(queue_count > 0)
+    {
+        if(EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING)
+        {
+            return;
+        }
+        
+        request = &queue[queue_active];
+        while(request->next < request->count)
+        {
+            address = request->first + request->next;
+            word = request->words[request->next++];
+            EEPROM_EEBLOCK_R = address / EEPROM_BLOCK_SIZE;
+            EEPROM_EEOFFSET_R = address % EEPROM_BLOCK_SIZE;
+            if(EEPROM_EERDWR_R != word)
+            {
+                program_start = GPTM_Timer1A_Read();
+                EEPROM_EERDWR_R = word;
+                EEPROM_Programmed(address / EEPROM_BLOCK_SIZE);
+                request->written++;
+                return;
+            }
+            EEPROM_COUNT(skipped, 1);
+        }
+        
+        EEPROM_Finish(request);
+    }
+    
+    /* Idle: the blocking calls run without the interrupt */
+    EEPROM_EEINT_R = 0;
+}
+
+/*
+ * EEPROM_Expire
+ * Abandons the active request once its deadline has passed. It is
+ * finished at once, without waiting for the word in progress, so a
+ * stuck EEPROM cannot hold the queue; the next request starts on the
+ * following done interrupt.
+ */
+static void EEPROM_Expire(void)
+{
+    EEPROM_Request *request;
+    
+    if(queue_count == 0)
+    {
+        return;
+    }
+    
+    NVIC_DIS0_R = EEPROM_NVIC_EN_BIT;
+    request = &queue[queue_active];
+    if(queue_count > 0 && (GPTM_Timer1A_Read() - request->start) > request->limit)
+    {
+        request->result = EEPROM_TIMEOUT;
+        EEPROM_Finish(request);
+        EEPROM_Pump();
+    }
+    NVIC_EN0_R = EEPROM_NVIC_EN_BIT;
+}
+
+/*
+ * EEPROM_Drain
+ * Waits until no queued word is left to program, so that a blocking
+ * call can use the registers. Bounded by the deadlines of the queue.
+ * A request that expired may leave its last word still programming, so
+ * the EEPROM itself must be done too.
+ * Returns: EEPROM_SUCCESS, EEPROM_TIMEOUT if the EEPROM is still busy
+ */
+static uint8_t EEPROM_Drain(void)
+{
+    while(queue_count > 0)
+    {
+        EEPROM_Expire();
+    }
+    
+    if(EEPROM_WaitDoneFor(EEPROM_WAIT_TIMEOUT_US) == EEPROM_TIMEOUT)
+    {
+        return EEPROM_TIMEOUT;
+    }
     return EEPROM_SUCCESS;
 }
 
@@ -72,14 +345,16 @@ uint8_t EEPROM_Init(void)
     /* Small delay for stability */
     for(timeout = 0; timeout < 6; timeout++);
     
-    /* Wait for EEPROM to be ready */
-    timeout = 1000000;
-    while((EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING) && (timeout > 0))
+    /* Time base of the timeouts */
+    GPTM_Timer1A_Init();
+    ticks_per_us = SysCtl_GetClock() / 1000000U;
+    if(ticks_per_us == 0)
     {
-        timeout--;
+        ticks_per_us = 1;
     }
     
-    if(timeout == 0)
+    /* Wait for EEPROM to be ready */
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
     {
         return EEPROM_ERROR;
     }
@@ -94,6 +369,11 @@ uint8_t EEPROM_Init(void)
     EEPROM_EEBLOCK_R = 0;
     EEPROM_EEOFFSET_R = 0;
     
+    /* Done interrupt for the queue; EEINT itself is only set while it runs */
+    FLASH_FCIM_R |= FLASH_FCIM_EMASK;
+    NVIC_PRI7_R = (NVIC_PRI7_R & ~EEPROM_NVIC_PRI_MASK) | EEPROM_NVIC_PRI;
+    NVIC_EN0_R = EEPROM_NVIC_EN_BIT;
+    
     return EEPROM_SUCCESS;
 }
 
@@ -109,12 +389,18 @@ uint8_t EEPROM_WriteWord(uint32_t block, uint32_t offset, uint32_t data)
         return EEPROM_ERROR;
     }
     
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
     /* Set block and offset */
     EEPROM_EEBLOCK_R = block;
     EEPROM_EEOFFSET_R = offset;
     
     /* Write data */
     EEPROM_EERDWR_R = data;
+    EEPROM_Programmed(block);
     
     /* Wait for write to complete */
     return EEPROM_WaitDone();
@@ -132,12 +418,18 @@ uint8_t EEPROM_ReadWord(uint32_t block, uint32_t offset, uint32_t *data)
         return EEPROM_ERROR;
     }
     
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
     /* Set block and offset */
     EEPROM_EEBLOCK_R = block;
     EEPROM_EEOFFSET_R = offset;
     
     /* Read data */
     *data = EEPROM_EERDWR_R;
+    EEPROM_COUNT(reads, 1);
     
     return EEPROM_SUCCESS;
 }
@@ -149,47 +441,86 @@ uint8_t EEPROM_ReadWord(uint32_t block, uint32_t offset, uint32_t *data)
 uint8_t EEPROM_WriteBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length)
 {
     uint32_t i;
-    uint32_t word;
-    uint32_t current_block = block;
-    uint32_t current_offset = offset;
     uint8_t result;
     
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
     /* Validate parameters */
-    if(buffer == 0 || (length % 4) != 0)
+    if(buffer == 0 || (length % 4) != 0 ||
+       EEPROM_BurstStart(block, offset, length / 4) != EEPROM_SUCCESS)
     {
         return EEPROM_ERROR;
     }
     
-    /* Write data word by word */
+    /* Stream words through the auto-incrementing register */
     for(i = 0; i < length; i += 4)
     {
-        /* Pack 4 bytes into a 32-bit word (little endian) */
-        word = (uint32_t)buffer[i] | 
-               ((uint32_t)buffer[i+1] << 8) | 
-               ((uint32_t)buffer[i+2] << 16) | 
-               ((uint32_t)buffer[i+3] << 24);
-        
-        /* Write word to EEPROM */
-        result = EEPROM_WriteWord(current_block, current_offset, word);
+        EEPROM_EERDWRINC_R = EEPROM_Pack(&buffer[i]);
+        EEPROM_Programmed(block);
+        result = EEPROM_WaitDone();
         if(result != EEPROM_SUCCESS)
         {
             return result;
         }
+        EEPROM_BurstNext(&block, &offset);
+    }
+    
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_UpdateBuffer
+ * Writes only the words of a buffer that differ from the EEPROM.
+ */
+uint8_t EEPROM_UpdateBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                            uint32_t *written)
+{
+    uint32_t i;
+    uint32_t word;
+    uint32_t count = 0;
+    uint8_t result = EEPROM_SUCCESS;
+    
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
+    /* Validate parameters */
+    if(buffer == 0 || (length % 4) != 0 ||
+       EEPROM_BurstStart(block, offset, length / 4) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    for(i = 0; i < length && result == EEPROM_SUCCESS; i += 4)
+    {
+        word = EEPROM_Pack(&buffer[i]);
         
-        /* Move to next word */
-        current_offset++;
-        if(current_offset >= EEPROM_BLOCK_SIZE)
+        /* Program only if the stored word differs; EERDWR reads without
+         * moving on, EERDWRINC moves on either way */
+        if(EEPROM_EERDWR_R != word)
         {
-            current_offset = 0;
-            current_block++;
-            if(current_block >= EEPROM_TOTAL_BLOCKS)
-            {
-                return EEPROM_ERROR;  /* Out of EEPROM space */
-            }
+            EEPROM_EERDWRINC_R = word;
+            EEPROM_Programmed(block);
+            result = EEPROM_WaitDone();
+            count++;
+        }
+        else
+        {
+            (void)EEPROM_EERDWRINC_R;
+            EEPROM_COUNT(skipped, 1);
         }
+        EEPROM_BurstNext(&block, &offset);
     }
     
-    return EEPROM_SUCCESS;
+    if(written != 0)
+    {
+        *written = count;
+    }
+    return result;
 }
 
 /*
@@ -200,25 +531,22 @@ uint8_t EEPROM_ReadBuffer(uint32_t block, uint32_t offset, uint8_t *buffer, uint
 {
     uint32_t i;
     uint32_t word;
-    uint32_t current_block = block;
-    uint32_t current_offset = offset;
-    uint8_t result;
+    
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
     
     /* Validate parameters */
-    if(buffer == 0 || (length % 4) != 0)
+    if(buffer == 0 || (length % 4) != 0 ||
+       EEPROM_BurstStart(block, offset, length / 4) != EEPROM_SUCCESS)
     {
         return EEPROM_ERROR;
     }
     
-    /* Read data word by word */
     for(i = 0; i < length; i += 4)
     {
-        /* Read word from EEPROM */
-        result = EEPROM_ReadWord(current_block, current_offset, &word);
-        if(result != EEPROM_SUCCESS)
-        {
-            return result;
-        }
+        word = EEPROM_EERDWRINC_R;
         
         /* Unpack 32-bit word into 4 bytes (little endian) */
         buffer[i]   = (uint8_t)(word & 0xFF);
@@ -226,16 +554,112 @@ uint8_t EEPROM_ReadBuffer(uint32_t block, uint32_t offset, uint8_t *buffer, uint
         buffer[i+2] = (uint8_t)((word >> 16) & 0xFF);
         buffer[i+3] = (uint8_t)((word >> 24) & 0xFF);
         
-        /* Move to next word */
-        current_offset++;
-        if(current_offset >= EEPROM_BLOCK_SIZE)
+        EEPROM_BurstNext(&block, &offset);
+    }
+    EEPROM_COUNT(reads, length / 4);
+    
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_ReadBurst
+ * Streams words out of EEPROM through EERDWRINC.
+ */
+uint8_t EEPROM_ReadBurst(uint32_t block, uint32_t offset, uint32_t *words, uint32_t count)
+{
+    uint32_t i;
+    
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
+    if(words == 0 || EEPROM_BurstStart(block, offset, count) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    for(i = 0; i < count; i++)
+    {
+        words[i] = EEPROM_EERDWRINC_R;
+        EEPROM_BurstNext(&block, &offset);
+    }
+    EEPROM_COUNT(reads, count);
+    
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_WriteBurst
+ * Streams words into EEPROM through EERDWRINC.
+ */
+uint8_t EEPROM_WriteBurst(uint32_t block, uint32_t offset, const uint32_t *words, uint32_t count)
+{
+    uint32_t i;
+    uint8_t result;
+    
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
+    if(words == 0 || EEPROM_BurstStart(block, offset, count) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    for(i = 0; i < count; i++)
+    {
+        EEPROM_EERDWRINC_R = words[i];
+        EEPROM_Programmed(block);
+        result = EEPROM_WaitDone();
+        if(result != EEPROM_SUCCESS)
         {
-            current_offset = 0;
-            current_block++;
-            if(current_block >= EEPROM_TOTAL_BLOCKS)
-            {
-                return EEPROM_ERROR;  /* Out of EEPROM space */
-            }
+            return result;
+        }
+        EEPROM_BurstNext(&block, &offset);
+    }
+    
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_EraseBlock
+ * Erases one block word by word.
+ */
+uint8_t EEPROM_EraseBlock(uint32_t block)
+{
+    uint32_t j;
+    uint8_t result;
+    
+    if(EEPROM_Drain() != EEPROM_SUCCESS)
+    {
+        return EEPROM_TIMEOUT;
+    }
+    
+    /* Validate parameters */
+    if(block >= EEPROM_TOTAL_BLOCKS)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    EEPROM_EEBLOCK_R = block;
+    for(j = 0; j < EEPROM_BLOCK_SIZE; j++)
+    {
+        /* Reading is cheap, programming is not: leave erased words alone */
+        EEPROM_EEOFFSET_R = j;
+        if(EEPROM_EERDWR_R == 0xFFFFFFFF)
+        {
+            EEPROM_COUNT(skipped, 1);
+            continue;
+        }
+        
+        EEPROM_EERDWR_R = 0xFFFFFFFF;
+        EEPROM_Programmed(block);
+        result = EEPROM_WaitDone();
+        if(result != EEPROM_SUCCESS)
+        {
+            return result;
         }
     }
     
@@ -244,25 +668,146 @@ uint8_t EEPROM_ReadBuffer(uint32_t block, uint32_t offset, uint8_t *buffer, uint
 
 /*
  * EEPROM_MassErase
- * Erases the entire EEPROM.
+ * Erases the entire EEPROM, block by block.
  */
 uint8_t EEPROM_MassErase(void)
 {
-    uint32_t i, j;
+    uint32_t i;
     uint8_t result;
     
-    /* Erase all blocks by writing 0xFFFFFFFF to all words */
     for(i = 0; i < EEPROM_TOTAL_BLOCKS; i++)
     {
-        for(j = 0; j < EEPROM_BLOCK_SIZE; j++)
+        result = EEPROM_EraseBlock(i);
+        if(result != EEPROM_SUCCESS)
         {
-            result = EEPROM_WriteWord(i, j, 0xFFFFFFFF);
-            if(result != EEPROM_SUCCESS)
-            {
-                return result;
-            }
+            return result;
         }
     }
     
     return EEPROM_SUCCESS;
 }
+
+/*
+ * EEPROM_Submit
+ * Copies a write into the queue and starts it if the queue was idle.
+ */
+uint8_t EEPROM_Submit(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                      uint32_t deadline_us, EEPROM_Callback done)
+{
+    EEPROM_Request *request = &queue[queue_submit];
+    uint32_t i;
+    
+    /* Validate parameters */
+    if(buffer == 0 || (length % 4) != 0 || length == 0 ||
+       length > EEPROM_QUEUE_WORDS * 4 ||
+       block >= EEPROM_TOTAL_BLOCKS || offset >= EEPROM_BLOCK_SIZE ||
+       length / 4 > (EEPROM_TOTAL_BLOCKS - block) * EEPROM_BLOCK_SIZE - offset)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    /* Full until the oldest entry has been reported */
+    if(request->state != EEPROM_REQ_FREE)
+    {
+        return EEPROM_ERROR;
+    }
+    
+    request->first = block * EEPROM_BLOCK_SIZE + offset;
+    for(i = 0; i < length; i += 4)
+    {
+        request->words[i / 4] = EEPROM_Pack(&buffer[i]);
+    }
+    request->count = (uint8_t)(length / 4);
+    request->next = 0;
+    request->written = 0;
+    request->result = EEPROM_SUCCESS;
+    request->done = done;
+    request->start = GPTM_Timer1A_Read();
+    request->limit = deadline_us * ticks_per_us;
+    request->state = EEPROM_REQ_QUEUED;
+    queue_submit = (uint8_t)((queue_submit + 1U) % EEPROM_QUEUE_SIZE);
+    
+    NVIC_DIS0_R = EEPROM_NVIC_EN_BIT;
+    queue_count++;
+    if(queue_count == 1)
+    {
+        EEPROM_EEINT_R = EEPROM_EEINT_INT;
+        EEPROM_Pump();
+    }
+    NVIC_EN0_R = EEPROM_NVIC_EN_BIT;
+    
+    return EEPROM_SUCCESS;
+}
+
+/*
+ * EEPROM_Task
+ * Deadlines and completion callbacks of the queue.
+ */
+void EEPROM_Task(void)
+{
+    EEPROM_Request *request;
+    
+    EEPROM_Expire();
+    
+    /* A callback may submit again: free the entry first */
+    while(queue[queue_report].state == EEPROM_REQ_DONE)
+    {
+        request = &queue[queue_report];
+        request->state = EEPROM_REQ_FREE;
+        queue_report = (uint8_t)((queue_report + 1U) % EEPROM_QUEUE_SIZE);
+        if(request->done != 0)
+        {
+            request->done(request->result, request->written);
+        }
+    }
+}
+
+/*
+ * FLASH_Handler
+ * EEPROM done interrupt: records a failed word and moves the queue on.
+ */
+void FLASH_Handler(void)
+{
+    EEPROM_Request *request;
+    
+    FLASH_FCMISC_R = FLASH_FCMISC_EMISC;
+    EEPROM_Timed(program_start);
+    
+    if(queue_count > 0 && (EEPROM_EEDONE_R & (EEPROM_EEDONE_INVPL | EEPROM_EEDONE_NOPERM)))
+    {
+        request = &queue[queue_active];
+        request->result = EEPROM_ERROR;
+        request->next = request->count;
+    }
+    EEPROM_Pump();
+}
+
+/*
+ * EEPROM_GetProfile
+ * Copies the operation counters.
+ */
+void EEPROM_GetProfile(EEPROM_Profile *profile_out)
+{
+    if(profile_out == 0)
+    {
+        return;
+    }
+#if EEPROM_PROFILE
+    NVIC_DIS0_R = EEPROM_NVIC_EN_BIT;
+    *profile_out = profile;
+    NVIC_EN0_R = EEPROM_NVIC_EN_BIT;
+#else
+    const EEPROM_Profile none = {0};
+    
+    *profile_out = none;
+#endif
+}
+
+/*
+ * EEPROM_BlockWrites
+ * Words programmed in one block since reset.
+ */
+uint32_t EEPROM_BlockWrites(uint32_t block)
+{
+    return (block < EEPROM_TOTAL_BLOCKS) ? block_writes[block] : 0;
+}
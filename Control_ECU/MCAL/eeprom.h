@@ -40,6 +40,48 @@
 #define EEPROM_EEDONE_WKCOPY    0x00000008  /* Working on a Copy */
 #define EEPROM_EEDONE_WKERASE   0x00000004  /* Working on an Erase */
 
+/* Wall-clock limits of the blocking calls (GPTM Timer1A) */
+#define EEPROM_WAIT_TIMEOUT_US  100000      /* one word, including a copy cycle */
+
+/* Queued writer */
+#define EEPROM_QUEUE_SIZE       4           /* requests, in flight or not yet reported */
+#define EEPROM_QUEUE_WORDS      EEPROM_BLOCK_SIZE   /* largest request */
+
+/* Operation counters and timings of EEPROM_GetProfile; 0 compiles them out
+ * (the per-block write counts of EEPROM_BlockWrites are always kept) */
+#ifndef EEPROM_PROFILE
+#define EEPROM_PROFILE          1
+#endif
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+/*
+ * Completion of an EEPROM_Submit request, called from EEPROM_Task.
+ *   result  - EEPROM_SUCCESS, EEPROM_ERROR, or EEPROM_TIMEOUT if the
+ *             deadline passed first
+ *   written - Number of words programmed (words already equal are skipped)
+ */
+typedef void (*EEPROM_Callback)(uint8_t result, uint32_t written);
+
+/*
+ * Counters since reset (EEPROM_PROFILE). Times are in GPTM Timer1A
+ * ticks, i.e. system clock cycles; the totals wrap.
+ */
+typedef struct
+{
+    uint32_t reads;             /* words read by the caller */
+    uint32_t writes;            /* words programmed, queued ones included */
+    uint32_t skipped;           /* words not programmed: already equal */
+    uint32_t retries;           /* programs / erases EESUPP asked to retry */
+    uint32_t programs;          /* timed word programs */
+    uint32_t program_cycles;    /* total time of the timed programs */
+    uint32_t program_max;       /* longest of them */
+    uint32_t request_last;      /* EEPROM_Submit to done, last request */
+    uint32_t request_max;       /* longest request */
+} EEPROM_Profile;
+
 /******************************************************************************
  *                          Function Prototypes                                *
  ******************************************************************************/
@@ -47,6 +89,8 @@
 /*
  * EEPROM_Init
  * Initializes the EEPROM module by enabling clock and waiting for ready state.
+ * Also starts GPTM Timer1A (if not running) as the time base of the
+ * timeouts and sets up the EEPROM done interrupt for EEPROM_Submit.
  * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR on failure
  */
 uint8_t EEPROM_Init(void);
@@ -58,7 +102,7 @@ uint8_t EEPROM_Init(void);
  *   block  - Block number (0-31)
  *   offset - Word offset within block (0-15)
  *   data   - 32-bit data to write
- * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR on failure
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
  */
 uint8_t EEPROM_WriteWord(uint32_t block, uint32_t offset, uint32_t data);
 
@@ -69,7 +113,7 @@ uint8_t EEPROM_WriteWord(uint32_t block, uint32_t offset, uint32_t data);
  *   block  - Block number (0-31)
  *   offset - Word offset within block (0-15)
  *   data   - Pointer to store the read data
- * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR on failure
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
  */
 uint8_t EEPROM_ReadWord(uint32_t block, uint32_t offset, uint32_t *data);
 
@@ -81,10 +125,26 @@ uint8_t EEPROM_ReadWord(uint32_t block, uint32_t offset, uint32_t *data);
  *   offset - Starting word offset within block (0-15)
  *   buffer - Pointer to data buffer
  *   length - Number of bytes to write (must be multiple of 4)
- * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR on failure
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
  */
 uint8_t EEPROM_WriteBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length);
 
+/*
+ * EEPROM_UpdateBuffer
+ * Same as EEPROM_WriteBuffer, but reads every word first and only
+ * programs the words that differ, so rewriting unchanged data costs
+ * reads only and no wear.
+ * Parameters:
+ *   block   - Starting block number (0-31)
+ *   offset  - Starting word offset within block (0-15)
+ *   buffer  - Pointer to data buffer
+ *   length  - Number of bytes to write (must be multiple of 4)
+ *   written - Receives the number of words programmed (may be 0)
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t EEPROM_UpdateBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                            uint32_t *written);
+
 /*
  * EEPROM_ReadBuffer
  * Reads a buffer of bytes from the EEPROM starting at specified address.
@@ -93,15 +153,96 @@ uint8_t EEPROM_WriteBuffer(uint32_t block, uint32_t offset, const uint8_t *buffe
  *   offset - Starting word offset within block (0-15)
  *   buffer - Pointer to buffer to store read data
  *   length - Number of bytes to read (must be multiple of 4)
- * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR on failure
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
  */
 uint8_t EEPROM_ReadBuffer(uint32_t block, uint32_t offset, uint8_t *buffer, uint32_t length);
 
+/*
+ * EEPROM_ReadBurst
+ * Reads consecutive words, setting block and offset once and streaming
+ * through the auto-incrementing EERDWRINC register; crosses block
+ * boundaries. EEPROM_ReadBuffer / WriteBuffer / UpdateBuffer stream the
+ * same way.
+ * Parameters:
+ *   block  - Starting block number (0-31)
+ *   offset - Starting word offset within block (0-15)
+ *   words  - Pointer to store the words
+ *   count  - Number of words (must end within the EEPROM)
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t EEPROM_ReadBurst(uint32_t block, uint32_t offset, uint32_t *words, uint32_t count);
+
+/*
+ * EEPROM_WriteBurst
+ * Writes consecutive words through EERDWRINC, waiting for each to be
+ * programmed. Same parameters as EEPROM_ReadBurst.
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t EEPROM_WriteBurst(uint32_t block, uint32_t offset, const uint32_t *words, uint32_t count);
+
+/*
+ * EEPROM_EraseBlock
+ * Sets every word of a block to 0xFFFFFFFF, skipping words already erased.
+ * Parameters:
+ *   block  - Block number (0-31)
+ * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
+ */
+uint8_t EEPROM_EraseBlock(uint32_t block);
+
 /*
  * EEPROM_MassErase
- * Erases the entire EEPROM (sets all bits to 1).
+ * Erases the entire EEPROM (sets all bits to 1): EEPROM_EraseBlock on
+ * every block, so words already erased are not programmed again.
  * Returns: EEPROM_SUCCESS on success, EEPROM_ERROR/EEPROM_TIMEOUT on failure
  */
 uint8_t EEPROM_MassErase(void);
 
+/*
+ * EEPROM_Submit
+ * Queues a write and returns at once; the words are programmed one per
+ * EEPROM done interrupt (FLASH_Handler), skipping words that already
+ * hold the data. The blocking calls above first wait for the queue to
+ * drain, so they never interleave with it.
+ * Parameters:
+ *   block       - Starting block number (0-31)
+ *   offset      - Starting word offset within block (0-15)
+ *   buffer      - Data, copied into the queue
+ *   length      - Number of bytes (multiple of 4, at most
+ *                 EEPROM_QUEUE_WORDS words, within the EEPROM)
+ *   deadline_us - Time allowed from now; the rest of the request is
+ *                 abandoned with EEPROM_TIMEOUT after it
+ *   done        - Completion callback (may be 0)
+ * Returns: EEPROM_SUCCESS if queued, EEPROM_ERROR on bad arguments or a
+ *          full queue (done is then never called)
+ */
+uint8_t EEPROM_Submit(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                      uint32_t deadline_us, EEPROM_Callback done);
+
+/*
+ * EEPROM_Task
+ * Enforces the deadlines of the queued writes and calls the callbacks of
+ * the finished ones, in submission order. Call from the main loop.
+ */
+void EEPROM_Task(void);
+
+/*
+ * EEPROM_GetProfile
+ * Copies the counters; all zero if built without EEPROM_PROFILE.
+ */
+void EEPROM_GetProfile(EEPROM_Profile *profile);
+
+/*
+ * EEPROM_BlockWrites
+ * Words programmed in a block since reset, by every write path.
+ * Returns: the count, 0 for a block out of range
+ */
+uint32_t EEPROM_BlockWrites(uint32_t block);
+
+/*
+ * FLASH_Handler
+ * Flash / EEPROM interrupt service routine (vector table entry for
+ * IRQ 29), moves the EEPROM_Submit queue on.
+ */
+void FLASH_Handler(void);
+
 #endif /* EEPROM_H_ */
@@ -0,0 +1,14 @@
+/*************************************************
+ * File: sysctl.h
+ * Description: System control: system clock frequency
+ *************************************************/
+
+#ifndef SYSCTL_H
+#define SYSCTL_H
+
+#include <stdint.h>
+
+/* Public APIs */
+uint32_t SysCtl_GetClock(void);         /* Hz, decoded from RCC/RCC2 */
+
+#endif /* SYSCTL_H */
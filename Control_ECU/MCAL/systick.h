@@ -9,4 +9,7 @@
 void SysTick_Init(uint32_t reload, uint8_t mode);
 void DelayMs(uint32_t ms);
 
+/* Milliseconds since SysTick_Init (SYSTICK_INT mode only, wraps after ~49 days) */
+uint32_t SysTick_GetMs(void);
+
 #endif
@@ -11,6 +11,11 @@
 #include "adc.h"
 #include "potentiometer.h"
 #include "uart.h"
+#include "protocol.h"
+#include "pinauth.h"
+#include "link.h"
+#include "bench.h"
+#include "GPTM_TIMER1.h"
 
 
 /**************************
@@ -23,8 +28,16 @@
 
 #define MIN_TIMEOUT             5       /* Minimum timeout in seconds */
 #define MAX_TIMEOUT             30      /* Maximum timeout in seconds */
-#define MAX_ATTEMPTS            3       /* Maximum password attempts */
-#define LOCKOUT_DURATION        10      /* Lockout duration in seconds */
+
+/* Inter-ECU link reply deadlines */
+#define LINK_TIMEOUT_MS         500     /* Plain command round trip */
+#define LINK_ERASE_TIMEOUT_MS   5000    /* Erase of all 32 blocks */
+#define LINK_DOOR_MOVE_MS       5000    /* Unlock move (3 s) plus margin */
+#define LINK_RETRIES            2       /* Extra attempts per request */
+#define BUSY_ANIMATION_MS       300     /* Progress dots while waiting */
+#define PIN_NO_VERDICT          0xFE    /* streamed PIN not decided yet */
+
+#define WELCOME_SCREEN_MS       250     /* "Welcome!" splash before the menu */
 
 /* Door LED Pins */
 #define DOOR_LED_RED            PIN1    /* PF1 - Red (Locked) */
@@ -44,7 +57,8 @@ typedef enum {
     STATE_ADJUST_TIMEOUT,
     STATE_TIMEOUT_PASSWORD,
     STATE_DOOR_UNLOCKED,
-    STATE_LOCKOUT
+    STATE_LOCKOUT,
+    STATE_WAIT_REPLY        /* request to Control_ECU in flight */
 } AppState;
 
 
@@ -54,14 +68,40 @@ typedef enum {
 
 static char password[PASSWORD_LENGTH + 1] = {0};          /* Current password buffer */
 static char temp_password[PASSWORD_LENGTH + 1] = {0};      /* Temp password for confirmation */
-//static char stored_password[PASSWORD_LENGTH + 1] = {0};    /* Password from EEPROM */
-static char stored_password[PASSWORD_LENGTH + 1] = {0};    /* Password from EEPROM */
 static uint8_t password_index = 0;
 //static AppState current_state = STATE_INIT;
 static AppState current_state = STATE_SETUP_PASSWORD;
-static uint8_t attempt_count = 0;
 static uint8_t auto_lock_timeout = 10;  /* Default 10 seconds */
 static uint8_t pending_timeout = 10;     /* Temp value when adjusting */
+static uint8_t link_request = LINK_NO_HANDLE; /* Request behind STATE_WAIT_REPLY */
+static uint8_t request_cancellable = 0;
+static uint8_t busy_dots = 0;
+static uint32_t busy_next_update = 0;
+static uint32_t door_deadline = 0;       /* Give up waiting for DOOR_LOCKED */
+static uint8_t pin_session = 0;          /* PROTO_CMD_PIN_DIGIT session of this entry */
+static uint8_t pin_verdict = PIN_NO_VERDICT;
+static uint8_t pin_fallback = 0;         /* a digit went missing: send the whole PIN */
+static uint8_t pin_sent = 0;             /* digits of this entry submitted so far */
+static uint8_t pin_digit_busy = 0;       /* a PIN_DIGIT request awaits its reply */
+static uint8_t pin_digit_session = 0;    /* pin_session of that request */
+static Link_Callback pin_on_done = 0;    /* set once the last digit is typed */
+static uint16_t pin_user = PROTO_USER_MASTER; /* whose PIN the streamed verdict was */
+static uint16_t pin_lockout = 0;        /* seconds left of a LOCKED streamed verdict */
+static uint8_t challenge[PINAUTH_CHALLENGE_SIZE];     /* Control_ECU's current PIN challenge */
+static uint8_t pin_challenge[PINAUTH_CHALLENGE_SIZE]; /* seals this entry's PIN_DIGIT session */
+static uint8_t pin_type = 0;            /* sealed request of SubmitPin */
+static uint8_t pin_payload[PROTO_MAX_PAYLOAD];
+static uint8_t pin_length = 0;
+static uint8_t pin_resealed = 0;        /* sealed again after a STALE reply */
+static Link_Callback pin_request_done = 0;
+static uint32_t lockout_end = 0;        /* SysTick_GetMs when Control_ECU's lockout ends */
+static uint16_t lockout_shown = 0;      /* seconds on the lockout screen */
+static uint8_t telemetry[PROTO_TLM_SIZE] = { PROTO_DOOR_LOCKED, PROTO_MOTOR_STOPPED, 0, 0 };
+static volatile uint32_t boot_time_ms = 0; /* ms to the menu or setup prompt (C-SPY) */
+static volatile uint32_t link_baud = UART5_DEFAULT_BAUD; /* Negotiated rate (watch in debugger) */
+
+/* Link rates offered to Control_ECU at boot, fastest first */
+static const uint32_t link_rates[] = { 2000000U, 1000000U, 460800U, 230400U };
 
 /**************************
  *                          Function Prototypes                                *
@@ -86,12 +126,41 @@ void ProcessKey(char key);
 //void HandleDoorOperation(void);
 //void HandleLockout(void);
 uint8_t ReadPotentiometerTimeout(void);
+uint32_t ReadLinkSeed(void);
 void DisplayTimeoutValue(uint8_t timeout_val);
+void ShowWaiting(const char *msg, uint8_t cancellable);
+void StartRequest(const char *msg, uint8_t type, const uint8_t *payload, uint8_t length,
+                  uint32_t timeout_ms, uint8_t cancellable, Link_Callback on_done);
+void StartPinRequest(const char *msg, uint8_t type, const uint8_t *payload, uint8_t length,
+                     uint8_t cancellable, Link_Callback on_done);
+void OnPinSubmitted(uint8_t status, const PROTO_Frame *reply);
+void UpdateBusy(void);
+void IgnoreReply(uint8_t status, const PROTO_Frame *reply);
+void ShowNoResponse(void);
+void WrongPassword(uint8_t status, const PROTO_Frame *reply);
+void Lockout_Start(uint16_t seconds);
+void Lockout_Update(void);
+void OnSetupPasswordStored(uint8_t status, const PROTO_Frame *reply);
+void SendPinDigit(void);
+void VerifyPin(Link_Callback on_done);
+void OnPinDigit(uint8_t status, const PROTO_Frame *reply);
+void OnOpenDoorVerified(uint8_t status, const PROTO_Frame *reply);
+void OnDoorUnlocked(uint8_t status, const PROTO_Frame *reply);
+void Door_Update(void);
+void Door_Show(void);
+void Door_Locked(void);
+void OnSubscribed(uint8_t status, const PROTO_Frame *reply);
+void OnLinkEvent(const PROTO_Frame *event);
+void OnChangeOldVerified(uint8_t status, const PROTO_Frame *reply);
+void OnPasswordChanged(uint8_t status, const PROTO_Frame *reply);
+void OnTimeoutVerified(uint8_t status, const PROTO_Frame *reply);
+void OnTimeoutStored(uint8_t status, const PROTO_Frame *reply);
+void OnFactoryReset(uint8_t status, const PROTO_Frame *reply);
 
 void System_Init(void)
 {
     /* Initialize SysTick for delays */
-    SysTick_Init(16000, SYSTICK_NOINT);
+    SysTick_Init(16000, SYSTICK_INT);
     
     /* Initialize LCD */
     LCD_Init();
@@ -103,6 +172,9 @@ void System_Init(void)
    
     /* Initialize Potentiometer */
     POT_Init();
+
+    /* Free-running cycle count, seeds the link nonces (ReadLinkSeed) */
+    GPTM_Timer1A_Init();
       DIO_Init(PORTF, DOOR_LED_RED, OUTPUT);      /* Red LED - Locked */
     DIO_Init(PORTF, DOOR_LED_GREEN, OUTPUT);    /* Green LED - Unlocked */
     DIO_Init(PORTF, STATUS_LED_BLUE, OUTPUT);   /* Blue LED - Status */
@@ -156,6 +228,7 @@ void ClearPasswordBuffer(void)
         temp_password[i] = 0;
     }
     password_index = 0;
+    pin_on_done = 0;            /* drop a verdict still on its way */
 }
 uint8_t VerifyPassword(const char* input, const char* stored);
 
@@ -176,56 +249,707 @@ uint8_t VerifyPassword(const char* input, const char* stored)
     return 1;  /* Password match */
 }
 
-void handleDoor_HMI(void){
-                                UART5_SendChar('F'); // HandleDoorOperation();
-                                
-                               uint8_t countdown = auto_lock_timeout;
-                               //char buffer[16];//----code refactoring
-                               char handle_lcd_time_tmp_char;
-                                    
-                               while(1){
-                                   if (UART5_IsDataAvailable()){
-                                      handle_lcd_time_tmp_char =  UART5_ReceiveChar();
-                                      break;
-                                      } 
-                                     }
-                                if(handle_lcd_time_tmp_char == 'u'){
-                                    //DelayMs(3000);
-                                    LCD_Clear();
-                                    LCD_SetCursor(0, 0);
-                                    LCD_WriteString("Door Unlocked!");
-                                
-                                
-                            /* Countdown display */
-                              while(countdown > 0)
-                               {          char buffer[16];//new place for buffer declaration
-                                          sprintf(buffer, "Lock in %d sec", countdown);
-                                          LCD_SetCursor(1, 0);
-                                          LCD_WriteString("                ");
-                                          LCD_SetCursor(1, 0);
-                                          LCD_WriteString(buffer);
-                                          DelayMs(1000);
-                                          countdown--;
-                                 }
-                                }
-                                
-                                 while(1){
-                                   if (UART5_IsDataAvailable()){
-                                      handle_lcd_time_tmp_char =  UART5_ReceiveChar();
-                                      break;
-                                      } 
-                                     }
-                                if(handle_lcd_time_tmp_char == 'l'){
-                                    //DelayMs(3000);
-                                    LCD_Clear();
-                                    LCD_SetCursor(0, 0);
-                                    LCD_WriteString("Door locked!");
-                                }
-                                DelayMs(1500);
+/*
+ * ShowWaiting
+ * Parks the UI in STATE_WAIT_REPLY with msg on the top line.
+ */
+void ShowWaiting(const char *msg, uint8_t cancellable)
+{
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString(msg);
+
+    busy_dots = 0;
+    busy_next_update = SysTick_GetMs();
+    request_cancellable = cancellable;
+    link_request = LINK_NO_HANDLE;
+    current_state = STATE_WAIT_REPLY;
+}
+
+/*
+ * StartRequest
+ * Submits a request on behalf of the current screen and parks the UI in
+ * STATE_WAIT_REPLY with msg on the top line. on_done runs from Link_Task
+ * when the reply arrives or every retry has timed out; until then the main
+ * loop keeps scanning keys and animating the second line. A cancellable
+ * request can be abandoned with '#'.
+ */
+void StartRequest(const char *msg, uint8_t type, const uint8_t *payload, uint8_t length,
+                  uint32_t timeout_ms, uint8_t cancellable, Link_Callback on_done)
+{
+    ShowWaiting(msg, cancellable);
+
+    link_request = Link_Submit(type, payload, length, timeout_ms, LINK_RETRIES, on_done);
+    if(link_request == LINK_NO_HANDLE)
+    {
+        on_done(LINK_STATUS_TIMEOUT, 0);
+    }
+}
+
+/*
+ * TakeChallenge
+ * Picks up the current challenge from a PROTO_STATUS_STALE reply.
+ */
+static void TakeChallenge(uint8_t status, const PROTO_Frame *reply)
+{
+    if(status == PROTO_STATUS_STALE && reply != 0 && reply->length == 1 + PINAUTH_CHALLENGE_SIZE)
+    {
+        memcpy(challenge, &reply->payload[1], PINAUTH_CHALLENGE_SIZE);
+    }
+}
+
+/*
+ * SubmitPin
+ * Sends a request carrying PIN digits, sealed with the current challenge
+ * (pinauth.h). If Control_ECU finds the challenge stale, OnPinSubmitted
+ * seals it again once with the one in its reply; on_done then gets the
+ * outcome. One at a time; link_request follows the resubmission.
+ * Returns: the handle, or LINK_NO_HANDLE
+ */
+static uint8_t SubmitPin(uint8_t type, const uint8_t *payload, uint8_t length, Link_Callback on_done)
+{
+    uint8_t sealed[PROTO_MAX_PAYLOAD];
+    uint8_t sealed_length;
+
+    if(payload != pin_payload)          /* not the resubmission */
+    {
+        pin_type = type;
+        memcpy(pin_payload, payload, length);
+        pin_length = length;
+        pin_resealed = 0;
+        pin_request_done = on_done;
+    }
+    memcpy(sealed, payload, length);
+    sealed_length = PinAuth_Seal(challenge, type, sealed, length);
+    if(sealed_length == 0)
+    {
+        return LINK_NO_HANDLE;
+    }
+    return Link_Submit(type, sealed, sealed_length, LINK_TIMEOUT_MS, LINK_RETRIES, OnPinSubmitted);
+}
+
+void OnPinSubmitted(uint8_t status, const PROTO_Frame *reply)
+{
+    TakeChallenge(status, reply);
+    if(status == PROTO_STATUS_STALE && !pin_resealed)
+    {
+        pin_resealed = 1;
+        link_request = SubmitPin(pin_type, pin_payload, pin_length, pin_request_done);
+        if(link_request != LINK_NO_HANDLE)
+        {
+            return;
+        }
+    }
+    if(status == PROTO_STATUS_STALE)
+    {
+        status = LINK_STATUS_TIMEOUT;   /* no pairing with Control_ECU */
+        reply = 0;
+    }
+    pin_request_done(status, reply);
+}
+
+/*
+ * StartPinRequest
+ * StartRequest for a request carrying PIN digits (SubmitPin).
+ */
+void StartPinRequest(const char *msg, uint8_t type, const uint8_t *payload, uint8_t length,
+                     uint8_t cancellable, Link_Callback on_done)
+{
+    ShowWaiting(msg, cancellable);
+
+    link_request = SubmitPin(type, payload, length, on_done);
+    if(link_request == LINK_NO_HANDLE)
+    {
+        on_done(LINK_STATUS_TIMEOUT, 0);
+    }
+}
+
+/*
+ * FinishPin
+ * Hands the streamed PIN result to the screen waiting for it, or sends the
+ * whole PIN as one PROTO_CMD_VERIFY_PASSWORD if a digit went missing.
+ */
+static void FinishPin(void)
+{
+    Link_Callback on_done = pin_on_done;
+
+    if(on_done == 0)
+    {
+        return;                     /* still typing, or abandoned */
+    }
+
+    if(pin_verdict != PIN_NO_VERDICT)
+    {
+        pin_on_done = 0;
+        on_done(pin_verdict, 0);
+    }
+    else if(pin_fallback)
+    {
+        pin_on_done = 0;
+        link_request = SubmitPin(PROTO_CMD_VERIFY_PASSWORD, (const uint8_t *)password,
+                                 PASSWORD_LENGTH, on_done);
+        if(link_request == LINK_NO_HANDLE)
+        {
+            on_done(LINK_STATUS_TIMEOUT, 0);
+        }
+    }
+}
+
+/*
+ * SendNextPinDigit
+ * Submits the next digit of password[] not yet sent, unless a digit is
+ * still waiting for its reply: one at a time, so a PIN never takes more
+ * than one Link slot and its digits reach Control_ECU in order.
+ */
+static void SendNextPinDigit(void)
+{
+    uint8_t payload[3 + PINAUTH_TAG_SIZE];
+    uint8_t length;
+
+    if(pin_digit_busy || pin_fallback || pin_sent >= password_index)
+    {
+        return;
+    }
+
+    payload[0] = pin_session;
+    payload[1] = pin_sent;
+    payload[2] = (uint8_t)password[pin_sent];
+    length = PinAuth_Seal(pin_challenge, PROTO_CMD_PIN_DIGIT, payload, 3);
+    if(Link_Submit(PROTO_CMD_PIN_DIGIT, payload, length, LINK_TIMEOUT_MS, LINK_RETRIES,
+                   OnPinDigit) == LINK_NO_HANDLE)
+    {
+        pin_fallback = 1;
+        return;
+    }
+    pin_sent++;
+    pin_digit_busy = 1;
+    pin_digit_session = pin_session;
+}
+
+/*
+ * SendPinDigit
+ * Streams the digit just typed into password[] to Control_ECU, which
+ * checks it against the stored password straight away (see
+ * PROTO_CMD_PIN_DIGIT). The first digit opens a new session, sealed
+ * throughout with the challenge current at that digit. A digit typed
+ * while the previous one is in flight goes out from OnPinDigit.
+ */
+void SendPinDigit(void)
+{
+    if(password_index == 1)
+    {
+        pin_session++;
+        pin_verdict = PIN_NO_VERDICT;
+        pin_fallback = 0;
+        pin_sent = 0;
+        memcpy(pin_challenge, challenge, PINAUTH_CHALLENGE_SIZE);
+    }
+    SendNextPinDigit();
+}
+
+void OnPinDigit(uint8_t status, const PROTO_Frame *reply)
+{
+    pin_digit_busy = 0;
+    TakeChallenge(status, reply);
+    if(pin_digit_session != pin_session)
+    {
+        SendNextPinDigit();         /* from an earlier entry */
+        return;
+    }
+    if(reply == 0 || reply->length < 3 || status == PROTO_STATUS_STALE)
+    {
+        pin_fallback = 1;           /* timed out or refused */
+    }
+    else if(reply->payload[2] == 0)
+    {
+        pin_verdict = status;
+        pin_user = PROTO_USER_MASTER;
+        pin_lockout = 0;
+        if(reply->length >= 5 && status == PROTO_STATUS_LOCKED)
+        {
+            pin_lockout = (uint16_t)(((uint16_t)reply->payload[3] << 8) | reply->payload[4]);
+        }
+        else if(reply->length >= 5)
+        {
+            pin_user = (uint16_t)(((uint16_t)reply->payload[3] << 8) | reply->payload[4]);
+        }
+    }
+    SendNextPinDigit();
+    FinishPin();
+}
+
+/*
+ * PinIsMaster
+ * Whether the PIN just verified is the master password rather than an
+ * enrolled user's (see PROTO_USER_MASTER): from the VERIFY_PASSWORD
+ * reply if there is one, else from the streamed verdict.
+ */
+static uint8_t PinIsMaster(const PROTO_Frame *reply)
+{
+    if(reply == 0)
+    {
+        return pin_user == PROTO_USER_MASTER;
+    }
+    return reply->length < 3 ||
+           (uint16_t)(((uint16_t)reply->payload[1] << 8) | reply->payload[2]) == PROTO_USER_MASTER;
+}
+
+/*
+ * VerifyPin
+ * Last digit typed: waits for the verdict of the digit stream, which is
+ * usually already in by the time the next screen is drawn.
+ */
+void VerifyPin(Link_Callback on_done)
+{
+    ShowWaiting("Checking...", 1);
+    pin_on_done = on_done;
+    FinishPin();
+}
+
+/*
+ * UpdateBusy
+ * Progress dots on the second line while a request is in flight.
+ */
+void UpdateBusy(void)
+{
+    if((int32_t)(SysTick_GetMs() - busy_next_update) < 0)
+    {
+        return;
+    }
+    busy_next_update += BUSY_ANIMATION_MS;
+    busy_dots = (busy_dots + 1) % 4;
+
+    LCD_SetCursor(1, 0);
+    LCD_WriteString(&"...   "[3 - busy_dots]);
+
+    /* What Control_ECU is doing, from the telemetry stream */
+    LCD_SetCursor(1, 4);
+    if(telemetry[PROTO_TLM_FLAGS] & PROTO_TLM_EEPROM_BUSY)
+    {
+        LCD_WriteString("EEPROM busy ");
+    }
+    else if(telemetry[PROTO_TLM_MOTOR] != PROTO_MOTOR_STOPPED)
+    {
+        LCD_WriteString("door moving ");
+    }
+    else
+    {
+        LCD_WriteString("            ");
+    }
+}
+
+/*
+ * IgnoreReply
+ * Callback for requests whose outcome does not change the screen.
+ */
+void IgnoreReply(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)status;
+    (void)reply;
+}
+
+/*
+ * ShowNoResponse
+ * Control_ECU did not answer any attempt - back to the main menu.
+ */
+void ShowNoResponse(void)
+{
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("No Response!");
+    DelayMs(1500);
+
+    ClearPasswordBuffer();
+    current_state = STATE_MAIN_MENU;
+    DisplayMainMenu();
+}
+
+/*
+ * WrongPassword
+ * A PIN was refused. Control_ECU counts the failures and sounds the alarm
+ * itself; its PROTO_STATUS_LOCKED (with the seconds left, in the reply or
+ * the streamed verdict) sends the UI to the lockout screen.
+ */
+void WrongPassword(uint8_t status, const PROTO_Frame *reply)
+{
+    uint16_t seconds = pin_lockout;
+
+    ClearPasswordBuffer();
+    if(status == PROTO_STATUS_LOCKED)
+    {
+        if(reply != 0 && reply->length >= 3)
+        {
+            seconds = (uint16_t)(((uint16_t)reply->payload[1] << 8) | reply->payload[2]);
+        }
+        Lockout_Start(seconds);
+        return;
+    }
+
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("Wrong Password!");
+    StatusLED_Blink(3);
+    DelayMs(1500);
+
+    current_state = STATE_MAIN_MENU;
+    DisplayMainMenu();
+}
+
+/*
+ * Lockout_Start
+ * Control_ECU refuses PIN checks for the next seconds. The UI waits in
+ * STATE_LOCKOUT with a countdown, kept in step by the telemetry stream,
+ * and takes no keys; the main loop keeps running meanwhile.
+ */
+void Lockout_Start(uint16_t seconds)
+{
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("System Locked");
+
+    lockout_end = SysTick_GetMs() + (uint32_t)seconds * 1000U;
+    lockout_shown = 0;
+    current_state = STATE_LOCKOUT;
+    Lockout_Update();
+}
+
+/*
+ * Lockout_Update
+ * Counts the lockout screen down; back to the main menu when it is over.
+ */
+void Lockout_Update(void)
+{
+    int32_t left = (int32_t)(lockout_end - SysTick_GetMs());
+    uint16_t seconds;
+    char buffer[17];
+
+    if(left <= 0)
+    {
+        current_state = STATE_MAIN_MENU;
+        DisplayMainMenu();
+        return;
+    }
+
+    seconds = (uint16_t)((left + 999) / 1000);
+    if(seconds != lockout_shown)
+    {
+        lockout_shown = seconds;
+        snprintf(buffer, sizeof(buffer), "Wait %u sec", (unsigned)seconds);
+        LCD_SetCursor(1, 0);
+        LCD_WriteString("                ");
+        LCD_SetCursor(1, 0);
+        LCD_WriteString(buffer);
+    }
+}
+
+void OnSetupPasswordStored(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    link_request = LINK_NO_HANDLE;
+
+    if(status == PROTO_STATUS_OK)
+    {
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("Password Saved!");
+        StatusLED_Blink(2);
+        DelayMs(1500);
+
+        // Go to main menu
+        current_state = STATE_MAIN_MENU;
+        DisplayMainMenu();
+    }
+    else
+    {
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("Save Failed!");
+        DelayMs(1500);
+        ClearPasswordBuffer();
+        current_state = STATE_SETUP_PASSWORD;
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("Enter Password:");
+        LCD_SetCursor(1, 0);
+    }
+}
+
+void OnOpenDoorVerified(uint8_t status, const PROTO_Frame *reply)
+{
+    link_request = LINK_NO_HANDLE;
+
+    if(status == PROTO_STATUS_OK)
+    {
+        ClearPasswordBuffer();
+        /* Reply comes once the door is unlocked - not cancellable */
+        StartRequest("Unlocking...", PROTO_CMD_OPEN_DOOR, 0, 0,
+                     LINK_DOOR_MOVE_MS, 0, OnDoorUnlocked);
+    }
+    else if(status == LINK_STATUS_TIMEOUT)
+    {
+        ShowNoResponse();
+    }
+    else
+    {
+        WrongPassword(status, reply);
+    }
+}
+
+/*
+ * OnDoorUnlocked
+ * Control_ECU now owns the door cycle; the HMI follows it from the
+ * telemetry stream until the DOOR_LOCKED event arrives (see OnLinkEvent).
+ */
+void OnDoorUnlocked(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    link_request = LINK_NO_HANDLE;
+
+    if(status != PROTO_STATUS_OK)
+    {
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString(status == LINK_STATUS_TIMEOUT ? "No Response!" : "Door Busy!");
+        DelayMs(1500);
+        current_state = STATE_MAIN_MENU;
+        DisplayMainMenu();
+        return;
+    }
+
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("Door Unlocked!");
+
+    door_deadline = SysTick_GetMs() + (uint32_t)auto_lock_timeout * 1000U +
+                    LINK_DOOR_MOVE_MS + 2000U;
+    current_state = STATE_DOOR_UNLOCKED;
+    Door_Show();
+}
+
+/*
+ * Door_Update
+ * Ends the door view on door_deadline if the DOOR_LOCKED event is lost.
+ */
+void Door_Update(void)
+{
+    if((int32_t)(SysTick_GetMs() - door_deadline) >= 0)
+    {
+        Door_Locked();
+    }
+}
+
+/*
+ * Door_Show
+ * Second line of the door view, from the latest telemetry record. Every
+ * record also pushes door_deadline out past the rest of the cycle.
+ */
+void Door_Show(void)
+{
+    char buffer[17];
+
+    if(telemetry[PROTO_TLM_DOOR] == PROTO_DOOR_OPEN)
+    {
+        snprintf(buffer, sizeof(buffer), "Lock in %d sec", telemetry[PROTO_TLM_SECONDS]);
+        door_deadline = SysTick_GetMs() + (uint32_t)telemetry[PROTO_TLM_SECONDS] * 1000U +
+                        LINK_DOOR_MOVE_MS + 2000U;
+    }
+    else if(telemetry[PROTO_TLM_DOOR] == PROTO_DOOR_HOLD ||
+            telemetry[PROTO_TLM_DOOR] == PROTO_DOOR_LOCKING)
+    {
+        strcpy(buffer, "Locking...");
+        door_deadline = SysTick_GetMs() + LINK_DOOR_MOVE_MS + 2000U;
+    }
+    else
+    {
+        return;
+    }
+
+    LCD_SetCursor(1, 0);
+    LCD_WriteString("                ");
+    LCD_SetCursor(1, 0);
+    LCD_WriteString(buffer);
+}
+
+/*
+ * Door_Locked
+ * End of the door cycle - back to the main menu.
+ */
+void Door_Locked(void)
+{
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("Door locked!");
+    DelayMs(1500);
+
+    current_state = STATE_MAIN_MENU;
+    DisplayMainMenu();
+}
+
+/*
+ * OnLinkEvent
+ * Unsolicited frames from Control_ECU.
+ */
+void OnLinkEvent(const PROTO_Frame *event)
+{
+    if(event->type == PROTO_EVT_DOOR_LOCKED && current_state == STATE_DOOR_UNLOCKED)
+    {
+        Door_Locked();
+    }
+    else if(event->type == PROTO_EVT_CHALLENGE && event->length == PINAUTH_CHALLENGE_SIZE)
+    {
+        memcpy(challenge, event->payload, PINAUTH_CHALLENGE_SIZE);
+    }
+    else if(event->type == PROTO_EVT_TELEMETRY && event->length == PROTO_TLM_SIZE)
+    {
+        memcpy(telemetry, event->payload, PROTO_TLM_SIZE);
+        if(current_state == STATE_DOOR_UNLOCKED)
+        {
+            Door_Show();
+        }
+        else if(current_state == STATE_LOCKOUT)
+        {
+            /* Control_ECU's count is the one that matters */
+            lockout_end = SysTick_GetMs() +
+                          ((uint32_t)telemetry[PROTO_TLM_LOCKOUT] << 8 | telemetry[PROTO_TLM_LOCKOUT + 1]) * 1000U;
+            Lockout_Update();
+        }
+    }
+}
+
+/*
+ * OnSubscribed
+ * The subscribe reply carries the current telemetry record.
+ */
+void OnSubscribed(uint8_t status, const PROTO_Frame *reply)
+{
+    if(status == PROTO_STATUS_OK && reply->length == 1 + PROTO_TLM_SIZE)
+    {
+        memcpy(telemetry, &reply->payload[1], PROTO_TLM_SIZE);
+    }
+}
+
+void OnChangeOldVerified(uint8_t status, const PROTO_Frame *reply)
+{
+    link_request = LINK_NO_HANDLE;
+    if(status == PROTO_STATUS_OK && !PinIsMaster(reply))
+    {
+        status = PROTO_STATUS_WRONG_PASSWORD;   /* settings take the master password */
+    }
+
+    if(status == PROTO_STATUS_OK)
+    {
+        /* Password correct - move to new password */
+        ClearPasswordBuffer();
+        current_state = STATE_CHANGE_NEW_PASSWORD;
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("New Password:");
+        LCD_SetCursor(1, 0);
+    }
+    else if(status == LINK_STATUS_TIMEOUT)
+    {
+        ShowNoResponse();
+    }
+    else
+    {
+        WrongPassword(status, reply);
+    }
+}
+
+void OnPasswordChanged(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    link_request = LINK_NO_HANDLE;
+
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    if(status == PROTO_STATUS_OK)
+    {
+        LCD_WriteString("Password Changed");
+        StatusLED_Blink(2);
+    }
+    else
+    {
+        LCD_WriteString("Save Failed!");
+    }
+    DelayMs(1500);
+
+    ClearPasswordBuffer();
+    current_state = STATE_MAIN_MENU;
+    DisplayMainMenu();
+}
+
+void OnTimeoutVerified(uint8_t status, const PROTO_Frame *reply)
+{
+    link_request = LINK_NO_HANDLE;
+    if(status == PROTO_STATUS_OK && !PinIsMaster(reply))
+    {
+        status = PROTO_STATUS_WRONG_PASSWORD;   /* settings take the master password */
+    }
+
+    if(status == PROTO_STATUS_OK)
+    {
+        /* Correct password - save timeout */
+        StartRequest("Saving...", PROTO_CMD_STORE_TIMEOUT, &pending_timeout, 1,
+                     LINK_TIMEOUT_MS, 0, OnTimeoutStored);
+    }
+    else if(status == LINK_STATUS_TIMEOUT)
+    {
+        ShowNoResponse();
+    }
+    else
+    {
+        WrongPassword(status, reply);
+    }
+}
+
+void OnTimeoutStored(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    link_request = LINK_NO_HANDLE;
 
+    if(status == PROTO_STATUS_OK)
+    {
+        auto_lock_timeout = pending_timeout;
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("Timeout Saved!");
+        StatusLED_Blink(2);
+        DelayMs(1500);
+    }
 
+    ClearPasswordBuffer();
+    current_state = STATE_MAIN_MENU;
+    DisplayMainMenu();
 }
 
+void OnFactoryReset(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    link_request = LINK_NO_HANDLE;
+
+    if(status == PROTO_STATUS_OK)
+    {
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("EEPROM Erased!");
+        LCD_SetCursor(1, 0);
+        LCD_WriteString("Restarting...");
+        DelayMs(2000);
+
+        /* Software reset by jumping to reset vector */
+        NVIC_APINT_R = 0x05FA0004;
+    }
+    else
+    {
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_WriteString("Erase Failed!");
+        DelayMs(2000);
+        current_state = STATE_MAIN_MENU;
+        DisplayMainMenu();
+    }
+}
 
 /*
  * ReadPotentiometerTimeout
@@ -242,14 +966,32 @@ uint8_t ReadPotentiometerTimeout(void)
     return timeout;
 }
 
+/*
+ * ReadLinkSeed
+ * Seed of the sealed link's nonces (Link_Secure): the cycle count since
+ * power-up, which depends on when Control_ECU first answered, mixed with
+ * the low bits of a few potentiometer samples and the time they took.
+ */
+uint32_t ReadLinkSeed(void)
+{
+    uint32_t seed = GPTM_Timer1A_Read();
+    uint8_t i;
+
+    for(i = 0; i < 16; i++)
+    {
+        seed = ((seed << 3) | (seed >> 29)) ^ POT_ReadRaw();
+    }
+    return seed ^ GPTM_Timer1A_Read();
+}
+
 /*
  * DisplayTimeoutValue
  * Displays the timeout value on LCD.
  */
 void DisplayTimeoutValue(uint8_t timeout_val)
 {
-    char buffer[16];
-    sprintf(buffer, "Timeout: %d sec", timeout_val);
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "Timeout: %u sec", (unsigned)timeout_val);
     LCD_SetCursor(1, 0);
     LCD_WriteString("                ");  /* Clear line */
     LCD_SetCursor(1, 0);
@@ -257,13 +999,9 @@ void DisplayTimeoutValue(uint8_t timeout_val)
 }
 void ProcessKey(char key)
 {
-  static uint8_t numberOfAttempts = 0;
-  static uint8_t numberOfAttemptsch = 0;
-
     switch(current_state)
     {
         case STATE_SETUP_PASSWORD:
-          UART5_SendChar('A');
           //StatusLED_On();
             /* Initial password setup */
             if(key >= '0' && key <= '9')
@@ -312,7 +1050,6 @@ void ProcessKey(char key)
                     temp_password[password_index] = key;
                     password_index++;
                     LCD_WriteChar('*');
-                    UART5_SendChar(key);
                     
                     if(password_index == PASSWORD_LENGTH)
                     {
@@ -323,52 +1060,10 @@ void ProcessKey(char key)
                         /* Verify passwords match */
                         if(VerifyPassword(password, temp_password))
                         {
-                          //UART0_SendChar('\n'); // \n
-                          
-                          //char received = UART0_ReceiveChar();
-                          UART5_SendChar('H');
-                          UART5_SendString(password);
-                          DelayMs(20);
-                          char received;
-                           while(1)
-                             {
-                          if(UART5_IsDataAvailable()){
-                              received = UART5_ReceiveChar();
-                                             break;
-                              
-                                }
-                            }
-                           
-                          
                             // Save to EEPROM 
-                            if(received == '1')
-                            {
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Password Saved!");
-                                StatusLED_Blink(2);
-                                DelayMs(1500);
-                                
-                                // Go to main menu
-                                current_state = STATE_MAIN_MENU;
-                                DisplayMainMenu();
-                            }
-                            
-                            else if (received == '0')
-                            {
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Save Failed!");
-                                DelayMs(1500);
-                                ClearPasswordBuffer();
-                                current_state = STATE_SETUP_PASSWORD;
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Enter Password:");
-                                LCD_SetCursor(1, 0);
-                            }
-                                
-                          
+                            StartPinRequest("Saving...", PROTO_CMD_STORE_PASSWORD,
+                                            (const uint8_t *)password, PASSWORD_LENGTH,
+                                            0, OnSetupPasswordStored);
                         }
                         
                         else 
@@ -382,7 +1077,6 @@ void ProcessKey(char key)
                             DelayMs(1500);
                             
                             ClearPasswordBuffer();
-                            UART5_SendChar('#'); // to clear password buffer from the Controller 
                             current_state = STATE_SETUP_PASSWORD;
                             LCD_Clear();
                             LCD_SetCursor(0, 0);
@@ -394,8 +1088,6 @@ void ProcessKey(char key)
             }
             else if(key == '#')  /* Cancel */
             {
-                UART5_SendChar('#');
-                DelayMs(300);
                 ClearPasswordBuffer();
                 current_state = STATE_SETUP_PASSWORD;
                 LCD_Clear();
@@ -452,38 +1144,8 @@ void ProcessKey(char key)
                 
                 if(confirm == '#')
                 {
-                    LCD_Clear();
-                    LCD_SetCursor(0, 0);
-                    LCD_WriteString("Erasing...");
-                    
-                    UART5_SendChar('J');
-                    char EEPROM_MassErase_receive;
-                    while(1){
-                      if(UART5_IsDataAvailable()){
-                         EEPROM_MassErase_receive = UART5_ReceiveChar();
-                        break;
-                      }
-                    }
-                    if(EEPROM_MassErase_receive == '1')
-                    {
-                        LCD_Clear();
-                        LCD_SetCursor(0, 0);
-                        LCD_WriteString("EEPROM Erased!");
-                        LCD_SetCursor(1, 0);
-                        LCD_WriteString("Restarting...");
-                        DelayMs(2000);
-                        
-                        /* Software reset by jumping to reset vector */
-                        NVIC_APINT_R = 0x05FA0004;
-                    }
-                    else
-                    {
-                        LCD_Clear();
-                        LCD_SetCursor(0, 0);
-                        LCD_WriteString("Erase Failed!");
-                        DelayMs(2000);
-                        DisplayMainMenu();
-                    }
+                    StartRequest("Erasing...", PROTO_CMD_FACTORY_RESET, 0, 0,
+                                 LINK_ERASE_TIMEOUT_MS, 0, OnFactoryReset);
                 }
                 else
                 {
@@ -508,68 +1170,14 @@ void ProcessKey(char key)
                     password[password_index] = key;
                     password_index++;
                     LCD_WriteChar('*');
+                    SendPinDigit();
                     
                     if(password_index == PASSWORD_LENGTH)
                     {
                         password[PASSWORD_LENGTH] = '\0';
                         //DelayMs(300);
                         
-UART5_SendChar('E');
-
-/* wait ready */
-while(!UART5_IsDataAvailable());
-if(UART5_ReceiveChar() == '1')
-{
-    UART5_SendString(password);
-
-    while(!UART5_IsDataAvailable());
-    char result = UART5_ReceiveChar();
-
-    if(result == '2')
-    {
-        handleDoor_HMI();
-        ClearPasswordBuffer();
-        current_state = STATE_MAIN_MENU;
-        numberOfAttempts = 0;
-        DisplayMainMenu();
-    }
-    else
-    {
-                                /* Incorrect password */
-/* Incorrect password */
-LCD_Clear();
-LCD_SetCursor(0, 0);
-LCD_WriteString("Wrong Password!");
-
-numberOfAttempts ++;
-StatusLED_Blink(3);
-DelayMs(1500);
-
-ClearPasswordBuffer();
-
-if (numberOfAttempts  >= 3)
-{
-    LCD_Clear();
-    LCD_SetCursor(0, 0);
-    LCD_WriteString("Attempts Exceeded");
-    LCD_SetCursor(1, 0);
-    LCD_WriteString("System Locked");
-
-
-    numberOfAttempts  = 0;  
-    UART5_SendChar('G');    //Buzzer_Beep(3000);
-    DelayMs(3000);
-
-    current_state = STATE_MAIN_MENU; 
-    DisplayMainMenu();
-}
-else
-{
-    current_state = STATE_MAIN_MENU;
-    DisplayMainMenu();
-}
-                            }
-                        }
+                        VerifyPin(OnOpenDoorVerified);
                     }
                 }
             }
@@ -590,95 +1198,13 @@ else
         {
             password[password_index++] = key;
             LCD_WriteChar('*');
+            SendPinDigit();
 
             if(password_index == PASSWORD_LENGTH)
             {
                 password[PASSWORD_LENGTH] = '\0';
-                DelayMs(300);
-
-                  UART5_SendChar('E');
-                    char tmp_stored_password_Received2;
-                     while(1){
-                      if (UART5_IsDataAvailable()){
-                        tmp_stored_password_Received2 =  UART5_ReceiveChar();
-                         break;
-                         } 
-                       } 
-                
-                        if(tmp_stored_password_Received2 == '1')
-                        {
-                          UART5_SendString(password);
-                          DelayMs(200);
-                        while(1){
-                          if (UART5_IsDataAvailable()){
-                                tmp_stored_password_Received2 =  UART5_ReceiveChar();
-                                 break;
-                                } 
-                      } 
-                                   
-                   if(tmp_stored_password_Received2 == '2')
-                     {
-                    /* Password correct - move to new password */
-                    ClearPasswordBuffer();
-                    current_state = STATE_CHANGE_NEW_PASSWORD;
-                    LCD_Clear();
-                    LCD_SetCursor(0, 0);
-                    LCD_WriteString("New Password:");
-                    LCD_SetCursor(1, 0);
-                }
-                /*
-                else
-                {
-                    // Wrong password 
-                    LCD_Clear();
-                    LCD_SetCursor(0, 0);
-                    LCD_WriteString("Wrong Password!");
-                    StatusLED_Blink(3);
-                    DelayMs(1500);
-                    ClearPasswordBuffer();
-                    current_state = STATE_CHANGE_OLD_PASSWORD;
-                    DisplayMainMenu();
-                }
-*/
-                
-                ///
-    else
-    {
-                                /* Incorrect password */
-/* Incorrect password */
-LCD_Clear();
-LCD_SetCursor(0, 0);
-LCD_WriteString("Wrong Password!");
-
-numberOfAttemptsch ++;
-StatusLED_Blink(3);
-DelayMs(1500);
-
-ClearPasswordBuffer();
 
-if (numberOfAttemptsch  >= 3)
-{
-    LCD_Clear();
-    LCD_SetCursor(0, 0);
-    LCD_WriteString("Attempts Exceeded");
-    LCD_SetCursor(1, 0);
-    LCD_WriteString("System Locked");
-
-
-    numberOfAttemptsch  = 0;  
-    UART5_SendChar('G');    //Buzzer_Beep(3000);
-        DelayMs(3000);
-
-    current_state = STATE_MAIN_MENU; 
-    DisplayMainMenu();
-}
-else
-{
-    current_state = STATE_MAIN_MENU;
-    DisplayMainMenu();
-}
-    }
-                ///
+                VerifyPin(OnChangeOldVerified);
             }
         }
     }
@@ -748,44 +1274,9 @@ else
                         if(VerifyPassword(password, temp_password))
                         {
                             /* Save to EEPROM */
-                          char store_new_pass_received ;
-                            UART5_SendChar('H');
-                            
-                           // while(1){
-                             // if(UART0_IsDataAvailable()){
-                               UART5_SendString(password);
-                               DelayMs(200);
-                              // break;
-                              //}
-                            //}
-                            
-                            while(1){
-                              if(UART5_IsDataAvailable()){
-                               store_new_pass_received = UART5_ReceiveChar();
-                               break;
-                              }
-                            }
-                            if(store_new_pass_received == '1')
-                            {
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Password Changed");
-                                StatusLED_Blink(2);
-                                DelayMs(1500);
-                                
-                                ClearPasswordBuffer();
-                                current_state = STATE_MAIN_MENU;
-                                DisplayMainMenu();
-                            }
-                            else
-                            {
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Save Failed!");
-                                DelayMs(1500);
-                                current_state = STATE_MAIN_MENU;
-                                DisplayMainMenu();
-                            }
+                            StartPinRequest("Saving...", PROTO_CMD_STORE_PASSWORD,
+                                            (const uint8_t *)password, PASSWORD_LENGTH,
+                                            0, OnPasswordChanged);
                         }
                         else
                         {
@@ -840,61 +1331,13 @@ else
                     password[password_index] = key;
                     password_index++;
                     LCD_WriteChar('*');
+                    SendPinDigit();
                     
             if(password_index == PASSWORD_LENGTH)
             {
                 password[PASSWORD_LENGTH] = '\0';
 
-UART5_SendChar('E');
-
-while(!UART5_IsDataAvailable());
-if(UART5_ReceiveChar() == '1')
-{
-    for(uint8_t i = 0; i < PASSWORD_LENGTH; i++)
-    {
-        UART5_SendChar(password[i]);
-    }
-
-    while(!UART5_IsDataAvailable());
-    char result = UART5_ReceiveChar();
-
-    if(result == '2')
-    {
-                                /* Correct password - save timeout */
-                                auto_lock_timeout = pending_timeout;
-UART5_SendChar('I');         
-UART5_SendUInt(auto_lock_timeout);  
-
-while(!UART5_IsDataAvailable());   
-char StoreTimeoutReceived = UART5_ReceiveChar();
-                                
-                                if(StoreTimeoutReceived == '1')
-                                {
-                                    LCD_Clear();
-                                    LCD_SetCursor(0, 0);
-                                    LCD_WriteString("Timeout Saved!");
-                                    StatusLED_Blink(2);
-                                    DelayMs(1500);
-                                }
-                                
-                                ClearPasswordBuffer();
-                                current_state = STATE_MAIN_MENU;
-                                DisplayMainMenu();
-                            }
-                            else
-                            {
-                                /* Incorrect password */
-                                LCD_Clear();
-                                LCD_SetCursor(0, 0);
-                                LCD_WriteString("Wrong Password!");
-                                StatusLED_Blink(3);
-                                DelayMs(1500);
-                                
-                                ClearPasswordBuffer();
-                                current_state = STATE_MAIN_MENU;
-                                DisplayMainMenu();
-                            }
-                        }
+                VerifyPin(OnTimeoutVerified);
                     }
                 }
             }
@@ -906,11 +1349,33 @@ char StoreTimeoutReceived = UART5_ReceiveChar();
             }
             break;
             
+        case STATE_WAIT_REPLY:
+            if(key == '#' && request_cancellable)  /* Abandon the request */
+            {
+                Link_Cancel(link_request);
+                link_request = LINK_NO_HANDLE;
+                ClearPasswordBuffer();
+                LCD_Clear();
+                LCD_SetCursor(0, 0);
+                LCD_WriteString("Cancelled");
+                DelayMs(1000);
+                current_state = STATE_MAIN_MENU;
+                DisplayMainMenu();
+            }
+            break;
+
+        case STATE_DOOR_UNLOCKED:
+            if(key == '#' && telemetry[PROTO_TLM_DOOR] == PROTO_DOOR_OPEN)  /* Lock now */
+            {
+                Link_Submit(PROTO_CMD_LOCK_NOW, 0, 0, LINK_TIMEOUT_MS, LINK_RETRIES,
+                            IgnoreReply);
+            }
+            break;
+
         default:
             break;            
             
             
-    }
     }
 }
 
@@ -924,10 +1389,17 @@ int main(void)
 {
     char key;
     uint8_t password_exists = 0;
+    uint16_t lockout;
+    uint8_t handle;
+    uint8_t result;
+    uint32_t next_scan;
+    const uint8_t subscribe = 1;
     //UART0_SendChar
     /* Initialize system */
     System_Init();
-    UART5_Init();
+    UART5_InitMode(UART5_MODE_INTERRUPT);
+    PinAuth_Init();
+    Link_Init(OnLinkEvent);
     /* Display initialization message */
     LCD_SetCursor(0, 0);
     LCD_WriteString("Smart Door Lock");
@@ -935,18 +1407,27 @@ int main(void)
     LCD_WriteString("Initializing...");
      StatusLED_On();
 
-      /* Initialize EEPROM */
-     
-     UART5_SendChar('B');
-     char EEPROM_SUCCESS_Received;
-       while(1){
-     if (UART5_IsDataAvailable()){
-       EEPROM_SUCCESS_Received =  UART5_ReceiveChar();
-       break;
-     } 
-       }
-     //printf(EEPROM_SUCCESS_Received);
-     if(EEPROM_SUCCESS_Received == '0'){
+     /* Open the sealed link first (nothing to do in a plain build).
+      * Retry until Control_ECU is up and answering. */
+     while(!Link_Secure(ReadLinkSeed()))
+     {
+     }
+
+     /* One round trip for EEPROM health, password, timeout, lockout and
+      * the PIN challenge.
+      * Retry until Control_ECU is up and answering. */
+     PROTO_Frame snapshot;
+     do
+     {
+         handle = Link_Submit(PROTO_CMD_BOOT_SNAPSHOT, 0, 0, LINK_TIMEOUT_MS, 0, 0);
+         do
+         {
+             Link_Task();
+             result = Link_Check(handle, &snapshot);
+         } while(result == LINK_PENDING);
+     } while(result != LINK_DONE || snapshot.length != PROTO_SNAP_SIZE + 1);
+
+     if(snapshot.payload[1 + PROTO_SNAP_EEPROM] != PROTO_STATUS_OK){
         LCD_Clear();
         LCD_SetCursor(0, 0);
         LCD_WriteString("EEPROM Error!");
@@ -955,51 +1436,42 @@ int main(void)
             StatusLED_Blink(1);
         }
      }
-     
-    
-    DelayMs(1000);
-    
-     UART5_SendChar('C');
-     char RetrievePassword_Received;
-       while(1){
-     if (UART5_IsDataAvailable()){
-       RetrievePassword_Received =  UART5_ReceiveChar();
-       break;
-     } 
-       }
-      
-        /* Check if EEPROM is in erased state (all 0xFF) or uninitialized (all 0x00) */
-        if(RetrievePassword_Received == '1')
-        {
-            LCD_Clear();
-            LCD_SetCursor(0, 0);
-            LCD_WriteString("EEPROM Empty");
-            DelayMs(1000);
-        }
-        /* Check if valid password exists (ASCII digits '0'-'9') */
-        else if(RetrievePassword_Received == '2')
-        {
-            password_exists = 1;
-        }
-    
-    
-       
-       
-      UART5_SendChar('D');
-     char RetrieveTimeout_Received;
-       while(1){
-     if (UART5_IsDataAvailable()){
-       RetrieveTimeout_Received =  UART5_ReceiveChar();
-       break;
-     } 
-       }
-       
-    /* Retrieve timeout (use default if not found) */
-    if(RetrieveTimeout_Received == '1')
+     memcpy(challenge, &snapshot.payload[1 + PROTO_SNAP_CHALLENGE], PINAUTH_CHALLENGE_SIZE);
+
+    /* Runs on from Link_Task; requests wait until the rate is settled */
+    Link_Negotiate(link_rates, sizeof(link_rates) / sizeof(link_rates[0]));
+
+#ifdef LINK_BENCH
+    while(Link_Negotiating())
+    {
+        Link_Task();
+    }
+    link_baud = UART5_GetBaudRate();
+    /* Benchmark build: measure the link instead of running the UI.
+     * Leaves Control_ECU factory reset (see bench.h). */
+    LCD_Clear();
+    LCD_SetCursor(0, 0);
+    LCD_WriteString("Link benchmark");
+    LCD_SetCursor(1, 0);
+    LCD_WriteString(Bench_Run() == 0 ? "Done" : "Done, failures");
+    return 0;
+#endif
+
+    /* Door and actuator state are pushed from now on (PROTO_EVT_TELEMETRY) */
+    Link_Submit(PROTO_CMD_SUBSCRIBE, &subscribe, 1, LINK_TIMEOUT_MS, LINK_RETRIES, OnSubscribed);
+
+    password_exists = snapshot.payload[1 + PROTO_SNAP_PASSWORD];
+    auto_lock_timeout = snapshot.payload[1 + PROTO_SNAP_TIMEOUT];
+    if(auto_lock_timeout < MIN_TIMEOUT || auto_lock_timeout > MAX_TIMEOUT)
     {
         auto_lock_timeout = 10;  /* Default */
     }
+
+    /* Control_ECU may still be serving a lockout from before the reset */
+    lockout = (uint16_t)(((uint16_t)snapshot.payload[1 + PROTO_SNAP_LOCKOUT] << 8) |
+                         snapshot.payload[2 + PROTO_SNAP_LOCKOUT]);
     
+
     StatusLED_Off();
     
     /* Check if password setup is needed */
@@ -1024,17 +1496,47 @@ int main(void)
         LCD_Clear();
         LCD_SetCursor(0, 0);
         LCD_WriteString("Welcome!");
-        DelayMs(1000);
+        DelayMs(WELCOME_SCREEN_MS);
         
-        current_state = STATE_MAIN_MENU;
-        DisplayMainMenu();
+        if(lockout != 0)
+        {
+            Lockout_Start(lockout);
+        }
+        else
+        {
+            current_state = STATE_MAIN_MENU;
+            DisplayMainMenu();
+        }
     }
+    boot_time_ms = SysTick_GetMs();
     
     
     
-    /* Main loop */
+    /* Main loop: the link is serviced on every pass, keys every 100 ms */
+    next_scan = SysTick_GetMs();
     while(1)
     {
+        Link_Task();
+        link_baud = UART5_GetBaudRate();
+
+        if(current_state == STATE_WAIT_REPLY)
+        {
+            UpdateBusy();
+        }
+        else if(current_state == STATE_DOOR_UNLOCKED)
+        {
+            Door_Update();
+        }
+        else if(current_state == STATE_LOCKOUT)
+        {
+            Lockout_Update();
+        }
+
+        if((int32_t)(SysTick_GetMs() - next_scan) < 0)
+        {
+            continue;
+        }
+
         key = Keypad_GetKey();
         //StatusLED_Off();
         if(key != 0)  /* Key pressed */
@@ -1056,12 +1558,11 @@ int main(void)
                 //auto_lock_timeout = pending_timeout;
                 DisplayTimeoutValue(pending_timeout);
             }
-            DelayMs(200);
+            next_scan = SysTick_GetMs() + 200;
         }
         else
         {
-            DelayMs(100);  /* Debounce delay */
+            next_scan = SysTick_GetMs() + 100;  /* Debounce delay */
         }
     }
 }
-//
\ No newline at end of file
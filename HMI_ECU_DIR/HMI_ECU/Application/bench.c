@@ -0,0 +1,688 @@
+/******************************************************************************
+ * File: bench.c
+ * Module: HMI Link
+ * Description: Round-trip latency and throughput benchmark of the
+ *              Control_ECU commands
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "link.h"
+#include "pinauth.h"
+#include "uart.h"
+#include "sysctl.h"
+#include "systick.h"
+#include "GPTM_TIMER1.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define BENCH_SAMPLES           50      /* quick commands */
+#define BENCH_TIMEOUT_MS        500
+#define BENCH_SLOW_TIMEOUT_MS   5000    /* full erase, unlock / lock move */
+#define BENCH_PASSWORD          "12345"
+#define BENCH_OTHER_PASSWORD    "54321"
+#define BENCH_AUTO_LOCK_S       5
+#define BENCH_USER_PIN_BASE     60000U  /* PIN of user n: BASE + n */
+
+/* Unit of the figures timed on GPTM Timer1A: system clock cycles on
+ * target. The host build times them on the host's clock instead
+ * (Host/Makefile), good only for comparing host runs with each other */
+#ifndef BENCH_TICKS
+#define BENCH_TICKS             "cycles"
+#endif
+
+/******************************************************************************
+ *                          Private Types                                      *
+ ******************************************************************************/
+
+/* One transaction; adds the bytes it put on the wire and returns its status */
+typedef uint8_t (*Bench_Transaction)(uint32_t *bytes);
+
+typedef struct
+{
+    const char        *name;
+    Bench_Transaction  run;
+    uint8_t            samples;
+} Bench_Case;
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static Bench_Result     results[BENCH_CASES];
+static uint32_t         samples[BENCH_MAX_SAMPLES];    /* round trips (us) */
+static uint32_t         ticks_per_us = 1;
+static volatile uint8_t door_locked = 0;
+static PROTO_Frame      last_reply;                     /* of the last Bench_Request */
+static volatile uint16_t audit_received = 0;            /* entries of the query streamed so far */
+static volatile uint32_t audit_bytes = 0;               /* their PROTO_EVT_AUDIT frames */
+static uint8_t          challenge[PINAUTH_CHALLENGE_SIZE];  /* Control_ECU's current one */
+static volatile uint32_t challenge_bytes = 0;           /* PROTO_EVT_CHALLENGE frames received */
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static void Bench_OnEvent(const PROTO_Frame *event)
+{
+    if(event->type == PROTO_EVT_DOOR_LOCKED)
+    {
+        door_locked = 1;
+    }
+    else if(event->type == PROTO_EVT_AUDIT && event->length >= 2 &&
+            (uint16_t)(((uint16_t)event->payload[0] << 8) | event->payload[1]) == audit_received)
+    {
+        audit_received += (uint16_t)((event->length - 2U) / PROTO_AUDIT_ENTRY_SIZE);
+        audit_bytes += PROTO_OVERHEAD + event->length;
+    }
+    else if(event->type == PROTO_EVT_CHALLENGE && event->length == PINAUTH_CHALLENGE_SIZE)
+    {
+        memcpy(challenge, event->payload, PINAUTH_CHALLENGE_SIZE);
+        challenge_bytes += PROTO_OVERHEAD + event->length;
+    }
+}
+
+/*
+ * Bench_Request
+ * Sends one request without retries and waits for its reply.
+ * Returns: the reply status, or LINK_STATUS_TIMEOUT
+ */
+static uint8_t Bench_Request(uint8_t type, const uint8_t *payload, uint8_t length,
+                             uint32_t timeout_ms, uint32_t *bytes)
+{
+    PROTO_Frame reply;
+    uint8_t handle;
+    uint8_t result;
+
+    handle = Link_Submit(type, payload, length, timeout_ms, 0, 0);
+    if(handle == LINK_NO_HANDLE)
+    {
+        return LINK_STATUS_TIMEOUT;
+    }
+
+    do
+    {
+        Link_Task();
+        result = Link_Check(handle, &reply);
+    } while(result == LINK_PENDING);
+
+    *bytes += PROTO_OVERHEAD + length;
+    if(result != LINK_DONE)
+    {
+        return LINK_STATUS_TIMEOUT;
+    }
+    *bytes += PROTO_OVERHEAD + reply.length;
+    last_reply = reply;
+    return reply.payload[0];
+}
+
+/*
+ * Bench_PinRequest
+ * Bench_Request of a request carrying PIN digits, sealed with the current
+ * challenge (pinauth.h) and sealed again once on PROTO_STATUS_STALE, as
+ * the UI does. The PROTO_EVT_CHALLENGE that follows counts as its bytes.
+ */
+static uint8_t Bench_PinRequest(uint8_t type, const uint8_t *payload, uint8_t length,
+                                uint32_t *bytes)
+{
+    uint8_t sealed[PROTO_MAX_PAYLOAD];
+    uint8_t status = PROTO_STATUS_STALE;
+    uint8_t attempt;
+
+    for(attempt = 0; attempt < 2 && status == PROTO_STATUS_STALE; attempt++)
+    {
+        memcpy(sealed, payload, length);
+        challenge_bytes = 0;
+        status = Bench_Request(type, sealed, PinAuth_Seal(challenge, type, sealed, length),
+                               BENCH_TIMEOUT_MS, bytes);
+        *bytes += challenge_bytes;
+        if(status == PROTO_STATUS_STALE && last_reply.length == 1 + PINAUTH_CHALLENGE_SIZE)
+        {
+            memcpy(challenge, &last_reply.payload[1], PINAUTH_CHALLENGE_SIZE);
+        }
+    }
+    return status;
+}
+
+static uint8_t Bench_Ping(uint32_t *bytes)
+{
+    return Bench_Request(PROTO_CMD_PING, 0, 0, BENCH_TIMEOUT_MS, bytes);
+}
+
+static uint8_t Bench_Verify(uint32_t *bytes)
+{
+    return Bench_PinRequest(PROTO_CMD_VERIFY_PASSWORD, (const uint8_t *)BENCH_PASSWORD,
+                            sizeof(BENCH_PASSWORD) - 1, bytes);
+}
+
+/* Alternates two passwords so every save changes the EEPROM; an even
+ * sample count leaves BENCH_PASSWORD stored */
+static uint8_t Bench_Store(uint32_t *bytes)
+{
+    static uint8_t other = 1;
+    const char *password = other ? BENCH_OTHER_PASSWORD : BENCH_PASSWORD;
+
+    other = !other;
+    return Bench_PinRequest(PROTO_CMD_STORE_PASSWORD, (const uint8_t *)password,
+                            sizeof(BENCH_PASSWORD) - 1, bytes);
+}
+
+/* Saves the password already stored: a no-op on Control_ECU */
+static uint8_t Bench_Resave(uint32_t *bytes)
+{
+    return Bench_PinRequest(PROTO_CMD_STORE_PASSWORD, (const uint8_t *)BENCH_PASSWORD,
+                            sizeof(BENCH_PASSWORD) - 1, bytes);
+}
+
+/* 5-digit PIN of user id */
+static void Bench_UserPin(uint16_t id, char *pin)
+{
+    uint32_t value = BENCH_USER_PIN_BASE + id;
+    uint8_t i;
+
+    for(i = 5; i > 0; i--)
+    {
+        pin[i - 1] = (char)('0' + value % 10U);
+        value /= 10U;
+    }
+}
+
+/* Enrolls users 1, 2, ... one per sample */
+static uint8_t Bench_Enroll(uint32_t *bytes)
+{
+    static uint16_t id = 0;
+    uint8_t payload[12];
+
+    id++;
+    memcpy(payload, BENCH_PASSWORD, 5);
+    payload[5] = (uint8_t)(id >> 8);
+    payload[6] = (uint8_t)(id & 0xFF);
+    Bench_UserPin(id, (char *)&payload[7]);
+    return Bench_PinRequest(PROTO_CMD_USER_ADD, payload, sizeof(payload), bytes);
+}
+
+/* Verifies the enrolled users' PINs in turn; the reply must name the user */
+static uint8_t Bench_UserVerify(uint32_t *bytes)
+{
+    static uint16_t id = 0;
+    char pin[5];
+    uint8_t status;
+
+    id = (uint16_t)(id % BENCH_SAMPLES + 1U);
+    Bench_UserPin(id, pin);
+    status = Bench_PinRequest(PROTO_CMD_VERIFY_PASSWORD, (const uint8_t *)pin, 5, bytes);
+    if(status == PROTO_STATUS_OK &&
+       (last_reply.length < 3 ||
+        (uint16_t)(((uint16_t)last_reply.payload[1] << 8) | last_reply.payload[2]) != id))
+    {
+        return PROTO_STATUS_FAIL;
+    }
+    return status;
+}
+
+static uint8_t Bench_Revoke(uint32_t *bytes)
+{
+    static uint16_t id = 0;
+    uint8_t payload[7];
+
+    id++;
+    memcpy(payload, BENCH_PASSWORD, 5);
+    payload[5] = (uint8_t)(id >> 8);
+    payload[6] = (uint8_t)(id & 0xFF);
+    return Bench_PinRequest(PROTO_CMD_USER_REVOKE, payload, sizeof(payload), bytes);
+}
+
+static uint8_t Bench_Timeout(uint32_t *bytes)
+{
+    const uint8_t timeout = BENCH_AUTO_LOCK_S;
+
+    return Bench_Request(PROTO_CMD_STORE_TIMEOUT, &timeout, 1, BENCH_TIMEOUT_MS, bytes);
+}
+
+/*
+ * Bench_Door
+ * Open, lock at once, and wait for the DOOR_LOCKED event.
+ */
+static uint8_t Bench_Door(uint32_t *bytes)
+{
+    uint8_t status;
+    uint32_t start;
+
+    door_locked = 0;
+    status = Bench_Request(PROTO_CMD_OPEN_DOOR, 0, 0, BENCH_SLOW_TIMEOUT_MS, bytes);
+    if(status != PROTO_STATUS_OK)
+    {
+        return status;
+    }
+    status = Bench_Request(PROTO_CMD_LOCK_NOW, 0, 0, BENCH_TIMEOUT_MS, bytes);
+    if(status != PROTO_STATUS_OK)
+    {
+        return status;
+    }
+
+    start = SysTick_GetMs();
+    while(!door_locked && (SysTick_GetMs() - start) < BENCH_SLOW_TIMEOUT_MS)
+    {
+        Link_Task();
+    }
+    if(!door_locked)
+    {
+        return LINK_STATUS_TIMEOUT;
+    }
+    *bytes += PROTO_OVERHEAD;                           /* the event frame */
+    return PROTO_STATUS_OK;
+}
+
+/*
+ * Bench_Audit
+ * Queries the whole access log and waits until every entry the reply
+ * announced has been streamed, in order.
+ */
+static uint8_t Bench_Audit(uint32_t *bytes)
+{
+    static const uint8_t range[8] = { 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF };
+    uint16_t expected;
+    uint8_t status;
+    uint32_t start;
+
+    audit_received = 0;
+    audit_bytes = 0;
+    status = Bench_Request(PROTO_CMD_AUDIT_QUERY, range, sizeof(range), BENCH_TIMEOUT_MS, bytes);
+    if(status != PROTO_STATUS_OK)
+    {
+        return status;
+    }
+    if(last_reply.length < 7)
+    {
+        return PROTO_STATUS_FAIL;
+    }
+    expected = (uint16_t)(((uint16_t)last_reply.payload[5] << 8) | last_reply.payload[6]);
+
+    start = SysTick_GetMs();
+    while(audit_received < expected && (SysTick_GetMs() - start) < BENCH_SLOW_TIMEOUT_MS)
+    {
+        Link_Task();
+    }
+    *bytes += audit_bytes;
+    if(expected == 0 || audit_received != expected)
+    {
+        return LINK_STATUS_TIMEOUT;
+    }
+    return PROTO_STATUS_OK;
+}
+
+/* A wrong PIN: counted until it locks Control_ECU out, refused after that */
+static uint8_t Bench_Reject(uint32_t *bytes)
+{
+    uint8_t status;
+
+    status = Bench_PinRequest(PROTO_CMD_VERIFY_PASSWORD, (const uint8_t *)BENCH_OTHER_PASSWORD,
+                              sizeof(BENCH_OTHER_PASSWORD) - 1, bytes);
+    if(status == PROTO_STATUS_WRONG_PASSWORD || status == PROTO_STATUS_LOCKED)
+    {
+        return PROTO_STATUS_OK;
+    }
+    return PROTO_STATUS_FAIL;
+}
+
+static uint8_t Bench_Erase(uint32_t *bytes)
+{
+    return Bench_Request(PROTO_CMD_FACTORY_RESET, 0, 0, BENCH_SLOW_TIMEOUT_MS, bytes);
+}
+
+static uint8_t Bench_Format(uint32_t *bytes)
+{
+    const uint8_t mode = PROTO_RESET_FULL;
+
+    return Bench_Request(PROTO_CMD_FACTORY_RESET, &mode, 1, BENCH_SLOW_TIMEOUT_MS, bytes);
+}
+
+static uint32_t Bench_GetU32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) |
+           ((uint32_t)in[2] << 8)  |  (uint32_t)in[3];
+}
+
+/*
+ * Bench_Scan
+ * Has Control_ECU time a full 2 KB EEPROM read word by word and in bursts
+ * (PROTO_CMD_EEPROM_SCAN) and prints the cost per word.
+ */
+static void Bench_Scan(void)
+{
+    const uint32_t words = BENCH_EEPROM_WORDS;
+    uint32_t bytes = 0;
+    uint32_t per_word_x100;
+    uint32_t burst_x100;
+
+    if(Bench_Request(PROTO_CMD_EEPROM_SCAN, 0, 0, BENCH_SLOW_TIMEOUT_MS, &bytes) != PROTO_STATUS_OK ||
+       last_reply.length < 9)
+    {
+        printf("EEPROM scan failed\n");
+        return;
+    }
+    per_word_x100 = (uint32_t)(((uint64_t)Bench_GetU32(&last_reply.payload[1]) * 100U) / words);
+    burst_x100 = (uint32_t)(((uint64_t)Bench_GetU32(&last_reply.payload[5]) * 100U) / words);
+    printf("EEPROM 2 KB scan (" BENCH_TICKS "/word): word by word %lu.%02lu, burst %lu.%02lu\n",
+           (unsigned long)(per_word_x100 / 100U), (unsigned long)(per_word_x100 % 100U),
+           (unsigned long)(burst_x100 / 100U), (unsigned long)(burst_x100 % 100U));
+}
+
+/* Cycles of the Control_ECU clock to us */
+static uint32_t Bench_CyclesToUs(uint32_t cycles, uint32_t clock_hz)
+{
+    return (uint32_t)(((uint64_t)cycles * 1000000ULL) / ((clock_hz > 0U) ? clock_hz : 1U));
+}
+
+/*
+ * Bench_HashScan
+ * Has Control_ECU time its PIN hash core and PIN sealing
+ * (PROTO_CMD_HASH_SCAN) and prints the cost of one SHA-256 block and of
+ * one PIN check; then the sealing cost of a PIN verify on each side:
+ * sealing it here, opening it and drawing the next challenge there.
+ */
+static void Bench_HashScan(void)
+{
+    uint8_t scratch[PINAUTH_CHALLENGE_SIZE] = {0};
+    uint8_t sealed[PROTO_MAX_PAYLOAD];
+    uint32_t bytes = 0;
+    uint32_t clock_hz;
+    uint32_t block_x100;
+    uint32_t check;
+    uint32_t seal_x100;
+    uint32_t open_x100;
+    uint32_t draw_x100;
+    uint32_t start;
+    uint16_t i;
+
+    if(Bench_Request(PROTO_CMD_HASH_SCAN, 0, 0, BENCH_SLOW_TIMEOUT_MS, &bytes) != PROTO_STATUS_OK ||
+       last_reply.length < 25)
+    {
+        printf("PIN hash scan failed\n");
+        return;
+    }
+    clock_hz = Bench_GetU32(&last_reply.payload[1]);
+    block_x100 = (uint32_t)(((uint64_t)Bench_GetU32(&last_reply.payload[9]) * 100U) / PROTO_HASH_SCAN_BLOCKS);
+    check = Bench_GetU32(&last_reply.payload[13]);
+    printf("PIN hash (" BENCH_TICKS "): SHA-256 block %lu.%02lu, check %lu = %lu us at %lu iterations\n",
+           (unsigned long)(block_x100 / 100U), (unsigned long)(block_x100 % 100U),
+           (unsigned long)check, (unsigned long)Bench_CyclesToUs(check, clock_hz),
+           (unsigned long)Bench_GetU32(&last_reply.payload[5]));
+
+    start = GPTM_Timer1A_Read();
+    for(i = 0; i < PROTO_HASH_SCAN_SEALS; i++)
+    {
+        memcpy(sealed, BENCH_PASSWORD, sizeof(BENCH_PASSWORD) - 1);
+        PinAuth_Seal(scratch, PROTO_CMD_VERIFY_PASSWORD, sealed, sizeof(BENCH_PASSWORD) - 1);
+    }
+    seal_x100 = (uint32_t)(((uint64_t)(GPTM_Timer1A_Read() - start) * 100U) / PROTO_HASH_SCAN_SEALS);
+    open_x100 = (uint32_t)(((uint64_t)Bench_GetU32(&last_reply.payload[17]) * 100U) / PROTO_HASH_SCAN_SEALS);
+    draw_x100 = (uint32_t)(((uint64_t)Bench_GetU32(&last_reply.payload[21]) * 100U) / PROTO_HASH_SCAN_SEALS);
+    printf("PIN seal per verify (" BENCH_TICKS "): HMI seal %lu.%02lu, Control open %lu.%02lu + challenge %lu.%02lu\n",
+           (unsigned long)(seal_x100 / 100U), (unsigned long)(seal_x100 % 100U),
+           (unsigned long)(open_x100 / 100U), (unsigned long)(open_x100 % 100U),
+           (unsigned long)(draw_x100 / 100U), (unsigned long)(draw_x100 % 100U));
+}
+
+#if PROTO_SECURE
+/*
+ * Bench_Seal
+ * Times the sealed link (seclink.h) here, on a scratch pair of sessions:
+ * sealing a frame with a full payload, then opening it, averaged over
+ * BENCH_SEALS frames; and what the seal adds to every frame on the wire
+ * at the current rate.
+ */
+static void Bench_Seal(void)
+{
+    static const uint8_t nonce[SECLINK_NONCE_SIZE] = {0};
+    const uint8_t header[SECLINK_HEADER_SIZE] =
+        { PROTO_CMD_PING | PROTO_SEAL_FLAG, 0, PROTO_MAX_PAYLOAD + SECLINK_OVERHEAD };
+    SecLink_Session sender;
+    SecLink_Session receiver;
+    uint8_t body[PROTO_MAX_PAYLOAD + SECLINK_OVERHEAD];
+    uint8_t confirm[SECLINK_TAG_SIZE];
+    uint8_t opened = 0;
+    uint32_t seal;
+    uint32_t both;
+    uint32_t seal_x100;
+    uint32_t open_x100;
+    uint32_t start;
+    uint16_t i;
+
+    SecLink_Start(&sender, SECLINK_HMI, nonce, nonce, confirm);
+    SecLink_Start(&receiver, SECLINK_CONTROL, nonce, nonce, confirm);
+    memset(body, 0x5A, sizeof(body));
+
+    start = GPTM_Timer1A_Read();
+    for(i = 0; i < BENCH_SEALS; i++)
+    {
+        SecLink_Seal(&sender, header, body, PROTO_MAX_PAYLOAD);
+    }
+    seal = GPTM_Timer1A_Read() - start;
+
+    start = GPTM_Timer1A_Read();
+    for(i = 0; i < BENCH_SEALS; i++)
+    {
+        SecLink_Seal(&sender, header, body, PROTO_MAX_PAYLOAD);
+        opened += SecLink_Open(&receiver, header, body, sizeof(body));
+    }
+    both = GPTM_Timer1A_Read() - start;
+
+    seal_x100 = (uint32_t)(((uint64_t)seal * 100U) / BENCH_SEALS);
+    open_x100 = (both > seal) ? (uint32_t)(((uint64_t)(both - seal) * 100U) / BENCH_SEALS) : 0;
+    printf("Link seal per %u-byte frame (" BENCH_TICKS "): seal %lu.%02lu, open %lu.%02lu%s;"
+           " %u bytes more = %lu us at %lu baud\n",
+           (unsigned)PROTO_MAX_PAYLOAD,
+           (unsigned long)(seal_x100 / 100U), (unsigned long)(seal_x100 % 100U),
+           (unsigned long)(open_x100 / 100U), (unsigned long)(open_x100 % 100U),
+           (opened == BENCH_SEALS) ? "" : " (FAILED)", (unsigned)PROTO_SEAL_SIZE,
+           (unsigned long)((PROTO_SEAL_SIZE * 10U * 1000000U) / UART5_GetBaudRate()),
+           (unsigned long)UART5_GetBaudRate());
+}
+#endif
+
+/*
+ * Bench_Stats
+ * Prints Control_ECU's EEPROM profile (PROTO_CMD_EEPROM_STATS): operation
+ * counts and program times since its reset, then the lifetime words
+ * programmed of every block.
+ */
+static void Bench_Stats(void)
+{
+    uint8_t mode[2] = { PROTO_STATS_COUNTS, 0 };
+    uint32_t bytes = 0;
+    uint32_t programs;
+    uint32_t clock_hz;
+    uint32_t block;
+    uint8_t i;
+
+    if(Bench_Request(PROTO_CMD_EEPROM_STATS, mode, 1, BENCH_TIMEOUT_MS, &bytes) != PROTO_STATUS_OK ||
+       last_reply.length < 21)
+    {
+        printf("EEPROM profile not available\n");
+    }
+    else
+    {
+        programs = Bench_GetU32(&last_reply.payload[17]);
+        printf("EEPROM words: %lu read, %lu programmed, %lu skipped (equal), %lu retries\n",
+               (unsigned long)Bench_GetU32(&last_reply.payload[1]),
+               (unsigned long)Bench_GetU32(&last_reply.payload[5]),
+               (unsigned long)Bench_GetU32(&last_reply.payload[9]),
+               (unsigned long)Bench_GetU32(&last_reply.payload[13]));
+
+        mode[0] = PROTO_STATS_TIMES;
+        if(Bench_Request(PROTO_CMD_EEPROM_STATS, mode, 1, BENCH_TIMEOUT_MS, &bytes) == PROTO_STATUS_OK &&
+           last_reply.length >= 21)
+        {
+            clock_hz = Bench_GetU32(&last_reply.payload[1]);
+            printf("EEPROM program (us): avg %lu, max %lu of %lu; queued write: last %lu, max %lu\n",
+                   (unsigned long)Bench_CyclesToUs((programs > 0U) ? Bench_GetU32(&last_reply.payload[5]) / programs : 0U, clock_hz),
+                   (unsigned long)Bench_CyclesToUs(Bench_GetU32(&last_reply.payload[9]), clock_hz),
+                   (unsigned long)programs,
+                   (unsigned long)Bench_CyclesToUs(Bench_GetU32(&last_reply.payload[13]), clock_hz),
+                   (unsigned long)Bench_CyclesToUs(Bench_GetU32(&last_reply.payload[17]), clock_hz));
+        }
+    }
+
+    printf("EEPROM lifetime words programmed per block:");
+    mode[0] = PROTO_STATS_WEAR;
+    for(block = 0; block < BENCH_EEPROM_BLOCKS; block += PROTO_STATS_WEAR_BLOCKS)
+    {
+        mode[1] = (uint8_t)block;
+        if(Bench_Request(PROTO_CMD_EEPROM_STATS, mode, 2, BENCH_TIMEOUT_MS, &bytes) != PROTO_STATUS_OK)
+        {
+            printf(" failed");
+            break;
+        }
+        for(i = 2; i + 4U <= last_reply.length; i += 4)
+        {
+            if(((block + (i - 2U) / 4U) % 8U) == 0U)
+            {
+                printf("\n  %2lu:", (unsigned long)(block + (i - 2U) / 4U));
+            }
+            printf(" %8lu", (unsigned long)Bench_GetU32(&last_reply.payload[i]));
+        }
+    }
+    printf("\n");
+}
+
+/* Nearest-rank percentile of the sorted samples */
+static uint32_t Bench_Percentile(uint16_t count, uint8_t percent)
+{
+    uint32_t rank = ((uint32_t)count * percent + 99U) / 100U;
+
+    return samples[(rank > 0U) ? (rank - 1U) : 0U];
+}
+
+static void Bench_RunCase(const Bench_Case *bench, Bench_Result *result)
+{
+    uint32_t bytes = 0;
+    uint32_t case_start;
+    uint32_t start;
+    uint32_t total_us;
+    uint32_t value;
+    uint16_t i;
+    uint16_t j;
+
+    result->name = bench->name;
+    result->completed = 0;
+    result->failed = 0;
+
+    case_start = GPTM_Timer1A_Read();
+    for(i = 0; i < bench->samples; i++)
+    {
+        start = GPTM_Timer1A_Read();
+        if(bench->run(&bytes) == PROTO_STATUS_OK)
+        {
+            samples[result->completed++] = (GPTM_Timer1A_Read() - start) / ticks_per_us;
+        }
+        else
+        {
+            result->failed++;
+        }
+    }
+    total_us = (GPTM_Timer1A_Read() - case_start) / ticks_per_us;
+
+    /* Insertion sort, at most BENCH_MAX_SAMPLES entries */
+    for(i = 1; i < result->completed; i++)
+    {
+        value = samples[i];
+        for(j = i; j > 0 && samples[j - 1] > value; j--)
+        {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = value;
+    }
+
+    result->p50_us = 0;
+    result->p99_us = 0;
+    result->max_us = 0;
+    result->txn_per_s_x100 = 0;
+    if(result->completed > 0)
+    {
+        result->p50_us = Bench_Percentile(result->completed, 50);
+        result->p99_us = Bench_Percentile(result->completed, 99);
+        result->max_us = samples[result->completed - 1];
+    }
+    if(total_us > 0)
+    {
+        result->txn_per_s_x100 = (uint32_t)(((uint64_t)result->completed * 100000000ULL) / total_us);
+    }
+    result->bytes_per_txn = (bench->samples > 0) ? (bytes / bench->samples) : 0;
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint8_t Bench_Run(void)
+{
+    static const Bench_Case cases[BENCH_CASES] =
+    {
+        { "PING",    Bench_Ping,    BENCH_SAMPLES },
+        { "STORE",   Bench_Store,   BENCH_SAMPLES },    /* first: sets BENCH_PASSWORD */
+        { "RESAVE",  Bench_Resave,  BENCH_SAMPLES },
+        { "VERIFY",  Bench_Verify,  BENCH_SAMPLES },
+        { "TIMEOUT", Bench_Timeout, BENCH_SAMPLES },
+        { "ENROLL",  Bench_Enroll,  BENCH_SAMPLES },
+        { "UVERIFY", Bench_UserVerify, BENCH_SAMPLES },
+        { "REVOKE",  Bench_Revoke,  BENCH_SAMPLES },    /* the users ENROLL added */
+        { "DOOR",    Bench_Door,    BENCH_DOOR_SAMPLES },
+        { "AUDIT",   Bench_Audit,   BENCH_AUDIT_SAMPLES },  /* the log of the cases above */
+        { "REJECT",  Bench_Reject,  BENCH_SAMPLES },    /* locked out until ERASE */
+        { "ERASE",   Bench_Erase,   BENCH_ERASE_SAMPLES },
+        { "FORMAT",  Bench_Format,  BENCH_ERASE_SAMPLES },
+    };
+    const Bench_Result *r;
+    uint32_t bytes = 0;
+    uint8_t failing = 0;
+    uint8_t i;
+
+    ticks_per_us = SysCtl_GetClock() / 1000000U;
+    if(ticks_per_us == 0)
+    {
+        ticks_per_us = 1;
+    }
+    GPTM_Timer1A_Init();
+    Link_Init(Bench_OnEvent);
+    /* The PIN cases start from Control_ECU's current challenge */
+    if(Bench_Request(PROTO_CMD_BOOT_SNAPSHOT, 0, 0, BENCH_TIMEOUT_MS, &bytes) == PROTO_STATUS_OK &&
+       last_reply.length == 1 + PROTO_SNAP_SIZE)
+    {
+        memcpy(challenge, &last_reply.payload[1 + PROTO_SNAP_CHALLENGE], PINAUTH_CHALLENGE_SIZE);
+    }
+
+    printf("Link benchmark at %lu baud\n", (unsigned long)UART5_GetBaudRate());
+    printf("%-8s %5s %5s %10s %10s %10s %6s %9s\n",
+           "case", "ok", "fail", "p50(us)", "p99(us)", "max(us)", "B/txn", "txn/s");
+
+    for(i = 0; i < BENCH_CASES; i++)
+    {
+        Bench_RunCase(&cases[i], &results[i]);
+        r = &results[i];
+        if(r->failed > 0)
+        {
+            failing++;
+        }
+        printf("%-8s %5u %5u %10lu %10lu %10lu %6lu %6lu.%02lu\n",
+               r->name, (unsigned)r->completed, (unsigned)r->failed,
+               (unsigned long)r->p50_us, (unsigned long)r->p99_us, (unsigned long)r->max_us,
+               (unsigned long)r->bytes_per_txn,
+               (unsigned long)(r->txn_per_s_x100 / 100U), (unsigned long)(r->txn_per_s_x100 % 100U));
+    }
+    Bench_Scan();
+    Bench_HashScan();
+#if PROTO_SECURE
+    Bench_Seal();
+#endif
+    Bench_Stats();
+    return failing;
+}
+
+const Bench_Result *Bench_Results(void)
+{
+    return results;
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ * File: bench.h
+ * Module: HMI Link
+ * Description: Round-trip latency and throughput benchmark of the
+ *              Control_ECU commands
+ *
+ * Each case drives one command repeatedly through the link layer with no
+ * retries and times every round trip on GPTM Timer1A (system clock ticks).
+ * PIN requests are sealed (pinauth.h) and their bytes include the
+ * PROTO_EVT_CHALLENGE that follows. With PROTO_SECURE every frame also
+ * carries the PROTO_SEAL_SIZE bytes of the sealed link, counted too:
+ *
+ *   PING     link floor, no work on Control_ECU
+ *   VERIFY   PROTO_CMD_VERIFY_PASSWORD ['E'], one PIN hash checked against
+ *            the RAM shadow (the calibrated PIN check cost)
+ *   STORE    PROTO_CMD_STORE_PASSWORD  ['H'], check and new hash, EEPROM
+ *            write (alternating passwords)
+ *   RESAVE   PROTO_CMD_STORE_PASSWORD  ['H'] of the stored password: one
+ *            check, then no-op
+ *   TIMEOUT  PROTO_CMD_STORE_TIMEOUT   ['I'], EEPROM write
+ *   ENROLL   PROTO_CMD_USER_ADD, one user per round trip (one EEPROM word)
+ *   UVERIFY  PROTO_CMD_VERIFY_PASSWORD of the enrolled users' PINs, looked
+ *            up in the user table
+ *   REVOKE   PROTO_CMD_USER_REVOKE of the same users (one EEPROM word)
+ *   DOOR     PROTO_CMD_OPEN_DOOR ['F'] + LOCK_NOW up to DOOR_LOCKED, i.e. one
+ *            full door cycle with both 3 s motor moves
+ *   AUDIT    PROTO_CMD_AUDIT_QUERY of the whole access log, up to its last
+ *            PROTO_EVT_AUDIT entry (the log is full by then)
+ *   REJECT   PROTO_CMD_VERIFY_PASSWORD of a wrong PIN: the first ones are
+ *            answered once the lockout counters are written, the rest
+ *            refused at once (PROTO_STATUS_LOCKED) without checking
+ *   ERASE    PROTO_CMD_FACTORY_RESET   ['J'], logical erase (one blank
+ *            record copy, the scrub runs after the reply)
+ *   FORMAT   PROTO_CMD_FACTORY_RESET [PROTO_RESET_FULL], erase of every
+ *            EEPROM block
+ *
+ * Per case it reports p50 / p99 / max round trip, bytes on the wire per
+ * transaction (both directions, frame overhead included) and completed
+ * transactions per second. Results go to stdout (C-SPY terminal I/O on
+ * target) and stay in Bench_Results for the debugger.
+ *
+ * After the table, PROTO_CMD_EEPROM_SCAN has Control_ECU time a full
+ * 2 KB EEPROM read word by word and in EERDWRINC bursts (as the config
+ * scan at boot does); both are printed in system clock cycles per word
+ * (BENCH_TICKS in bench.c; host ticks in the host build).
+ * PROTO_CMD_HASH_SCAN then times Control_ECU's PIN hash core: cycles per
+ * SHA-256 block and of one PIN check at its calibrated iteration count
+ * (host ticks and host time in the host build);
+ * and the sealing of a PIN verify (pinauth.h): cycles to seal it here,
+ * to open it and draw the next challenge on Control_ECU (host ticks in
+ * the host build).
+ * With PROTO_SECURE, the cost of the sealed link (seclink.h) follows:
+ * cycles to seal and to open a frame with a full payload, timed here
+ * (host ticks in the host build), and the time its bytes add to every
+ * frame at the current rate, computed from the rate.
+ * Last, PROTO_CMD_EEPROM_STATS reads Control_ECU's EEPROM counters and
+ * timings for the whole run and its lifetime write count of every block.
+ *
+ * Build with LINK_BENCH defined to run it at boot instead of the UI.
+ * DESTRUCTIVE: it overwrites the password, timeout and users, locks
+ * PIN checks out and ends with a factory reset of Control_ECU.
+ ******************************************************************************/
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define BENCH_CASES             13
+#define BENCH_MAX_SAMPLES       64      /* round trips timed per case */
+#define BENCH_DOOR_SAMPLES      5       /* ~6 s each */
+#define BENCH_ERASE_SAMPLES     10
+#define BENCH_AUDIT_SAMPLES     10      /* whole log streamed each */
+#define BENCH_EEPROM_WORDS      512     /* 2 KB read by PROTO_CMD_EEPROM_SCAN */
+#define BENCH_EEPROM_BLOCKS     32      /* blocks of PROTO_STATS_WEAR */
+#define BENCH_SEALS             64      /* frames sealed and opened, timed */
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+typedef struct
+{
+    const char *name;
+    uint16_t    completed;          /* round trips with PROTO_STATUS_OK */
+    uint16_t    failed;             /* timeouts and error replies */
+    uint32_t    p50_us;
+    uint32_t    p99_us;
+    uint32_t    max_us;
+    uint32_t    bytes_per_txn;
+    uint32_t    txn_per_s_x100;     /* transactions per second * 100 */
+} Bench_Result;
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Bench_Run
+ * Runs every case in turn and prints the table. Takes over the link
+ * (Link_Init) and blocks until done; nothing else may be in flight.
+ * Returns: number of cases with at least one failed round trip
+ */
+uint8_t Bench_Run(void);
+
+/*
+ * Bench_Results
+ * Returns: the BENCH_CASES results of the last Bench_Run
+ */
+const Bench_Result *Bench_Results(void);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,621 @@
+/******************************************************************************
+ * File: link.c
+ * Module: HMI Link
+ * Description: Asynchronous request/response transactions with Control_ECU
+ ******************************************************************************/
+
+#include <string.h>
+#include "link.h"
+#include "pinauth.h"
+#include "systick.h"
+#include "uart.h"
+
+/* Slot i only ever uses SEQs equal to i modulo LINK_MAX_PENDING, so the
+ * reply Control_ECU caches for a request in flight (PROTO_ReplayReply)
+ * is only replaced by the next request of the same slot */
+#if (PROTO_REPLY_CACHE % LINK_MAX_PENDING) != 0 || (256 % PROTO_REPLY_CACHE) != 0
+#error "PROTO_REPLY_CACHE must be a multiple of LINK_MAX_PENDING dividing 256"
+#endif
+
+/* Rate negotiation phases (Link_Negotiate) */
+#define LINK_NEGOTIATE_IDLE     0
+#define LINK_NEGOTIATE_OFFER    1       /* SET_BAUD in flight */
+#define LINK_NEGOTIATE_CHECK    2       /* PING in flight at the new rate */
+#define LINK_NEGOTIATE_BACKOFF  3       /* waiting out Control_ECU's probation */
+
+/******************************************************************************
+ *                          Private Types                                      *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint8_t       state;            /* LINK_xxx */
+    uint8_t       type;
+    uint8_t       seq;              /* slot index modulo LINK_MAX_PENDING */
+    uint8_t       length;
+    uint8_t       payload[PROTO_MAX_PAYLOAD];   /* kept for retransmission */
+    uint8_t       retries_left;
+    uint32_t      timeout_ms;
+    uint32_t      deadline;         /* SysTick_GetMs() of the next expiry */
+    Link_Callback callback;
+    PROTO_Frame   reply;            /* held for Link_Check */
+} Link_Slot;
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static Link_Slot         slots[LINK_MAX_PENDING];
+static PROTO_Parser      parser;
+static Link_EventHandler event_handler = 0;
+static PROTO_ErrorWatch  rx_errors;
+
+/* Rate negotiation; other requests are held while it runs */
+static const uint32_t   *negotiate_rates;
+static uint8_t           negotiate_count;
+static uint8_t           negotiate_index;
+static uint8_t           negotiate_phase = LINK_NEGOTIATE_IDLE;
+static uint8_t           negotiate_handle = LINK_NO_HANDLE;    /* its request */
+static uint32_t          negotiate_until;       /* end of the back-off */
+
+#if PROTO_SECURE
+/* Session handshake (PROTO_CMD_HELLO) */
+static uint8_t           hello_pending = 0;
+static uint8_t           hello_seq = 0;
+static uint8_t           hello_retries_left;
+static uint32_t          hello_deadline;
+static uint8_t           hello_nonce[SECLINK_NONCE_SIZE];
+static uint32_t          hello_seed = 0;        /* Link_Secure */
+static uint32_t          hello_count = 0;       /* nonces drawn from it */
+#endif
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+/*
+ * Link_Finish
+ * Completes a slot: runs its callback and frees it, or parks the result
+ * for Link_Check.
+ */
+static void Link_Finish(Link_Slot *slot, uint8_t result, const PROTO_Frame *reply)
+{
+    Link_Callback callback = slot->callback;
+    PROTO_Frame   copy;
+
+    if(callback == 0)
+    {
+        if(reply != 0)
+        {
+            slot->reply = *reply;
+        }
+        slot->state = result;
+        return;
+    }
+
+    /* Free the slot first so the callback can submit the next request */
+    slot->state = LINK_FREE;
+    if(result == LINK_DONE)
+    {
+        copy = *reply;
+        callback(copy.payload[0], &copy);
+    }
+    else
+    {
+        callback(LINK_STATUS_TIMEOUT, 0);
+    }
+}
+
+/*
+ * Link_Dispatch
+ * Routes one received frame to the transaction waiting for it, or to the
+ * event handler. Replies nobody waits for (cancelled, late) are dropped.
+ */
+static void Link_Dispatch(const PROTO_Frame *frame)
+{
+    uint8_t i;
+
+    if((frame->type & PROTO_REPLY_FLAG) == 0)
+    {
+        if(event_handler != 0)
+        {
+            event_handler(frame);
+        }
+        return;
+    }
+
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if((slots[i].state == LINK_PENDING) &&
+           ((slots[i].type | PROTO_REPLY_FLAG) == frame->type) &&
+           (slots[i].seq == frame->seq) && (frame->length > 0))
+        {
+            Link_Finish(&slots[i], LINK_DONE, frame);
+            return;
+        }
+    }
+}
+
+/*
+ * Link_Fallback
+ * Returns to the safe rate. A peer still on the fast rate sees framing
+ * errors from our slow bytes and follows (PROTO_BAUD_ERROR_LIMIT).
+ */
+static void Link_Fallback(void)
+{
+    if(UART5_GetBaudRate() != UART5_DEFAULT_BAUD)
+    {
+        UART5_SetBaudRate(UART5_DEFAULT_BAUD);
+        PROTO_ParserReset(&parser);
+    }
+}
+
+/*
+ * Link_Held
+ * Whether a pending request waits unsent: for the session handshake, or
+ * for the rate negotiation unless it is the negotiation's own.
+ */
+static uint8_t Link_Held(uint8_t handle)
+{
+#if PROTO_SECURE
+    if(hello_pending)
+    {
+        return 1;
+    }
+#endif
+    return (uint8_t)(negotiate_phase != LINK_NEGOTIATE_IDLE && handle != negotiate_handle);
+}
+
+/*
+ * Link_SendHeld
+ * Sends the pending requests no longer held, each with a full attempt left.
+ */
+static void Link_SendHeld(void)
+{
+    uint32_t now = SysTick_GetMs();
+    uint8_t i;
+
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if(slots[i].state == LINK_PENDING && !Link_Held(i))
+        {
+            slots[i].deadline = now + slots[i].timeout_ms;
+            PROTO_Send(slots[i].type, slots[i].seq, slots[i].payload, slots[i].length);
+        }
+    }
+}
+
+#if PROTO_SECURE
+/*
+ * Link_Hello
+ * Starts a session: sends PROTO_CMD_HELLO with a new nonce, drawn from
+ * the seed and a count. Pending requests are held until it is answered.
+ */
+static void Link_Hello(void)
+{
+    hello_count++;
+    PinAuth_Nonce(hello_seed, hello_count, hello_nonce);
+    hello_seq++;
+    hello_retries_left = LINK_HELLO_RETRIES;
+    hello_deadline = SysTick_GetMs() + LINK_HELLO_TIMEOUT_MS;
+    hello_pending = 1;
+    PROTO_SendPlain(PROTO_CMD_HELLO, hello_seq, hello_nonce, SECLINK_NONCE_SIZE);
+}
+
+/*
+ * Link_Unsealed
+ * A plain frame: the answer to our HELLO, which opens the session once
+ * its confirm tag checks, or PROTO_STATUS_NO_SESSION for a request in
+ * flight, which starts a new one. Anything else is dropped.
+ */
+static void Link_Unsealed(const PROTO_Frame *frame)
+{
+    uint8_t confirm[SECLINK_TAG_SIZE];
+    uint8_t differ = 0;
+    uint8_t i;
+
+    if(frame->type == (PROTO_CMD_HELLO | PROTO_REPLY_FLAG))
+    {
+        if(!hello_pending || frame->seq != hello_seq ||
+           frame->length != 1 + SECLINK_NONCE_SIZE + SECLINK_TAG_SIZE ||
+           frame->payload[0] != PROTO_STATUS_OK)
+        {
+            return;
+        }
+
+        PROTO_SecureStart(SECLINK_HMI, hello_nonce, &frame->payload[1], confirm);
+        for(i = 0; i < SECLINK_TAG_SIZE; i++)
+        {
+            differ |= (uint8_t)(confirm[i] ^ frame->payload[1 + SECLINK_NONCE_SIZE + i]);
+        }
+        if(differ != 0)
+        {
+            PROTO_SecureStop();         /* not from a holder of the link key */
+            return;
+        }
+
+        hello_pending = 0;
+        Link_SendHeld();
+        return;
+    }
+
+    if((frame->type & PROTO_REPLY_FLAG) == 0 || frame->length == 0 ||
+       frame->payload[0] != PROTO_STATUS_NO_SESSION || hello_pending)
+    {
+        return;
+    }
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if((slots[i].state == LINK_PENDING) &&
+           ((slots[i].type | PROTO_REPLY_FLAG) == frame->type) &&
+           (slots[i].seq == frame->seq))
+        {
+            PROTO_SecureStop();
+            Link_Hello();
+            return;
+        }
+    }
+}
+
+/*
+ * Link_HelloTask
+ * Retransmits HELLO, at the default rate, until answered or out of
+ * retries; the requests held then expire as usual.
+ */
+static void Link_HelloTask(uint32_t now)
+{
+    if(!hello_pending || (int32_t)(now - hello_deadline) < 0)
+    {
+        return;
+    }
+
+    if(hello_retries_left > 0)
+    {
+        Link_Fallback();
+        hello_retries_left--;
+        hello_deadline = now + LINK_HELLO_TIMEOUT_MS;
+        PROTO_SendPlain(PROTO_CMD_HELLO, hello_seq, hello_nonce, SECLINK_NONCE_SIZE);
+    }
+    else
+    {
+        hello_pending = 0;
+    }
+}
+#endif
+
+static void Link_Offer(void);
+
+/*
+ * Link_NegotiateDone
+ * Ends the negotiation at the current rate and releases held requests.
+ */
+static void Link_NegotiateDone(void)
+{
+    negotiate_phase = LINK_NEGOTIATE_IDLE;
+    negotiate_handle = LINK_NO_HANDLE;
+    Link_SendHeld();
+}
+
+/*
+ * Link_NegotiateSubmit
+ * Submits a request of the negotiation, sent even though others are held.
+ * Without a free slot it fails at once.
+ */
+static void Link_NegotiateSubmit(uint8_t type, const uint8_t *payload, uint8_t length,
+                                 uint8_t retries, Link_Callback callback)
+{
+    uint8_t handle;
+
+    negotiate_handle = LINK_NO_HANDLE;
+    handle = Link_Submit(type, payload, length, LINK_NEGOTIATE_TIMEOUT_MS, retries, callback);
+    if(handle == LINK_NO_HANDLE)
+    {
+        callback(LINK_STATUS_TIMEOUT, 0);
+        return;
+    }
+
+    negotiate_handle = handle;
+    if(!Link_Held(handle))
+    {
+        PROTO_Send(type, slots[handle].seq, slots[handle].payload, length);
+    }
+}
+
+/*
+ * Link_OnCheck
+ * PING at the new rate: answered keeps it, otherwise back to the default
+ * rate and, once Control_ECU's probation is over, the next offer.
+ */
+static void Link_OnCheck(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    negotiate_handle = LINK_NO_HANDLE;
+    if(status != LINK_STATUS_TIMEOUT && UART5_GetBaudRate() == negotiate_rates[negotiate_index])
+    {
+        Link_NegotiateDone();
+        return;
+    }
+
+    Link_Fallback();
+    negotiate_phase = LINK_NEGOTIATE_BACKOFF;
+    negotiate_until = SysTick_GetMs() + PROTO_BAUD_PROBATION_MS;
+}
+
+/*
+ * Link_OnOffer
+ * SET_BAUD accepted: switch and check the rate with a PING. Refused or
+ * unanswered: offer the next one.
+ */
+static void Link_OnOffer(uint8_t status, const PROTO_Frame *reply)
+{
+    (void)reply;
+    negotiate_handle = LINK_NO_HANDLE;
+    if(status != PROTO_STATUS_OK)
+    {
+        negotiate_index++;
+        Link_Offer();
+        return;
+    }
+
+    UART5_SetBaudRate(negotiate_rates[negotiate_index]);
+    PROTO_ParserReset(&parser);
+    negotiate_phase = LINK_NEGOTIATE_CHECK;
+    Link_NegotiateSubmit(PROTO_CMD_PING, 0, 0, 0, Link_OnCheck);
+}
+
+/*
+ * Link_Offer
+ * Offers the next rate within reach of our own clock, or ends the
+ * negotiation when none is left.
+ */
+static void Link_Offer(void)
+{
+    uint8_t payload[4];
+    uint32_t rate;
+
+    while(negotiate_index < negotiate_count &&
+          UART5_CheckBaudRate(negotiate_rates[negotiate_index]) == 0)
+    {
+        negotiate_index++;
+    }
+    if(negotiate_index >= negotiate_count)
+    {
+        Link_NegotiateDone();
+        return;
+    }
+
+    rate = negotiate_rates[negotiate_index];
+    payload[0] = (uint8_t)(rate >> 24);
+    payload[1] = (uint8_t)(rate >> 16);
+    payload[2] = (uint8_t)(rate >> 8);
+    payload[3] = (uint8_t)rate;
+    negotiate_phase = LINK_NEGOTIATE_OFFER;
+    Link_NegotiateSubmit(PROTO_CMD_SET_BAUD, payload, 4, 1, Link_OnOffer);
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+void Link_Init(Link_EventHandler on_event)
+{
+    uint8_t i;
+
+    PROTO_ParserReset(&parser);
+    rx_errors.errors = UART5_GetRxErrorCount() + UART5_GetRxOverflowCount();
+    rx_errors.window_start = SysTick_GetMs();
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        slots[i].state = LINK_FREE;
+        slots[i].seq   = i;
+    }
+    event_handler = on_event;
+    negotiate_phase = LINK_NEGOTIATE_IDLE;
+    negotiate_handle = LINK_NO_HANDLE;
+#if PROTO_SECURE
+    hello_pending = 0;
+#endif
+}
+
+uint8_t Link_Secure(uint32_t seed)
+{
+#if PROTO_SECURE
+    hello_seed = seed;
+    if(!hello_pending)
+    {
+        PROTO_SecureStop();
+        Link_Hello();
+    }
+    while(hello_pending)
+    {
+        Link_Task();
+    }
+#else
+    (void)seed;
+#endif
+    return PROTO_Secured();
+}
+
+uint8_t Link_Submit(uint8_t type, const uint8_t *payload, uint8_t length,
+                    uint32_t timeout_ms, uint8_t retries, Link_Callback callback)
+{
+    uint8_t i;
+    Link_Slot *slot;
+
+    if(length > PROTO_MAX_PAYLOAD)
+    {
+        return LINK_NO_HANDLE;
+    }
+
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if(slots[i].state == LINK_FREE)
+        {
+            break;
+        }
+    }
+    if(i == LINK_MAX_PENDING)
+    {
+        return LINK_NO_HANDLE;
+    }
+
+    slot = &slots[i];
+    slot->type         = type;
+    slot->seq          = (uint8_t)(slot->seq + LINK_MAX_PENDING);
+    slot->length       = length;
+    slot->retries_left = retries;
+    slot->timeout_ms   = timeout_ms;
+    slot->callback     = callback;
+    if(length > 0)
+    {
+        memcpy(slot->payload, payload, length);
+    }
+
+    slot->state    = LINK_PENDING;
+    slot->deadline = SysTick_GetMs() + timeout_ms;
+#if PROTO_SECURE
+    if(!PROTO_Secured() && !hello_pending)
+    {
+        Link_Hello();               /* the session was lost; held until up */
+    }
+#endif
+    if(Link_Held(i))
+    {
+        return i;                   /* sent by Link_SendHeld */
+    }
+    PROTO_Send(type, slot->seq, slot->payload, length);
+
+    return i;
+}
+
+uint8_t Link_Check(uint8_t handle, PROTO_Frame *reply)
+{
+    uint8_t state;
+
+    if(handle >= LINK_MAX_PENDING)
+    {
+        return LINK_FREE;
+    }
+
+    state = slots[handle].state;
+    if(state == LINK_DONE || state == LINK_TIMEOUT)
+    {
+        if(state == LINK_DONE && reply != 0)
+        {
+            *reply = slots[handle].reply;
+        }
+        slots[handle].state = LINK_FREE;
+    }
+    return state;
+}
+
+void Link_Cancel(uint8_t handle)
+{
+    if(handle < LINK_MAX_PENDING)
+    {
+        slots[handle].state = LINK_FREE;
+    }
+}
+
+void Link_Negotiate(const uint32_t *rates, uint8_t count)
+{
+    if(negotiate_phase != LINK_NEGOTIATE_IDLE)
+    {
+        return;
+    }
+
+    negotiate_rates = rates;
+    negotiate_count = count;
+    negotiate_index = 0;
+    Link_Offer();
+}
+
+uint8_t Link_Negotiating(void)
+{
+    return (uint8_t)(negotiate_phase != LINK_NEGOTIATE_IDLE);
+}
+
+uint8_t Link_Pending(void)
+{
+    uint8_t i;
+    uint8_t count = 0;
+
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if(slots[i].state == LINK_PENDING)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Link_Task(void)
+{
+    PROTO_Frame frame;
+    uint32_t now;
+    uint8_t result;
+    uint8_t i;
+
+    while((result = PROTO_Poll(&parser, &frame)) != PROTO_NO_FRAME)
+    {
+        if(result == PROTO_FRAME_READY)
+        {
+            Link_Dispatch(&frame);
+        }
+#if PROTO_SECURE
+        else if(result == PROTO_FRAME_PLAIN)
+        {
+            Link_Unsealed(&frame);
+        }
+#endif
+    }
+
+    now = SysTick_GetMs();
+    if(PROTO_ErrorBurst(&rx_errors, now))
+    {
+        Link_Fallback();
+    }
+
+#if PROTO_SECURE
+    Link_HelloTask(now);
+    if(hello_pending)
+    {
+        return;                     /* requests held, see Link_Unsealed */
+    }
+#endif
+
+    if(negotiate_phase == LINK_NEGOTIATE_BACKOFF && (int32_t)(now - negotiate_until) >= 0)
+    {
+        negotiate_index++;
+        Link_Offer();
+    }
+
+    for(i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if((slots[i].state != LINK_PENDING) || Link_Held(i) ||
+           ((int32_t)(now - slots[i].deadline) < 0))
+        {
+            continue;
+        }
+
+        if(slots[i].retries_left > 0)
+        {
+            Link_Fallback();            /* no-op at the default rate */
+            slots[i].retries_left--;
+            slots[i].deadline = now + slots[i].timeout_ms;
+#if PROTO_SECURE
+            if(!PROTO_Secured())
+            {
+                Link_Hello();           /* the last one gave up; held again */
+                return;
+            }
+#endif
+            PROTO_Send(slots[i].type, slots[i].seq, slots[i].payload, slots[i].length);
+        }
+        else
+        {
+            Link_Finish(&slots[i], LINK_TIMEOUT, 0);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * File: link.h
+ * Module: HMI Link
+ * Description: Asynchronous request/response transactions with Control_ECU
+ *
+ * A transaction is submitted once and then driven by Link_Task from the main
+ * loop, so the keypad and LCD keep running while it is in flight:
+ *
+ *   - the request is retransmitted with the SAME sequence number when its
+ *     deadline passes, up to the given number of retries (Control_ECU
+ *     answers a repeated sequence number from its reply cache instead of
+ *     executing the command twice)
+ *   - on reply or after the last retry the callback runs from Link_Task,
+ *     or, with no callback, the result is kept until Link_Check collects it
+ *   - frames that are not replies (PROTO_EVT_xxx) go to the event handler
+ *
+ * Link_Negotiate raises the UART rate (see PROTO_CMD_SET_BAUD). Afterwards
+ * Link_Task drops back to UART5_DEFAULT_BAUD on a receive error burst or
+ * before retransmitting a request that got no answer at the fast rate.
+ *
+ * With PROTO_SECURE, Link_Secure opens the session of the sealed link
+ * (PROTO_CMD_HELLO) before anything else is sent. When Control_ECU answers
+ * a request PROTO_STATUS_NO_SESSION (it was reset) Link_Task opens a new
+ * one on its own: requests are held meanwhile, then sent again, sealed
+ * under the new keys, with a full attempt left. If that handshake goes
+ * unanswered, the next retransmission of a held request starts another.
+ ******************************************************************************/
+
+#ifndef LINK_H_
+#define LINK_H_
+
+#include <stdint.h>
+#include "protocol.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define LINK_MAX_PENDING        4       /* transactions in flight at once */
+#define LINK_NO_HANDLE          0xFF    /* Link_Submit failed, no free slot */
+
+/* Pseudo status passed to callbacks when every attempt timed out */
+#define LINK_STATUS_TIMEOUT     0xFF
+
+/* Transaction states (Link_Check) */
+#define LINK_FREE               0
+#define LINK_PENDING            1
+#define LINK_DONE               2       /* reply received */
+#define LINK_TIMEOUT            3       /* no reply after the last retry */
+
+/* Per-attempt timeout of the negotiation requests */
+#define LINK_NEGOTIATE_TIMEOUT_MS   50
+
+/* Session handshake (PROTO_SECURE): per-attempt timeout, extra attempts */
+#define LINK_HELLO_TIMEOUT_MS   100
+#define LINK_HELLO_RETRIES      4
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+/* status is reply->payload[0], or LINK_STATUS_TIMEOUT with reply == 0 */
+typedef void (*Link_Callback)(uint8_t status, const PROTO_Frame *reply);
+
+typedef void (*Link_EventHandler)(const PROTO_Frame *event);
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * Link_Init
+ * Resets the decoder and frees every slot. on_event may be 0.
+ * UART5 (interrupt mode) and SysTick (SYSTICK_INT) must be running.
+ */
+void Link_Init(Link_EventHandler on_event);
+
+/*
+ * Link_Secure
+ * Opens a session of the sealed link (see PROTO_CMD_HELLO) with a new
+ * nonce. Blocks; meant for boot, with no other transaction in flight.
+ * seed - Something that differs from one boot to the next, e.g. timer
+ *        and ADC readings; the nonces are drawn from it and a count
+ * Returns: 1 once the session is open (always without PROTO_SECURE),
+ *          0 if Control_ECU did not answer
+ */
+uint8_t Link_Secure(uint32_t seed);
+
+/*
+ * Link_Submit
+ * Sends a request and returns at once. timeout_ms is per attempt, retries
+ * is the number of extra attempts. callback may be 0 to poll with
+ * Link_Check instead.
+ * Returns: handle, or LINK_NO_HANDLE if all slots are busy
+ */
+uint8_t Link_Submit(uint8_t type, const uint8_t *payload, uint8_t length,
+                    uint32_t timeout_ms, uint8_t retries, Link_Callback callback);
+
+/*
+ * Link_Check
+ * Polls a transaction submitted without a callback. Once the result is
+ * LINK_DONE or LINK_TIMEOUT the reply (if any) is copied out and the slot
+ * is released.
+ * Returns: LINK_PENDING, LINK_DONE, LINK_TIMEOUT or LINK_FREE (bad handle)
+ */
+uint8_t Link_Check(uint8_t handle, PROTO_Frame *reply);
+
+/*
+ * Link_Cancel
+ * Drops a transaction; a late reply is discarded and no callback runs.
+ */
+void Link_Cancel(uint8_t handle);
+
+/*
+ * Link_Pending
+ * Returns: number of transactions still waiting for a reply
+ */
+uint8_t Link_Pending(void);
+
+/*
+ * Link_Negotiate
+ * Starts offering each rate in turn (fastest first); Link_Task keeps the
+ * first one that Control_ECU accepts and answers a PING at, waiting out
+ * PROTO_BAUD_PROBATION_MS after each that fails. Returns at once; requests
+ * submitted meanwhile are held and sent once it is over. rates must stay
+ * valid until then. Meant for boot.
+ */
+void Link_Negotiate(const uint32_t *rates, uint8_t count);
+
+/*
+ * Link_Negotiating
+ * Returns: 1 while a Link_Negotiate is running, 0 once the rate is settled
+ *          (UART5_GetBaudRate, UART5_DEFAULT_BAUD if none worked)
+ */
+uint8_t Link_Negotiating(void);
+
+/*
+ * Link_Task
+ * Dispatches received frames, retransmits and expires requests.
+ * Call on every pass of the main loop; never blocks.
+ */
+void Link_Task(void);
+
+#endif /* LINK_H_ */
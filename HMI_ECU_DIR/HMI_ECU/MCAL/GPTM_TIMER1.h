@@ -0,0 +1,15 @@
+/*************************************************
+ * File: GPTM_TIMER1.h
+ * Description: GPTM Timer1A free-running time base (32-bit, system clock)
+ *************************************************/
+
+#ifndef GPTM_TIMER1_H
+#define GPTM_TIMER1_H
+
+#include <stdint.h>
+
+/* Public APIs */
+void GPTM_Timer1A_Init(void);                /* no-op if already running */
+uint32_t GPTM_Timer1A_Read(void);       /* system clock ticks, wraps at 2^32 */
+
+#endif /* GPTM_TIMER1_H */
@@ -0,0 +1,67 @@
+/*************************************************
+ * File: sysctl.c
+ * Description: System clock frequency from the RCC/RCC2 settings
+ *************************************************/
+
+#include "sysctl.h"
+#include "tm4c123gh6pm.h"
+
+#define PIOSC_HZ              16000000U
+#define LFIOSC_HZ             30000U
+#define PLL_HZ                400000000U
+
+/* MOSC frequency for each RCC.XTAL code, starting at code 0x06 */
+static const uint32_t xtal_hz[] =
+{
+    4000000U,  4096000U,  4915200U,  5000000U,  5120000U,  6000000U,
+    6144000U,  7372800U,  8000000U,  8192000U,  10000000U, 12000000U,
+    12288000U, 13560000U, 14318180U, 16000000U, 16384000U, 18000000U,
+    20000000U, 24000000U, 25000000U
+};
+
+uint32_t SysCtl_GetClock(void)
+{
+    uint32_t rcc  = SYSCTL_RCC_R;
+    uint32_t rcc2 = SYSCTL_RCC2_R;
+    uint32_t source;
+    uint32_t xtal;
+    uint32_t clock;
+    uint32_t bypass;
+    uint32_t divisor;
+
+    /* Oscillator feeding the PLL (or the system clock when bypassed) */
+    source = (rcc2 & SYSCTL_RCC2_USERCC2) ? (rcc2 & SYSCTL_RCC2_OSCSRC2_M)
+                                          : (rcc & SYSCTL_RCC_OSCSRC_M);
+    switch (source)
+    {
+        case SYSCTL_RCC2_OSCSRC2_MO:
+            xtal = (rcc & SYSCTL_RCC_XTAL_M) >> 6;
+            clock = (xtal >= 0x06U && xtal < 0x06U + sizeof(xtal_hz) / sizeof(xtal_hz[0]))
+                    ? xtal_hz[xtal - 0x06U] : PIOSC_HZ;
+            break;
+        case SYSCTL_RCC2_OSCSRC2_IO:  clock = PIOSC_HZ;       break;
+        case SYSCTL_RCC2_OSCSRC2_IO4: clock = PIOSC_HZ / 4U;  break;
+        case SYSCTL_RCC2_OSCSRC2_30:  clock = LFIOSC_HZ;      break;
+        default:                      clock = 32768U;         break;
+    }
+
+    if (rcc2 & SYSCTL_RCC2_USERCC2)
+    {
+        bypass = rcc2 & SYSCTL_RCC2_BYPASS2;
+        if (rcc2 & SYSCTL_RCC2_DIV400)
+        {
+            /* 400 MHz PLL divided by SYSDIV2:SYSDIV2LSB + 1 */
+            divisor = ((rcc2 & (SYSCTL_RCC2_SYSDIV2_M | SYSCTL_RCC2_SYSDIV2LSB)) >> 22) + 1U;
+            return bypass ? clock / divisor : PLL_HZ / divisor;
+        }
+        divisor = ((rcc2 & SYSCTL_RCC2_SYSDIV2_M) >> SYSCTL_RCC2_SYSDIV2_S) + 1U;
+    }
+    else
+    {
+        bypass = rcc & SYSCTL_RCC_BYPASS;
+        divisor = (rcc & SYSCTL_RCC_USESYSDIV)
+                  ? ((rcc & SYSCTL_RCC_SYSDIV_M) >> SYSCTL_RCC_SYSDIV_S) + 1U : 1U;
+    }
+
+    return bypass ? clock / divisor : (PLL_HZ / 2U) / divisor;
+}
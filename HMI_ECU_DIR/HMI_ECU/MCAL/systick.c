@@ -1,7 +1,6 @@
 #include <stdint.h>
 #include "tm4c123gh6pm.h"
 #include "systick.h"
-#include "dio.h"
 
 volatile uint32_t msTicks = 0;
 static uint8_t interruptMode = 0;
@@ -37,13 +36,21 @@ void DelayMs(uint32_t ms)
             NVIC_ST_CURRENT_R = 0;
         }
     }
+    else
+    {
+        // INTERRUPT MODE - wait on the tick counter (at least ms full ticks)
+        uint32_t start = msTicks;
+        while ((msTicks - start) <= ms);
+    }
+}
+
+uint32_t SysTick_GetMs(void)
+{
+    return msTicks;
 }
 
-/* SysTick Interrupt Handler */
-void SystickHandler(void)
+/* SysTick Interrupt Handler - 1 ms time base (reload = 1 ms of core clock) */
+void SysTick_Handler(void)
 {
-    /* Toggle Green LED every SysTick interrupt */
-    DIO_TogglePin(PORTF, PIN3);
-    DIO_TogglePin(PORTF, PIN3);
-    DIO_TogglePin(PORTF, PIN3);
+    msTicks++;
 }
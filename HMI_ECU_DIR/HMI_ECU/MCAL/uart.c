@@ -1,6 +1,6 @@
 
-
 #include "uart.h"
+#include "sysctl.h"
 #include "tm4c123gh6pm.h"
 
 /* ================= UART5 Register Abstraction ================= */
@@ -10,12 +10,139 @@
 #define UART_IBRD_R   UART5_IBRD_R
 #define UART_FBRD_R   UART5_FBRD_R
 #define UART_LCRH_R   UART5_LCRH_R
+#define UART_IFLS_R   UART5_IFLS_R
+#define UART_IM_R     UART5_IM_R
+#define UART_MIS_R    UART5_MIS_R
+#define UART_ICR_R    UART5_ICR_R
+#define UART_ECR_R    UART5_ECR_R
+
+/* UART5 is IRQ 61: enable bit 29 of EN1, priority field [15:13] of PRI15 */
+#define UART5_NVIC_EN_BIT     (1U << 29)
+#define UART5_NVIC_PRI_MASK   0x0000E000U
+#define UART5_NVIC_PRI        (2U << 13)
+
+#define UART_DR_ERRORS  (UART_DR_OE | UART_DR_BE | UART_DR_PE | UART_DR_FE)
+
+/* Largest baud rate error accepted by UART5_CheckBaudRate, in 1/1000 */
+#define UART_BAUD_TOLERANCE   25U
 
 /* =============================================================== */
 
+/* Ring buffers used in interrupt mode.
+ * Single producer / single consumer: the ISR owns rx_head and tx_tail,
+ * the application owns rx_tail and tx_head, so no locking is needed. */
+static volatile uint8_t  rx_buffer[UART5_RX_BUFFER_SIZE];
+static volatile uint8_t  tx_buffer[UART5_TX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+static volatile uint32_t rx_overflow_count = 0;
+static volatile uint32_t rx_error_count = 0;
+
+static uint8_t uartMode = UART5_MODE_POLLING;
+static uint32_t uartBaud = UART5_DEFAULT_BAUD;
+
+#define RX_COUNT()  (rx_head - rx_tail)
+#define TX_COUNT()  (tx_head - tx_tail)
+
+/* Move bytes from the TX ring into the hardware FIFO until either runs out */
+static void UART5_FillTxFifo(void)
+{
+    while ((TX_COUNT() != 0U) && ((UART_FR_R & UART_FR_TXFF) == 0U))
+    {
+        UART_DR_R = tx_buffer[tx_tail & (UART5_TX_BUFFER_SIZE - 1U)];
+        tx_tail++;
+    }
+
+    if (TX_COUNT() == 0U)
+    {
+        UART_IM_R &= ~UART_IM_TXIM;
+    }
+}
+
+/* Move every byte waiting in the hardware FIFO into the RX ring */
+static void UART5_DrainRxFifo(void)
+{
+    uint32_t data;
+
+    while ((UART_FR_R & UART_FR_RXFE) == 0U)
+    {
+        data = UART_DR_R;
+
+        if (data & UART_DR_ERRORS)
+        {
+            rx_error_count++;
+            UART_ECR_R = 0;
+            continue;
+        }
+
+        if (RX_COUNT() < UART5_RX_BUFFER_SIZE)
+        {
+            rx_buffer[rx_head & (UART5_RX_BUFFER_SIZE - 1U)] = (uint8_t)data;
+            rx_head++;
+        }
+        else
+        {
+            rx_overflow_count++;
+        }
+    }
+}
+
+/* Divisor for baud, in 1/64 bit-clock units, and whether HSE (8x) is needed.
+ * Returns 0 if baud cannot be reached within UART_BAUD_TOLERANCE. */
+static uint32_t UART5_BaudDivisor(uint32_t baud, uint32_t *hse)
+{
+    uint32_t clock = SysCtl_GetClock();
+    uint32_t divisor;
+    uint32_t actual;
+
+    if (baud == 0U)
+    {
+        return 0;
+    }
+
+    /* 16x oversampling unless the clock is too slow, then 8x (HSE) */
+    *hse = 0U;
+    if ((uint64_t)baud * 16U > clock)
+    {
+        if ((uint64_t)baud * 8U > clock)
+        {
+            return 0;
+        }
+        *hse = UART_CTL_HSE;
+        clock *= 2U;
+    }
+
+    /* BRD = clock / (16 * baud), rounded to 1/64 */
+    divisor = (uint32_t)((((uint64_t)clock * 8U) / baud + 1U) / 2U);
+    if ((divisor < 64U) || (divisor > (0xFFFFU * 64U + 63U)))
+    {
+        return 0;
+    }
+
+    actual = (uint32_t)(((uint64_t)clock * 4U) / divisor);
+    if ((actual > baud ? actual - baud : baud - actual) >
+        (uint32_t)(((uint64_t)baud * UART_BAUD_TOLERANCE) / 1000U))
+    {
+        return 0;
+    }
+    return divisor;
+}
+
 void UART5_Init(void)
+{
+    UART5_InitMode(UART5_MODE_POLLING);
+}
+
+void UART5_InitMode(uint8_t mode)
 {
     volatile uint32_t delay;
+    uint32_t hse;
+    uint32_t divisor;
+
+    uartMode = mode;
 
     /* 1. Enable clocks */
     SYSCTL_RCGCUART_R |= (1U << 5);    /* UART5 */
@@ -31,27 +158,202 @@ void UART5_Init(void)
     /* 3. Disable UART before config */
     UART_CTL_R &= ~UART_CTL_UARTEN;
 
-    /* 4. Baud rate: 115200 @ 16 MHz */
-    UART_IBRD_R = 8;
-    UART_FBRD_R = 44;
+    /* 4. Baud rate: UART5_DEFAULT_BAUD from the current system clock
+     *    (IBRD = 8, FBRD = 44 at 16 MHz) */
+    divisor = UART5_BaudDivisor(UART5_DEFAULT_BAUD, &hse);
+    UART_IBRD_R = divisor >> 6;
+    UART_FBRD_R = divisor & 0x3FU;
+    uartBaud = UART5_DEFAULT_BAUD;
 
     /* 5. 8N1 + FIFO */
     UART_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;
 
-    /* 6. Enable UART, TX, RX */
-    UART_CTL_R = UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE;
+    /* 6. Interrupts: RX at 1/2 full + receive time-out for the tail of a
+     *    burst, TX refill when the FIFO drains to 1/2 */
+    rx_head = rx_tail = 0;
+    tx_head = tx_tail = 0;
+    if (mode == UART5_MODE_INTERRUPT)
+    {
+        UART_IFLS_R = UART_IFLS_RX4_8 | UART_IFLS_TX4_8;
+        UART_ICR_R  = 0x7F2;
+        UART_IM_R   = UART_IM_RXIM | UART_IM_RTIM | UART_IM_OEIM;
+        NVIC_PRI15_R = (NVIC_PRI15_R & ~UART5_NVIC_PRI_MASK) | UART5_NVIC_PRI;
+        NVIC_EN1_R   = UART5_NVIC_EN_BIT;
+    }
+    else
+    {
+        UART_IM_R  = 0;
+        NVIC_DIS1_R = UART5_NVIC_EN_BIT;
+    }
+
+    /* 7. Enable UART, TX, RX */
+    UART_CTL_R = hse | UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE;
+}
+
+/* ================= Baud Rate ================= */
+
+uint32_t UART5_CheckBaudRate(uint32_t baud)
+{
+    uint32_t hse;
+    uint32_t divisor = UART5_BaudDivisor(baud, &hse);
+
+    if (divisor == 0U)
+    {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)SysCtl_GetClock() * (hse ? 8U : 4U)) / divisor);
+}
+
+uint32_t UART5_SetBaudRate(uint32_t baud)
+{
+    uint32_t hse;
+    uint32_t divisor = UART5_BaudDivisor(baud, &hse);
+
+    if (divisor == 0U)
+    {
+        return 0;
+    }
+
+    /* Let queued bytes leave at the old rate */
+    while (UART5_TxPending() != 0U);
+    while (UART_FR_R & UART_FR_BUSY);
+
+    /* The divisor is latched by the LCRH write, with the UART disabled */
+    UART_CTL_R &= ~UART_CTL_UARTEN;
+    UART_IBRD_R = divisor >> 6;
+    UART_FBRD_R = divisor & 0x3FU;
+    UART_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;
+    UART_CTL_R = (UART_CTL_R & ~UART_CTL_HSE) | hse | UART_CTL_UARTEN;
+
+    uartBaud = baud;
+    return UART5_CheckBaudRate(baud);
+}
+
+uint32_t UART5_GetBaudRate(void)
+{
+    return uartBaud;
+}
+
+/* ================= Interrupt Handler ================= */
+
+void UART5_Handler(void)
+{
+    uint32_t status = UART_MIS_R;
+
+    UART_ICR_R = status;
+
+    if (status & (UART_MIS_RXMIS | UART_MIS_RTMIS | UART_MIS_OEMIS))
+    {
+        if (status & UART_MIS_OEMIS)
+        {
+            rx_overflow_count++;
+        }
+        UART5_DrainRxFifo();
+    }
+
+    if (status & UART_MIS_TXMIS)
+    {
+        UART5_FillTxFifo();
+    }
+}
+
+/* ================= Non-blocking APIs ================= */
+
+uint32_t UART5_Read(uint8_t *buf, uint32_t len)
+{
+    uint32_t count = 0;
+
+    if (uartMode != UART5_MODE_INTERRUPT)
+    {
+        while ((count < len) && ((UART_FR_R & UART_FR_RXFE) == 0U))
+        {
+            buf[count++] = (uint8_t)(UART_DR_R & 0xFF);
+        }
+        return count;
+    }
+
+    while ((count < len) && (RX_COUNT() != 0U))
+    {
+        buf[count++] = rx_buffer[rx_tail & (UART5_RX_BUFFER_SIZE - 1U)];
+        rx_tail++;
+    }
+    return count;
+}
+
+uint32_t UART5_Write(const uint8_t *buf, uint32_t len)
+{
+    uint32_t count = 0;
+
+    if (uartMode != UART5_MODE_INTERRUPT)
+    {
+        while ((count < len) && ((UART_FR_R & UART_FR_TXFF) == 0U))
+        {
+            UART_DR_R = buf[count++];
+        }
+        return count;
+    }
+
+    while ((count < len) && (TX_COUNT() < UART5_TX_BUFFER_SIZE))
+    {
+        tx_buffer[tx_head & (UART5_TX_BUFFER_SIZE - 1U)] = buf[count++];
+        tx_head++;
+    }
+
+    /* Prime the FIFO with the ISR masked, then let TXIM refill it */
+    UART_IM_R &= ~UART_IM_TXIM;
+    UART5_FillTxFifo();
+    if (TX_COUNT() != 0U)
+    {
+        UART_IM_R |= UART_IM_TXIM;
+    }
+    return count;
+}
+
+uint32_t UART5_TxPending(void)
+{
+    if (uartMode != UART5_MODE_INTERRUPT)
+    {
+        return 0;
+    }
+    return TX_COUNT();
+}
+
+uint32_t UART5_GetRxOverflowCount(void)
+{
+    return rx_overflow_count;
+}
+
+uint32_t UART5_GetRxErrorCount(void)
+{
+    return rx_error_count;
 }
 
 /* ================= Blocking APIs ================= */
 
 void UART5_SendChar(char data)
 {
+    uint8_t byte = (uint8_t)data;
+
+    if (uartMode == UART5_MODE_INTERRUPT)
+    {
+        while (UART5_Write(&byte, 1) == 0);
+        return;
+    }
+
     while (UART_FR_R & UART_FR_TXFF);
     UART_DR_R = data;
 }
 
 char UART5_ReceiveChar(void)
 {
+    uint8_t byte;
+
+    if (uartMode == UART5_MODE_INTERRUPT)
+    {
+        while (UART5_Read(&byte, 1) == 0);
+        return (char)byte;
+    }
+
     while (UART_FR_R & UART_FR_RXFE);
     return (char)(UART_DR_R & 0xFF);
 }
@@ -66,6 +368,10 @@ void UART5_SendString(const char *str)
 
 uint8_t UART5_IsDataAvailable(void)
 {
+    if (uartMode == UART5_MODE_INTERRUPT)
+    {
+        return (RX_COUNT() != 0U);
+    }
     return ((UART_FR_R & UART_FR_RXFE) == 0);
 }
 
@@ -97,7 +403,6 @@ void UART5_SendUInt(uint32_t num)
     UART5_SendChar('\n'); 
 }
 
-
 uint32_t UART5_ReceiveUInt(void)
 {
     char c;
@@ -0,0 +1,57 @@
+/******************************************************************************
+ * File: host.h
+ * Module: Host Simulation
+ * Description: Services shared by the host (Linux) backends of both ECUs
+ *
+ * The host builds compile the real Application layer (HMI_main.c,
+ * ECU_main.c) and Shared/ sources unchanged and replace every MCAL/HAL
+ * driver with the host_*.c files in this directory. link_sim starts both
+ * ECU processes and carries their UART5 traffic (see host_link.h).
+ *
+ * Environment (set by link_sim, may be set by hand):
+ *   SIM_UART_FD   socket descriptor of this ECU's UART5
+ *   SIM_SPEED     time scale, 1 = real time, 10 = ten times faster
+ *   SIM_NAME      prefix for log lines ("HMI", "CTL")
+ ******************************************************************************/
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+/* Simulated core clock, used to convert timer ticks to time */
+#define HOST_SYSCLK_HZ          16000000U
+
+/*
+ * Host_Micros
+ * Simulated microseconds since start (scaled by SIM_SPEED).
+ */
+uint64_t Host_Micros(void);
+
+/*
+ * Host_Log
+ * printf-style line on stdout, prefixed with SIM_NAME and simulated time.
+ */
+void Host_Log(const char *format, ...);
+
+/*
+ * Host_Flush
+ * Called whenever the application waits (DelayMs, key scan); each ECU
+ * backend uses it to publish deferred output such as the LCD contents.
+ */
+void Host_Flush(void);
+
+/*
+ * Host_CheckReset
+ * Restarts the process image when the application requested a system
+ * reset through NVIC_APINT_R, like the SYSRESETREQ bit on target.
+ */
+void Host_CheckReset(void);
+
+/*
+ * Host_Restart
+ * Logs reason and restarts the process image, as a reset would.
+ */
+void Host_Restart(const char *reason);
+
+#endif /* HOST_H_ */
@@ -0,0 +1,221 @@
+/******************************************************************************
+ * File: host_control_hal.c
+ * Module: Host Simulation
+ * Description: Control_ECU peripherals on the host - motor, buzzer, door
+ *              LEDs and GPTM Timer0A. Actuator changes are logged.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include "host.h"
+#include "dio.h"
+#include "adc.h"
+#include "Buzzer.h"
+#include "motor.h"
+#include "systick.h"
+#include "GPTM_TIMER0.h"
+#include "GPTM_TIMER1.h"
+
+static uint8_t port_f = 0;              /* door / status LEDs */
+static uint8_t motor = MOTOR_STOPPED;
+static uint8_t buzzer = 0;
+static uint32_t buzzer_end = 0;
+static uint8_t buzzer_async = 0;
+static uint64_t timer0_start_us = 0;
+static uint64_t timer0_period_us = 0;
+static uint32_t timer0_reload = 0;
+static uint8_t timer0_running = 0;
+
+void Host_Flush(void)
+{
+}
+
+/******************************************************************************
+ *                          Motor / Buzzer                                     *
+ ******************************************************************************/
+
+void Motor_Init(void)
+{
+}
+
+void Motor_RotateCW(void)
+{
+    motor = MOTOR_CW;
+    Host_Log("MOTOR CW");
+}
+
+void Motor_RotateCCW(void)
+{
+    motor = MOTOR_CCW;
+    Host_Log("MOTOR CCW");
+}
+
+void Motor_Stop(void)
+{
+    motor = MOTOR_STOPPED;
+    Host_Log("MOTOR STOP");
+}
+
+uint8_t Motor_GetDirection(void)
+{
+    return motor;
+}
+
+void Buzzer_Init(void)
+{
+}
+
+void Buzzer_On(void)
+{
+    buzzer = 1;
+    Host_Log("BUZZER ON");
+}
+
+void Buzzer_Off(void)
+{
+    buzzer = 0;
+    Host_Log("BUZZER OFF");
+}
+
+void Buzzer_Beep(uint32_t duration_ms)
+{
+    Buzzer_On();
+    DelayMs(duration_ms);
+    Buzzer_Off();
+}
+
+void Buzzer_BeepAsync(uint32_t duration_ms)
+{
+    Buzzer_On();
+    buzzer_end = SysTick_GetMs() + duration_ms;
+    buzzer_async = 1;
+}
+
+void Buzzer_Task(void)
+{
+    if (buzzer_async && (int32_t)(SysTick_GetMs() - buzzer_end) >= 0)
+    {
+        buzzer_async = 0;
+        Buzzer_Off();
+    }
+}
+
+uint8_t Buzzer_IsOn(void)
+{
+    return buzzer;
+}
+
+/******************************************************************************
+ *                          GPTM Timer0A                                       *
+ ******************************************************************************/
+
+void GPTM_Timer0A_Init(uint32_t reloadValue)
+{
+    timer0_reload = reloadValue;
+    timer0_period_us = ((uint64_t)reloadValue * 1000000ULL) / HOST_SYSCLK_HZ;
+    timer0_start_us = Host_Micros();
+    timer0_running = 1;
+}
+
+uint8_t GPTM_Timer0A_TimeOut(void)
+{
+    return timer0_running && (Host_Micros() - timer0_start_us) >= timer0_period_us;
+}
+
+void GPTM_Timer0A_ClearFlag(void)
+{
+    /* Periodic mode: the next time-out is one period later */
+    if (GPTM_Timer0A_TimeOut())
+    {
+        timer0_start_us += timer0_period_us;
+    }
+}
+
+uint32_t GPTM_Timer0A_Remaining(void)
+{
+    uint64_t elapsed = Host_Micros() - timer0_start_us;
+    uint64_t ticks = (elapsed * HOST_SYSCLK_HZ) / 1000000ULL;
+
+    return (ticks >= timer0_reload) ? 0U : (uint32_t)(timer0_reload - ticks);
+}
+
+/******************************************************************************
+ *                          GPTM Timer1A                                       *
+ ******************************************************************************/
+
+static uint64_t timer1_start_us = 0;
+static uint8_t timer1_running = 0;
+
+void GPTM_Timer1A_Init(void)
+{
+    if (!timer1_running)
+    {
+        timer1_start_us = Host_Micros();
+        timer1_running = 1;
+    }
+}
+
+uint32_t GPTM_Timer1A_Read(void)
+{
+    return (uint32_t)((Host_Micros() - timer1_start_us) * (HOST_SYSCLK_HZ / 1000000U));
+}
+
+/******************************************************************************
+ *                          DIO / ADC                                          *
+ ******************************************************************************/
+
+void DIO_Init(uint8_t port, uint8_t pin, uint8_t direction)
+{
+    (void)port; (void)pin; (void)direction;
+}
+
+void DIO_WritePin(uint8_t port, uint8_t pin, uint8_t value)
+{
+    uint8_t next;
+
+    if (port != PORTF)
+    {
+        return;
+    }
+
+    next = value ? (uint8_t)(port_f | (1U << pin)) : (uint8_t)(port_f & ~(1U << pin));
+    if (next != port_f)
+    {
+        port_f = next;
+        Host_Log("LED PF%u=%u", pin, value ? 1U : 0U);
+    }
+}
+
+uint8_t DIO_ReadPin(uint8_t port, uint8_t pin)
+{
+    return (port == PORTF) ? ((port_f >> pin) & 1U) : HIGH;
+}
+
+void DIO_TogglePin(uint8_t port, uint8_t pin)
+{
+    DIO_WritePin(port, pin, !DIO_ReadPin(port, pin));
+}
+
+void DIO_SetPUR(uint8_t port, uint8_t pin, uint8_t enable)
+{
+    (void)port; (void)pin; (void)enable;
+}
+
+void DIO_SetPDR(uint8_t port, uint8_t pin, uint8_t enable)
+{
+    (void)port; (void)pin; (void)enable;
+}
+
+void ADC_Init(uint8_t channel)
+{
+    (void)channel;
+}
+
+uint16_t ADC_Read(void)
+{
+    return 0;
+}
+
+uint32_t ADC_ToMillivolts(uint16_t adcValue)
+{
+    return ((uint32_t)adcValue * 3300U) / ADC_MAX_VALUE;
+}
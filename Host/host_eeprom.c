@@ -0,0 +1,646 @@
+/******************************************************************************
+ * File: host_eeprom.c
+ * Module: Host Simulation
+ * Description: eeprom.h API on a file-backed image of the 2 KB EEPROM
+ *
+ * The image has the geometry of the device, 32 blocks of 16 words, and is
+ * mmap'd from SIM_EEPROM_FILE (created erased, all 0xFFFFFFFF, if missing
+ * or of the wrong size), so every programmed word is in the file at once
+ * and survives a restart or a crash of the simulation. Without
+ * SIM_EEPROM_FILE the image is anonymous memory and starts erased.
+ *
+ * Every word program goes through Host_EepromProgram, which applies the
+ * model (also settable through host_eeprom.h):
+ *   SIM_EEPROM_WORD_US     program time of one word in simulated us
+ *                          (default HOST_EEPROM_WORD_US, 0 = no delay):
+ *                          the blocking calls wait for it, the
+ *                          EEPROM_Submit queue programs one word per
+ *                          period
+ *   SIM_EEPROM_POWER_LOSS  N: power fails during the Nth word program
+ *                          (1 = the first). That word keeps a mix of its
+ *                          old and new bits and the process restarts as
+ *                          from a reset, without this variable.
+ * A mass erase is EEPROM_EraseBlock on every block, as on the target:
+ * each word not already erased is one program, where the power can fail.
+ *
+ * Next to the image, SIM_EEPROM_FILE.wear holds the lifetime program
+ * count of every word, the ground truth for the firmware's own wear
+ * table; link_sim --eeprom-stats prints it. EEPROM_GetProfile times
+ * programs in simulated system clock cycles.
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "eeprom.h"
+#include "host.h"
+#include "host_eeprom.h"
+
+#define HOST_EEPROM_WORDS       (EEPROM_TOTAL_BLOCKS * EEPROM_BLOCK_SIZE)
+#define HOST_EEPROM_ERASED      0xFFFFFFFFU
+#define HOST_EEPROM_WORD_US     110U            /* a word program on target, roughly */
+
+/* Queue entry states, as on target */
+#define HOST_REQ_FREE           0
+#define HOST_REQ_QUEUED         1
+#define HOST_REQ_DONE           2
+
+typedef struct
+{
+    uint32_t        first;                      /* word address */
+    uint32_t        words[EEPROM_QUEUE_WORDS];
+    uint64_t        start_us;
+    uint64_t        deadline_us;
+    EEPROM_Callback done;
+    uint8_t         count;
+    uint8_t         next;
+    uint8_t         written;
+    uint8_t         result;
+    uint8_t         state;
+} Host_EepromRequest;
+
+static uint32_t *image = NULL;                  /* HOST_EEPROM_WORDS words */
+static uint32_t *wear = NULL;                   /* programs of each word, lifetime */
+static uint32_t  block_writes[EEPROM_TOTAL_BLOCKS];
+static EEPROM_Profile profile;
+static uint8_t   powered = 0;                   /* 0 after a power loss */
+static uint32_t  word_us = HOST_EEPROM_WORD_US;
+static uint32_t  power_loss_at = 0;
+static uint32_t  programs = 0;
+static uint64_t  busy_until_us = 0;             /* end of the word in progress */
+static void    (*power_loss_handler)(void) = NULL;
+
+static Host_EepromRequest requests[EEPROM_QUEUE_SIZE];
+static uint8_t request_active = 0;
+static uint8_t request_submit = 0;
+static uint8_t request_report = 0;
+static uint8_t request_count = 0;
+
+/******************************************************************************
+ *                          Image and model                                    *
+ ******************************************************************************/
+
+static uint32_t Host_EepromEnv(const char *name, uint32_t fallback)
+{
+    const char *env = getenv(name);
+
+    return (env != NULL) ? (uint32_t)strtoul(env, NULL, 0) : fallback;
+}
+
+/*
+ * Host_EepromMapFile
+ * Maps size bytes of path (created or resized as needed, *fresh set), or
+ * anonymous memory (*fresh set) if path is NULL.
+ */
+static void *Host_EepromMapFile(const char *path, size_t size, uint8_t *fresh)
+{
+    struct stat st;
+    void *map;
+    int fd = -1;
+
+    *fresh = 1;
+    if (path != NULL)
+    {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0)
+        {
+            perror(path);
+        }
+    }
+    if (fd >= 0)
+    {
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size == size)
+        {
+            *fresh = 0;
+        }
+        else if (ftruncate(fd, (off_t)size) != 0)
+        {
+            perror(path);
+        }
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    else
+    {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    return map;
+}
+
+static void Host_EepromMap(void)
+{
+    const char *path = getenv("SIM_EEPROM_FILE");
+    const size_t size = HOST_EEPROM_WORDS * sizeof(uint32_t);
+    char wear_path[PATH_MAX];
+    uint8_t fresh;
+
+    word_us = Host_EepromEnv("SIM_EEPROM_WORD_US", HOST_EEPROM_WORD_US);
+    power_loss_at = Host_EepromEnv("SIM_EEPROM_POWER_LOSS", 0U);
+
+    image = Host_EepromMapFile(path, size, &fresh);
+    if (fresh)
+    {
+        memset(image, 0xFF, size);
+    }
+    if (path != NULL)
+    {
+        snprintf(wear_path, sizeof(wear_path), "%s%s", path, HOST_EEPROM_WEAR_SUFFIX);
+    }
+    wear = Host_EepromMapFile((path != NULL) ? wear_path : NULL, size, &fresh);
+    if (fresh)
+    {
+        memset(wear, 0, size);
+    }
+    powered = 1;
+}
+
+/* Maps the image on first use; returns 0 while the power is off */
+static uint8_t Host_EepromReady(void)
+{
+    if (image == NULL)
+    {
+        Host_EepromMap();
+    }
+    return powered;
+}
+
+static void Host_EepromRestart(void)
+{
+    char reason[64];
+
+    snprintf(reason, sizeof(reason), "EEPROM power loss at word program %u", (unsigned)programs);
+    unsetenv("SIM_EEPROM_POWER_LOSS");
+    Host_Restart(reason);
+}
+
+/* Counts a program operation; returns 1 if the power fails during it */
+static uint8_t Host_EepromPowerFails(void)
+{
+    programs++;
+    return programs == power_loss_at;
+}
+
+static void Host_EepromPowerOff(void)
+{
+    powered = 0;
+    memset(requests, 0, sizeof(requests));
+    request_active = request_submit = request_report = request_count = 0;
+    if (power_loss_handler != NULL)
+    {
+        power_loss_handler();
+    }
+    else
+    {
+        Host_EepromRestart();
+    }
+}
+
+/* Waits out the program time of count words */
+static void Host_EepromWait(uint32_t count)
+{
+    uint64_t until;
+
+    if (word_us == 0U)
+    {
+        return;
+    }
+    until = Host_Micros() + (uint64_t)word_us * count;
+    while (Host_Micros() < until)
+    {
+    }
+}
+
+/* Simulated system clock cycles of a duration in us */
+static uint32_t Host_EepromCycles(uint64_t us)
+{
+    return (uint32_t)(us * (HOST_SYSCLK_HZ / 1000000U));
+}
+
+/* Records one program of the given duration in the profile */
+static void Host_EepromTimed(uint64_t us)
+{
+    uint32_t cycles = Host_EepromCycles(us);
+
+    profile.programs++;
+    profile.program_cycles += cycles;
+    if (cycles > profile.program_max)
+    {
+        profile.program_max = cycles;
+    }
+}
+
+/* Counts a program of one word in the wear and the profile */
+static void Host_EepromCount(uint32_t address)
+{
+    wear[address]++;
+    block_writes[address / EEPROM_BLOCK_SIZE]++;
+    profile.writes++;
+}
+
+static uint8_t Host_EepromProgram(uint32_t address, uint32_t word)
+{
+    uint32_t mask;
+
+    if (!powered)
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromCount(address);
+    if (Host_EepromPowerFails())
+    {
+        mask = programs * 0x9E3779B9U;          /* which bits made it */
+        image[address] = (image[address] & ~mask) | (word & mask);
+        Host_EepromPowerOff();
+        return EEPROM_ERROR;
+    }
+    image[address] = word;
+    return EEPROM_SUCCESS;
+}
+
+static uint8_t Host_EepromInRange(uint32_t block, uint32_t offset, uint32_t count)
+{
+    return block < EEPROM_TOTAL_BLOCKS && offset < EEPROM_BLOCK_SIZE &&
+           count <= HOST_EEPROM_WORDS - (block * EEPROM_BLOCK_SIZE + offset);
+}
+
+static uint32_t Host_EepromPack(const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0] |
+           ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) |
+           ((uint32_t)bytes[3] << 24);
+}
+
+/******************************************************************************
+ *                          Write queue                                        *
+ ******************************************************************************/
+
+static void Host_EepromFinish(Host_EepromRequest *request)
+{
+    profile.request_last = Host_EepromCycles(Host_Micros() - request->start_us);
+    if (profile.request_last > profile.request_max)
+    {
+        profile.request_max = profile.request_last;
+    }
+    request->state = HOST_REQ_DONE;
+    request_active = (uint8_t)((request_active + 1U) % EEPROM_QUEUE_SIZE);
+    request_count--;
+}
+
+/*
+ * Host_EepromRun
+ * Advances the queue to the current time: programs the next differing
+ * word whenever the previous one has had its word time, finishes requests
+ * and enforces their deadlines.
+ */
+static void Host_EepromRun(void)
+{
+    Host_EepromRequest *request;
+    uint64_t now = Host_Micros();
+
+    while (request_count > 0 && powered)
+    {
+        request = &requests[request_active];
+        if (now - request->start_us > request->deadline_us)
+        {
+            request->result = EEPROM_TIMEOUT;
+            Host_EepromFinish(request);
+            continue;
+        }
+        while (request->next < request->count &&
+               image[request->first + request->next] == request->words[request->next])
+        {
+            request->next++;
+            profile.skipped++;
+        }
+        if (busy_until_us > now)
+        {
+            return;
+        }
+        if (request->next == request->count)
+        {
+            Host_EepromFinish(request);
+            continue;
+        }
+        if (Host_EepromProgram(request->first + request->next, request->words[request->next]) != EEPROM_SUCCESS)
+        {
+            return;                             /* power lost, queue gone */
+        }
+        request->next++;
+        request->written++;
+        busy_until_us = now + word_us;
+        Host_EepromTimed(word_us);
+    }
+}
+
+/* Lets the queue run dry before a blocking call, as on target, including
+ * the last word of a request that expired while it was programming */
+static void Host_EepromDrain(void)
+{
+    while (request_count > 0 && powered)
+    {
+        Host_EepromRun();
+    }
+    while (Host_Micros() < busy_until_us && powered)
+    {
+    }
+}
+
+/******************************************************************************
+ *                          eeprom.h API                                       *
+ ******************************************************************************/
+
+uint8_t EEPROM_Init(void)
+{
+    if (image == NULL)
+    {
+        Host_EepromMap();
+    }
+    powered = 1;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_WriteWord(uint32_t block, uint32_t offset, uint32_t data)
+{
+    if (!Host_EepromInRange(block, offset, 1) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    if (Host_EepromProgram(block * EEPROM_BLOCK_SIZE + offset, data) != EEPROM_SUCCESS)
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromWait(1);
+    Host_EepromTimed(word_us);
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_ReadWord(uint32_t block, uint32_t offset, uint32_t *data)
+{
+    if (data == 0 || !Host_EepromInRange(block, offset, 1) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    *data = image[block * EEPROM_BLOCK_SIZE + offset];
+    profile.reads++;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_WriteBurst(uint32_t block, uint32_t offset, const uint32_t *words, uint32_t count)
+{
+    uint32_t first = block * EEPROM_BLOCK_SIZE + offset;
+    uint32_t i;
+
+    if (words == 0 || !Host_EepromInRange(block, offset, count) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    for (i = 0; i < count; i++)
+    {
+        if (Host_EepromProgram(first + i, words[i]) != EEPROM_SUCCESS)
+        {
+            return EEPROM_ERROR;
+        }
+        Host_EepromWait(1);
+        Host_EepromTimed(word_us);
+    }
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_ReadBurst(uint32_t block, uint32_t offset, uint32_t *words, uint32_t count)
+{
+    if (words == 0 || !Host_EepromInRange(block, offset, count) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    memcpy(words, &image[block * EEPROM_BLOCK_SIZE + offset], count * sizeof(uint32_t));
+    profile.reads += count;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_WriteBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length)
+{
+    uint32_t words[HOST_EEPROM_WORDS];
+    uint32_t i;
+
+    if (buffer == 0 || (length % 4) != 0 || length / 4 > HOST_EEPROM_WORDS)
+    {
+        return EEPROM_ERROR;
+    }
+    for (i = 0; i < length / 4; i++)
+    {
+        words[i] = Host_EepromPack(&buffer[i * 4]);
+    }
+    return EEPROM_WriteBurst(block, offset, words, length / 4);
+}
+
+uint8_t EEPROM_UpdateBuffer(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                            uint32_t *written)
+{
+    uint32_t first = block * EEPROM_BLOCK_SIZE + offset;
+    uint32_t count = 0;
+    uint32_t word;
+    uint32_t i;
+    uint8_t result = EEPROM_SUCCESS;
+
+    if (buffer == 0 || (length % 4) != 0 ||
+        !Host_EepromInRange(block, offset, length / 4) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    for (i = 0; i < length / 4 && result == EEPROM_SUCCESS; i++)
+    {
+        word = Host_EepromPack(&buffer[i * 4]);
+        if (image[first + i] != word)
+        {
+            result = Host_EepromProgram(first + i, word);
+            Host_EepromWait(1);
+            Host_EepromTimed(word_us);
+            count++;
+        }
+        else
+        {
+            profile.skipped++;
+        }
+    }
+    if (written != 0)
+    {
+        *written = count;
+    }
+    return result;
+}
+
+uint8_t EEPROM_ReadBuffer(uint32_t block, uint32_t offset, uint8_t *buffer, uint32_t length)
+{
+    uint32_t first = block * EEPROM_BLOCK_SIZE + offset;
+    uint32_t word;
+    uint32_t i;
+
+    if (buffer == 0 || (length % 4) != 0 ||
+        !Host_EepromInRange(block, offset, length / 4) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    for (i = 0; i < length; i += 4)
+    {
+        word = image[first + i / 4];
+        buffer[i]   = (uint8_t)(word & 0xFF);
+        buffer[i+1] = (uint8_t)((word >> 8) & 0xFF);
+        buffer[i+2] = (uint8_t)((word >> 16) & 0xFF);
+        buffer[i+3] = (uint8_t)((word >> 24) & 0xFF);
+    }
+    profile.reads += length / 4;
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_EraseBlock(uint32_t block)
+{
+    uint32_t i;
+
+    if (!Host_EepromInRange(block, 0, EEPROM_BLOCK_SIZE) || !Host_EepromReady())
+    {
+        return EEPROM_ERROR;
+    }
+    Host_EepromDrain();
+    for (i = block * EEPROM_BLOCK_SIZE; i < (block + 1U) * EEPROM_BLOCK_SIZE; i++)
+    {
+        if (image[i] == HOST_EEPROM_ERASED)
+        {
+            profile.skipped++;
+            continue;
+        }
+        if (Host_EepromProgram(i, HOST_EEPROM_ERASED) != EEPROM_SUCCESS)
+        {
+            return EEPROM_ERROR;
+        }
+        Host_EepromWait(1);
+        Host_EepromTimed(word_us);
+    }
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_MassErase(void)
+{
+    uint32_t block;
+
+    for (block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        if (EEPROM_EraseBlock(block) != EEPROM_SUCCESS)
+        {
+            return EEPROM_ERROR;
+        }
+    }
+    return EEPROM_SUCCESS;
+}
+
+uint8_t EEPROM_Submit(uint32_t block, uint32_t offset, const uint8_t *buffer, uint32_t length,
+                      uint32_t deadline_us, EEPROM_Callback done)
+{
+    Host_EepromRequest *request = &requests[request_submit];
+    uint32_t i;
+
+    if (buffer == 0 || (length % 4) != 0 || length == 0 || length > EEPROM_QUEUE_WORDS * 4 ||
+        !Host_EepromInRange(block, offset, length / 4) || !Host_EepromReady() ||
+        request->state != HOST_REQ_FREE)
+    {
+        return EEPROM_ERROR;
+    }
+
+    request->first = block * EEPROM_BLOCK_SIZE + offset;
+    for (i = 0; i < length / 4; i++)
+    {
+        request->words[i] = Host_EepromPack(&buffer[i * 4]);
+    }
+    request->count = (uint8_t)(length / 4);
+    request->next = 0;
+    request->written = 0;
+    request->result = EEPROM_SUCCESS;
+    request->done = done;
+    request->start_us = Host_Micros();
+    request->deadline_us = deadline_us;
+    request->state = HOST_REQ_QUEUED;
+    request_submit = (uint8_t)((request_submit + 1U) % EEPROM_QUEUE_SIZE);
+    request_count++;
+
+    Host_EepromRun();
+    return EEPROM_SUCCESS;
+}
+
+void EEPROM_Task(void)
+{
+    Host_EepromRequest *request;
+
+    Host_EepromRun();
+    while (requests[request_report].state == HOST_REQ_DONE)
+    {
+        request = &requests[request_report];
+        request->state = HOST_REQ_FREE;
+        request_report = (uint8_t)((request_report + 1U) % EEPROM_QUEUE_SIZE);
+        if (request->done != 0)
+        {
+            request->done(request->result, request->written);
+        }
+    }
+}
+
+void EEPROM_GetProfile(EEPROM_Profile *profile_out)
+{
+    if (profile_out != 0)
+    {
+        *profile_out = profile;
+    }
+}
+
+uint32_t EEPROM_BlockWrites(uint32_t block)
+{
+    return (block < EEPROM_TOTAL_BLOCKS) ? block_writes[block] : 0U;
+}
+
+/******************************************************************************
+ *                          host_eeprom.h API                                  *
+ ******************************************************************************/
+
+void Host_EepromSetModel(uint32_t word_time_us, uint32_t loss_at)
+{
+    (void)Host_EepromReady();
+    word_us = word_time_us;
+    power_loss_at = loss_at;
+    programs = 0;
+}
+
+void Host_EepromSetPowerLossHandler(void (*handler)(void))
+{
+    power_loss_handler = handler;
+}
+
+uint32_t Host_EepromPrograms(void)
+{
+    return programs;
+}
+
+uint32_t Host_EepromWordWear(uint32_t block, uint32_t offset)
+{
+    if (!Host_EepromInRange(block, offset, 1))
+    {
+        return 0U;
+    }
+    (void)Host_EepromReady();
+    return wear[block * EEPROM_BLOCK_SIZE + offset];
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * File: host_eeprom.h
+ * Module: Host Simulation
+ * Description: Controls of the host EEPROM emulator (host_eeprom.c) for
+ *              test programs
+ *
+ * The simulation sets the same model through the environment (see
+ * host_eeprom.c); these calls override it at run time, e.g. for a stress
+ * program that cuts the power at every word in turn.
+ ******************************************************************************/
+
+#ifndef HOST_EEPROM_H_
+#define HOST_EEPROM_H_
+
+#include <stdint.h>
+
+/* Lifetime program count of every word, next to SIM_EEPROM_FILE: 512
+ * native uint32_t, block by block */
+#define HOST_EEPROM_WEAR_SUFFIX ".wear"
+
+/*
+ * Host_EepromSetModel
+ * Parameters:
+ *   word_us       - Program time of one word in simulated us (0 = none)
+ *   power_loss_at - Power fails during this word program, counted from
+ *                   this call (1 = the next one); 0 = never
+ */
+void Host_EepromSetModel(uint32_t word_us, uint32_t power_loss_at);
+
+/*
+ * Host_EepromSetPowerLossHandler
+ * Replaces what happens after the torn word is stored (default: restart
+ * the process like a reset). If the handler returns, or jumps out, every
+ * EEPROM call fails until the next EEPROM_Init, which powers the emulated
+ * device up again with an empty write queue.
+ */
+void Host_EepromSetPowerLossHandler(void (*handler)(void));
+
+/*
+ * Host_EepromPrograms
+ * Returns: word programs since the last
+ *          Host_EepromSetModel, or since start
+ */
+uint32_t Host_EepromPrograms(void);
+
+/*
+ * Host_EepromWordWear
+ * Returns: programs of one word over the life of the image (persisted in
+ *          SIM_EEPROM_FILE.wear), 0 for a word out of range
+ */
+uint32_t Host_EepromWordWear(uint32_t block, uint32_t offset);
+
+#endif /* HOST_EEPROM_H_ */
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * File: host_eeprom_regs.h
+ * Module: Host Simulation
+ * Description: Register-level stand-in for the EEPROM module, to test the
+ *              target driver (Control_ECU/MCAL/eeprom.c) on the host
+ *
+ * The simulations replace the driver with host_eeprom.c; the driver tests
+ * compile the real one against these registers instead. Force-include it
+ * (-include host_eeprom_regs.h): it claims the include guard of the device
+ * header, so the driver's own #include "tm4c123gh6pm.h" is skipped.
+ *
+ * EERDWR and EERDWRINC read and write the word at EEBLOCK/EEOFFSET of
+ * HOST_EE_WORDS; EERDWRINC then moves EEOFFSET on and, as on target, wraps
+ * it to 0 within the same block. Every other register is plain memory and
+ * EEDONE never reports WORKING, so each program completes at once.
+ ******************************************************************************/
+
+#ifndef HOST_EEPROM_REGS_H_
+#define HOST_EEPROM_REGS_H_
+
+#define __TM4C123GH6PM_H__
+
+#include <stdint.h>
+
+#define HOST_EE_WORDS           512
+
+extern uint32_t HOST_EE_IMAGE[HOST_EE_WORDS];
+extern volatile uint32_t HOST_EE_REG[16];
+
+/* Word at EEBLOCK/EEOFFSET; the Inc form moves EEOFFSET on afterwards */
+volatile uint32_t *Host_EeRdWr(void);
+volatile uint32_t *Host_EeRdWrInc(void);
+
+#define EEPROM_EEBLOCK_R        HOST_EE_REG[0]
+#define EEPROM_EEOFFSET_R       HOST_EE_REG[1]
+#define EEPROM_EEDONE_R         HOST_EE_REG[2]
+#define EEPROM_EESUPP_R         HOST_EE_REG[3]
+#define EEPROM_EEINT_R          HOST_EE_REG[4]
+#define FLASH_FCIM_R            HOST_EE_REG[6]
+#define FLASH_FCMISC_R          HOST_EE_REG[7]
+#define NVIC_EN0_R              HOST_EE_REG[8]
+#define NVIC_DIS0_R             HOST_EE_REG[9]
+#define NVIC_PRI7_R             HOST_EE_REG[10]
+#define SYSCTL_RCGCEEPROM_R     HOST_EE_REG[11]
+#define EEPROM_EERDWR_R         (*Host_EeRdWr())
+#define EEPROM_EERDWRINC_R      (*Host_EeRdWrInc())
+
+#define EEPROM_EEINT_INT        0x00000001
+#define EEPROM_EESUPP_ERETRY    0x00000004
+#define EEPROM_EESUPP_PRETRY    0x00000008
+#define FLASH_FCIM_EMASK        0x00000004
+#define FLASH_FCMISC_EMISC      0x00000004
+
+#endif /* HOST_EEPROM_REGS_H_ */
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * File: host_hmi_hal.c
+ * Module: Host Simulation
+ * Description: HMI_ECU peripherals on the host - LCD, keypad, potentiometer
+ *
+ *   LCD     a 2x16 frame buffer, printed whenever it changed and the
+ *           application waits (DelayMs or a key scan)
+ *   Keypad  one character of stdin per scan: 0-9 A-D * # are keys, '.'
+ *           is an idle scan (no key), whitespace is skipped. stdin at EOF
+ *           means no key is pressed.
+ *   POT     fixed reading from SIM_POT (0..4095, default mid-scale)
+ *   Timer1  free-running at HOST_SYSCLK_HZ on the (scaled) host clock
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+#include "dio.h"
+#include "adc.h"
+#include "lcd.h"
+#include "keypad.h"
+#include "potentiometer.h"
+#include "GPTM_TIMER1.h"
+
+#define LCD_ROWS        2
+#define LCD_COLS        16
+
+static char lcd[LCD_ROWS][LCD_COLS + 1];
+static char lcd_shown[LCD_ROWS][LCD_COLS + 1];
+static uint8_t lcd_row = 0;
+static uint8_t lcd_col = 0;
+
+static int keys_eof = 0;
+
+void Host_Flush(void)
+{
+    if (memcmp(lcd, lcd_shown, sizeof(lcd)) != 0)
+    {
+        memcpy(lcd_shown, lcd, sizeof(lcd));
+        Host_Log("LCD |%s|%s|", lcd[0], lcd[1]);
+    }
+}
+
+/******************************************************************************
+ *                          LCD                                                *
+ ******************************************************************************/
+
+void LCD_Init(void)
+{
+    LCD_Clear();
+}
+
+void LCD_Clear(void)
+{
+    uint8_t row;
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        memset(lcd[row], ' ', LCD_COLS);
+        lcd[row][LCD_COLS] = '\0';
+    }
+    lcd_row = 0;
+    lcd_col = 0;
+}
+
+void LCD_SendCommand(uint8_t command)
+{
+    if (command == LCD_CLEAR)
+    {
+        LCD_Clear();
+    }
+    else if (command == LCD_HOME)
+    {
+        lcd_row = 0;
+        lcd_col = 0;
+    }
+}
+
+void LCD_SendData(uint8_t data)
+{
+    LCD_WriteChar((char)data);
+}
+
+void LCD_SetCursor(uint8_t row, uint8_t col)
+{
+    lcd_row = (row < LCD_ROWS) ? row : (LCD_ROWS - 1);
+    lcd_col = col;
+}
+
+void LCD_WriteChar(char c)
+{
+    if (lcd_col < LCD_COLS)
+    {
+        lcd[lcd_row][lcd_col] = c;
+    }
+    lcd_col++;
+}
+
+void LCD_WriteString(const char *str)
+{
+    while (*str)
+    {
+        LCD_WriteChar(*str++);
+    }
+}
+
+/******************************************************************************
+ *                          Keypad                                             *
+ ******************************************************************************/
+
+void Keypad_Init(void)
+{
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+}
+
+char Keypad_GetKey(void)
+{
+    char c;
+
+    Host_Flush();
+    while (!keys_eof)
+    {
+        ssize_t size = read(STDIN_FILENO, &c, 1);
+
+        if (size == 0)
+        {
+            keys_eof = 1;
+        }
+        if (size <= 0)
+        {
+            return 0;
+        }
+        if (c == '.')
+        {
+            return 0;
+        }
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'D') || c == '*' || c == '#')
+        {
+            Host_Log("KEY %c", c);
+            return c;
+        }
+    }
+    return 0;
+}
+
+/******************************************************************************
+ *                          Potentiometer / ADC                                *
+ ******************************************************************************/
+
+void ADC_Init(uint8_t channel)
+{
+    (void)channel;
+}
+
+uint16_t ADC_Read(void)
+{
+    const char *env = getenv("SIM_POT");
+    int value = (env != NULL) ? atoi(env) : (ADC_MAX_VALUE / 2);
+
+    if (value < 0)
+    {
+        value = 0;
+    }
+    return (uint16_t)((value > ADC_MAX_VALUE) ? ADC_MAX_VALUE : value);
+}
+
+uint32_t ADC_ToMillivolts(uint16_t adcValue)
+{
+    return ((uint32_t)adcValue * 3300U) / ADC_MAX_VALUE;
+}
+
+void POT_Init(void)
+{
+    ADC_Init(POT_ADC_CHANNEL);
+}
+
+uint16_t POT_ReadRaw(void)
+{
+    return ADC_Read();
+}
+
+uint32_t POT_ReadMillivolts(void)
+{
+    return ADC_ToMillivolts(ADC_Read());
+}
+
+uint8_t POT_ReadPercentage(void)
+{
+    return (uint8_t)(((uint32_t)ADC_Read() * 100U) / ADC_MAX_VALUE);
+}
+
+uint32_t POT_ReadMapped(uint32_t min, uint32_t max)
+{
+    return min + (((uint32_t)ADC_Read() * (max - min)) / ADC_MAX_VALUE);
+}
+
+/******************************************************************************
+ *                          DIO (LEDs)                                         *
+ ******************************************************************************/
+
+void DIO_Init(uint8_t port, uint8_t pin, uint8_t direction)
+{
+    (void)port; (void)pin; (void)direction;
+}
+
+void DIO_WritePin(uint8_t port, uint8_t pin, uint8_t value)
+{
+    (void)port; (void)pin; (void)value;
+}
+
+uint8_t DIO_ReadPin(uint8_t port, uint8_t pin)
+{
+    (void)port; (void)pin;
+    return HIGH;
+}
+
+void DIO_TogglePin(uint8_t port, uint8_t pin)
+{
+    (void)port; (void)pin;
+}
+
+void DIO_SetPUR(uint8_t port, uint8_t pin, uint8_t enable)
+{
+    (void)port; (void)pin; (void)enable;
+}
+
+void DIO_SetPDR(uint8_t port, uint8_t pin, uint8_t enable)
+{
+    (void)port; (void)pin; (void)enable;
+}
+
+/******************************************************************************
+ *                          GPTM Timer1A                                       *
+ ******************************************************************************/
+
+static uint64_t timer1_start_us = 0;
+static uint8_t timer1_running = 0;
+
+void GPTM_Timer1A_Init(void)
+{
+    if (!timer1_running)
+    {
+        timer1_start_us = Host_Micros();
+        timer1_running = 1;
+    }
+}
+
+uint32_t GPTM_Timer1A_Read(void)
+{
+    return (uint32_t)((Host_Micros() - timer1_start_us) * (HOST_SYSCLK_HZ / 1000000U));
+}
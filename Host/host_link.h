@@ -0,0 +1,31 @@
+/******************************************************************************
+ * File: host_link.h
+ * Module: Host Simulation
+ * Description: Records exchanged between an ECU's UART5 and link_sim
+ *
+ * Each ECU owns one end of a SOCK_SEQPACKET socket pair; link_sim owns the
+ * other end of both and relays bytes with the configured line model.
+ * Every byte travels as one record tagged with the sender's baud rate, so
+ * the relay can turn a byte sent at a rate the receiver is not listening
+ * at into a framing error, exactly what a mismatched UART would see.
+ ******************************************************************************/
+
+#ifndef HOST_LINK_H_
+#define HOST_LINK_H_
+
+#include <stdint.h>
+
+/* Record kinds */
+#define HOST_LINK_DATA          0       /* ECU -> relay -> ECU: one byte */
+#define HOST_LINK_BAUD          1       /* ECU -> relay: my rate changed */
+#define HOST_LINK_ERROR         2       /* relay -> ECU: byte with framing error */
+
+typedef struct
+{
+    uint8_t  kind;
+    uint8_t  data;
+    uint8_t  reserved[2];
+    uint32_t baud;                  /* sender's rate (DATA, BAUD) */
+} HOST_LinkRecord;
+
+#endif /* HOST_LINK_H_ */
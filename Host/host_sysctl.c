@@ -0,0 +1,13 @@
+/******************************************************************************
+ * File: host_sysctl.c
+ * Module: Host Simulation
+ * Description: System control of both ECUs: the simulated system clock
+ ******************************************************************************/
+
+#include "host.h"
+#include "sysctl.h"
+
+uint32_t SysCtl_GetClock(void)
+{
+    return HOST_SYSCLK_HZ;
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+ * File: host_systick.c
+ * Module: Host Simulation
+ * Description: SysTick driver and common services on the host clock
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "host.h"
+#include "systick.h"
+#include "tm4c123gh6pm.h"
+
+#define SYSRESETREQ_KEY         0x05FA0004U
+
+volatile uint32_t HOST_NVIC_APINT = 0;
+
+static uint64_t start_ns = 0;
+static uint32_t speed = 0;
+
+/******************************************************************************
+ *                          Host Services                                      *
+ ******************************************************************************/
+
+static uint64_t Host_RealNanos(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t Host_Micros(void)
+{
+    if (speed == 0U)
+    {
+        const char *env = getenv("SIM_SPEED");
+
+        speed = (env != NULL && atoi(env) > 0) ? (uint32_t)atoi(env) : 1U;
+        start_ns = Host_RealNanos();
+    }
+    return ((Host_RealNanos() - start_ns) * speed) / 1000ULL;
+}
+
+void Host_Log(const char *format, ...)
+{
+    const char *name = getenv("SIM_NAME");
+    uint64_t us = Host_Micros();
+    va_list args;
+
+    printf("[%s %7llu.%03llu] ", name != NULL ? name : "ECU",
+           (unsigned long long)(us / 1000000ULL),
+           (unsigned long long)((us / 1000ULL) % 1000ULL));
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    putchar('\n');
+    fflush(stdout);
+}
+
+void Host_Restart(const char *reason)
+{
+    Host_Log("%s", reason);
+    fflush(stdout);
+    /* Descriptors (SIM_UART_FD) and environment survive the exec */
+    execl("/proc/self/exe", "ecu_sim", (char *)NULL);
+    perror("execl");
+    exit(EXIT_FAILURE);
+}
+
+void Host_CheckReset(void)
+{
+    if (HOST_NVIC_APINT == SYSRESETREQ_KEY)
+    {
+        Host_Restart("system reset");
+    }
+}
+
+/******************************************************************************
+ *                          SysTick API                                        *
+ ******************************************************************************/
+
+void SysTick_Init(uint32_t reload, uint8_t mode)
+{
+    (void)reload;
+    (void)mode;
+    (void)Host_Micros();
+}
+
+uint32_t SysTick_GetMs(void)
+{
+    Host_CheckReset();
+    return (uint32_t)(Host_Micros() / 1000ULL);
+}
+
+void DelayMs(uint32_t ms)
+{
+    uint32_t start = SysTick_GetMs();
+    struct timespec pause = { 0, 0 };
+
+    Host_Flush();
+    while ((SysTick_GetMs() - start) < ms)
+    {
+        /* Sleep for the rest of the delay in real time, at most 10 ms */
+        uint32_t left = ms - (SysTick_GetMs() - start);
+        uint64_t real_us = ((uint64_t)left * 1000ULL) / speed;
+
+        pause.tv_nsec = (long)((real_us > 10000ULL ? 10000ULL : real_us + 1ULL) * 1000ULL);
+        nanosleep(&pause, NULL);
+    }
+}
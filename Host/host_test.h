@@ -0,0 +1,38 @@
+/******************************************************************************
+ * File: host_test.h
+ * Module: Host Simulation
+ * Description: Checks for the host test programs (make test)
+ *
+ * Each test_*.c is a program of its own: it runs its cases, reports every
+ * failed check with its line, and exits non-zero if any failed.
+ ******************************************************************************/
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+static unsigned host_test_failures = 0;
+
+/* Records a failed check and carries on with the test */
+#define HOST_CHECK(cond) \
+    ((cond) ? (void)0 : \
+     (void)(host_test_failures++, \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond)))
+
+/* Byte for byte comparison of two buffers */
+#define HOST_CHECK_MEM(a, b, n)     HOST_CHECK(memcmp((a), (b), (n)) == 0)
+
+/*
+ * Host_TestResult
+ * Prints the summary line of the program.
+ * Returns: exit status for main, 0 if every check passed
+ */
+static int Host_TestResult(const char *name)
+{
+    printf("%s: %s\n", name, host_test_failures ? "FAIL" : "ok");
+    return host_test_failures ? 1 : 0;
+}
+
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,234 @@
+/******************************************************************************
+ * File: host_uart.c
+ * Module: Host Simulation
+ * Description: UART5 driver backed by a link_sim socket (see host_link.h)
+ *
+ * Implements the uart.h API of both ECUs. Bytes leave immediately as
+ * records; line timing, loss and corruption are applied by link_sim.
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "host.h"
+#include "host_link.h"
+#include "uart.h"
+
+/* Fastest rate the simulated UART accepts (sysclk / 8 with HSE) */
+#define HOST_UART_MAX_BAUD      (HOST_SYSCLK_HZ / 8U)
+#define HOST_UART_MIN_BAUD      300U
+
+static int uartFd = -1;
+static uint32_t uartBaud = UART5_DEFAULT_BAUD;
+static uint32_t rx_overflow_count = 0;
+static uint32_t rx_error_count = 0;
+
+/* One byte of look-ahead for UART5_IsDataAvailable */
+static int peeked = -1;
+
+static void Host_UartSend(uint8_t kind, uint8_t data)
+{
+    HOST_LinkRecord record = { kind, data, { 0, 0 }, uartBaud };
+
+    while (send(uartFd, &record, sizeof(record), 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            exit(EXIT_SUCCESS);     /* link_sim is gone */
+        }
+    }
+}
+
+/* Returns the next received byte, or -1 if none is waiting */
+static int Host_UartReceive(void)
+{
+    HOST_LinkRecord record;
+    ssize_t size;
+
+    if (peeked >= 0)
+    {
+        int byte = peeked;
+        peeked = -1;
+        return byte;
+    }
+
+    while (1)
+    {
+        size = recv(uartFd, &record, sizeof(record), MSG_DONTWAIT);
+        if (size == 0)
+        {
+            exit(EXIT_SUCCESS);     /* link_sim closed the link */
+        }
+        if (size < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                exit(EXIT_SUCCESS);
+            }
+            sched_yield();          /* main loops spin on UART5_Read */
+            return -1;
+        }
+
+        if (record.kind == HOST_LINK_DATA)
+        {
+            return record.data;
+        }
+        if (record.kind == HOST_LINK_ERROR)
+        {
+            rx_error_count++;
+        }
+    }
+}
+
+void UART5_Init(void)
+{
+    UART5_InitMode(UART5_MODE_POLLING);
+}
+
+void UART5_InitMode(uint8_t mode)
+{
+    const char *env = getenv("SIM_UART_FD");
+
+    (void)mode;
+    if (env == NULL)
+    {
+        fprintf(stderr, "SIM_UART_FD not set - start the ECUs through link_sim\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uartFd = atoi(env);
+    peeked = -1;
+    uartBaud = UART5_DEFAULT_BAUD;
+    Host_UartSend(HOST_LINK_BAUD, 0);
+}
+
+uint32_t UART5_CheckBaudRate(uint32_t baud)
+{
+    return (baud >= HOST_UART_MIN_BAUD && baud <= HOST_UART_MAX_BAUD) ? baud : 0U;
+}
+
+uint32_t UART5_SetBaudRate(uint32_t baud)
+{
+    if (UART5_CheckBaudRate(baud) == 0U)
+    {
+        return 0;
+    }
+    uartBaud = baud;
+    Host_UartSend(HOST_LINK_BAUD, 0);
+    return baud;
+}
+
+uint32_t UART5_GetBaudRate(void)
+{
+    return uartBaud;
+}
+
+void UART5_Handler(void)
+{
+}
+
+uint32_t UART5_Read(uint8_t *buf, uint32_t len)
+{
+    uint32_t count = 0;
+    int byte;
+
+    while (count < len && (byte = Host_UartReceive()) >= 0)
+    {
+        buf[count++] = (uint8_t)byte;
+    }
+    return count;
+}
+
+uint32_t UART5_Write(const uint8_t *buf, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        Host_UartSend(HOST_LINK_DATA, buf[i]);
+    }
+    return len;
+}
+
+uint32_t UART5_TxPending(void)
+{
+    return 0;
+}
+
+uint32_t UART5_GetRxOverflowCount(void)
+{
+    return rx_overflow_count;
+}
+
+uint32_t UART5_GetRxErrorCount(void)
+{
+    return rx_error_count;
+}
+
+void UART5_SendChar(char data)
+{
+    Host_UartSend(HOST_LINK_DATA, (uint8_t)data);
+}
+
+char UART5_ReceiveChar(void)
+{
+    int byte;
+
+    while ((byte = Host_UartReceive()) < 0);
+    return (char)byte;
+}
+
+void UART5_SendString(const char *str)
+{
+    while (*str)
+    {
+        UART5_SendChar(*str++);
+    }
+}
+
+uint8_t UART5_IsDataAvailable(void)
+{
+    if (peeked < 0)
+    {
+        peeked = Host_UartReceive();
+    }
+    return (peeked >= 0);
+}
+
+void UART5_SendUInt(uint32_t num)
+{
+    char text[12];
+
+    snprintf(text, sizeof(text), "%u\n", num);
+    UART5_SendString(text);
+}
+
+uint32_t UART5_ReceiveUInt(void)
+{
+    char c;
+    uint32_t val = 0;
+
+    while (1)
+    {
+        c = UART5_ReceiveChar();
+        if (c == '\r' || c == '\n' || c == '\0')
+            break;
+
+        if (c >= '0' && c <= '9')
+            val = (val * 10) + (c - '0');
+    }
+    return val;
+}
+
+void UART5_ReceiveString(char *buffer)
+{
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        buffer[i] = UART5_ReceiveChar();
+    }
+    buffer[5] = '\n';
+}
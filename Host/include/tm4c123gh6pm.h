@@ -0,0 +1,20 @@
+/******************************************************************************
+ * File: tm4c123gh6pm.h (host)
+ * Module: Host Simulation
+ * Description: Stand-in for the device header in host builds
+ *
+ * Only the Application layer is compiled on the host, and it touches one
+ * register directly: NVIC_APINT_R, to request a software reset. Writing
+ * the SYSRESETREQ key here restarts the simulated ECU (Host_CheckReset).
+ ******************************************************************************/
+
+#ifndef HOST_TM4C123GH6PM_H_
+#define HOST_TM4C123GH6PM_H_
+
+#include <stdint.h>
+
+extern volatile uint32_t HOST_NVIC_APINT;
+
+#define NVIC_APINT_R            HOST_NVIC_APINT
+
+#endif /* HOST_TM4C123GH6PM_H_ */
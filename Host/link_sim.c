@@ -0,0 +1,480 @@
+/******************************************************************************
+ * File: link_sim.c
+ * Module: Host Simulation
+ * Description: Runs HMI_ECU and Control_ECU as two processes joined by a
+ *              simulated UART5 line
+ *
+ * Each ECU gets one end of a SOCK_SEQPACKET pair (SIM_UART_FD); this
+ * process relays the byte records between them (host_link.h) and applies
+ * the line model per byte:
+ *
+ *   - serialization: 10 bit times at the SENDER's current baud rate, one
+ *     byte after another on each direction
+ *   - latency:       fixed extra delay (--latency-us)
+ *   - loss:          byte silently dropped (--loss, probability)
+ *   - corruption:    one random bit flipped (--corrupt, probability)
+ *   - rate mismatch: a byte sent at a rate the receiver is not set to, or
+ *                    above --baud-limit, arrives as a framing error
+ *
+ * stdin is handed to the HMI (keypad input, see host_hmi_hal.c); both ECUs
+ * log to stdout. Statistics go to stderr when the simulation ends.
+ *
+ * Usage: link_sim [options]
+ *   --latency-us N   --loss P   --corrupt P   --baud-limit N
+ *   --speed N        time scale for both ECUs and the line (default 1)
+ *   --duration S     stop after S simulated seconds (default: run until
+ *                    interrupted or an ECU exits)
+ *   --eeprom FILE    persistent EEPROM image for Control_ECU
+ *   --eeprom-word-us N   EEPROM program time per word (simulated us,
+ *                    default 110, 0 = none)
+ *   --power-loss N   cut Control_ECU's power during its Nth EEPROM word
+ *                    program; it restarts from the torn image
+ *   --eeprom-stats   with --eeprom: print the lifetime program counts of
+ *                    the image per block (total, busiest word) at the end
+ *   --pot N          potentiometer reading on the HMI (0..4095)
+ *   --seed N         random seed for loss / corruption
+ *   --hmi PATH       --control PATH   ECU executables (default: next to
+ *                    link_sim)
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "host_eeprom.h"
+#include "host_link.h"
+
+#define QUEUE_SIZE      4096U           /* records in flight per direction */
+#define DEFAULT_BAUD    115200U         /* UART5_DEFAULT_BAUD */
+
+typedef struct
+{
+    uint64_t        due_us;
+    HOST_LinkRecord record;
+} Pending;
+
+typedef struct
+{
+    const char *name;
+    int         fd;                     /* relay end of this ECU's socket */
+    pid_t       pid;
+    uint32_t    baud;                   /* rate this ECU is set to */
+} Side;
+
+typedef struct
+{
+    Side     *from;
+    Side     *to;
+    Pending   queue[QUEUE_SIZE];
+    uint32_t  head;
+    uint32_t  tail;
+    uint64_t  line_free_us;
+    uint64_t  bytes;
+    uint64_t  dropped;
+    uint64_t  corrupted;
+    uint64_t  errors;
+} Channel;
+
+static double   opt_loss = 0.0;
+static double   opt_corrupt = 0.0;
+static uint32_t opt_latency_us = 0;
+static uint32_t opt_baud_limit = 0;
+static uint32_t opt_speed = 1;
+static uint32_t opt_duration_s = 0;
+static uint8_t  opt_eeprom_stats = 0;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static volatile sig_atomic_t running = 1;
+static uint64_t start_ns;
+
+/******************************************************************************
+ *                          Helpers                                            *
+ ******************************************************************************/
+
+static void Stop(int signum)
+{
+    (void)signum;
+    running = 0;
+}
+
+/* Simulated microseconds since start */
+static uint64_t Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec - start_ns) *
+            opt_speed) / 1000ULL;
+}
+
+/* xorshift64*, uniform in [0, 1) */
+static double Random(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static pid_t Spawn(const char *path, const char *name, int fd, int keep_stdin)
+{
+    char fd_text[16];
+    char speed_text[16];
+    pid_t pid = fork();
+
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    snprintf(fd_text, sizeof(fd_text), "%d", fd);
+    snprintf(speed_text, sizeof(speed_text), "%u", opt_speed);
+    setenv("SIM_UART_FD", fd_text, 1);
+    setenv("SIM_SPEED", speed_text, 1);
+    setenv("SIM_NAME", name, 1);
+    fcntl(fd, F_SETFD, 0);          /* only this ECU's end survives exec */
+
+    if (!keep_stdin)
+    {
+        int null_fd = open("/dev/null", O_RDONLY);
+        dup2(null_fd, STDIN_FILENO);
+        close(null_fd);
+    }
+
+    execl(path, path, (char *)NULL);
+    perror(path);
+    _exit(EXIT_FAILURE);
+}
+
+/******************************************************************************
+ *                          Line Model                                         *
+ ******************************************************************************/
+
+static void Channel_Accept(Channel *ch, HOST_LinkRecord *record)
+{
+    uint64_t now = Now();
+    uint64_t start;
+    Pending *slot;
+
+    if (record->kind == HOST_LINK_BAUD)
+    {
+        ch->from->baud = record->baud;
+        return;
+    }
+
+    ch->bytes++;
+    start = (ch->line_free_us > now) ? ch->line_free_us : now;
+    ch->line_free_us = start + (10000000ULL + record->baud - 1U) / record->baud;
+
+    if (Random() < opt_loss)
+    {
+        ch->dropped++;
+        return;
+    }
+    if (Random() < opt_corrupt)
+    {
+        record->data ^= (uint8_t)(1U << (uint32_t)(Random() * 8.0));
+        ch->corrupted++;
+    }
+    if (opt_baud_limit != 0U && record->baud > opt_baud_limit)
+    {
+        record->kind = HOST_LINK_ERROR;
+    }
+
+    if (ch->head - ch->tail >= QUEUE_SIZE)
+    {
+        ch->dropped++;              /* receiver far behind: overrun */
+        return;
+    }
+    slot = &ch->queue[ch->head % QUEUE_SIZE];
+    slot->due_us = ch->line_free_us + opt_latency_us;
+    slot->record = *record;
+    ch->head++;
+}
+
+static void Channel_Deliver(Channel *ch)
+{
+    uint64_t now = Now();
+    Pending *slot;
+
+    while (ch->tail != ch->head)
+    {
+        slot = &ch->queue[ch->tail % QUEUE_SIZE];
+        if (slot->due_us > now)
+        {
+            break;
+        }
+
+        /* The receiver samples at its own rate */
+        if (slot->record.kind == HOST_LINK_DATA && slot->record.baud != ch->to->baud)
+        {
+            slot->record.kind = HOST_LINK_ERROR;
+        }
+        if (slot->record.kind == HOST_LINK_ERROR)
+        {
+            ch->errors++;
+        }
+
+        if (send(ch->to->fd, &slot->record, sizeof(slot->record), 0) < 0 && errno != EINTR)
+        {
+            running = 0;
+            return;
+        }
+        ch->tail++;
+    }
+}
+
+static int Channel_Receive(Channel *ch)
+{
+    HOST_LinkRecord record;
+    ssize_t size;
+
+    while ((size = recv(ch->from->fd, &record, sizeof(record), MSG_DONTWAIT)) > 0)
+    {
+        if (size == (ssize_t)sizeof(record))
+        {
+            Channel_Accept(ch, &record);
+        }
+    }
+    if (size == 0)
+    {
+        return 0;                   /* ECU exited */
+    }
+    return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+}
+
+static void Channel_Report(const Channel *ch)
+{
+    fprintf(stderr, "%s -> %s: %llu bytes, %llu dropped, %llu corrupted, %llu framing errors\n",
+            ch->from->name, ch->to->name,
+            (unsigned long long)ch->bytes, (unsigned long long)ch->dropped,
+            (unsigned long long)ch->corrupted, (unsigned long long)ch->errors);
+}
+
+/*
+ * Eeprom_Report
+ * Prints the word program counts the EEPROM emulator keeps next to the
+ * image (host_eeprom.h), per block of 16 words.
+ */
+static void Eeprom_Report(void)
+{
+    const char *image = getenv("SIM_EEPROM_FILE");
+    char path[PATH_MAX];
+    uint32_t words[16];
+    uint64_t total;
+    uint32_t busiest;
+    unsigned block = 0;
+    unsigned i;
+    FILE *file;
+
+    if (image == NULL)
+    {
+        fprintf(stderr, "--eeprom-stats needs --eeprom\n");
+        return;
+    }
+    snprintf(path, sizeof(path), "%s%s", image, HOST_EEPROM_WEAR_SUFFIX);
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return;
+    }
+    fprintf(stderr, "EEPROM wear (word programs): block total / busiest word\n");
+    while (fread(words, sizeof(words), 1, file) == 1)
+    {
+        total = 0;
+        busiest = 0;
+        for (i = 0; i < 16U; i++)
+        {
+            total += words[i];
+            busiest = (words[i] > busiest) ? words[i] : busiest;
+        }
+        fprintf(stderr, "  %2u: %8llu / %6u%s", block, (unsigned long long)total, busiest,
+                ((block % 4U) == 3U) ? "\n" : "");
+        block++;
+    }
+    fclose(file);
+}
+
+/******************************************************************************
+ *                          Main                                               *
+ ******************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    static Channel to_control;
+    static Channel to_hmi;
+    static const struct option options[] =
+    {
+        { "latency-us", required_argument, 0, 'l' },
+        { "loss",       required_argument, 0, 'p' },
+        { "corrupt",    required_argument, 0, 'c' },
+        { "baud-limit", required_argument, 0, 'b' },
+        { "speed",      required_argument, 0, 's' },
+        { "duration",   required_argument, 0, 'd' },
+        { "eeprom",     required_argument, 0, 'e' },
+        { "eeprom-word-us", required_argument, 0, 'w' },
+        { "power-loss", required_argument, 0, 'L' },
+        { "eeprom-stats", no_argument,     0, 'W' },
+        { "pot",        required_argument, 0, 'P' },
+        { "seed",       required_argument, 0, 'r' },
+        { "hmi",        required_argument, 0, 'H' },
+        { "control",    required_argument, 0, 'C' },
+        { 0, 0, 0, 0 }
+    };
+    char dir[PATH_MAX];
+    const char *base;
+    ssize_t size;
+    char hmi_path[PATH_MAX + 32];
+    char control_path[PATH_MAX + 32];
+    const char *hmi = NULL;
+    const char *control = NULL;
+    Side hmi_side = { "HMI", -1, 0, DEFAULT_BAUD };
+    Side control_side = { "CTL", -1, 0, DEFAULT_BAUD };
+    int hmi_pair[2];
+    int control_pair[2];
+    struct pollfd fds[2];
+    struct timespec ts;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'l': opt_latency_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'p': opt_loss = strtod(optarg, NULL);                      break;
+            case 'c': opt_corrupt = strtod(optarg, NULL);                   break;
+            case 'b': opt_baud_limit = (uint32_t)strtoul(optarg, NULL, 0);  break;
+            case 's': opt_speed = (uint32_t)strtoul(optarg, NULL, 0);       break;
+            case 'd': opt_duration_s = (uint32_t)strtoul(optarg, NULL, 0);  break;
+            case 'e': setenv("SIM_EEPROM_FILE", optarg, 1);                  break;
+            case 'w': setenv("SIM_EEPROM_WORD_US", optarg, 1);               break;
+            case 'L': setenv("SIM_EEPROM_POWER_LOSS", optarg, 1);            break;
+            case 'W': opt_eeprom_stats = 1;                                 break;
+            case 'P': setenv("SIM_POT", optarg, 1);                          break;
+            case 'r': rng_state ^= strtoull(optarg, NULL, 0) * 0x2545F4914F6CDD1DULL; break;
+            case 'H': hmi = optarg;                                         break;
+            case 'C': control = optarg;                                     break;
+            default:
+                fprintf(stderr, "see the header of link_sim.c for options\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if (opt_speed == 0U)
+    {
+        opt_speed = 1U;
+    }
+
+    /* ECU executables default to the directory of link_sim */
+    size = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+    if (size < 0)
+    {
+        strncpy(dir, argv[0], sizeof(dir) - 1);
+        size = (ssize_t)strlen(dir);
+    }
+    dir[size] = '\0';
+    base = dirname(dir);
+    snprintf(hmi_path, sizeof(hmi_path), "%s/hmi_ecu_sim", base);
+    snprintf(control_path, sizeof(control_path), "%s/control_ecu_sim", base);
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, hmi_pair) < 0 ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, control_pair) < 0)
+    {
+        perror("socketpair");
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    signal(SIGPIPE, SIG_IGN);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    start_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+    control_side.pid = Spawn(control ? control : control_path, "CTL", control_pair[1], 0);
+    hmi_side.pid = Spawn(hmi ? hmi : hmi_path, "HMI", hmi_pair[1], 1);
+    close(control_pair[1]);
+    close(hmi_pair[1]);
+    hmi_side.fd = hmi_pair[0];
+    control_side.fd = control_pair[0];
+
+    to_control.from = &hmi_side;
+    to_control.to = &control_side;
+    to_hmi.from = &control_side;
+    to_hmi.to = &hmi_side;
+
+    fds[0].fd = hmi_side.fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = control_side.fd;
+    fds[1].events = POLLIN;
+
+    while (running)
+    {
+        uint64_t now = Now();
+        uint64_t next = now + 10000U;
+        struct timespec wait;
+
+        if (to_control.tail != to_control.head &&
+            to_control.queue[to_control.tail % QUEUE_SIZE].due_us < next)
+        {
+            next = to_control.queue[to_control.tail % QUEUE_SIZE].due_us;
+        }
+        if (to_hmi.tail != to_hmi.head &&
+            to_hmi.queue[to_hmi.tail % QUEUE_SIZE].due_us < next)
+        {
+            next = to_hmi.queue[to_hmi.tail % QUEUE_SIZE].due_us;
+        }
+
+        /* Sleep until the next delivery, in real time */
+        next = (next > now) ? (next - now) / opt_speed : 0U;
+        wait.tv_sec = (time_t)(next / 1000000ULL);
+        wait.tv_nsec = (long)((next % 1000000ULL) * 1000ULL);
+        if (ppoll(fds, 2, &wait, NULL) < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        if ((fds[0].revents & (POLLIN | POLLHUP)) && !Channel_Receive(&to_control))
+        {
+            break;
+        }
+        if ((fds[1].revents & (POLLIN | POLLHUP)) && !Channel_Receive(&to_hmi))
+        {
+            break;
+        }
+
+        Channel_Deliver(&to_control);
+        Channel_Deliver(&to_hmi);
+
+        if (opt_duration_s != 0U && Now() >= (uint64_t)opt_duration_s * 1000000ULL)
+        {
+            break;
+        }
+    }
+
+    kill(hmi_side.pid, SIGTERM);
+    kill(control_side.pid, SIGTERM);
+    waitpid(hmi_side.pid, NULL, 0);
+    waitpid(control_side.pid, NULL, 0);
+    fflush(stdout);
+
+    Channel_Report(&to_control);
+    Channel_Report(&to_hmi);
+    fprintf(stderr, "final rates: HMI %u, CTL %u baud\n", hmi_side.baud, control_side.baud);
+    if (opt_eeprom_stats)
+    {
+        Eeprom_Report();
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+/******************************************************************************
+ * File: test_eeprom.c
+ * Module: Host Simulation
+ * Description: Tests of the target EEPROM driver (Control_ECU/MCAL/eeprom.c)
+ *              on the register model of host_eeprom_regs.h
+ *
+ * The bursts stream through EERDWRINC, which wraps within a block; only
+ * EEPROM_BurstNext selects the next block. A burst that crossed a boundary
+ * without it would land back on word 0 of the same block, so each case
+ * starts a few words before a boundary and checks both sides of it.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "eeprom.h"
+#include "GPTM_TIMER1.h"
+#include "sysctl.h"
+#include "host_test.h"
+
+/******************************************************************************
+ *                          Register model                                     *
+ ******************************************************************************/
+
+uint32_t HOST_EE_IMAGE[HOST_EE_WORDS];
+volatile uint32_t HOST_EE_REG[16];
+static uint32_t timer_ticks = 0;
+
+volatile uint32_t *Host_EeRdWr(void)
+{
+    return &HOST_EE_IMAGE[(EEPROM_EEBLOCK_R % EEPROM_TOTAL_BLOCKS) * EEPROM_BLOCK_SIZE +
+                          EEPROM_EEOFFSET_R % EEPROM_BLOCK_SIZE];
+}
+
+volatile uint32_t *Host_EeRdWrInc(void)
+{
+    volatile uint32_t *word = Host_EeRdWr();
+
+    EEPROM_EEOFFSET_R = (EEPROM_EEOFFSET_R + 1U) % EEPROM_BLOCK_SIZE;
+    return word;
+}
+
+void GPTM_Timer1A_Init(void)
+{
+}
+
+uint32_t GPTM_Timer1A_Read(void)
+{
+    return timer_ticks++;
+}
+
+uint32_t SysCtl_GetClock(void)
+{
+    return 16000000U;
+}
+
+/******************************************************************************
+ *                          Helpers                                            *
+ ******************************************************************************/
+
+#define WORD(block, offset)     HOST_EE_IMAGE[(block) * EEPROM_BLOCK_SIZE + (offset)]
+
+static void Erase(void)
+{
+    memset(HOST_EE_IMAGE, 0xFF, sizeof(HOST_EE_IMAGE));
+}
+
+static void Pattern(uint32_t *words, uint32_t count, uint32_t seed)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        words[i] = seed * 0x10001U + i;
+    }
+}
+
+static void Bytes(const uint32_t *words, uint32_t count, uint8_t *bytes)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        bytes[i * 4]     = (uint8_t)(words[i] & 0xFF);
+        bytes[i * 4 + 1] = (uint8_t)((words[i] >> 8) & 0xFF);
+        bytes[i * 4 + 2] = (uint8_t)((words[i] >> 16) & 0xFF);
+        bytes[i * 4 + 3] = (uint8_t)((words[i] >> 24) & 0xFF);
+    }
+}
+
+/* count words from block/offset hold words[], and the rest is erased */
+static uint8_t Holds(uint32_t block, uint32_t offset, const uint32_t *words, uint32_t count)
+{
+    uint32_t first = block * EEPROM_BLOCK_SIZE + offset;
+    uint32_t i;
+
+    for (i = 0; i < HOST_EE_WORDS; i++)
+    {
+        if (HOST_EE_IMAGE[i] != ((i >= first && i < first + count) ? words[i - first] : 0xFFFFFFFFU))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                          Cases                                              *
+ ******************************************************************************/
+
+static void Test_WriteBurstCrossesBlocks(void)
+{
+    uint32_t words[40];
+    uint32_t back[40];
+    uint32_t before[EEPROM_TOTAL_BLOCKS];
+    uint32_t block;
+
+    Erase();
+    for (block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+    {
+        before[block] = EEPROM_BlockWrites(block);
+    }
+    Pattern(words, 40, 1);
+
+    /* 3:14 to 6:5, over three boundaries */
+    HOST_CHECK(EEPROM_WriteBurst(3, 14, words, 40) == EEPROM_SUCCESS);
+    HOST_CHECK(Holds(3, 14, words, 40));
+    HOST_CHECK(WORD(3, 0) == 0xFFFFFFFFU);          /* not wrapped within 3 */
+
+    HOST_CHECK(EEPROM_ReadBurst(3, 14, back, 40) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(back, words, sizeof(words));
+
+    /* Programs are counted against the block each word went to */
+    HOST_CHECK(EEPROM_BlockWrites(3) - before[3] == 2);
+    HOST_CHECK(EEPROM_BlockWrites(4) - before[4] == 16);
+    HOST_CHECK(EEPROM_BlockWrites(5) - before[5] == 16);
+    HOST_CHECK(EEPROM_BlockWrites(6) - before[6] == 6);
+    HOST_CHECK(EEPROM_BlockWrites(7) - before[7] == 0);
+}
+
+static void Test_BufferCrossesBlock(void)
+{
+    uint32_t words[6];
+    uint8_t bytes[24];
+    uint8_t back[24];
+
+    Erase();
+    Pattern(words, 6, 2);
+    Bytes(words, 6, bytes);
+
+    HOST_CHECK(EEPROM_WriteBuffer(9, 13, bytes, sizeof(bytes)) == EEPROM_SUCCESS);
+    HOST_CHECK(Holds(9, 13, words, 6));
+
+    memset(back, 0, sizeof(back));
+    HOST_CHECK(EEPROM_ReadBuffer(9, 13, back, sizeof(back)) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(back, bytes, sizeof(bytes));
+}
+
+static void Test_UpdateCrossesBlock(void)
+{
+    uint32_t words[8];
+    uint8_t bytes[32];
+    uint32_t written = 0;
+
+    Erase();
+    Pattern(words, 8, 3);
+    Bytes(words, 8, bytes);
+    HOST_CHECK(EEPROM_UpdateBuffer(20, 12, bytes, sizeof(bytes), &written) == EEPROM_SUCCESS);
+    HOST_CHECK(written == 8);
+    HOST_CHECK(Holds(20, 12, words, 8));
+
+    /* Unchanged words on both sides are skipped, the read pointer still
+     * follows them into the next block */
+    words[1]++;
+    words[6]++;
+    Bytes(words, 8, bytes);
+    HOST_CHECK(EEPROM_UpdateBuffer(20, 12, bytes, sizeof(bytes), &written) == EEPROM_SUCCESS);
+    HOST_CHECK(written == 2);
+    HOST_CHECK(Holds(20, 12, words, 8));
+
+    HOST_CHECK(EEPROM_UpdateBuffer(20, 12, bytes, sizeof(bytes), &written) == EEPROM_SUCCESS);
+    HOST_CHECK(written == 0);
+}
+
+static void Test_WholeArray(void)
+{
+    static uint32_t words[HOST_EE_WORDS];
+    static uint32_t back[HOST_EE_WORDS];
+
+    Erase();
+    Pattern(words, HOST_EE_WORDS, 4);
+    HOST_CHECK(EEPROM_WriteBurst(0, 0, words, HOST_EE_WORDS) == EEPROM_SUCCESS);
+    HOST_CHECK(Holds(0, 0, words, HOST_EE_WORDS));
+    HOST_CHECK(EEPROM_ReadBurst(0, 0, back, HOST_EE_WORDS) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(back, words, sizeof(words));
+}
+
+static void Test_EndOfArray(void)
+{
+    uint32_t words[3];
+
+    Erase();
+    Pattern(words, 3, 5);
+
+    /* Ends on the last word: the block past the end is never selected */
+    HOST_CHECK(EEPROM_WriteBurst(31, 13, words, 3) == EEPROM_SUCCESS);
+    HOST_CHECK(Holds(31, 13, words, 3));
+
+    /* One word too many is refused before anything is written */
+    Erase();
+    HOST_CHECK(EEPROM_WriteBurst(31, 14, words, 3) == EEPROM_ERROR);
+    HOST_CHECK(EEPROM_ReadBurst(31, 14, words, 3) == EEPROM_ERROR);
+    HOST_CHECK(Holds(0, 0, words, 0));
+}
+
+static uint8_t queued_result = 0xFF;
+static uint32_t queued_written = 0;
+
+static void OnQueued(uint8_t result, uint32_t written)
+{
+    queued_result = result;
+    queued_written = written;
+}
+
+static void Test_QueuedCrossesBlock(void)
+{
+    uint32_t words[EEPROM_QUEUE_WORDS];
+    uint8_t bytes[EEPROM_QUEUE_WORDS * 4];
+    uint32_t i;
+
+    Erase();
+    Pattern(words, EEPROM_QUEUE_WORDS, 6);
+    Bytes(words, EEPROM_QUEUE_WORDS, bytes);
+
+    /* Addressed word by word, no EERDWRINC; one done interrupt per word */
+    HOST_CHECK(EEPROM_Submit(14, 9, bytes, sizeof(bytes), 100000, OnQueued) == EEPROM_SUCCESS);
+    for (i = 0; i < 2 * EEPROM_QUEUE_WORDS && queued_result == 0xFF; i++)
+    {
+        FLASH_Handler();
+        EEPROM_Task();
+    }
+    HOST_CHECK(queued_result == EEPROM_SUCCESS);
+    HOST_CHECK(queued_written == EEPROM_QUEUE_WORDS);
+    HOST_CHECK(Holds(14, 9, words, EEPROM_QUEUE_WORDS));
+}
+
+int main(void)
+{
+    Erase();
+    HOST_CHECK(EEPROM_Init() == EEPROM_SUCCESS);
+
+    Test_WriteBurstCrossesBlocks();
+    Test_BufferCrossesBlock();
+    Test_UpdateCrossesBlock();
+    Test_WholeArray();
+    Test_EndOfArray();
+    Test_QueuedCrossesBlock();
+
+    return Host_TestResult("test_eeprom");
+}
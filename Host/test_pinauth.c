@@ -0,0 +1,137 @@
+/******************************************************************************
+ * File: test_pinauth.c
+ * Module: Host Simulation
+ * Description: Known-answer and replay tests of the PIN sealing
+ *              (Shared/pinauth.c)
+ *
+ * Built with the key of the SipHash reference vectors (bytes 00..0f,
+ * -DPINAUTH_KEY) and with pinauth.c included, so the MAC itself is
+ * checked against the reference outputs for the messages 00..len-1.
+ * The rest seals frames as the HMI does and opens them as Control_ECU
+ * does: a frame opens under its own challenge only, so once Control_ECU
+ * has drawn the next one (ECU_main.c, Challenge_Next) a recorded frame is
+ * refused.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "host_test.h"
+#include "pinauth.c"
+
+/******************************************************************************
+ *                          SipHash-2-4                                        *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint8_t length;
+    uint64_t mac;           /* SipHash-2-4(00..0f, 00..length-1) */
+} PinAuth_Vector;
+
+static const PinAuth_Vector vectors[] = {
+    {  0, 0x726fdb47dd0e0e31ULL },
+    {  1, 0x74f839c593dc67fdULL },
+    {  7, 0xab0200f58b01d137ULL },
+    {  8, 0x93f5f5799a932462ULL },
+    { 15, 0xa129ca6149be45e5ULL },
+    { 16, 0x3f2acc7f57c29bdbULL },
+    { 31, 0x32d892fad841c342ULL },
+    { 63, 0x958a324ceb064572ULL },
+};
+
+#define VECTOR_COUNT            (sizeof(vectors) / sizeof(vectors[0]))
+
+static void Test_SipHash(void)
+{
+    uint8_t message[64];
+    uint32_t i;
+
+    for (i = 0; i < sizeof(message); i++)
+    {
+        message[i] = (uint8_t)i;
+    }
+    for (i = 0; i < VECTOR_COUNT; i++)
+    {
+        HOST_CHECK(PinAuth_Mac(message, vectors[i].length) == vectors[i].mac);
+    }
+}
+
+/******************************************************************************
+ *                          Sealing                                            *
+ ******************************************************************************/
+
+#define EPOCH                   7U
+
+static void Test_SealOpens(void)
+{
+    uint8_t challenge[PINAUTH_CHALLENGE_SIZE];
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint8_t plain[PROTO_MAX_PAYLOAD];
+    uint8_t length;
+
+    PinAuth_Nonce(EPOCH, 1, challenge);
+    memcpy(payload, "12345", 5);
+    length = PinAuth_Seal(challenge, PROTO_CMD_VERIFY_PASSWORD, payload, 5);
+    HOST_CHECK(length == 5 + PINAUTH_TAG_SIZE);
+    HOST_CHECK(memcmp(payload, "12345", 5) != 0);       /* not in clear */
+
+    HOST_CHECK(PinAuth_Open(challenge, PROTO_CMD_VERIFY_PASSWORD, payload, length, plain) == 5);
+    HOST_CHECK_MEM(plain, "12345", 5);
+
+    /* Not under another command, nor altered */
+    HOST_CHECK(PinAuth_Open(challenge, PROTO_CMD_STORE_PASSWORD, payload, length, plain) == 0);
+    payload[0] ^= 0x01;
+    HOST_CHECK(PinAuth_Open(challenge, PROTO_CMD_VERIFY_PASSWORD, payload, length, plain) == 0);
+    payload[0] ^= 0x01;
+    payload[length - 1] ^= 0x80;
+    HOST_CHECK(PinAuth_Open(challenge, PROTO_CMD_VERIFY_PASSWORD, payload, length, plain) == 0);
+}
+
+/* A frame recorded under a spent challenge opens under no later one */
+static void Test_ReusedChallenge(void)
+{
+    uint8_t spent[PINAUTH_CHALLENGE_SIZE];
+    uint8_t next[PINAUTH_CHALLENGE_SIZE];
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    uint8_t digit[PROTO_MAX_PAYLOAD];
+    uint8_t plain[PROTO_MAX_PAYLOAD];
+    uint8_t length;
+    uint8_t digit_length;
+    uint32_t count;
+
+    PinAuth_Nonce(EPOCH, 1, spent);
+    memcpy(payload, "24680", 5);
+    length = PinAuth_Seal(spent, PROTO_CMD_VERIFY_PASSWORD, payload, 5);
+    digit[0] = 3;                   /* session, index, digit */
+    digit[1] = 2;
+    digit[2] = '6';
+    digit_length = PinAuth_Seal(spent, PROTO_CMD_PIN_DIGIT, digit, 3);
+    HOST_CHECK(PinAuth_Open(spent, PROTO_CMD_PIN_DIGIT, digit, digit_length, plain) == 3);
+    HOST_CHECK(plain[2] == '6');
+
+    for (count = 2; count < 1000; count++)
+    {
+        PinAuth_Nonce(EPOCH, count, next);
+        HOST_CHECK(memcmp(next, spent, PINAUTH_CHALLENGE_SIZE) != 0);
+        HOST_CHECK(PinAuth_Open(next, PROTO_CMD_VERIFY_PASSWORD, payload, length, plain) == 0);
+        HOST_CHECK(PinAuth_Open(next, PROTO_CMD_PIN_DIGIT, digit, digit_length, plain) == 0);
+    }
+
+    /* Nor in the next epoch, which restarts the count after a reset */
+    for (count = 1; count < 1000; count++)
+    {
+        PinAuth_Nonce(EPOCH + 1U, count, next);
+        HOST_CHECK(PinAuth_Open(next, PROTO_CMD_VERIFY_PASSWORD, payload, length, plain) == 0);
+    }
+}
+
+int main(void)
+{
+    PinAuth_Init();
+
+    Test_SipHash();
+    Test_SealOpens();
+    Test_ReusedChallenge();
+
+    return Host_TestResult("test_pinauth");
+}
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * File: test_pinhash.c
+ * Module: Host Simulation
+ * Description: Known-answer tests of the PIN hash (Control_ECU/Application/
+ *              pinhash.c)
+ *
+ * The tag of a stored hash is the first 4 bytes of PBKDF2-HMAC-SHA256 of
+ * the 5 digits with the 2-byte salt, MSB first, as the salt string. The
+ * vectors were made with an independent PBKDF2 (Python hashlib) and run
+ * from one iteration to PINHASH_MAX_ITERATIONS. Each is laid out as a
+ * password field the way PinHash_Make stores it: it must check with its
+ * PIN, and not with another PIN or with any tag byte changed.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "pinhash.h"
+#include "GPTM_TIMER1.h"
+#include "systick.h"
+#include "host_test.h"
+
+/******************************************************************************
+ *                          Timer stand-ins                                    *
+ ******************************************************************************/
+
+static uint32_t timer_ticks = 0;
+
+void GPTM_Timer1A_Init(void)
+{
+}
+
+uint32_t GPTM_Timer1A_Read(void)
+{
+    timer_ticks += 977U;
+    return timer_ticks;
+}
+
+uint32_t SysTick_GetMs(void)
+{
+    return timer_ticks >> 14;
+}
+
+/******************************************************************************
+ *                          Vectors                                            *
+ ******************************************************************************/
+
+typedef struct
+{
+    const char *pin;
+    uint16_t salt;
+    uint16_t iterations;
+    uint8_t tag[4];         /* PBKDF2-HMAC-SHA256(pin, salt, iterations)[0..3] */
+} PinHash_Vector;
+
+static const PinHash_Vector vectors[] = {
+    { "12345", 0x0000,     1, { 0x1f, 0x1d, 0x84, 0xeb } },
+    { "12345", 0x1234,     1, { 0x64, 0x84, 0x22, 0xbe } },
+    { "12345", 0x1234,     2, { 0x86, 0x88, 0x26, 0x49 } },
+    { "00000", 0xBEEF,    16, { 0x0b, 0x9d, 0xfb, 0xc4 } },
+    { "98765", 0xFFFF,  1000, { 0xac, 0xe5, 0x52, 0x65 } },
+    { "54321", 0x0102, 10000, { 0xd7, 0xae, 0x3d, 0x0f } },
+};
+
+#define VECTOR_COUNT            (sizeof(vectors) / sizeof(vectors[0]))
+
+static void Field(const PinHash_Vector *v, uint8_t *hash)
+{
+    hash[0] = (uint8_t)(v->iterations >> 8);
+    hash[1] = (uint8_t)(v->iterations & 0xFF);
+    hash[2] = (uint8_t)(v->salt >> 8);
+    hash[3] = (uint8_t)(v->salt & 0xFF);
+    memcpy(&hash[4], v->tag, sizeof(v->tag));
+}
+
+/******************************************************************************
+ *                          Cases                                              *
+ ******************************************************************************/
+
+static void Test_KnownAnswers(void)
+{
+    uint8_t hash[PINHASH_SIZE];
+    uint32_t i;
+    uint8_t byte;
+
+    for (i = 0; i < VECTOR_COUNT; i++)
+    {
+        Field(&vectors[i], hash);
+        HOST_CHECK(!PinHash_IsPlain(hash));
+        HOST_CHECK(PinHash_Check(vectors[i].pin, hash) == 1);
+        HOST_CHECK(PinHash_Check("13579", hash) == 0);
+
+        for (byte = 4; byte < PINHASH_SIZE; byte++)
+        {
+            hash[byte] ^= 0x01;
+            HOST_CHECK(PinHash_Check(vectors[i].pin, hash) == 0);
+            hash[byte] ^= 0x01;
+        }
+
+        /* The salt and count are part of it too */
+        hash[3] ^= 0x80;
+        HOST_CHECK(PinHash_Check(vectors[i].pin, hash) == 0);
+    }
+}
+
+static void Test_Unset(void)
+{
+    uint8_t hash[PINHASH_SIZE];
+
+    memset(hash, 0xFF, sizeof(hash));
+    HOST_CHECK(PinHash_Check("12345", hash) == 0);
+    memset(hash, 0x00, sizeof(hash));
+    HOST_CHECK(PinHash_Check("12345", hash) == 0);
+}
+
+static void Test_Plain(void)
+{
+    const uint8_t plain[PINHASH_SIZE] = { '1', '2', '3', '4', '5', 0, 0, 0 };
+
+    HOST_CHECK(PinHash_IsPlain(plain));
+    HOST_CHECK(PinHash_Check("12345", plain) == 1);
+    HOST_CHECK(PinHash_Check("12346", plain) == 0);
+}
+
+/* Two fresh hashes of one PIN both check, under different salts */
+static void Test_MakeChecks(void)
+{
+    uint8_t first[PINHASH_SIZE];
+    uint8_t second[PINHASH_SIZE];
+
+    PinHash_Init(16000000U);
+    HOST_CHECK(PinHash_Iterations() >= PINHASH_MIN_ITERATIONS &&
+               PinHash_Iterations() <= PINHASH_MAX_ITERATIONS);
+
+    PinHash_Make("24680", first);
+    PinHash_Make("24680", second);
+    HOST_CHECK(((uint16_t)(first[0] << 8) | first[1]) == PinHash_Iterations());
+    HOST_CHECK(!PinHash_IsPlain(first));
+    HOST_CHECK(PinHash_Check("24680", first) == 1);
+    HOST_CHECK(PinHash_Check("24681", first) == 0);
+    HOST_CHECK(PinHash_Check("24680", second) == 1);
+    HOST_CHECK(memcmp(&first[2], &second[2], 2) != 0);
+}
+
+int main(void)
+{
+    Test_KnownAnswers();
+    Test_Unset();
+    Test_Plain();
+    Test_MakeChecks();
+
+    return Host_TestResult("test_pinhash");
+}
@@ -0,0 +1,263 @@
+/******************************************************************************
+ * File: test_seclink.c
+ * Module: Host Simulation
+ * Description: Known-answer and replay tests of the link sealing
+ *              (Shared/seclink.c)
+ *
+ * seclink.c is included, so the ChaCha20 block and the AEAD are checked
+ * against RFC 8439 (2.3.2 and 2.8.2) below the frame layout: the RFC
+ * vector has 12 bytes of associated data where a frame has its 3-byte
+ * header, and nonce bytes 07 00 00 00 where the link has zeros
+ * (-DSECLINK_NONCE_FIXED). Only the first SECLINK_TAG_SIZE bytes of the
+ * tag are kept.
+ *
+ * The rest runs a pair of sessions as the two ECUs do: a frame opens
+ * once, and a frame whose counter is not above the last one accepted (a
+ * replay, or one overtaken by a later frame) is refused and leaves the
+ * session as it was.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include "host_test.h"
+#include "seclink.c"
+
+/******************************************************************************
+ *                          RFC 8439                                           *
+ ******************************************************************************/
+
+/* 2.3.2: key 00..1f, block counter 1, nonce 00000009 0000004a 00000000 */
+static const uint8_t block_out[CHACHA_BLOCK_SIZE] = {
+    0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f,
+    0xa3, 0x20, 0x71, 0xc4, 0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,
+    0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e, 0xd2, 0x82, 0x64, 0x46,
+    0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+    0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8,
+    0xa2, 0x50, 0x3c, 0x4e
+};
+
+/* 2.8.2: key 80..9f, nonce 07000000 | 40..47, associated data below */
+static const uint8_t aead_ad[12] = {
+    0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7
+};
+
+static const char aead_plain[] =
+    "Ladies and Gentlemen of the class of '99: If I could offer you only one "
+    "tip for the future, sunscreen would be it.";
+
+static const uint8_t aead_cipher[sizeof(aead_plain) - 1] = {
+    0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc,
+    0x53, 0xef, 0x7e, 0xc2, 0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe,
+    0xa9, 0xe2, 0xb5, 0xa7, 0x36, 0xee, 0x62, 0xd6, 0x3d, 0xbe, 0xa4, 0x5e,
+    0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa, 0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b,
+    0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29, 0x05, 0xd6, 0xa5, 0xb6,
+    0x7e, 0xcd, 0x3b, 0x36, 0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77, 0x8b, 0x8c,
+    0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58, 0xfa, 0xb3, 0x24, 0xe4,
+    0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc,
+    0x3f, 0xf4, 0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65,
+    0x86, 0xce, 0xc6, 0x4b, 0x61, 0x16
+};
+
+static const uint8_t aead_tag[16] = {
+    0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a,
+    0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60, 0x06, 0x91
+};
+
+#define AEAD_COUNTER            0x4746454443424140ULL   /* nonce bytes 4-11 */
+
+static void Test_ChaChaBlock(void)
+{
+    uint8_t bytes[SECLINK_KEY_SIZE];
+    uint32_t key[SECLINK_KEY_SIZE / 4];
+    uint32_t input[4] = { 1, 0x09000000U, 0x4a000000U, 0 };
+    uint32_t out[CHACHA_BLOCK_WORDS];
+    uint8_t serial[CHACHA_BLOCK_SIZE];
+    uint32_t i;
+
+    for (i = 0; i < SECLINK_KEY_SIZE; i++)
+    {
+        bytes[i] = (uint8_t)i;
+    }
+    for (i = 0; i < SECLINK_KEY_SIZE / 4; i++)
+    {
+        key[i] = SecLink_Load32(&bytes[4 * i]);
+    }
+    SecLink_Block(key, input, out);
+    for (i = 0; i < CHACHA_BLOCK_WORDS; i++)
+    {
+        SecLink_Store32(&serial[4 * i], out[i]);
+    }
+    HOST_CHECK_MEM(serial, block_out, sizeof(block_out));
+}
+
+static void Test_Aead(void)
+{
+    uint8_t bytes[SECLINK_KEY_SIZE];
+    uint32_t key[SECLINK_KEY_SIZE / 4];
+    uint8_t data[sizeof(aead_cipher)];
+    uint8_t tag[SECLINK_TAG_SIZE];
+    uint32_t i;
+
+    for (i = 0; i < SECLINK_KEY_SIZE; i++)
+    {
+        bytes[i] = (uint8_t)(0x80 + i);
+    }
+    for (i = 0; i < SECLINK_KEY_SIZE / 4; i++)
+    {
+        key[i] = SecLink_Load32(&bytes[4 * i]);
+    }
+
+    memcpy(data, aead_plain, sizeof(data));
+    SecLink_Crypt(key, AEAD_COUNTER, data, sizeof(data));
+    HOST_CHECK_MEM(data, aead_cipher, sizeof(aead_cipher));
+
+    SecLink_Tag(key, AEAD_COUNTER, aead_ad, sizeof(aead_ad), data, sizeof(data), tag);
+    HOST_CHECK_MEM(tag, aead_tag, SECLINK_TAG_SIZE);
+
+    SecLink_Crypt(key, AEAD_COUNTER, data, sizeof(data));
+    HOST_CHECK_MEM(data, aead_plain, sizeof(data));
+}
+
+/******************************************************************************
+ *                          Sessions                                           *
+ ******************************************************************************/
+
+static const uint8_t hmi_nonce[SECLINK_NONCE_SIZE] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+static const uint8_t control_nonce[SECLINK_NONCE_SIZE] = { 9, 10, 11, 12, 13, 14, 15, 16 };
+
+static SecLink_Session hmi;
+static SecLink_Session control;
+
+typedef struct
+{
+    uint8_t header[SECLINK_HEADER_SIZE];
+    uint8_t body[SECLINK_OVERHEAD + 16];
+    uint8_t length;
+} Sealed_Frame;
+
+static void Pair(void)
+{
+    uint8_t hmi_confirm[SECLINK_TAG_SIZE];
+    uint8_t control_confirm[SECLINK_TAG_SIZE];
+
+    SecLink_Start(&hmi, SECLINK_HMI, hmi_nonce, control_nonce, hmi_confirm);
+    SecLink_Start(&control, SECLINK_CONTROL, hmi_nonce, control_nonce, control_confirm);
+    HOST_CHECK_MEM(hmi_confirm, control_confirm, SECLINK_TAG_SIZE);
+}
+
+/* HMI -> Control frame with a 5-byte payload */
+static void Seal(Sealed_Frame *frame, uint8_t seq)
+{
+    frame->header[0] = 0x04;
+    frame->header[1] = seq;
+    frame->header[2] = 5 + SECLINK_OVERHEAD;
+    memcpy(&frame->body[SECLINK_COUNTER_SIZE], "12345", 5);
+    SecLink_Seal(&hmi, frame->header, frame->body, 5);
+    frame->length = 5 + SECLINK_OVERHEAD;
+}
+
+/* Opens a copy, so a refused frame can be checked untouched */
+static uint8_t Open(const Sealed_Frame *frame)
+{
+    Sealed_Frame copy = *frame;
+    uint8_t result;
+
+    result = SecLink_Open(&control, copy.header, copy.body, copy.length);
+    if (result)
+    {
+        HOST_CHECK_MEM(&copy.body[SECLINK_COUNTER_SIZE], "12345", 5);
+    }
+    else
+    {
+        HOST_CHECK_MEM(copy.body, frame->body, frame->length);
+    }
+    return result;
+}
+
+static void Test_Roundtrip(void)
+{
+    Sealed_Frame frame;
+    uint32_t i;
+
+    Pair();
+    for (i = 0; i < 4; i++)
+    {
+        Seal(&frame, (uint8_t)i);
+        HOST_CHECK(memcmp(&frame.body[SECLINK_COUNTER_SIZE], "12345", 5) != 0);
+        HOST_CHECK(Open(&frame) == 1);
+    }
+
+    /* Altered payload, tag or header */
+    Seal(&frame, 4);
+    frame.body[SECLINK_COUNTER_SIZE] ^= 0x01;
+    HOST_CHECK(Open(&frame) == 0);
+    frame.body[SECLINK_COUNTER_SIZE] ^= 0x01;
+    frame.body[frame.length - 1] ^= 0x80;
+    HOST_CHECK(Open(&frame) == 0);
+    frame.body[frame.length - 1] ^= 0x80;
+    frame.header[1] ^= 0x10;
+    HOST_CHECK(Open(&frame) == 0);
+    frame.header[1] ^= 0x10;
+    HOST_CHECK(Open(&frame) == 1);
+}
+
+static void Test_ReusedCounter(void)
+{
+    Sealed_Frame first;
+    Sealed_Frame second;
+    uint8_t later_nonce[SECLINK_NONCE_SIZE] = { 9, 10, 11, 12, 13, 14, 15, 17 };
+    uint8_t confirm[SECLINK_TAG_SIZE];
+    uint64_t accepted;
+
+    Pair();
+    Seal(&first, 1);
+
+    /* A replay of an accepted frame */
+    HOST_CHECK(Open(&first) == 1);
+    accepted = control.rx_counter;
+    HOST_CHECK(Open(&first) == 0);
+    HOST_CHECK(control.rx_counter == accepted);
+
+    /* One overtaken by a later frame */
+    Pair();
+    Seal(&first, 1);
+    Seal(&second, 2);
+    HOST_CHECK(Open(&second) == 1);
+    HOST_CHECK(Open(&first) == 0);
+    HOST_CHECK(Open(&second) == 0);
+    HOST_CHECK(control.rx_counter == 2);
+
+    /* Past the 16 bits that travel, a replay is still refused */
+    Pair();
+    hmi.tx_counter = 0xFFFEU;
+    control.rx_counter = 0xFFFEU;
+    Seal(&first, 1);                /* 0xFFFF */
+    Seal(&second, 2);               /* 0x10000, sent as 0000 */
+    HOST_CHECK(Open(&first) == 1);
+    HOST_CHECK(Open(&second) == 1);
+    HOST_CHECK(control.rx_counter == 0x10000U);
+    HOST_CHECK(Open(&first) == 0);
+    HOST_CHECK(Open(&second) == 0);
+
+    /* A frame of an earlier session opens in no later one, which counts
+     * from 1 again */
+    Pair();
+    Seal(&first, 1);
+    SecLink_Start(&control, SECLINK_CONTROL, hmi_nonce, later_nonce, confirm);
+    HOST_CHECK(Open(&first) == 0);
+    HOST_CHECK(control.rx_counter == 0);
+
+    /* Nor before a session is started */
+    memset(&control, 0, sizeof(control));
+    HOST_CHECK(Open(&first) == 0);
+}
+
+int main(void)
+{
+    Test_ChaChaBlock();
+    Test_Aead();
+    Test_Roundtrip();
+    Test_ReusedCounter();
+
+    return Host_TestResult("test_seclink");
+}
@@ -0,0 +1,665 @@
+/******************************************************************************
+ * File: test_store.c
+ * Module: Host Simulation
+ * Description: Power-loss tests of the config journal (store.c, config.c)
+ *              on the host EEPROM emulator
+ *
+ * A sweep runs the same script of writes once for every word program in
+ * it, cutting the power during that program (host_eeprom.h). After each
+ * cut the journal is mounted again as at boot and must hold either the
+ * last write that reported success or the one in flight, never a mix and
+ * never an older one. The sweep ends with the first run that completes.
+ * The recovery cases damage copies in place and check that the mount
+ * falls back to the newest intact one, and that erased data is scrubbed.
+ * The wear sweep cuts the power during every program of a write of the
+ * wear table (wear.h): no block's count may go back.
+ * The store sweep runs the script in a child process, so the mount after
+ * the cut starts from fresh RAM as at boot; the config sweep stays in one
+ * process and relies on Config_Init loading the shadow again.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "store.h"
+#include "wear.h"
+#include "host_eeprom.h"
+#include "host_test.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define IMAGE_SIZE              (STORE_IMAGE_WORDS * EEPROM_WORD_SIZE)
+#define RECORD_SIZE             (STORE_RECORD_WORDS * EEPROM_WORD_SIZE)
+#define SWEEP_STEPS             24      /* writes per run of a sweep */
+
+/******************************************************************************
+ *                          Power model                                        *
+ ******************************************************************************/
+
+static uint8_t power_lost = 0;
+
+/* Instead of restarting the process: the EEPROM stays off until the next
+ * EEPROM_Init, which the test calls as the reset would */
+static void OnPowerLoss(void)
+{
+    power_lost = 1;
+}
+
+/* Powers up with the model off */
+static void PowerUp(void)
+{
+    Host_EepromSetModel(0, 0);
+    power_lost = 0;
+    HOST_CHECK(EEPROM_Init() == EEPROM_SUCCESS);
+}
+
+/* Powers up on an erased array and mounts it */
+static void Blank(uint8_t *image, uint8_t *tag)
+{
+    PowerUp();
+    HOST_CHECK(EEPROM_MassErase() == EEPROM_SUCCESS);
+    HOST_CHECK(Store_Mount(image, tag) == EEPROM_SUCCESS);
+}
+
+/* A different image for every step of every run */
+static void Image(uint8_t *image, uint32_t run, uint32_t step)
+{
+    uint32_t i;
+
+    for (i = 0; i < IMAGE_SIZE; i++)
+    {
+        image[i] = (uint8_t)(run * 31U + step * 7U + i);
+    }
+}
+
+static uint8_t IsBlank(const uint8_t *data, uint32_t length)
+{
+    while (length-- > 0)
+    {
+        if (*data++ != 0xFF)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                          Store sweep                                        *
+ ******************************************************************************/
+
+static uint8_t submit_result = 0xFF;
+
+static void OnSubmitted(uint8_t result, uint32_t written)
+{
+    (void)written;
+    submit_result = result;
+}
+
+/*
+ * Store_Step
+ * One write of the script: every third a Store_Write, every seventh a
+ * Store_Erase, the rest through Store_Submit.
+ * Returns: 1 if it reported success
+ */
+static uint8_t Store_Step(uint32_t step, uint8_t *image, uint8_t *tag)
+{
+    uint32_t written;
+
+    if (step % 7U == 6U)
+    {
+        memset(image, 0xFF, IMAGE_SIZE);
+        *tag = 0;
+        return Store_Erase() == EEPROM_SUCCESS;
+    }
+    if (step % 3U == 0U)
+    {
+        return Store_Write(image, *tag, &written) == EEPROM_SUCCESS;
+    }
+    submit_result = 0xFF;
+    if (Store_Submit(image, *tag, OnSubmitted) != EEPROM_SUCCESS)
+    {
+        return 0;
+    }
+    while (submit_result == 0xFF && !power_lost)
+    {
+        Store_Task();
+    }
+    return submit_result == EEPROM_SUCCESS;
+}
+
+/* What a run of the sweep leaves for the parent to check */
+typedef struct
+{
+    uint8_t committed[IMAGE_SIZE];      /* last write that reported success */
+    uint8_t inflight[IMAGE_SIZE];       /* the one the power cut */
+    uint8_t committed_tag;
+    uint8_t inflight_tag;
+    uint8_t lost;
+} Sweep_Run;
+
+static Sweep_Run *sweep_run;            /* shared with the child */
+
+/* The script, in a child process: cutting the power there and mounting
+ * again in the parent starts from fresh RAM, as a reset does */
+static void Store_Script(uint32_t run)
+{
+    uint32_t step;
+
+    Host_EepromSetModel(0, run);
+    for (step = 0; step < SWEEP_STEPS && !power_lost; step++)
+    {
+        Image(sweep_run->inflight, run, step);
+        sweep_run->inflight_tag = (uint8_t)(step | 1U);
+        if (Store_Step(step, sweep_run->inflight, &sweep_run->inflight_tag))
+        {
+            memcpy(sweep_run->committed, sweep_run->inflight, IMAGE_SIZE);
+            sweep_run->committed_tag = sweep_run->inflight_tag;
+        }
+        Store_Task();       /* scrubbing after an erase is cut too */
+    }
+    sweep_run->lost = power_lost;
+}
+
+static void Test_StoreSweep(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t tag;
+    uint32_t run;
+    pid_t child;
+    int status;
+
+    for (run = 1; ; run++)
+    {
+        Blank(image, &tag);
+        memcpy(sweep_run->committed, image, IMAGE_SIZE);
+        sweep_run->committed_tag = tag;
+        sweep_run->lost = 0;
+
+        fflush(stdout);
+        child = fork();
+        if (child == 0)
+        {
+            Store_Script(run);
+            _exit(0);
+        }
+        HOST_CHECK(child > 0 && waitpid(child, &status, 0) == child &&
+                   WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        if (child <= 0 || !sweep_run->lost)
+        {
+            break;
+        }
+
+        PowerUp();
+        HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+        HOST_CHECK((tag == sweep_run->committed_tag &&
+                    memcmp(image, sweep_run->committed, IMAGE_SIZE) == 0) ||
+                   (tag == sweep_run->inflight_tag &&
+                    memcmp(image, sweep_run->inflight, IMAGE_SIZE) == 0));
+    }
+    HOST_CHECK(run > SWEEP_STEPS);      /* every step was cut at least once */
+}
+
+/******************************************************************************
+ *                          Config sweep                                       *
+ ******************************************************************************/
+
+/* Fields of the script: word offset and length in bytes */
+static const uint8_t config_fields[][2] = { { 0, 8 }, { 4, 4 }, { 2, 4 }, { 5, 4 } };
+
+static void Test_ConfigSweep(void)
+{
+    uint8_t committed[CONFIG_SIZE];
+    uint8_t inflight[CONFIG_SIZE];
+    uint8_t record[CONFIG_SIZE];
+    uint8_t field[8];
+    uint32_t offset;
+    uint32_t length;
+    uint32_t run;
+    uint32_t step;
+    uint8_t result;
+
+    for (run = 1; ; run++)
+    {
+        PowerUp();
+        HOST_CHECK(Config_Erase(1) == EEPROM_SUCCESS);
+        HOST_CHECK(Config_Read(0, committed, CONFIG_SIZE) == EEPROM_SUCCESS);
+        HOST_CHECK(IsBlank(committed, CONFIG_SIZE));
+        memcpy(inflight, committed, CONFIG_SIZE);
+
+        Host_EepromSetModel(0, run);
+        for (step = 0; step < SWEEP_STEPS && !power_lost; step++)
+        {
+            offset = config_fields[step % 4U][0];
+            length = config_fields[step % 4U][1];
+            Image(field, run, step);
+            memcpy(inflight, committed, CONFIG_SIZE);
+            memcpy(&inflight[offset * EEPROM_WORD_SIZE], field, length);
+
+            result = Config_Write(offset, field, length, 0);
+            HOST_CHECK(result == EEPROM_SUCCESS || power_lost);
+            if (result == EEPROM_SUCCESS)
+            {
+                memcpy(committed, inflight, CONFIG_SIZE);
+            }
+        }
+        if (!power_lost)
+        {
+            break;
+        }
+
+        /* The failed write left the shadow unloaded: the next read mounts
+         * the journal again, as Config_Init does at boot */
+        Host_EepromSetModel(0, 0);
+        HOST_CHECK(Config_Read(0, record, CONFIG_SIZE) == EEPROM_SUCCESS);
+        HOST_CHECK(memcmp(record, committed, CONFIG_SIZE) == 0 ||
+                   memcmp(record, inflight, CONFIG_SIZE) == 0);
+        HOST_CHECK(Config_IsSet(0, 8) == !IsBlank(record, 8));
+    }
+    HOST_CHECK(run > SWEEP_STEPS);
+}
+
+/******************************************************************************
+ *                          Old fixed layout                                   *
+ ******************************************************************************/
+
+static const uint8_t legacy[IMAGE_SIZE] = {
+    '5', '4', '3', '2', '1', 0, 0, 0,       /* password, zero padded */
+    7, 0, 0, 0,                             /* timeout */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/*
+ * A first copy torn by a reset is all a fresh device has in block 0. It
+ * must not be taken for the old layout and migrated: the device comes up
+ * blank, and nothing is written at mount.
+ */
+static void Test_TornFirstCopy(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t block[EEPROM_BLOCK_SIZE * EEPROM_WORD_SIZE];
+    uint8_t tag;
+    uint32_t written;
+    uint32_t cut;
+
+    /* Erased words of the record are skipped, so count the programs */
+    for (cut = 1; ; cut++)
+    {
+        Blank(image, &tag);
+        Host_EepromSetModel(0, cut);
+        if (Store_Write(legacy, 0x03, &written) == EEPROM_SUCCESS)
+        {
+            break;
+        }
+        HOST_CHECK(power_lost);
+
+        PowerUp();
+        HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+        HOST_CHECK(tag == 0 && IsBlank(image, IMAGE_SIZE));
+        HOST_CHECK(Host_EepromPrograms() == 0);
+        HOST_CHECK(EEPROM_ReadBuffer(STORE_FIRST_BLOCK + 1, 0, block, sizeof(block)) == EEPROM_SUCCESS);
+        HOST_CHECK(IsBlank(block, sizeof(block)));
+    }
+    HOST_CHECK(cut > 1 && !power_lost);
+}
+
+/*
+ * The old layout itself is migrated into block 1, and a reset during the
+ * migration leaves block 0 to migrate again at the next mount.
+ */
+static void Test_LegacyMigration(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t block0[EEPROM_BLOCK_SIZE * EEPROM_WORD_SIZE];
+    uint8_t tag;
+    uint32_t cut;
+
+    for (cut = 1; cut <= STORE_RECORD_WORDS + 1U; cut++)
+    {
+        Blank(image, &tag);
+        HOST_CHECK(EEPROM_WriteBuffer(STORE_FIRST_BLOCK, 0, legacy, IMAGE_SIZE) == EEPROM_SUCCESS);
+
+        Host_EepromSetModel(0, cut);
+        (void)Store_Mount(image, &tag);
+
+        PowerUp();
+        HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+        HOST_CHECK_MEM(image, legacy, IMAGE_SIZE);
+        HOST_CHECK(tag == 0x07);            /* words 0-2 were written */
+        HOST_CHECK(EEPROM_ReadBuffer(STORE_FIRST_BLOCK, 0, block0, IMAGE_SIZE) == EEPROM_SUCCESS);
+        HOST_CHECK_MEM(block0, legacy, IMAGE_SIZE);
+
+        /* Migrated once: the next mount finds the copy, writes nothing */
+        Host_EepromSetModel(0, 0);
+        HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+        HOST_CHECK_MEM(image, legacy, IMAGE_SIZE);
+        HOST_CHECK(Host_EepromPrograms() == 0);
+    }
+}
+
+/******************************************************************************
+ *                          Recovery                                           *
+ ******************************************************************************/
+
+static void ReadSlot(uint8_t slot, uint8_t *raw)
+{
+    HOST_CHECK(EEPROM_ReadBuffer(STORE_FIRST_BLOCK + slot / STORE_SLOTS_PER_BLOCK,
+                                 (slot % STORE_SLOTS_PER_BLOCK) * STORE_RECORD_WORDS,
+                                 raw, RECORD_SIZE) == EEPROM_SUCCESS);
+}
+
+/* Overwrites one word of a copy in place */
+static void DamageSlot(uint8_t slot, uint32_t word, uint32_t value)
+{
+    HOST_CHECK(EEPROM_WriteBuffer(STORE_FIRST_BLOCK + slot / STORE_SLOTS_PER_BLOCK,
+                                  (slot % STORE_SLOTS_PER_BLOCK) * STORE_RECORD_WORDS + word,
+                                  (const uint8_t *)&value, EEPROM_WORD_SIZE) == EEPROM_SUCCESS);
+}
+
+/* Slot whose copy holds image, STORE_SLOTS if none */
+static uint8_t FindCopy(const uint8_t *image)
+{
+    uint8_t raw[RECORD_SIZE];
+    uint8_t slot;
+
+    for (slot = 0; slot < STORE_SLOTS; slot++)
+    {
+        ReadSlot(slot, raw);
+        if (memcmp(&raw[4], image, IMAGE_SIZE) == 0)
+        {
+            break;
+        }
+    }
+    return slot;
+}
+
+/* Number of slots not erased */
+static uint32_t WrittenSlots(void)
+{
+    uint8_t raw[RECORD_SIZE];
+    uint32_t count = 0;
+    uint8_t slot;
+
+    for (slot = 0; slot < STORE_SLOTS; slot++)
+    {
+        ReadSlot(slot, raw);
+        count += !IsBlank(raw, RECORD_SIZE);
+    }
+    return count;
+}
+
+/* No slot holds anything in its image words */
+static uint8_t ImagesErased(void)
+{
+    uint8_t raw[RECORD_SIZE];
+    uint8_t slot;
+
+    for (slot = 0; slot < STORE_SLOTS; slot++)
+    {
+        ReadSlot(slot, raw);
+        if (!IsBlank(&raw[4], IMAGE_SIZE))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Writes copies 1..count of run, as Image() makes them */
+static void WriteCopies(uint32_t run, uint32_t count)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint32_t written;
+    uint32_t step;
+
+    for (step = 1; step <= count; step++)
+    {
+        Image(image, run, step);
+        HOST_CHECK(Store_Write(image, (uint8_t)step, &written) == EEPROM_SUCCESS);
+    }
+}
+
+/*
+ * The mount keeps the valid copy with the highest sequence number, after
+ * the journal has wrapped too; a copy that fails its CRC, in the image or
+ * the sequence word, is passed over for the one before it.
+ */
+static void Test_NewestWins(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t expect[IMAGE_SIZE];
+    uint8_t tag;
+    uint8_t slot;
+    uint32_t count = STORE_SLOTS + 3U;
+
+    Blank(image, &tag);
+    WriteCopies(40, count);
+
+    Image(expect, 40, count);
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(image, expect, IMAGE_SIZE);
+    HOST_CHECK(tag == count);
+
+    /* Newest copy: one image word changed */
+    slot = FindCopy(expect);
+    HOST_CHECK(slot < STORE_SLOTS);
+    DamageSlot(slot, 2, 0x12345678U);
+    Image(expect, 40, count - 1U);
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(image, expect, IMAGE_SIZE);
+    HOST_CHECK(tag == count - 1U);
+
+    /* The one before: a torn sequence number */
+    slot = FindCopy(expect);
+    HOST_CHECK(slot < STORE_SLOTS);
+    DamageSlot(slot, STORE_RECORD_WORDS - 1U, 0x0000FFFFU);
+    Image(expect, 40, count - 2U);
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(image, expect, IMAGE_SIZE);
+    HOST_CHECK(tag == count - 2U);
+
+    /* Written next, the copy after it wins again */
+    WriteCopies(41, 1);
+    Image(expect, 41, 1);
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(image, expect, IMAGE_SIZE);
+}
+
+/* After Store_Erase and a pass of Store_Task no old image is readable */
+static void Test_EraseScrubs(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t tag;
+    uint32_t i;
+
+    Blank(image, &tag);
+    WriteCopies(50, STORE_SLOTS - 1U);
+    HOST_CHECK(Store_Erase() == EEPROM_SUCCESS);
+    HOST_CHECK(!ImagesErased());        /* left to Store_Task */
+    for (i = 0; i < STORE_SLOTS; i++)
+    {
+        Store_Task();
+    }
+    HOST_CHECK(ImagesErased());
+    HOST_CHECK(WrittenSlots() == 1);    /* the blank copy */
+
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK(tag == 0 && IsBlank(image, IMAGE_SIZE));
+}
+
+/*
+ * A reset during the scrubbing still comes up blank, and the mount of a
+ * blank copy starts the scrubbing over.
+ */
+static void Test_EraseCutMidScrub(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t tag;
+    uint32_t cut;
+    uint32_t i;
+
+    for (cut = 1; ; cut++)
+    {
+        Blank(image, &tag);
+        WriteCopies(60, STORE_SLOTS - 1U);
+        HOST_CHECK(Store_Erase() == EEPROM_SUCCESS);
+
+        Host_EepromSetModel(0, cut);
+        for (i = 0; i < STORE_SLOTS && !power_lost; i++)
+        {
+            Store_Task();
+        }
+        if (!power_lost)
+        {
+            break;
+        }
+
+        PowerUp();
+        HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+        HOST_CHECK(tag == 0 && IsBlank(image, IMAGE_SIZE));
+        for (i = 0; i < STORE_SLOTS; i++)
+        {
+            Store_Task();
+        }
+        HOST_CHECK(ImagesErased());
+    }
+    HOST_CHECK(cut > STORE_SLOTS - 2U);     /* cut in every old slot */
+    HOST_CHECK(ImagesErased());
+}
+
+/* Store_Forget scrubs all but the live copy, which still mounts */
+static void Test_Forget(void)
+{
+    uint8_t image[IMAGE_SIZE];
+    uint8_t expect[IMAGE_SIZE];
+    uint8_t tag;
+    uint32_t i;
+
+    Blank(image, &tag);
+    WriteCopies(70, 4);
+    HOST_CHECK(WrittenSlots() == 4);
+    Store_Forget();
+    for (i = 0; i < STORE_SLOTS; i++)
+    {
+        Store_Task();
+    }
+    HOST_CHECK(WrittenSlots() == 1);
+
+    Image(expect, 70, 4);
+    HOST_CHECK(Store_Mount(image, &tag) == EEPROM_SUCCESS);
+    HOST_CHECK_MEM(image, expect, IMAGE_SIZE);
+    HOST_CHECK(tag == 4);
+}
+
+/******************************************************************************
+ *                          Wear sweep                                         *
+ ******************************************************************************/
+
+/* Programs count words in a block, then writes the wear table with the
+ * EEPROM queue moving on */
+static void WearWrite(uint32_t block, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count && !power_lost; i++)
+    {
+        EEPROM_WriteWord(block, i % EEPROM_BLOCK_SIZE, i);
+    }
+    if (!power_lost)
+    {
+        HOST_CHECK(Wear_Flush() == EEPROM_SUCCESS);
+    }
+    for (i = 0; i < 16 * WEAR_BLOCKS && !power_lost; i++)
+    {
+        EEPROM_Task();
+        Wear_Task();
+    }
+}
+
+static void Test_WearSweep(void)
+{
+    uint32_t before[EEPROM_TOTAL_BLOCKS];
+    uint32_t block;
+    uint32_t cut;
+
+    for (cut = 1; ; cut++)
+    {
+        PowerUp();
+        HOST_CHECK(EEPROM_MassErase() == EEPROM_SUCCESS);
+        HOST_CHECK(Wear_Init() == EEPROM_SUCCESS);
+        WearWrite(1, 100);
+        for (block = 0; block < EEPROM_TOTAL_BLOCKS; block++)
+        {
+            before[block] = Wear_Block(block);
+        }
+
+        Host_EepromSetModel(0, cut);
+        WearWrite(1, 100);
+        Host_EepromSetModel(0, 0);
+        HOST_CHECK(EEPROM_Init() == EEPROM_SUCCESS);
+        HOST_CHECK(Wear_Init() == EEPROM_SUCCESS);
+        for (block = 0; block < WEAR_FIRST_BLOCK; block++)
+        {
+            HOST_CHECK(Wear_Block(block) >= before[block]);
+        }
+        if (!power_lost)
+        {
+            break;
+        }
+        power_lost = 0;
+    }
+    HOST_CHECK(Wear_Block(1) == before[1] + 100U);
+    HOST_CHECK(cut > 100U + 2U);            /* cut in both copies */
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test_store_XXXXXX";
+    char wear_path[sizeof(path) + sizeof(HOST_EEPROM_WEAR_SUFFIX)];
+    int fd;
+
+    /* A file for the image, so the children of the store sweep share it;
+     * the model is set by the test only */
+    fd = mkstemp(path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    unlink(path);
+    snprintf(wear_path, sizeof(wear_path), "%s%s", path, HOST_EEPROM_WEAR_SUFFIX);
+    setenv("SIM_EEPROM_FILE", path, 1);
+    unsetenv("SIM_EEPROM_WORD_US");
+    unsetenv("SIM_EEPROM_POWER_LOSS");
+    Host_EepromSetPowerLossHandler(OnPowerLoss);
+
+    sweep_run = mmap(NULL, sizeof(*sweep_run), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sweep_run == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    Test_StoreSweep();
+    Test_ConfigSweep();
+    Test_TornFirstCopy();
+    Test_LegacyMigration();
+    Test_NewestWins();
+    Test_EraseScrubs();
+    Test_EraseCutMidScrub();
+    Test_Forget();
+    Test_WearSweep();
+
+    unlink(path);
+    unlink(wear_path);
+    return Host_TestResult("test_store");
+}
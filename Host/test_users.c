@@ -0,0 +1,202 @@
+/******************************************************************************
+ * File: test_users.c
+ * Module: Host Simulation
+ * Description: Lookup tests of the user PIN table (Control_ECU/Application/
+ *              users.c) on the host EEPROM emulator
+ *
+ * The table is filled to USERS_MAX and then asked for every one of the
+ * 10^5 PINs: an enrolled PIN must give its own user and any other PIN
+ * nobody, from the RAM copy and again after loading it from the EEPROM.
+ * A PIN that is taken cannot be enrolled twice, and a revoked or cleared
+ * one matches nobody.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "users.h"
+#include "host_test.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define PIN_COUNT               100000UL
+
+static uint16_t owner[PIN_COUNT];               /* USERS_NONE if not enrolled */
+
+static void Pin(uint32_t value, char *pin)
+{
+    uint8_t i;
+
+    for (i = USERS_PIN_LENGTH; i > 0; i--)
+    {
+        pin[i - 1] = (char)('0' + value % 10U);
+        value /= 10U;
+    }
+}
+
+/* Takes an id out of owner[] */
+static void Forget(uint16_t id)
+{
+    uint32_t value;
+
+    for (value = 0; value < PIN_COUNT; value++)
+    {
+        if (owner[value] == id)
+        {
+            owner[value] = USERS_NONE;
+        }
+    }
+}
+
+/* Every PIN gives its owner, and only its owner */
+static void CheckAll(void)
+{
+    char pin[USERS_PIN_LENGTH];
+    uint32_t value;
+    uint32_t wrong = 0;
+
+    for (value = 0; value < PIN_COUNT; value++)
+    {
+        Pin(value, pin);
+        if (Users_Find(pin) != owner[value])
+        {
+            wrong++;
+        }
+    }
+    HOST_CHECK(wrong == 0);
+}
+
+static void PowerUp(void)
+{
+    HOST_CHECK(EEPROM_Init() == EEPROM_SUCCESS);
+    HOST_CHECK(EEPROM_MassErase() == EEPROM_SUCCESS);
+    HOST_CHECK(Users_Init() == EEPROM_SUCCESS);
+}
+
+/******************************************************************************
+ *                          Cases                                              *
+ ******************************************************************************/
+
+/* An unenrolled PIN, drawn at random */
+static uint32_t Unused(void)
+{
+    uint32_t value;
+
+    do
+    {
+        value = (uint32_t)rand() % PIN_COUNT;
+    } while (owner[value] != USERS_NONE);
+    return value;
+}
+
+/* Enrolls an unused PIN; one whose slots in reach are all taken is
+ * refused, and another is drawn */
+static void Enroll(uint16_t id)
+{
+    char pin[USERS_PIN_LENGTH];
+    uint32_t value;
+    uint32_t tries;
+
+    for (tries = 0; tries < 100; tries++)
+    {
+        value = Unused();
+        Pin(value, pin);
+        if (Users_Add(id, pin) == EEPROM_SUCCESS)
+        {
+            owner[value] = id;
+            return;
+        }
+    }
+    HOST_CHECK(tries < 100);
+}
+
+static void Test_Full(void)
+{
+    char pin[USERS_PIN_LENGTH];
+    uint32_t value;
+    uint16_t id;
+
+    for (value = 0; value < PIN_COUNT; value++)
+    {
+        owner[value] = USERS_NONE;
+    }
+    srand(20);
+    for (id = 1; id <= USERS_MAX; id++)
+    {
+        Enroll(id);
+    }
+    HOST_CHECK(Users_Count() == USERS_MAX);
+    CheckAll();
+
+    /* A full table takes nobody else */
+    Pin(Unused(), pin);
+    HOST_CHECK(Users_Add(USERS_MAX + 1, pin) == EEPROM_ERROR);
+
+    HOST_CHECK(Users_Init() == EEPROM_SUCCESS);
+    HOST_CHECK(Users_Count() == USERS_MAX);
+    CheckAll();
+}
+
+static void Test_TakenAndRevoked(void)
+{
+    char pin[USERS_PIN_LENGTH];
+    uint32_t value;
+    uint16_t id;
+    uint16_t other;
+
+    for (value = 0; owner[value] == USERS_NONE; value++)
+    {
+    }
+    Pin(value, pin);
+    id = owner[value];
+    other = (id == 1) ? 2 : 1;
+
+    /* A free id cannot take a PIN in use, nor a user a second PIN */
+    HOST_CHECK(Users_Revoke(other) == EEPROM_SUCCESS);
+    HOST_CHECK(Users_Revoke(other) == EEPROM_ERROR);
+    Forget(other);
+    HOST_CHECK(Users_Add(other, pin) == EEPROM_ERROR);
+    HOST_CHECK(Users_Find(pin) == id);
+    Pin(Unused(), pin);
+    HOST_CHECK(Users_Add(id, pin) == EEPROM_ERROR);
+
+    /* Revoked, a PIN matches nobody and can be enrolled again */
+    Pin(value, pin);
+    HOST_CHECK(Users_Revoke(id) == EEPROM_SUCCESS);
+    Forget(id);
+    HOST_CHECK(Users_Find(pin) == USERS_NONE);
+    HOST_CHECK(Users_Add(other, pin) == EEPROM_SUCCESS);
+    owner[value] = other;
+    CheckAll();
+}
+
+static void Test_Clear(void)
+{
+    uint32_t value;
+
+    HOST_CHECK(Users_Clear() == EEPROM_SUCCESS);
+    HOST_CHECK(Users_Count() == 0);
+    for (value = 0; value < PIN_COUNT; value++)
+    {
+        owner[value] = USERS_NONE;
+    }
+    CheckAll();
+    HOST_CHECK(Users_Init() == EEPROM_SUCCESS);
+    HOST_CHECK(Users_Count() == 0);
+}
+
+int main(void)
+{
+    unsetenv("SIM_EEPROM_FILE");
+    unsetenv("SIM_EEPROM_WORD_US");
+    unsetenv("SIM_EEPROM_POWER_LOSS");
+
+    PowerUp();
+    Test_Full();
+    Test_TakenAndRevoked();
+    Test_Clear();
+
+    return Host_TestResult("test_users");
+}
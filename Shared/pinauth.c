@@ -0,0 +1,246 @@
+/******************************************************************************
+ * File: pinauth.c
+ * Module: PIN Authentication
+ * Description: Challenge-response sealing of the PINs sent over UART5
+ ******************************************************************************/
+
+#include <string.h>
+#include "pinauth.h"
+#include "protocol.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define PINAUTH_PIN_LENGTH      5
+#define PINAUTH_BLOCK_SIZE      8       /* keystream bytes per MAC */
+
+/* Domain of each MAC, first byte of its message */
+#define PINAUTH_DOMAIN_MASK     'M'
+#define PINAUTH_DOMAIN_TAG      'T'
+#define PINAUTH_DOMAIN_NONCE    'N'
+
+#define ROTL64(x, b)            (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3)                                              \
+    do {                                                                      \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32);        \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                              \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                              \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32);        \
+    } while(0)
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static const uint8_t pairing_key[PINAUTH_KEY_SIZE] = { PINAUTH_KEY };
+
+/* SipHash v0..v3 after the key is folded in (PinAuth_Init) */
+static uint64_t key_state[4];
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint64_t PinAuth_Load64(const uint8_t *in)
+{
+    uint64_t value = 0;
+    uint8_t i;
+
+    for(i = PINAUTH_BLOCK_SIZE; i > 0; i--)
+    {
+        value = (value << 8) | in[i - 1];
+    }
+    return value;
+}
+
+/*
+ * PinAuth_Mac
+ * SipHash-2-4 of data under the pairing key.
+ */
+static uint64_t PinAuth_Mac(const uint8_t *data, uint8_t length)
+{
+    uint64_t v0 = key_state[0];
+    uint64_t v1 = key_state[1];
+    uint64_t v2 = key_state[2];
+    uint64_t v3 = key_state[3];
+    uint64_t m;
+    uint8_t left = length;
+    uint8_t i;
+
+    for(; left >= PINAUTH_BLOCK_SIZE; left -= PINAUTH_BLOCK_SIZE, data += PINAUTH_BLOCK_SIZE)
+    {
+        m = PinAuth_Load64(data);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    m = (uint64_t)length << 56;
+    for(i = 0; i < left; i++)
+    {
+        m |= (uint64_t)data[i] << (8 * i);
+    }
+    v3 ^= m;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= m;
+
+    v2 ^= 0xFF;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/* MAC of domain | challenge | data */
+static uint64_t PinAuth_MacChallenge(uint8_t domain, const uint8_t *challenge,
+                                     const uint8_t *data, uint8_t length)
+{
+    uint8_t message[1 + PINAUTH_CHALLENGE_SIZE + 1 + PROTO_MAX_PAYLOAD];
+
+    message[0] = domain;
+    memcpy(&message[1], challenge, PINAUTH_CHALLENGE_SIZE);
+    memcpy(&message[1 + PINAUTH_CHALLENGE_SIZE], data, length);
+    return PinAuth_Mac(message, (uint8_t)(1 + PINAUTH_CHALLENGE_SIZE + length));
+}
+
+/* Keystream block n of the challenge */
+static void PinAuth_Keystream(const uint8_t *challenge, uint8_t n, uint8_t *stream)
+{
+    uint64_t block = PinAuth_MacChallenge(PINAUTH_DOMAIN_MASK, challenge, &n, 1);
+    uint8_t i;
+
+    for(i = 0; i < PINAUTH_BLOCK_SIZE; i++)
+    {
+        stream[i] = (uint8_t)(block >> (8 * i));
+    }
+}
+
+/*
+ * PinAuth_Mask
+ * XORs the digit bytes of a payload (see PinAuth_Seal) with the keystream;
+ * positions past length are left out. Its own inverse.
+ */
+static void PinAuth_Mask(const uint8_t *challenge, uint8_t type, uint8_t *payload, uint8_t length)
+{
+    uint8_t stream[2 * PINAUTH_BLOCK_SIZE];
+    uint8_t i;
+
+    PinAuth_Keystream(challenge, 0, stream);
+    if(type == PROTO_CMD_PIN_DIGIT)
+    {
+        if(length >= 3 && payload[1] < PINAUTH_BLOCK_SIZE)
+        {
+            payload[2] ^= stream[payload[1]];
+        }
+        return;
+    }
+
+    for(i = 0; i < PINAUTH_PIN_LENGTH && i < length; i++)
+    {
+        payload[i] ^= stream[i];
+    }
+    if(type == PROTO_CMD_USER_ADD)
+    {
+        /* master password, user id (2), user PIN */
+        PinAuth_Keystream(challenge, 1, &stream[PINAUTH_BLOCK_SIZE]);
+        for(i = 0; i < PINAUTH_PIN_LENGTH && PINAUTH_PIN_LENGTH + 2 + i < length; i++)
+        {
+            payload[PINAUTH_PIN_LENGTH + 2 + i] ^= stream[PINAUTH_PIN_LENGTH + i];
+        }
+    }
+}
+
+/* Tag of a sealed payload: type | payload after the challenge */
+static uint64_t PinAuth_Tag(const uint8_t *challenge, uint8_t type,
+                            const uint8_t *payload, uint8_t length)
+{
+    uint8_t data[1 + PROTO_MAX_PAYLOAD];
+
+    data[0] = type;
+    memcpy(&data[1], payload, length);
+    return PinAuth_MacChallenge(PINAUTH_DOMAIN_TAG, challenge, data, (uint8_t)(1 + length));
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+void PinAuth_Init(void)
+{
+    uint64_t k0 = PinAuth_Load64(&pairing_key[0]);
+    uint64_t k1 = PinAuth_Load64(&pairing_key[PINAUTH_BLOCK_SIZE]);
+
+    key_state[0] = k0 ^ 0x736F6D6570736575ULL;
+    key_state[1] = k1 ^ 0x646F72616E646F6DULL;
+    key_state[2] = k0 ^ 0x6C7967656E657261ULL;
+    key_state[3] = k1 ^ 0x7465646279746573ULL;
+}
+
+uint8_t PinAuth_Seal(const uint8_t *challenge, uint8_t type, uint8_t *payload, uint8_t length)
+{
+    uint64_t tag;
+    uint8_t i;
+
+    if(length + PINAUTH_TAG_SIZE > PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+    PinAuth_Mask(challenge, type, payload, length);
+    tag = PinAuth_Tag(challenge, type, payload, length);
+    for(i = 0; i < PINAUTH_TAG_SIZE; i++)
+    {
+        payload[length + i] = (uint8_t)(tag >> (8 * i));
+    }
+    return (uint8_t)(length + PINAUTH_TAG_SIZE);
+}
+
+uint8_t PinAuth_Open(const uint8_t *challenge, uint8_t type, const uint8_t *payload,
+                     uint8_t length, uint8_t *plain)
+{
+    uint64_t tag;
+    uint8_t differ = 0;
+    uint8_t i;
+
+    if(length <= PINAUTH_TAG_SIZE || length > PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+    length -= PINAUTH_TAG_SIZE;
+    tag = PinAuth_Tag(challenge, type, payload, length);
+    for(i = 0; i < PINAUTH_TAG_SIZE; i++)
+    {
+        differ |= (uint8_t)(payload[length + i] ^ (uint8_t)(tag >> (8 * i)));
+    }
+    if(differ != 0)
+    {
+        return 0;
+    }
+
+    memcpy(plain, payload, length);
+    PinAuth_Mask(challenge, type, plain, length);
+    return length;
+}
+
+void PinAuth_Nonce(uint32_t seed_a, uint32_t seed_b, uint8_t *challenge)
+{
+    uint8_t seeds[1 + 8];
+    uint64_t nonce;
+    uint8_t i;
+
+    seeds[0] = PINAUTH_DOMAIN_NONCE;
+    for(i = 0; i < 4; i++)
+    {
+        seeds[1 + i] = (uint8_t)(seed_a >> (8 * i));
+        seeds[5 + i] = (uint8_t)(seed_b >> (8 * i));
+    }
+    nonce = PinAuth_Mac(seeds, sizeof(seeds));
+    for(i = 0; i < PINAUTH_CHALLENGE_SIZE; i++)
+    {
+        challenge[i] = (uint8_t)(nonce >> (8 * i));
+    }
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+ * File: pinauth.h
+ * Module: PIN Authentication
+ * Description: Challenge-response sealing of the PINs sent over UART5
+ *
+ * HMI_ECU and Control_ECU share a pairing key, PINAUTH_KEY, set at build
+ * time for each pair. Control_ECU keeps a single-use challenge: an
+ * unpredictable PINAUTH_CHALLENGE_SIZE-byte nonce, drawn at boot and
+ * again every time one is spent. The HMI learns it from the boot
+ * snapshot and from PROTO_EVT_CHALLENGE, which Control_ECU sends right
+ * after spending one, so a PIN request never waits for an extra round
+ * trip.
+ *
+ * Every frame carrying PIN digits (VERIFY_PASSWORD, STORE_PASSWORD,
+ * PIN_DIGIT, USER_ADD, USER_REVOKE) is sealed with the challenge:
+ *
+ *   - the digit bytes are XORed with a keystream,
+ *       block n = SipHash-2-4(K, 'M' | challenge | n), 8 bytes each
+ *   - PINAUTH_TAG_SIZE bytes are appended,
+ *       SipHash-2-4(K, 'T' | challenge | type | sealed payload)
+ *     (first bytes, LSB first), covering every byte of the payload
+ *
+ * so the digits never cross the link in clear, a recorded frame is
+ * refused once its challenge is spent, and a frame can't be altered or
+ * moved to another command. The other bytes (user id, PIN_DIGIT session
+ * and index) travel in clear under the tag. Which bytes are digits is
+ * fixed per command type, see PinAuth_Seal.
+ *
+ * SipHash keeps its 128-bit key as the four 64-bit words it starts from;
+ * PinAuth_Init computes them once, so a MAC costs only its compressions.
+ ******************************************************************************/
+
+#ifndef PINAUTH_H_
+#define PINAUTH_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define PINAUTH_KEY_SIZE        16
+#define PINAUTH_CHALLENGE_SIZE  8
+#define PINAUTH_TAG_SIZE        4
+
+/* Pairing key, bytes in order: no default, every pair is built with its
+ * own (-DPINAUTH_KEY="0x..,0x..,...", see README "Pairing Keys") */
+#ifndef PINAUTH_KEY
+#error "PINAUTH_KEY must be provided"
+#endif
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * PinAuth_Init
+ * Precomputes the key state. Call once before anything else here.
+ */
+void PinAuth_Init(void);
+
+/*
+ * PinAuth_Seal
+ * Masks the digit bytes of a PIN payload in place and appends the tag:
+ *   VERIFY_PASSWORD, STORE_PASSWORD, USER_REVOKE - bytes 0-4
+ *   USER_ADD  - bytes 0-4 (master password), 7-11 (user PIN)
+ *   PIN_DIGIT - byte 2, with keystream byte 'index' (byte 1)
+ * Parameters:
+ *   challenge - PINAUTH_CHALLENGE_SIZE bytes
+ *   type      - PROTO_CMD_xxx of the frame
+ *   payload   - Plain payload, room for PINAUTH_TAG_SIZE more bytes
+ *   length    - Plain payload length
+ * Returns: sealed length, 0 if the payload is too short for the type
+ */
+uint8_t PinAuth_Seal(const uint8_t *challenge, uint8_t type, uint8_t *payload, uint8_t length);
+
+/*
+ * PinAuth_Open
+ * Checks the tag (every byte, whatever differs first) and unmasks the
+ * digit bytes of a sealed payload into plain.
+ * Parameters:
+ *   challenge - PINAUTH_CHALLENGE_SIZE bytes
+ *   type      - PROTO_CMD_xxx of the frame
+ *   payload   - Sealed payload
+ *   length    - Sealed payload length
+ *   plain     - Receives the plain payload (length - PINAUTH_TAG_SIZE)
+ * Returns: plain length, 0 if the tag is wrong or the payload too short
+ */
+uint8_t PinAuth_Open(const uint8_t *challenge, uint8_t type, const uint8_t *payload,
+                     uint8_t length, uint8_t *plain);
+
+/*
+ * PinAuth_Nonce
+ * Draws a challenge: the MAC of the seeds, so it is unpredictable
+ * without the key as long as the seeds never repeat.
+ * Parameters:
+ *   seed_a, seed_b - e.g. a persistent clock and a counter
+ *   challenge      - Receives PINAUTH_CHALLENGE_SIZE bytes
+ */
+void PinAuth_Nonce(uint32_t seed_a, uint32_t seed_b, uint8_t *challenge);
+
+#endif /* PINAUTH_H_ */
@@ -0,0 +1,396 @@
+/******************************************************************************
+ * File: protocol.c
+ * Module: Inter-ECU Protocol
+ * Description: Frame encoder/decoder shared by HMI_ECU and Control_ECU
+ ******************************************************************************/
+
+#include <string.h>
+#include "protocol.h"
+#include "uart.h"
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+/* Nibble table for CRC-16/CCITT (poly 0x1021) - 32 bytes of flash */
+static const uint16_t crc16_nibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/* Replies sent by PROTO_Reply, plain, for PROTO_ReplayReply: the last
+ * one for each SEQ modulo PROTO_REPLY_CACHE (type 0 = none) */
+static PROTO_Frame reply_cache[PROTO_REPLY_CACHE];
+
+#if PROTO_SECURE
+static SecLink_Session session;
+#endif
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+/*
+ * PROTO_Discard
+ * Drops the first count bytes of the assembly buffer.
+ */
+static void PROTO_Discard(PROTO_Parser *parser, uint8_t count)
+{
+    parser->count -= count;
+    memmove(parser->raw, &parser->raw[count], parser->count);
+}
+
+/*
+ * PROTO_Resync
+ * Drops the leading SYNC of a rejected frame and everything up to the next
+ * SYNC byte already buffered, so decoding restarts inside the bad frame.
+ */
+static void PROTO_Resync(PROTO_Parser *parser)
+{
+    uint8_t skip = 1;
+
+    while((skip < parser->count) && (parser->raw[skip] != PROTO_SYNC))
+    {
+        skip++;
+    }
+    PROTO_Discard(parser, skip);
+}
+
+/*
+ * PROTO_LengthValid
+ * Checks LEN against TYPE as soon as the header is in, so a SYNC byte
+ * inside a frame whose own SYNC was lost is dropped at once instead of
+ * holding the parser for up to a whole frame of what follows. In a secure
+ * build a sealed frame carries at least its counter and tag.
+ */
+static uint8_t PROTO_LengthValid(uint8_t type, uint8_t length)
+{
+#if PROTO_SECURE
+    if((type & PROTO_SEAL_FLAG) != 0)
+    {
+        return (uint8_t)(length >= SECLINK_OVERHEAD && length <= PROTO_MAX_PAYLOAD + SECLINK_OVERHEAD);
+    }
+#else
+    (void)type;
+#endif
+    return (uint8_t)(length <= PROTO_MAX_PAYLOAD);
+}
+
+/*
+ * PROTO_ParserScan
+ * Tries to extract one frame from the assembly buffer. Rejected frames are
+ * re-scanned from their next SYNC, so bytes already buffered after a bad
+ * frame may still complete a good one.
+ */
+static uint8_t PROTO_ParserScan(PROTO_Parser *parser, PROTO_Frame *frame)
+{
+    uint8_t  length;
+    uint8_t  total;
+    uint16_t crc;
+    uint8_t  result = PROTO_FRAME_READY;
+
+    while(parser->count >= PROTO_HEADER_SIZE)
+    {
+        length = parser->raw[3];
+        if(!PROTO_LengthValid(parser->raw[1], length))
+        {
+            parser->crc_errors++;
+            PROTO_Resync(parser);
+            continue;
+        }
+
+        total = (uint8_t)(PROTO_HEADER_SIZE + length + PROTO_CRC_SIZE);
+        if(parser->count < total)
+        {
+            break;                  /* need more bytes */
+        }
+
+        crc = PROTO_Crc16(0xFFFF, &parser->raw[1], (uint32_t)length + 3U);
+        if((parser->raw[total - 2] != (uint8_t)(crc >> 8)) ||
+           (parser->raw[total - 1] != (uint8_t)(crc & 0xFF)))
+        {
+            parser->crc_errors++;
+            PROTO_Resync(parser);
+            continue;
+        }
+
+        frame->type   = parser->raw[1];
+        frame->seq    = parser->raw[2];
+        frame->length = length;
+#if PROTO_SECURE
+        if(parser->raw[1] & PROTO_SEAL_FLAG)
+        {
+            /* Opened in place; only the plain payload is copied out */
+            frame->type &= (uint8_t)~PROTO_SEAL_FLAG;
+            frame->length = 0;
+            result = PROTO_FRAME_REFUSED;
+            if(SecLink_Open(&session, &parser->raw[1], &parser->raw[PROTO_HEADER_SIZE], length))
+            {
+                frame->length = (uint8_t)(length - SECLINK_OVERHEAD);
+                memcpy(frame->payload, &parser->raw[PROTO_HEADER_SIZE + SECLINK_COUNTER_SIZE],
+                       frame->length);
+                result = PROTO_FRAME_READY;
+            }
+            else
+            {
+                parser->refused++;
+            }
+            PROTO_Discard(parser, total);
+            return result;
+        }
+        result = PROTO_FRAME_PLAIN;
+#endif
+        memcpy(frame->payload, &parser->raw[PROTO_HEADER_SIZE], length);
+        PROTO_Discard(parser, total);
+        return result;
+    }
+
+    return PROTO_NO_FRAME;
+}
+
+/*
+ * PROTO_AppendCrc
+ * Appends the CRC to a frame whose header and LEN bytes are in place.
+ * Returns: frame size in bytes
+ */
+static uint32_t PROTO_AppendCrc(uint8_t *out)
+{
+    uint8_t  length = out[3];
+    uint16_t crc = PROTO_Crc16(0xFFFF, &out[1], (uint32_t)length + 3U);
+
+    out[PROTO_HEADER_SIZE + length]     = (uint8_t)(crc >> 8);
+    out[PROTO_HEADER_SIZE + length + 1] = (uint8_t)(crc & 0xFF);
+
+    return (uint32_t)PROTO_HEADER_SIZE + length + PROTO_CRC_SIZE;
+}
+
+/*
+ * PROTO_Transmit
+ * Encodes a frame and queues it on UART5. A sealed frame (PROTO_SECURE)
+ * gets its payload copied once, into the frame, and encrypted there.
+ * Returns: 1 if sent, 0 if the payload is too long or, sealed, if no
+ *          session is open
+ */
+static uint8_t PROTO_Transmit(uint8_t type, uint8_t seq, const uint8_t *payload,
+                              uint8_t length, uint8_t sealed)
+{
+    uint8_t  out[PROTO_MAX_FRAME];
+    uint32_t size;
+    uint32_t sent = 0;
+
+    if(length > PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+#if PROTO_SECURE
+    if(sealed)
+    {
+        if(!session.active)
+        {
+            return 0;               /* nothing leaves in clear */
+        }
+        out[0] = PROTO_SYNC;
+        out[1] = type | PROTO_SEAL_FLAG;
+        out[2] = seq;
+        out[3] = (uint8_t)(length + SECLINK_OVERHEAD);
+        if(length > 0)
+        {
+            memcpy(&out[PROTO_HEADER_SIZE + SECLINK_COUNTER_SIZE], payload, length);
+        }
+        SecLink_Seal(&session, &out[1], &out[PROTO_HEADER_SIZE], length);
+        size = PROTO_AppendCrc(out);
+    }
+    else
+#endif
+    {
+        (void)sealed;
+        size = PROTO_Encode(type, seq, payload, length, out);
+    }
+
+    while(sent < size)
+    {
+        sent += UART5_Write(&out[sent], size - sent);
+    }
+    return 1;
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+uint16_t PROTO_Crc16(uint16_t crc, const uint8_t *data, uint32_t length)
+{
+    uint32_t i;
+
+    for(i = 0; i < length; i++)
+    {
+        crc = (uint16_t)(crc << 4) ^ crc16_nibble[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ crc16_nibble[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+uint32_t PROTO_Encode(uint8_t type, uint8_t seq, const uint8_t *payload,
+                      uint8_t length, uint8_t *out)
+{
+    if(length > PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    out[0] = PROTO_SYNC;
+    out[1] = type;
+    out[2] = seq;
+    out[3] = length;
+    if(length > 0)
+    {
+        memcpy(&out[PROTO_HEADER_SIZE], payload, length);
+    }
+
+    return PROTO_AppendCrc(out);
+}
+
+void PROTO_ParserReset(PROTO_Parser *parser)
+{
+    parser->count = 0;
+}
+
+uint8_t PROTO_ParserFeed(PROTO_Parser *parser, uint8_t byte, PROTO_Frame *frame)
+{
+    if((parser->count == 0) && (byte != PROTO_SYNC))
+    {
+        return PROTO_NO_FRAME;      /* hunting for SYNC */
+    }
+    parser->raw[parser->count++] = byte;
+
+    return PROTO_ParserScan(parser, frame);
+}
+
+uint8_t PROTO_Send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length)
+{
+    return PROTO_Transmit(type, seq, payload, length, 1);
+}
+
+uint8_t PROTO_SendPlain(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length)
+{
+    return PROTO_Transmit(type, seq, payload, length, 0);
+}
+
+uint8_t PROTO_Reply(const PROTO_Frame *request, uint8_t status,
+                    const uint8_t *data, uint8_t length)
+{
+    PROTO_Frame *reply = &reply_cache[request->seq % PROTO_REPLY_CACHE];
+
+    if(length >= PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    reply->type = request->type | PROTO_REPLY_FLAG;
+    reply->seq = request->seq;
+    reply->length = (uint8_t)(length + 1U);
+    reply->payload[0] = status;
+    if(length > 0)
+    {
+        memcpy(&reply->payload[1], data, length);
+    }
+
+    return PROTO_Transmit(reply->type, reply->seq, reply->payload, reply->length, 1);
+}
+
+uint8_t PROTO_ReplyPlain(const PROTO_Frame *request, uint8_t status,
+                         const uint8_t *data, uint8_t length)
+{
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+
+    if(length >= PROTO_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    payload[0] = status;
+    if(length > 0)
+    {
+        memcpy(&payload[1], data, length);
+    }
+    return PROTO_Transmit(request->type | PROTO_REPLY_FLAG, request->seq,
+                          payload, (uint8_t)(length + 1U), 0);
+}
+
+uint8_t PROTO_ReplayReply(const PROTO_Frame *request)
+{
+    const PROTO_Frame *reply = &reply_cache[request->seq % PROTO_REPLY_CACHE];
+
+    if((reply->type != (request->type | PROTO_REPLY_FLAG)) || (reply->seq != request->seq))
+    {
+        return 0;
+    }
+
+    PROTO_Transmit(reply->type, reply->seq, reply->payload, reply->length, 1);
+    return 1;
+}
+
+uint8_t PROTO_ErrorBurst(PROTO_ErrorWatch *watch, uint32_t now_ms)
+{
+    uint32_t errors = UART5_GetRxErrorCount() + UART5_GetRxOverflowCount();
+
+    if((errors - watch->errors) >= PROTO_BAUD_ERROR_LIMIT)
+    {
+        watch->errors = errors;
+        watch->window_start = now_ms;
+        return 1;
+    }
+
+    if((now_ms - watch->window_start) >= PROTO_BAUD_ERROR_WINDOW_MS)
+    {
+        watch->errors = errors;
+        watch->window_start = now_ms;
+    }
+    return 0;
+}
+
+uint8_t PROTO_Poll(PROTO_Parser *parser, PROTO_Frame *frame)
+{
+    uint8_t byte;
+    uint8_t result = PROTO_ParserScan(parser, frame);
+
+    if(result != PROTO_NO_FRAME)
+    {
+        return result;
+    }
+
+    while(UART5_Read(&byte, 1) == 1)
+    {
+        result = PROTO_ParserFeed(parser, byte, frame);
+        if(result != PROTO_NO_FRAME)
+        {
+            return result;
+        }
+    }
+    return PROTO_NO_FRAME;
+}
+
+uint8_t PROTO_Secured(void)
+{
+#if PROTO_SECURE
+    return session.active;
+#else
+    return 1;
+#endif
+}
+
+#if PROTO_SECURE
+void PROTO_SecureStart(uint8_t role, const uint8_t *hmi_nonce,
+                       const uint8_t *control_nonce, uint8_t *confirm)
+{
+    SecLink_Start(&session, role, hmi_nonce, control_nonce, confirm);
+    memset(reply_cache, 0, sizeof(reply_cache));   /* replies of the last session */
+}
+
+void PROTO_SecureStop(void)
+{
+    memset(&session, 0, sizeof(session));
+}
+#endif
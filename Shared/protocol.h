@@ -0,0 +1,428 @@
+/******************************************************************************
+ * File: protocol.h
+ * Module: Inter-ECU Protocol
+ * Description: Framed binary protocol shared by HMI_ECU and Control_ECU
+ *
+ * Frame layout (all fields are bytes, CRC is sent high byte first):
+ *
+ *   +------+------+-----+-----+-----------------+-------+
+ *   | SYNC | TYPE | SEQ | LEN | PAYLOAD[0..LEN) | CRC16 |
+ *   +------+------+-----+-----+-----------------+-------+
+ *
+ *   - SYNC is always PROTO_SYNC
+ *   - CRC16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over
+ *     TYPE, SEQ, LEN and PAYLOAD
+ *   - A reply carries the request TYPE | PROTO_REPLY_FLAG and the same SEQ;
+ *     its first payload byte is a PROTO_STATUS_xxx code
+ *   - A retransmitted request keeps its SEQ; the responder resends the
+ *     cached reply (PROTO_ReplayReply) instead of running it again. It
+ *     keeps the last reply for each SEQ modulo PROTO_REPLY_CACHE, and the
+ *     HMI keeps the requests it has in flight on distinct ones, so none
+ *     of their replies is overwritten before it is done
+ *
+ * The decoder drops bytes until it sees SYNC and re-scans a rejected frame
+ * for the next SYNC, so a lost or corrupted byte costs at most one frame.
+ *
+ * Built with PROTO_SECURE (the default) every frame is sealed (seclink.h)
+ * once the HMI has opened a session; see "Sealed link" below. The layout
+ * above stays, with TYPE | PROTO_SEAL_FLAG and LEN covering the sealed
+ * body:
+ *
+ *   | COUNTER (2) | PAYLOAD, encrypted | TAG (8) |
+ ******************************************************************************/
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include <stdint.h>
+#include "seclink.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+/* Seal every frame (1) or build the plain protocol (0); both ECUs must
+ * be built the same */
+#ifndef PROTO_SECURE
+#define PROTO_SECURE            1
+#endif
+
+#define PROTO_SYNC              0xA5
+#define PROTO_HEADER_SIZE       4       /* SYNC, TYPE, SEQ, LEN */
+#define PROTO_CRC_SIZE          2
+#define PROTO_MAX_PAYLOAD       32
+#if PROTO_SECURE
+#define PROTO_SEAL_SIZE         SECLINK_OVERHEAD
+#else
+#define PROTO_SEAL_SIZE         0
+#endif
+#define PROTO_OVERHEAD          (PROTO_HEADER_SIZE + PROTO_SEAL_SIZE + PROTO_CRC_SIZE)
+#define PROTO_MAX_FRAME         (PROTO_MAX_PAYLOAD + PROTO_OVERHEAD)
+#define PROTO_REPLY_CACHE       4       /* replies kept for retransmissions, by
+                                           SEQ; a multiple of LINK_MAX_PENDING
+                                           dividing 256 */
+
+#define PROTO_REPLY_FLAG        0x80
+#define PROTO_SEAL_FLAG         0x20    /* on the wire only, see PROTO_SECURE */
+
+/* Commands HMI -> Control (legacy ASCII opcode in brackets) */
+#define PROTO_CMD_EEPROM_INIT       0x01    /* ['B'] reply: status */
+#define PROTO_CMD_PASSWORD_STATUS   0x02    /* ['C'] reply: status, present */
+#define PROTO_CMD_GET_TIMEOUT       0x03    /* ['D'] reply: status, timeout */
+#define PROTO_CMD_VERIFY_PASSWORD   0x04    /* ['E'] payload: 5 digits, sealed
+                                               reply: status, user id if OK,
+                                               seconds left if LOCKED */
+#define PROTO_CMD_OPEN_DOOR         0x05    /* ['F'] reply sent once unlocked */
+#define PROTO_CMD_ALARM             0x06    /* ['G'] (lockouts sound it on their own) */
+#define PROTO_CMD_STORE_PASSWORD    0x07    /* ['H'] payload: 5 digits, sealed
+                                               reply: status, words written */
+#define PROTO_CMD_STORE_TIMEOUT     0x08    /* ['I'] payload: timeout (s)
+                                               reply: status, words written */
+#define PROTO_CMD_FACTORY_RESET     0x09    /* ['J'] payload: none or PROTO_RESET_xxx */
+#define PROTO_CMD_BOOT_SNAPSHOT     0x0A    /* replaces 'B','C','D' at boot */
+#define PROTO_CMD_LOCK_NOW          0x0B    /* end the auto-lock wait now */
+#define PROTO_CMD_DOOR_STATUS       0x0C    /* reply: status, door, seconds */
+#define PROTO_CMD_SET_BAUD          0x0D    /* payload: baud (4 bytes, MSB first) */
+#define PROTO_CMD_PING              0x0E    /* reply: status */
+#define PROTO_CMD_SUBSCRIBE         0x0F    /* payload: 1 = on, 0 = off
+                                               reply: status, telemetry */
+#define PROTO_CMD_PIN_DIGIT         0x10    /* payload: session, index, digit, sealed
+                                               reply: status, session, missing
+                                               [, user id / seconds left] */
+#define PROTO_CMD_EEPROM_SCAN       0x11    /* reply: status, system clock cycles of
+                                               a full 2 KB read word by word,
+                                               then in bursts (4 bytes each,
+                                               MSB first) */
+#define PROTO_CMD_EEPROM_STATS      0x12    /* payload: PROTO_STATS_xxx [, first block]
+                                               reply: see below */
+#define PROTO_CMD_USER_ADD          0x13    /* payload: master password (5 digits),
+                                               user id, user PIN (5 digits), sealed
+                                               reply: status [, seconds left] */
+#define PROTO_CMD_USER_REVOKE       0x14    /* payload: master password (5 digits),
+                                               user id, sealed
+                                               reply: status [, seconds left] */
+#define PROTO_CMD_AUDIT_QUERY       0x15    /* payload: from, to (s, 4 bytes each)
+                                               reply: status, now (s, 4 bytes),
+                                               entries (2 bytes), then the
+                                               entries as PROTO_EVT_AUDIT */
+#define PROTO_CMD_HASH_SCAN         0x16    /* reply: status, system clock (Hz),
+                                               iterations of a PIN check, then in
+                                               cycles: PROTO_HASH_SCAN_BLOCKS SHA-256
+                                               blocks, one PIN check, then
+                                               PROTO_HASH_SCAN_SEALS times: opening
+                                               a sealed VERIFY_PASSWORD, drawing a
+                                               challenge (4 bytes each, MSB first) */
+#define PROTO_CMD_HELLO             0x17    /* payload: HMI nonce, in clear
+                                               reply: status, Control nonce,
+                                               confirm tag, in clear */
+
+/* Events Control -> HMI (not replies, SEQ is the sender's own counter) */
+#define PROTO_EVT_DOOR_LOCKED       0x40    /* ['l'] door cycle finished */
+#define PROTO_EVT_TELEMETRY         0x41    /* payload: telemetry (subscribed) */
+#define PROTO_EVT_AUDIT             0x42    /* payload: index of the first entry in
+                                               the query (2 bytes), then up to
+                                               PROTO_AUDIT_PER_EVENT entries */
+#define PROTO_EVT_CHALLENGE         0x43    /* payload: the new PIN challenge */
+
+/* Reply status codes */
+#define PROTO_STATUS_OK             0x00
+#define PROTO_STATUS_FAIL           0x01
+#define PROTO_STATUS_WRONG_PASSWORD 0x02
+#define PROTO_STATUS_BAD_REQUEST    0x03
+#define PROTO_STATUS_BUSY           0x04
+#define PROTO_STATUS_LOCKED         0x05    /* PIN checks locked out; seconds left
+                                               (2 bytes) where the command says */
+#define PROTO_STATUS_STALE          0x06    /* sealed PIN frame refused: challenge
+                                               spent or tag wrong; the reply
+                                               carries the current challenge */
+#define PROTO_STATUS_NO_SESSION     0x07    /* sealed link: frame not opened,
+                                               sent in clear (PROTO_CMD_HELLO) */
+
+/* Door cycle phases (PROTO_CMD_DOOR_STATUS) */
+#define PROTO_DOOR_LOCKED           0
+#define PROTO_DOOR_UNLOCKING        1
+#define PROTO_DOOR_OPEN             2       /* waiting for auto-lock */
+#define PROTO_DOOR_HOLD             3       /* grace period before locking */
+#define PROTO_DOOR_LOCKING          4
+
+/* Boot snapshot reply: status byte followed by these fields */
+#define PROTO_SNAP_EEPROM           0       /* PROTO_STATUS_xxx of EEPROM_Init */
+#define PROTO_SNAP_PASSWORD         1       /* 1 if a password is stored */
+#define PROTO_SNAP_TIMEOUT          2       /* auto-lock timeout (s) */
+#define PROTO_SNAP_LOCKOUT          3       /* lockout seconds left (2 bytes, MSB
+                                               first), 0 = none */
+#define PROTO_SNAP_CHALLENGE        5       /* PIN challenge (PINAUTH_CHALLENGE_SIZE) */
+#define PROTO_SNAP_SIZE             13
+
+/* Telemetry record (PROTO_EVT_TELEMETRY, PROTO_CMD_SUBSCRIBE reply). Once
+ * subscribed, Control_ECU sends it whenever any field changes. */
+#define PROTO_TLM_DOOR              0       /* PROTO_DOOR_xxx */
+#define PROTO_TLM_MOTOR             1       /* PROTO_MOTOR_xxx */
+#define PROTO_TLM_SECONDS           2       /* seconds left in the door phase
+                                               (auto-lock countdown when OPEN) */
+#define PROTO_TLM_FLAGS             3       /* PROTO_TLM_xxx bits below */
+#define PROTO_TLM_LOCKOUT           4       /* lockout seconds left (2 bytes, MSB
+                                               first), 0 = none */
+#define PROTO_TLM_SIZE              6
+
+#define PROTO_TLM_BUZZER            0x01    /* buzzer sounding */
+#define PROTO_TLM_EEPROM_BUSY       0x02    /* EEPROM write / erase running */
+
+#define PROTO_MOTOR_STOPPED         0
+#define PROTO_MOTOR_CW              1       /* unlocking */
+#define PROTO_MOTOR_CCW             2       /* locking */
+
+/* Factory reset modes (PROTO_CMD_FACTORY_RESET, no payload = LOGICAL) */
+#define PROTO_RESET_LOGICAL         0       /* void the config record, scrub later */
+#define PROTO_RESET_FULL            1       /* every EEPROM block erased first */
+
+/* EEPROM diagnostics (PROTO_CMD_EEPROM_STATS), values 4 bytes MSB first.
+ * COUNTS and TIMES are since reset and fail on a build without
+ * EEPROM_PROFILE; WEAR is the lifetime table of wear.h. */
+#define PROTO_STATS_COUNTS          0       /* reply: status, words read, programmed,
+                                               skipped (equal), retries, timed programs */
+#define PROTO_STATS_TIMES           1       /* reply: status, system clock (Hz), then in
+                                               cycles: programs total, longest program,
+                                               last queued write, longest queued write */
+#define PROTO_STATS_WEAR            2       /* payload: mode, first block
+                                               reply: status, first block, then the
+                                               words programmed of up to
+                                               PROTO_STATS_WEAR_BLOCKS blocks */
+#define PROTO_STATS_WEAR_BLOCKS     7
+
+/* PIN hash benchmark (PROTO_CMD_HASH_SCAN) */
+#define PROTO_HASH_SCAN_BLOCKS      512
+#define PROTO_HASH_SCAN_SEALS       64
+
+/* Sealed PIN frames (Shared/pinauth.h)
+ * Every payload carrying digits is sealed with Control_ECU's current
+ * challenge: the digits are masked and a tag of PINAUTH_TAG_SIZE bytes
+ * is appended, after the payload described above. Each challenge opens
+ * one request, or one PIN_DIGIT session; Control_ECU then draws the
+ * next and sends it as PROTO_EVT_CHALLENGE ahead of the reply. A frame
+ * sealed with any other challenge, or whose tag is wrong, is answered
+ * PROTO_STATUS_STALE with the current one, for the HMI to seal again. */
+
+/* Sealed link (PROTO_SECURE, Shared/seclink.h)
+ * Nothing but PROTO_CMD_HELLO and its reply goes out in clear. The HMI
+ * sends HELLO with a fresh nonce; Control_ECU draws one of its own,
+ * starts the session and answers with it and the confirm tag, and the
+ * HMI starts the same session once the tag checks. A HELLO repeating the
+ * nonce of the current session gets the same answer. Control_ECU answers
+ * any other plain request, and any sealed one that does not open (no
+ * session since its reset, a replay, a forgery), PROTO_STATUS_NO_SESSION
+ * in clear; the HMI then opens a new session and sends it again. The
+ * cached reply of PROTO_ReplayReply is sealed again with a new counter. */
+
+/* Users (PROTO_CMD_USER_xxx), ids 2 bytes MSB first
+ * Besides the master password, Control_ECU keeps a table of users with a
+ * PIN of their own; adding or revoking one takes the master password.
+ * A PIN that verifies (VERIFY_PASSWORD, the last PIN_DIGIT) is answered
+ * with the id it belongs to; only PROTO_USER_MASTER may change settings.
+ * USER_ADD fails for an id or a PIN already enrolled or a full table. */
+#define PROTO_USER_MASTER           0       /* the password of the config record */
+#define PROTO_USER_MAX              510     /* user ids 1..PROTO_USER_MAX */
+
+/* Access log (PROTO_CMD_AUDIT_QUERY), values MSB first
+ * The query is answered at once with the number of entries logged from
+ * 'from' to 'to' inclusive; Control_ECU then streams them, oldest first,
+ * a few per main loop pass in PROTO_EVT_AUDIT events, while it goes on
+ * serving requests. An entry overwritten in the meantime is skipped; its
+ * index is not sent. A new query replaces one still streaming. Times are
+ * the log's own clock in seconds (see Control_ECU/Application/audit.h);
+ * 'now' in the reply lines it up with the host's. */
+#define PROTO_AUDIT_ENTRY_SIZE      8       /* time (4), event, result, user id (2) */
+#define PROTO_AUDIT_PER_EVENT       3
+#define PROTO_AUDIT_NOBODY          0xFFFF  /* user id of an entry for nobody */
+
+#define PROTO_AUDIT_BOOT            0       /* Control_ECU started */
+#define PROTO_AUDIT_VERIFY          1       /* PIN check: result, user if OK */
+#define PROTO_AUDIT_DOOR            2       /* door opened for the last verified user */
+#define PROTO_AUDIT_ALARM           3
+#define PROTO_AUDIT_PASSWORD        4       /* master password stored */
+#define PROTO_AUDIT_TIMEOUT         5       /* auto-lock timeout stored */
+#define PROTO_AUDIT_USER_ADD        6       /* user: the one enrolled */
+#define PROTO_AUDIT_USER_REVOKE     7       /* user: the one revoked */
+#define PROTO_AUDIT_RESET           8       /* factory reset */
+#define PROTO_AUDIT_LOCKOUT         9       /* wrong PINs started a lockout */
+
+/* Streamed PIN verification (PROTO_CMD_PIN_DIGIT)
+ * Each digit is sent as it is typed, tagged with a session number the HMI
+ * changes for every PIN entry and the digit's index (0..4). Control_ECU
+ * collects the digits as they arrive, in any order, and checks the PIN
+ * once the last one is in. The whole session is sealed with one
+ * challenge, the one current at its first digit; the first frame of the
+ * session to arrive spends it. The reply carries the number of digits
+ * still missing; the one that brings it to 0 carries the verdict
+ * (PROTO_STATUS_OK or PROTO_STATUS_WRONG_PASSWORD) in its status, and
+ * the user id if OK. */
+
+/* Baud negotiation (PROTO_CMD_SET_BAUD)
+ *   1. The initiator sends SET_BAUD at the current rate. The responder
+ *      answers at the current rate, then switches once the reply is out.
+ *   2. The initiator switches and sends PING at the new rate.
+ *   3. A responder that sees no good frame within PROTO_BAUD_PROBATION_MS
+ *      of switching goes back to UART5_DEFAULT_BAUD, and so does the
+ *      initiator if PING is not answered.
+ * After that, either side drops to UART5_DEFAULT_BAUD on its own when
+ * PROTO_BAUD_ERROR_LIMIT receive errors arrive within
+ * PROTO_BAUD_ERROR_WINDOW_MS. A peer still on the fast rate then sees
+ * framing errors from the slow bytes and follows. */
+#define PROTO_BAUD_PROBATION_MS     200
+#define PROTO_BAUD_ERROR_LIMIT      4
+#define PROTO_BAUD_ERROR_WINDOW_MS  1000
+
+/* Return codes */
+#define PROTO_NO_FRAME          0
+#define PROTO_FRAME_READY       1       /* opened if sealed */
+#define PROTO_FRAME_PLAIN       2       /* PROTO_SECURE: sent in clear */
+#define PROTO_FRAME_REFUSED     3       /* PROTO_SECURE: sealed, did not open;
+                                           type and seq only, length 0 */
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t seq;
+    uint8_t length;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+} PROTO_Frame;
+
+typedef struct
+{
+    uint8_t  raw[PROTO_MAX_FRAME];  /* bytes of the frame being assembled */
+    uint8_t  count;
+    uint32_t crc_errors;            /* frames rejected by CRC or length */
+    uint32_t refused;               /* sealed frames that did not open */
+} PROTO_Parser;
+
+/* Receive error burst detector for the baud fallback */
+typedef struct
+{
+    uint32_t errors;                /* UART5 error count at window start */
+    uint32_t window_start;          /* ms */
+} PROTO_ErrorWatch;
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * PROTO_Crc16
+ * Continues a CRC-16/CCITT-FALSE over length bytes (start with 0xFFFF).
+ */
+uint16_t PROTO_Crc16(uint16_t crc, const uint8_t *data, uint32_t length);
+
+/*
+ * PROTO_Encode
+ * Builds a complete plain frame into out (at least PROTO_MAX_FRAME bytes).
+ * Returns: frame size in bytes, 0 if length exceeds PROTO_MAX_PAYLOAD
+ */
+uint32_t PROTO_Encode(uint8_t type, uint8_t seq, const uint8_t *payload,
+                      uint8_t length, uint8_t *out);
+
+/*
+ * PROTO_ParserReset
+ * Discards any partially received frame.
+ */
+void PROTO_ParserReset(PROTO_Parser *parser);
+
+/*
+ * PROTO_ParserFeed
+ * Pushes one received byte into the decoder. A sealed frame is opened in
+ * the assembly buffer and only its plain payload is copied out.
+ * Returns: PROTO_FRAME_READY when frame holds a complete, CRC-checked frame
+ *          (opened, if sealed), PROTO_FRAME_PLAIN / PROTO_FRAME_REFUSED
+ *          (PROTO_SECURE only) for a plain frame / one that did not open
+ */
+uint8_t PROTO_ParserFeed(PROTO_Parser *parser, uint8_t byte, PROTO_Frame *frame);
+
+/*
+ * PROTO_Send
+ * Encodes a frame, sealed in place under the session (PROTO_SECURE), and
+ * queues it on UART5 (blocks only while the TX ring is full).
+ * Returns: 1 on success, 0 if the payload is too long or, sealed, if no
+ *          session is open (nothing is sent)
+ */
+uint8_t PROTO_Send(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length);
+
+/*
+ * PROTO_SendPlain
+ * PROTO_Send in clear, whatever PROTO_SECURE (PROTO_CMD_HELLO).
+ */
+uint8_t PROTO_SendPlain(uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length);
+
+/*
+ * PROTO_Reply
+ * Sends the reply to request with the given status and extra payload,
+ * sealed as PROTO_Send.
+ */
+uint8_t PROTO_Reply(const PROTO_Frame *request, uint8_t status,
+                    const uint8_t *data, uint8_t length);
+
+/*
+ * PROTO_ReplyPlain
+ * PROTO_Reply in clear, and not cached for PROTO_ReplayReply (replies
+ * to PROTO_CMD_HELLO, PROTO_STATUS_NO_SESSION).
+ */
+uint8_t PROTO_ReplyPlain(const PROTO_Frame *request, uint8_t status,
+                         const uint8_t *data, uint8_t length);
+
+/*
+ * PROTO_ReplayReply
+ * If request repeats the TYPE and SEQ of the last request with its SEQ
+ * modulo PROTO_REPLY_CACHE answered with PROTO_Reply, resends that reply
+ * (sealed again with a new counter).
+ * Returns: 1 if the request was a retransmission and has been answered
+ */
+uint8_t PROTO_ReplayReply(const PROTO_Frame *request);
+
+/*
+ * PROTO_ErrorBurst
+ * Samples the UART5 receive error counters. now_ms is the caller's
+ * millisecond clock.
+ * Returns: 1 when PROTO_BAUD_ERROR_LIMIT errors arrived within
+ * PROTO_BAUD_ERROR_WINDOW_MS (the window then restarts)
+ */
+uint8_t PROTO_ErrorBurst(PROTO_ErrorWatch *watch, uint32_t now_ms);
+
+/*
+ * PROTO_Poll
+ * Drains every byte currently buffered by UART5 into the decoder and stops
+ * at the first complete frame. Never blocks.
+ * Returns: as PROTO_ParserFeed, PROTO_NO_FRAME if no frame is complete
+ */
+uint8_t PROTO_Poll(PROTO_Parser *parser, PROTO_Frame *frame);
+
+/*
+ * PROTO_Secured
+ * Returns: 1 if PROTO_Send can send: a session is open, or always
+ *          without PROTO_SECURE
+ */
+uint8_t PROTO_Secured(void);
+
+#if PROTO_SECURE
+/*
+ * PROTO_SecureStart
+ * (Re)starts the session of the link (SecLink_Start) for this side.
+ * Parameters:
+ *   role          - SECLINK_HMI or SECLINK_CONTROL
+ *   hmi_nonce     - SECLINK_NONCE_SIZE bytes
+ *   control_nonce - SECLINK_NONCE_SIZE bytes
+ *   confirm       - Receives the SECLINK_TAG_SIZE-byte confirm tag
+ */
+void PROTO_SecureStart(uint8_t role, const uint8_t *hmi_nonce,
+                       const uint8_t *control_nonce, uint8_t *confirm);
+
+/*
+ * PROTO_SecureStop
+ * Closes the session: nothing is sent sealed or opened until the next
+ * PROTO_SecureStart.
+ */
+void PROTO_SecureStop(void);
+#endif
+
+#endif /* PROTOCOL_H_ */
@@ -0,0 +1,349 @@
+/******************************************************************************
+ * File: seclink.c
+ * Module: Secure Link
+ * Description: ChaCha20-Poly1305 sealing of the frames sent over UART5
+ ******************************************************************************/
+
+#include <string.h>
+#include "seclink.h"
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define CHACHA_BLOCK_SIZE       64
+#define CHACHA_BLOCK_WORDS      16
+#define POLY_BLOCK_SIZE         16
+#define POLY_LIMB_MASK          0x3FFFFFFU
+
+/* Nonce bytes 0-3 as a word; zero on the link, set by the RFC 8439 test */
+#ifndef SECLINK_NONCE_FIXED
+#define SECLINK_NONCE_FIXED     0U
+#endif
+
+#define ROTL32(x, b)            (((x) << (b)) | ((x) >> (32 - (b))))
+
+#define QUARTERROUND(a, b, c, d)                                              \
+    do {                                                                      \
+        a += b; d ^= a; d = ROTL32(d, 16);                                    \
+        c += d; b ^= c; b = ROTL32(b, 12);                                    \
+        a += b; d ^= a; d = ROTL32(d, 8);                                     \
+        c += d; b ^= c; b = ROTL32(b, 7);                                     \
+    } while(0)
+
+/******************************************************************************
+ *                          Private Types                                      *
+ ******************************************************************************/
+
+/* Poly1305 accumulator, key and pad, 26-bit limbs */
+typedef struct
+{
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[2];                /* the tag is truncated to these words */
+} SecLink_Poly;
+
+/******************************************************************************
+ *                          Private Data                                       *
+ ******************************************************************************/
+
+static const uint8_t link_key[SECLINK_KEY_SIZE] = { SECLINK_KEY };
+
+/******************************************************************************
+ *                          Private Functions                                  *
+ ******************************************************************************/
+
+static uint32_t SecLink_Load32(const uint8_t *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) |
+           ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static void SecLink_Store32(uint8_t *out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+/*
+ * SecLink_Block
+ * One ChaCha20 block: key is 8 words, input the 4 words of block counter
+ * and nonce.
+ */
+static void SecLink_Block(const uint32_t *key, const uint32_t *input, uint32_t *out)
+{
+    uint32_t x[CHACHA_BLOCK_WORDS];
+    uint8_t i;
+
+    x[0] = 0x61707865U;             /* "expand 32-byte k" */
+    x[1] = 0x3320646EU;
+    x[2] = 0x79622D32U;
+    x[3] = 0x6B206574U;
+    for(i = 0; i < 8; i++)
+    {
+        x[4 + i] = key[i];
+    }
+    for(i = 0; i < 4; i++)
+    {
+        x[12 + i] = input[i];
+    }
+    memcpy(out, x, sizeof(x));
+
+    for(i = 0; i < 10; i++)
+    {
+        QUARTERROUND(x[0], x[4], x[8],  x[12]);
+        QUARTERROUND(x[1], x[5], x[9],  x[13]);
+        QUARTERROUND(x[2], x[6], x[10], x[14]);
+        QUARTERROUND(x[3], x[7], x[11], x[15]);
+        QUARTERROUND(x[0], x[5], x[10], x[15]);
+        QUARTERROUND(x[1], x[6], x[11], x[12]);
+        QUARTERROUND(x[2], x[7], x[8],  x[13]);
+        QUARTERROUND(x[3], x[4], x[9],  x[14]);
+    }
+
+    for(i = 0; i < CHACHA_BLOCK_WORDS; i++)
+    {
+        out[i] += x[i];
+    }
+}
+
+/* Keystream block 'block' of message 'counter' (nonce 0 | counter) */
+static void SecLink_Keystream(const uint32_t *key, uint64_t counter, uint32_t block, uint32_t *out)
+{
+    uint32_t input[4];
+
+    input[0] = block;
+    input[1] = SECLINK_NONCE_FIXED;
+    input[2] = (uint32_t)counter;
+    input[3] = (uint32_t)(counter >> 32);
+    SecLink_Block(key, input, out);
+}
+
+/* XORs data with the keystream from block 1 on (block 0 keys Poly1305) */
+static void SecLink_Crypt(const uint32_t *key, uint64_t counter, uint8_t *data, uint8_t length)
+{
+    uint32_t stream[CHACHA_BLOCK_WORDS];
+    uint32_t block = 1;
+    uint8_t i;
+
+    while(length > 0)
+    {
+        SecLink_Keystream(key, counter, block++, stream);
+        for(i = 0; i < CHACHA_BLOCK_SIZE && i < length; i++)
+        {
+            data[i] ^= (uint8_t)(stream[i / 4] >> (8 * (i % 4)));
+        }
+        data += i;
+        length -= i;
+    }
+}
+
+/* Clamps r and keeps the pad words of a one-time key (keystream block 0) */
+static void SecLink_PolyInit(SecLink_Poly *poly, const uint32_t *key)
+{
+    poly->r[0] =   key[0]                        & 0x3FFFFFFU;
+    poly->r[1] = ((key[0] >> 26) | (key[1] << 6))  & 0x3FFFF03U;
+    poly->r[2] = ((key[1] >> 20) | (key[2] << 12)) & 0x3FFC0FFU;
+    poly->r[3] = ((key[2] >> 14) | (key[3] << 18)) & 0x3F03FFFU;
+    poly->r[4] =  (key[3] >> 8)                  & 0x00FFFFFU;
+    memset(poly->h, 0, sizeof(poly->h));
+    poly->pad[0] = key[4];
+    poly->pad[1] = key[5];
+}
+
+/*
+ * SecLink_PolyBlocks
+ * Absorbs data zero-padded to whole blocks, as the AEAD pads the
+ * associated data and the ciphertext.
+ */
+static void SecLink_PolyBlocks(SecLink_Poly *poly, const uint8_t *data, uint8_t length)
+{
+    const uint32_t *r = poly->r;
+    uint32_t *h = poly->h;
+    uint32_t s1 = r[1] * 5U;
+    uint32_t s2 = r[2] * 5U;
+    uint32_t s3 = r[3] * 5U;
+    uint32_t s4 = r[4] * 5U;
+    uint8_t  block[POLY_BLOCK_SIZE];
+    uint64_t d0, d1, d2, d3, d4;
+    uint32_t c;
+    uint8_t  take;
+
+    while(length > 0)
+    {
+        take = (length < POLY_BLOCK_SIZE) ? length : POLY_BLOCK_SIZE;
+        memset(block, 0, sizeof(block));
+        memcpy(block, data, take);
+        data += take;
+        length -= take;
+
+        h[0] +=  SecLink_Load32(&block[0])        & POLY_LIMB_MASK;
+        h[1] += (SecLink_Load32(&block[3]) >> 2)  & POLY_LIMB_MASK;
+        h[2] += (SecLink_Load32(&block[6]) >> 4)  & POLY_LIMB_MASK;
+        h[3] += (SecLink_Load32(&block[9]) >> 6)  & POLY_LIMB_MASK;
+        h[4] += (SecLink_Load32(&block[12]) >> 8) | (1U << 24);
+
+        d0 = (uint64_t)h[0] * r[0] + (uint64_t)h[1] * s4 + (uint64_t)h[2] * s3 +
+             (uint64_t)h[3] * s2 + (uint64_t)h[4] * s1;
+        d1 = (uint64_t)h[0] * r[1] + (uint64_t)h[1] * r[0] + (uint64_t)h[2] * s4 +
+             (uint64_t)h[3] * s3 + (uint64_t)h[4] * s2;
+        d2 = (uint64_t)h[0] * r[2] + (uint64_t)h[1] * r[1] + (uint64_t)h[2] * r[0] +
+             (uint64_t)h[3] * s4 + (uint64_t)h[4] * s3;
+        d3 = (uint64_t)h[0] * r[3] + (uint64_t)h[1] * r[2] + (uint64_t)h[2] * r[1] +
+             (uint64_t)h[3] * r[0] + (uint64_t)h[4] * s4;
+        d4 = (uint64_t)h[0] * r[4] + (uint64_t)h[1] * r[3] + (uint64_t)h[2] * r[2] +
+             (uint64_t)h[3] * r[1] + (uint64_t)h[4] * r[0];
+
+        c = (uint32_t)(d0 >> 26); h[0] = (uint32_t)d0 & POLY_LIMB_MASK;
+        d1 += c; c = (uint32_t)(d1 >> 26); h[1] = (uint32_t)d1 & POLY_LIMB_MASK;
+        d2 += c; c = (uint32_t)(d2 >> 26); h[2] = (uint32_t)d2 & POLY_LIMB_MASK;
+        d3 += c; c = (uint32_t)(d3 >> 26); h[3] = (uint32_t)d3 & POLY_LIMB_MASK;
+        d4 += c; c = (uint32_t)(d4 >> 26); h[4] = (uint32_t)d4 & POLY_LIMB_MASK;
+        h[0] += c * 5U; c = h[0] >> 26; h[0] &= POLY_LIMB_MASK;
+        h[1] += c;
+    }
+}
+
+/* Fully reduces h mod 2^130 - 5 and adds the pad: first 8 tag bytes */
+static void SecLink_PolyFinish(SecLink_Poly *poly, uint8_t *tag)
+{
+    uint32_t *h = poly->h;
+    uint32_t g[5];
+    uint32_t c;
+    uint32_t mask;
+    uint64_t f;
+    uint8_t i;
+
+    c = h[1] >> 26; h[1] &= POLY_LIMB_MASK;
+    h[2] += c; c = h[2] >> 26; h[2] &= POLY_LIMB_MASK;
+    h[3] += c; c = h[3] >> 26; h[3] &= POLY_LIMB_MASK;
+    h[4] += c; c = h[4] >> 26; h[4] &= POLY_LIMB_MASK;
+    h[0] += c * 5U; c = h[0] >> 26; h[0] &= POLY_LIMB_MASK;
+    h[1] += c;
+
+    /* g = h + 5 - 2^130, kept if it did not go negative */
+    g[0] = h[0] + 5U; c = g[0] >> 26; g[0] &= POLY_LIMB_MASK;
+    for(i = 1; i < 5; i++)
+    {
+        g[i] = h[i] + c; c = g[i] >> 26; g[i] &= POLY_LIMB_MASK;
+    }
+    g[4] = (g[4] | (c << 26)) - (1U << 26);
+    mask = (g[4] >> 31) - 1U;
+    for(i = 0; i < 5; i++)
+    {
+        h[i] = (h[i] & ~mask) | (g[i] & mask);
+    }
+
+    f = (uint64_t)(h[0] | (h[1] << 26)) + poly->pad[0];
+    SecLink_Store32(&tag[0], (uint32_t)f);
+    f = (uint64_t)((h[1] >> 6) | (h[2] << 20)) + poly->pad[1] + (f >> 32);
+    SecLink_Store32(&tag[4], (uint32_t)f);
+}
+
+/*
+ * SecLink_Tag
+ * AEAD tag (first SECLINK_TAG_SIZE bytes) of ad and ciphertext under
+ * message counter.
+ */
+static void SecLink_Tag(const uint32_t *key, uint64_t counter, const uint8_t *ad, uint8_t ad_length,
+                        const uint8_t *ciphertext, uint8_t length, uint8_t *tag)
+{
+    uint32_t one_time[CHACHA_BLOCK_WORDS];
+    uint8_t lengths[POLY_BLOCK_SIZE] = {0};
+    SecLink_Poly poly;
+
+    SecLink_Keystream(key, counter, 0, one_time);
+    SecLink_PolyInit(&poly, one_time);
+    SecLink_PolyBlocks(&poly, ad, ad_length);
+    SecLink_PolyBlocks(&poly, ciphertext, length);
+    lengths[0] = ad_length;
+    lengths[8] = length;
+    SecLink_PolyBlocks(&poly, lengths, POLY_BLOCK_SIZE);
+    SecLink_PolyFinish(&poly, tag);
+}
+
+/******************************************************************************
+ *                          Public Functions                                   *
+ ******************************************************************************/
+
+void SecLink_Start(SecLink_Session *session, uint8_t role, const uint8_t *hmi_nonce,
+                   const uint8_t *control_nonce, uint8_t *confirm)
+{
+    uint32_t key[SECLINK_KEY_SIZE / 4];
+    uint32_t input[4];
+    uint32_t derived[CHACHA_BLOCK_WORDS];
+    uint8_t nonces[2 * SECLINK_NONCE_SIZE];
+    uint8_t i;
+
+    for(i = 0; i < SECLINK_KEY_SIZE / 4; i++)
+    {
+        key[i] = SecLink_Load32(&link_key[4 * i]);
+    }
+    memcpy(nonces, hmi_nonce, SECLINK_NONCE_SIZE);
+    memcpy(&nonces[SECLINK_NONCE_SIZE], control_nonce, SECLINK_NONCE_SIZE);
+    for(i = 0; i < 4; i++)
+    {
+        input[i] = SecLink_Load32(&nonces[4 * i]);
+    }
+    SecLink_Block(key, input, derived);
+
+    /* words 0-7: HMI -> Control, 8-15: Control -> HMI */
+    memcpy(session->tx_key, &derived[(role == SECLINK_HMI) ? 0 : 8], sizeof(session->tx_key));
+    memcpy(session->rx_key, &derived[(role == SECLINK_HMI) ? 8 : 0], sizeof(session->rx_key));
+    session->tx_counter = 0;
+    session->rx_counter = 0;
+    session->active = 1;
+
+    SecLink_Tag(&derived[8], 0, nonces, sizeof(nonces), 0, 0, confirm);
+    memset(key, 0, sizeof(key));
+    memset(derived, 0, sizeof(derived));
+}
+
+void SecLink_Seal(SecLink_Session *session, const uint8_t *header, uint8_t *body, uint8_t length)
+{
+    uint64_t counter = ++session->tx_counter;
+    uint8_t *data = &body[SECLINK_COUNTER_SIZE];
+
+    body[0] = (uint8_t)counter;
+    body[1] = (uint8_t)(counter >> 8);
+    SecLink_Crypt(session->tx_key, counter, data, length);
+    SecLink_Tag(session->tx_key, counter, header, SECLINK_HEADER_SIZE, data, length, &data[length]);
+}
+
+uint8_t SecLink_Open(SecLink_Session *session, const uint8_t *header, uint8_t *body, uint8_t length)
+{
+    uint8_t tag[SECLINK_TAG_SIZE];
+    uint8_t *data = &body[SECLINK_COUNTER_SIZE];
+    uint64_t counter;
+    uint8_t differ = 0;
+    uint8_t i;
+
+    if(!session->active || length < SECLINK_OVERHEAD)
+    {
+        return 0;
+    }
+    length -= SECLINK_OVERHEAD;
+
+    /* The smallest counter above the last accepted one with these low bytes */
+    counter = (session->rx_counter & ~(uint64_t)0xFFFF) | body[0] | ((uint16_t)body[1] << 8);
+    if(counter <= session->rx_counter)
+    {
+        counter += 0x10000;
+    }
+
+    SecLink_Tag(session->rx_key, counter, header, SECLINK_HEADER_SIZE, data, length, tag);
+    for(i = 0; i < SECLINK_TAG_SIZE; i++)
+    {
+        differ |= (uint8_t)(data[length + i] ^ tag[i]);
+    }
+    if(differ != 0)
+    {
+        return 0;
+    }
+
+    session->rx_counter = counter;
+    SecLink_Crypt(session->rx_key, counter, data, length);
+    return 1;
+}
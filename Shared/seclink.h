@@ -0,0 +1,121 @@
+/******************************************************************************
+ * File: seclink.h
+ * Module: Secure Link
+ * Description: ChaCha20-Poly1305 sealing of the frames sent over UART5
+ *
+ * HMI_ECU and Control_ECU share a link key, SECLINK_KEY, set at build
+ * time for each pair. It is never used on a frame: at boot the HMI sends
+ * a nonce, Control_ECU answers with one of its own, and both derive the
+ * session keys from the pair,
+ *
+ *   HMI -> Control key | Control -> HMI key = ChaCha20(K, hmi | control)
+ *
+ * (the 64-byte block with the 16 nonce bytes in place of counter and
+ * nonce). Control_ECU proves it holds the keys with a confirm tag, the
+ * Poly1305 tag of hmi | control under its sending key with counter 0.
+ * A nonce must never repeat, so each side draws its own: the keys of a
+ * session are new as soon as one of them is.
+ *
+ * Each direction then seals every frame with the AEAD of RFC 8439:
+ *
+ *   - 96-bit nonce: 4 zero bytes | 64-bit message counter, LSB first;
+ *     the sender counts from 1 and never reuses one
+ *   - associated data: the frame header (TYPE, SEQ, LEN)
+ *   - the payload is encrypted in place and the first SECLINK_TAG_SIZE
+ *     bytes of the tag are appended
+ *
+ * Only the SECLINK_COUNTER_SIZE low bytes of the counter travel; the
+ * receiver takes the smallest counter above the last one it accepted
+ * that ends in them, so up to 65535 frames may be lost in a row. A frame
+ * that does not open, or whose counter is not above the last accepted
+ * (a replay), is refused and leaves the session unchanged.
+ *
+ * ChaCha20 is 32-bit add-rotate-xor and Poly1305 runs on 26-bit limbs
+ * with 32x32->64 multiplies (UMULL/UMLAL on the Cortex-M4), so neither
+ * needs tables and both take the same time whatever the data.
+ ******************************************************************************/
+
+#ifndef SECLINK_H_
+#define SECLINK_H_
+
+#include <stdint.h>
+
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+#define SECLINK_KEY_SIZE        32
+#define SECLINK_NONCE_SIZE      8       /* handshake nonce of each side */
+#define SECLINK_COUNTER_SIZE    2
+#define SECLINK_TAG_SIZE        8
+#define SECLINK_OVERHEAD        (SECLINK_COUNTER_SIZE + SECLINK_TAG_SIZE)
+#define SECLINK_HEADER_SIZE     3       /* TYPE, SEQ, LEN */
+
+/* Link key, bytes in order: no default, every pair is built with its own
+ * (-DSECLINK_KEY="0x..,0x..,...", see README "Pairing Keys") */
+#ifndef SECLINK_KEY
+#error "SECLINK_KEY must be provided"
+#endif
+
+/* Side of the link (SecLink_Start) */
+#define SECLINK_HMI             0
+#define SECLINK_CONTROL         1
+
+/******************************************************************************
+ *                              Types                                          *
+ ******************************************************************************/
+
+typedef struct
+{
+    uint32_t tx_key[SECLINK_KEY_SIZE / 4];
+    uint32_t rx_key[SECLINK_KEY_SIZE / 4];
+    uint64_t tx_counter;            /* last sent */
+    uint64_t rx_counter;            /* last accepted */
+    uint8_t  active;
+} SecLink_Session;
+
+/******************************************************************************
+ *                          Function Prototypes                                *
+ ******************************************************************************/
+
+/*
+ * SecLink_Start
+ * Derives the session keys of a nonce pair and resets both counters.
+ * Parameters:
+ *   session       - Session to (re)start
+ *   role          - SECLINK_HMI or SECLINK_CONTROL, picks the sending key
+ *   hmi_nonce     - SECLINK_NONCE_SIZE bytes
+ *   control_nonce - SECLINK_NONCE_SIZE bytes
+ *   confirm       - Receives the SECLINK_TAG_SIZE-byte confirm tag
+ */
+void SecLink_Start(SecLink_Session *session, uint8_t role, const uint8_t *hmi_nonce,
+                   const uint8_t *control_nonce, uint8_t *confirm);
+
+/*
+ * SecLink_Seal
+ * Seals a frame body in place under the next sending counter:
+ *   body[0..SECLINK_COUNTER_SIZE)  receives the counter, LSB first
+ *   then the payload, encrypted     (length bytes, already in place)
+ *   then SECLINK_TAG_SIZE tag bytes
+ * Parameters:
+ *   header - SECLINK_HEADER_SIZE bytes, LEN already the sealed length
+ *   body   - Room for length + SECLINK_OVERHEAD bytes
+ *   length - Plain payload length
+ */
+void SecLink_Seal(SecLink_Session *session, const uint8_t *header, uint8_t *body, uint8_t length);
+
+/*
+ * SecLink_Open
+ * Checks the tag and counter of a sealed body and decrypts the payload in
+ * place (body + SECLINK_COUNTER_SIZE, length - SECLINK_OVERHEAD bytes).
+ * The body is left untouched if it is refused.
+ * Parameters:
+ *   header - SECLINK_HEADER_SIZE bytes as received
+ *   body   - Sealed body
+ *   length - Sealed body length
+ * Returns: 1 if authentic and newer than the last frame accepted, 0 if not
+ *          or if no session is active
+ */
+uint8_t SecLink_Open(SecLink_Session *session, const uint8_t *header, uint8_t *body, uint8_t length);
+
+#endif /* SECLINK_H_ */
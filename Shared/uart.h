@@ -1,13 +1,14 @@
 /******************************************************************************
  * File: uart.h
  * Module: UART (Universal Asynchronous Receiver/Transmitter)
- * Description: Header file for TM4C123GH6PM UART0 Driver (Register Level)
+ * Description: Header file for TM4C123GH6PM UART5 Driver (Register Level)
  * Author: Ahmedhh
  * Date: December 10, 2025
  * 
  * Configuration:
- *   - UART0 (PA0: RX, PA1: TX)
- *   - Baud Rate: 115200
+ *   - UART5 (PE4: RX, PE5: TX)
+ *   - Baud Rate: UART5_DEFAULT_BAUD (115200) at init, then set at run
+ *     time (UART5_SetBaudRate) from the running system clock
  *   - Data: 8 bits
  *   - Parity: None
  *   - Stop: 1 bit
@@ -18,54 +19,158 @@
 
 #include <stdint.h>
 
+/******************************************************************************
+ *                              Definitions                                    *
+ ******************************************************************************/
+
+/* UART5 operating modes (see UART5_InitMode) */
+#define UART5_MODE_POLLING      0
+#define UART5_MODE_INTERRUPT    1
+
+/* Rate set by UART5_Init / UART5_InitMode, and the link fallback rate */
+#define UART5_DEFAULT_BAUD      115200U
+
+/* Interrupt mode ring buffer sizes in bytes (must be powers of two) */
+#ifndef UART5_RX_BUFFER_SIZE
+#define UART5_RX_BUFFER_SIZE    256U
+#endif
+#ifndef UART5_TX_BUFFER_SIZE
+#define UART5_TX_BUFFER_SIZE    128U
+#endif
+
 /******************************************************************************
  *                          Function Prototypes                                *
  ******************************************************************************/
 
 /*
- * UART0_Init
- * Initializes UART0 with 115200 baud rate, 8N1 configuration.
- * Uses PA0 (RX) and PA1 (TX).
- * System clock is assumed to be 16 MHz.
+ * UART5_Init
+ * Initializes UART5 in polling mode at UART5_DEFAULT_BAUD, 8N1.
+ * Uses PE4 (RX) and PE5 (TX).
+ * The divisor is computed from the running system clock.
  */
-void UART0_Init(void);
+void UART5_Init(void);
 
 /*
- * UART0_SendChar
- * Transmits a single character through UART0.
- * Blocks until the transmit FIFO is ready.
+ * UART5_InitMode
+ * Initializes UART5 like UART5_Init, selecting the driver mode.
+ *   UART5_MODE_POLLING   - every call talks to the hardware FIFO directly
+ *   UART5_MODE_INTERRUPT - RX/TX go through ring buffers serviced by
+ *                          UART5_Handler (RX, RX time-out and TX interrupts)
+ * The blocking APIs below work in both modes.
+ */
+void UART5_InitMode(uint8_t mode);
+
+/*
+ * UART5_CheckBaudRate
+ * Returns the rate the hardware would actually produce for baud at the
+ * current system clock, or 0 if it is out of range or more than 2.5% off.
+ * Up to sysclk/16 uses 16x oversampling, up to sysclk/8 uses HSE (8x).
+ */
+uint32_t UART5_CheckBaudRate(uint32_t baud);
+
+/*
+ * UART5_SetBaudRate
+ * Waits for queued TX bytes to go out at the old rate, then reprograms the
+ * divisor. Received bytes already buffered are kept.
+ * Returns: actual rate, or 0 (rate unchanged) if baud is not reachable
+ */
+uint32_t UART5_SetBaudRate(uint32_t baud);
+
+/*
+ * UART5_GetBaudRate
+ * Returns the rate last set (nominal, as passed to UART5_SetBaudRate).
+ */
+uint32_t UART5_GetBaudRate(void);
+
+/*
+ * UART5_Read
+ * Copies up to len received bytes into buf without blocking.
+ *
+ * Returns:
+ *   Number of bytes copied (0 if nothing has been received)
+ */
+uint32_t UART5_Read(uint8_t *buf, uint32_t len);
+
+/*
+ * UART5_Write
+ * Queues up to len bytes from buf for transmission without blocking.
+ *
+ * Returns:
+ *   Number of bytes accepted (less than len when the TX buffer is full)
+ */
+uint32_t UART5_Write(const uint8_t *buf, uint32_t len);
+
+/*
+ * UART5_TxPending
+ * Returns the number of bytes still waiting in the TX ring buffer.
+ */
+uint32_t UART5_TxPending(void);
+
+/*
+ * UART5_GetRxOverflowCount / UART5_GetRxErrorCount
+ * Diagnostic counters: bytes dropped because the RX ring (or hardware FIFO)
+ * was full, and bytes discarded for framing/parity/break/overrun errors.
+ */
+uint32_t UART5_GetRxOverflowCount(void);
+uint32_t UART5_GetRxErrorCount(void);
+
+/*
+ * UART5_Handler
+ * UART5 interrupt service routine (vector table entry for IRQ 61).
+ */
+void UART5_Handler(void);
+
+/*
+ * UART5_SendChar
+ * Transmits a single character through UART5.
+ * Blocks until the TX FIFO (or, in interrupt mode, the TX ring) has room.
  * 
  * Parameters:
  *   data - Character to transmit
  */
-void UART0_SendChar(char data);
+void UART5_SendChar(char data);
 
 /*
- * UART0_ReceiveChar
- * Receives a single character from UART0.
- * Blocks until a character is available in the receive FIFO.
+ * UART5_ReceiveChar
+ * Receives a single character from UART5.
+ * Blocks until a character is available in the RX FIFO (or RX ring).
  * 
  * Returns:
  *   Received character
  */
-char UART0_ReceiveChar(void);
+char UART5_ReceiveChar(void);
 
 /*
- * UART0_SendString
- * Transmits a null-terminated string through UART0.
+ * UART5_SendString
+ * Transmits a null-terminated string through UART5.
  * 
  * Parameters:
  *   str - Pointer to null-terminated string to transmit
  */
-void UART0_SendString(const char *str);
+void UART5_SendString(const char *str);
+
+/*
+ * UART5_ReceiveString
+ * Receives 5 characters into buffer and puts '\n' after them, so buffer
+ * must hold 6.
+ */
+void UART5_ReceiveString(char *buffer);
+
+/*
+ * UART5_SendUInt / UART5_ReceiveUInt
+ * A decimal number followed by '\n'. The receive side skips non-digits
+ * and stops at '\r', '\n' or '\0'.
+ */
+void UART5_SendUInt(uint32_t num);
+uint32_t UART5_ReceiveUInt(void);
 
 /*
- * UART0_IsDataAvailable
- * Checks if data is available in the receive FIFO.
+ * UART5_IsDataAvailable
+ * Checks if data is available in the RX FIFO (or RX ring).
  * 
  * Returns:
  *   1 if data is available, 0 otherwise
  */
-uint8_t UART0_IsDataAvailable(void);
+uint8_t UART5_IsDataAvailable(void);
 
 #endif /* UART_H_ */